@@ -0,0 +1,59 @@
+#include "AsyncComputeScheduler.h"
+
+#include <stdexcept>
+
+AsyncComputeScheduler::AsyncComputeScheduler(CommandQueueSync* graphics,
+                                             CommandQueueSync* compute) {
+  Initialize(graphics, compute);
+}
+
+void AsyncComputeScheduler::Initialize(CommandQueueSync* graphics,
+                                       CommandQueueSync* compute) {
+  if (graphics == nullptr || compute == nullptr) {
+    throw std::invalid_argument("AsyncComputeScheduler needs two queues");
+  }
+  mGraphics = graphics;
+  mCompute = compute;
+  mComputeValue = compute->GetCompletedValue();
+  mGraphicsValue = graphics->GetCompletedValue();
+  mStage = Stage::Idle;
+}
+
+void AsyncComputeScheduler::BeginComputeWork() {
+  if (mStage != Stage::Idle) {
+    throw std::logic_error("BeginComputeWork called out of order");
+  }
+  // The compute allocator is reset right after this call, so every earlier
+  // compute submission has to be finished on the GPU.
+  mCompute->WaitOnCpu(mComputeValue);
+  if (mGraphicsValue > 0) {
+    mCompute->Wait(*mGraphics, mGraphicsValue);
+  }
+  mStage = Stage::ComputeRecording;
+}
+
+uint64_t AsyncComputeScheduler::EndComputeWork() {
+  if (mStage != Stage::ComputeRecording) {
+    throw std::logic_error("EndComputeWork called out of order");
+  }
+  mCompute->Signal(++mComputeValue);
+  mStage = Stage::ComputeSubmitted;
+  return mComputeValue;
+}
+
+void AsyncComputeScheduler::BeginGraphicsConsume() {
+  if (mStage != Stage::ComputeSubmitted) {
+    throw std::logic_error("BeginGraphicsConsume called out of order");
+  }
+  mGraphics->Wait(*mCompute, mComputeValue);
+  mStage = Stage::Consuming;
+}
+
+uint64_t AsyncComputeScheduler::EndGraphicsConsume() {
+  if (mStage != Stage::Consuming) {
+    throw std::logic_error("EndGraphicsConsume called out of order");
+  }
+  mGraphics->Signal(++mGraphicsValue);
+  mStage = Stage::Idle;
+  return mGraphicsValue;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// A command queue together with the fence it signals. Implemented on top of
+// ID3D12CommandQueue/ID3D12Fence by D3D12QueueSync; any other implementation
+// (for example a simulated queue) can drive AsyncComputeScheduler as well.
+class CommandQueueSync {
+ public:
+  virtual ~CommandQueueSync() = default;
+
+  // GPU-side: the queue signals its own fence once previously submitted
+  // work has completed.
+  virtual void Signal(uint64_t value) = 0;
+  // GPU-side: work submitted after this call does not start until the
+  // producer's fence reaches the value.
+  virtual void Wait(CommandQueueSync& producer, uint64_t value) = 0;
+  virtual uint64_t GetCompletedValue() const = 0;
+  // CPU-side: blocks until the queue's fence reaches the value.
+  virtual void WaitOnCpu(uint64_t value) = 0;
+};
+
+// Orders the particle compute work on an async compute queue against the
+// graphics queue. Per frame:
+//   compute:  wait for graphics to finish reading last frame's particles,
+//             run the simulation, signal;
+//   graphics: record work that does not need the particles (geometry,
+//             compose), wait for the compute signal, draw the particles,
+//             signal.
+// Calls must follow that order; violations throw std::logic_error.
+class AsyncComputeScheduler {
+ public:
+  AsyncComputeScheduler() = default;
+  AsyncComputeScheduler(CommandQueueSync* graphics, CommandQueueSync* compute);
+
+  void Initialize(CommandQueueSync* graphics, CommandQueueSync* compute);
+
+  // CPU-waits for the previous compute submission (its allocator is reset
+  // next), then makes the compute queue wait for the last graphics consumer
+  // of the shared resources.
+  void BeginComputeWork();
+  uint64_t EndComputeWork();
+
+  // Makes the graphics queue wait for this frame's compute signal.
+  void BeginGraphicsConsume();
+  uint64_t EndGraphicsConsume();
+
+  uint64_t GetLastComputeValue() const { return mComputeValue; }
+  uint64_t GetLastGraphicsValue() const { return mGraphicsValue; }
+
+ private:
+  enum class Stage { Idle, ComputeRecording, ComputeSubmitted, Consuming };
+
+  CommandQueueSync* mGraphics = nullptr;
+  CommandQueueSync* mCompute = nullptr;
+  uint64_t mComputeValue = 0;
+  uint64_t mGraphicsValue = 0;
+  Stage mStage = Stage::Idle;
+};
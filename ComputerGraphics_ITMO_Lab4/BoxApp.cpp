@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <cfloat>
+#include <chrono>
 #include <cmath>
 #include <numeric>
 #include <utility>
@@ -11,6 +12,7 @@
 #include "Material.h"
 #include "ModelLoader.h"
 #include "ShaderHelper.h"
+#include "VertexCompression.h"
 
 namespace {
 DirectX::SimpleMath::Vector3 ToVector3(const DirectX::XMFLOAT3& value) {
@@ -57,6 +59,75 @@ DirectX::BoundingBox TransformBoundingBox(
   DirectX::BoundingBox::CreateFromPoints(worldBounds, minCorner, maxCorner);
   return worldBounds;
 }
+
+// Квантует позиции относительно границ сабмеша, который рисует вершину
+// (Submesh::PositionBounds, с учётом индексов всех LOD). Возвращает false,
+// если вершину используют несколько сабмешей: границы тогда неоднозначны
+bool PackVertices(ModelGeometry& geometry, std::vector<PackedVertex>& packed) {
+  std::vector<UINT> owners(geometry.Vertices.size(), UINT_MAX);
+  for (UINT submeshIndex = 0; submeshIndex < geometry.Submeshes.size();
+       ++submeshIndex) {
+    Submesh& submesh = geometry.Submeshes[submeshIndex];
+    DirectX::SimpleMath::Vector3 minCorner(FLT_MAX, FLT_MAX, FLT_MAX);
+    DirectX::SimpleMath::Vector3 maxCorner(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    auto addRange = [&](UINT start, UINT count) {
+      for (UINT i = start; i < start + count; ++i) {
+        const uint32_t vertex = geometry.Indices[i];
+        if (owners[vertex] != UINT_MAX && owners[vertex] != submeshIndex) {
+          return false;
+        }
+        owners[vertex] = submeshIndex;
+        const auto& pos = geometry.Vertices[vertex].Pos;
+        minCorner = DirectX::SimpleMath::Vector3::Min(minCorner, pos);
+        maxCorner = DirectX::SimpleMath::Vector3::Max(maxCorner, pos);
+      }
+      return true;
+    };
+    if (!addRange(submesh.StartIndexLocation, submesh.IndexCount)) {
+      return false;
+    }
+    for (UINT lod = 0; lod < Submesh::kLodCount; ++lod) {
+      if (!addRange(submesh.LodStartIndexLocation[lod],
+                    submesh.LodIndexCount[lod])) {
+        return false;
+      }
+    }
+    if (minCorner.x <= maxCorner.x) {
+      DirectX::BoundingBox::CreateFromPoints(submesh.PositionBounds,
+                                             minCorner, maxCorner);
+    }
+  }
+
+  packed.resize(geometry.Vertices.size());
+  for (size_t i = 0; i < geometry.Vertices.size(); ++i) {
+    const Vertex& vertex = geometry.Vertices[i];
+    // Вершины без сабмеша не рисуются, их границы не важны
+    VertexPositionBounds bounds;
+    if (owners[i] != UINT_MAX) {
+      const DirectX::BoundingBox& box =
+          geometry.Submeshes[owners[i]].PositionBounds;
+      bounds = {{box.Center.x, box.Center.y, box.Center.z},
+                {box.Extents.x, box.Extents.y, box.Extents.z}};
+    }
+    UnpackedVertex unpacked;
+    unpacked.Pos[0] = vertex.Pos.x;
+    unpacked.Pos[1] = vertex.Pos.y;
+    unpacked.Pos[2] = vertex.Pos.z;
+    unpacked.Normal[0] = vertex.Normal.x;
+    unpacked.Normal[1] = vertex.Normal.y;
+    unpacked.Normal[2] = vertex.Normal.z;
+    unpacked.Tangent[0] = vertex.Tangent.x;
+    unpacked.Tangent[1] = vertex.Tangent.y;
+    unpacked.Tangent[2] = vertex.Tangent.z;
+    unpacked.Bitangent[0] = vertex.Bitangent.x;
+    unpacked.Bitangent[1] = vertex.Bitangent.y;
+    unpacked.Bitangent[2] = vertex.Bitangent.z;
+    unpacked.TexC[0] = vertex.TexC.x;
+    unpacked.TexC[1] = vertex.TexC.y;
+    packed[i] = PackVertex(unpacked, bounds);
+  }
+  return true;
+}
 }  // namespace
 
 BoxApp::BoxApp(HINSTANCE hInstance)
@@ -110,6 +181,7 @@ BoxApp::BoxApp(HINSTANCE hInstance)
 BoxApp::~BoxApp() { FlushCommandQueue(); }
 
 bool BoxApp::Initialize() {
+  const auto startupStart = std::chrono::steady_clock::now();
   if (!m_window.Initialize(GetModuleHandle(nullptr), WIDTH, HEIGHT,
                            L"Direct3D 12 with Assimp Model UBEITE MENYA PZH")) {
     return false;
@@ -120,7 +192,6 @@ bool BoxApp::Initialize() {
   CreateSwapChain();
   BuildDescriptorHeaps();
   CreateRTVs();
-  CreateDepthStencil();
 
   mScreenViewport.TopLeftX = 0;
   mScreenViewport.TopLeftY = 0;
@@ -135,13 +206,38 @@ bool BoxApp::Initialize() {
   ThrowIfFailed(mCommandList->Reset(mCommandAllocator.Get(), nullptr));
 
   BuildConstantBuffers();
+  mGpuMemory.Initialize(mDevice.Get());
   BuildBoxGeometry();  // загружает модель, создаёт буферы и текстуры
 
   // Создаём сэмплер
   CreateSamplerHeap();
-  mRenderingSystem.Initialize(mDevice.Get(), WIDTH, HEIGHT, mRtvHeap.Get(),
-                              mCbvHeap.Get(), mRtvDescriptorSize,
-                              mCbvSrvDescriptorSize);
+  // Байткод берётся из кэша; пропущенные шейдеры компилируются и
+  // дописываются в него
+  const auto shaderCacheLoadStart = std::chrono::steady_clock::now();
+  const bool shaderCacheLoaded =
+      ShaderHelper::GetCache().Load(ShaderHelper::GetCachePath());
+  const double shaderCacheLoadMs =
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - shaderCacheLoadStart)
+          .count();
+  mRenderingSystem.SetPackedVertices(mPackedVertices);
+  mRenderingSystem.Initialize(mDevice.Get(), mCommandQueue.Get(), WIDTH,
+                              HEIGHT, mRtvHeap.Get(), &mCbvHeap,
+                              mRtvDescriptorSize, DepthStencilView(),
+                              mModelGeometry, mSceneObjects);
+  mCbvHeap.LogStatistics();
+  const ShaderHelper::CacheStats& shaderStats = ShaderHelper::GetCacheStats();
+  std::ostringstream shaderMessage;
+  shaderMessage << "Shaders: " << shaderStats.Milliseconds << " ms, "
+                << shaderStats.Hits << " from cache, " << shaderStats.Misses
+                << " compiled (" << (shaderCacheLoaded ? "warm" : "cold")
+                << " cache, loaded in " << shaderCacheLoadMs << " ms)\n";
+  OutputDebugStringA(shaderMessage.str().c_str());
+  if (ShaderHelper::GetCache().IsDirty()) {
+    ShaderHelper::GetCache().Save(ShaderHelper::GetCachePath());
+    ShaderHelper::GetCache().MarkClean();
+  }
+  BuildParticleEmitters();
   // Закрываем и выполняем все накопленные команды (геометрия + текстуры)
   ThrowIfFailed(mCommandList->Close());
 
@@ -151,6 +247,14 @@ bool BoxApp::Initialize() {
   FlushCommandQueue();
   OnResize();
 
+  std::ostringstream startupMessage;
+  startupMessage << "Startup: "
+                 << std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - startupStart)
+                        .count()
+                 << " ms (" << (shaderCacheLoaded ? "warm" : "cold")
+                 << " shader cache)\n";
+  OutputDebugStringA(startupMessage.str().c_str());
   return true;
 }
 
@@ -158,6 +262,7 @@ void BoxApp::OnResize() {
   mProj = DirectX::SimpleMath::Matrix::CreatePerspectiveFieldOfView(
       0.25f * DirectX::XM_PI,
       static_cast<float>(WIDTH) / static_cast<float>(HEIGHT), 0.1f, 1000.0f);
+  mRenderingSystem.SetProjection(mProj);
 }
 
 void BoxApp::ResetFallingLight(FallingPointLight& light) {
@@ -174,7 +279,7 @@ void BoxApp::ResetFallingLight(FallingPointLight& light) {
 void BoxApp::BuildDescriptorHeaps() {
   D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
   rtvHeapDesc.NumDescriptors =
-      SwapChainBufferCount + GBuffer::kRenderTargetCount;
+      SwapChainBufferCount + GBuffer::kRtvCount;
   rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
   rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
   ThrowIfFailed(
@@ -187,13 +292,10 @@ void BoxApp::BuildDescriptorHeaps() {
   ThrowIfFailed(
       mDevice->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&mDsvHeap)));
 
-  D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc = {};
-  cbvHeapDesc.NumDescriptors =
-      512;  // достаточно для object CBV, light CBV и множества текстур
-  cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-  cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-  ThrowIfFailed(
-      mDevice->CreateDescriptorHeap(&cbvHeapDesc, IID_PPV_ARGS(&mCbvHeap)));
+  // Слоты раздаются по запросу: постоянные — G-буферу, частицам и
+  // текстурам, временные — видам на один кадр
+  mCbvHeap.Initialize(mDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+                      kPersistentDescriptorCount, kTransientDescriptorCount);
 
   D3D12_DESCRIPTOR_HEAP_DESC samplerHeapDesc = {};
   samplerHeapDesc.NumDescriptors = 1;
@@ -205,7 +307,7 @@ void BoxApp::BuildDescriptorHeaps() {
 
 void BoxApp::BuildConstantBuffers() {
   mObjectCB = std::unique_ptr<UploadBuffer<ObjectConstants>>(
-      new UploadBuffer<ObjectConstants>(mDevice.Get(), 1, true));
+      new UploadBuffer<ObjectConstants>(mDevice.Get(), 1, false));
   mLightCB = std::unique_ptr<UploadBuffer<LightConstants>>(
       new UploadBuffer<LightConstants>(mDevice.Get(), 1, true));
   mComposeCB = std::unique_ptr<UploadBuffer<ComposeConstants>>(
@@ -256,13 +358,9 @@ void BoxApp::BuildRootSignature() {
 void BoxApp::BuildShadersAndInputLayout() {
   try {
     mVSByteCode = ShaderHelper::CompileShader(
-        L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-        L"ComputerGraphics_ITMO_Lab4/BoxVertexShader.hlsl",
-        "VS", "vs_5_0");
+        L"BoxVertexShader.hlsl", "VS", "vs_5_0");
     mPSByteCode = ShaderHelper::CompileShader(
-        L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-        L"ComputerGraphics_ITMO_Lab4/BoxPixelShader.hlsl",
-        "PS", "ps_5_0");
+        L"BoxPixelShader.hlsl", "PS", "ps_5_0");
   } catch (const std::exception& e) {
     MessageBoxA(nullptr, e.what(), "Shader Error", MB_OK | MB_ICONERROR);
     throw;
@@ -535,52 +633,53 @@ void BoxApp::BuildBoxGeometry() {
     mModelGeometry.Materials.push_back(defaultMat);
   }
 
-  // Создаём буфер материалов
+  // Структурированные буферы объектов и материалов: шейдеры геометрии
+  // читают их по индексам из корневых констант, без CBV на каждый объект
   mObjectCB = std::unique_ptr<UploadBuffer<ObjectConstants>>(
       new UploadBuffer<ObjectConstants>(
           mDevice.Get(),
-          static_cast<UINT>(std::max<size_t>(1, mSceneObjects.size())), true));
-
-  const UINT cbvDescSize = (sizeof(ObjectConstants) + 255) & ~255;
-  for (UINT i = 0;
-       i < static_cast<UINT>(std::max<size_t>(1, mSceneObjects.size())); ++i) {
-    D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDescObject = {};
-    cbvDescObject.BufferLocation =
-        mObjectCB->Resource()->GetGPUVirtualAddress() +
-        static_cast<UINT64>(i) * cbvDescSize;
-    cbvDescObject.SizeInBytes = cbvDescSize;
-    CD3DX12_CPU_DESCRIPTOR_HANDLE objectCbvHandle(
-        mCbvHeap->GetCPUDescriptorHandleForHeapStart(),
-        static_cast<INT>(RenderingSystem::kObjectCbvStart + i),
-        mCbvSrvDescriptorSize);
-    mDevice->CreateConstantBufferView(&cbvDescObject, objectCbvHandle);
-  }
+          static_cast<UINT>(std::max<size_t>(1, mSceneObjects.size())),
+          false));
 
   UINT numMaterials = static_cast<UINT>(mModelGeometry.Materials.size());
   mMaterialCB = std::unique_ptr<UploadBuffer<MaterialConstants>>(
-      new UploadBuffer<MaterialConstants>(mDevice.Get(), numMaterials, true));
+      new UploadBuffer<MaterialConstants>(mDevice.Get(), numMaterials, false));
 
   for (UINT i = 0; i < numMaterials; ++i) {
     mMaterialCB->CopyData(i, mModelGeometry.Materials[i].Data);
     mModelGeometry.Materials[i].MatCBIndex = static_cast<int>(i);
   }
 
+  // Упакованные вершины занимают 20 байт вместо 76; если упаковка
+  // невозможна, остаётся полный формат
+  std::vector<PackedVertex> packedVertices;
+  if (mPackedVertices) {
+    mPackedVertices = PackVertices(mModelGeometry, packedVertices);
+  }
+  const UINT vertexStride =
+      mPackedVertices ? sizeof(PackedVertex) : sizeof(Vertex);
   mVertexBufferByteSize =
-      static_cast<UINT>(mModelGeometry.Vertices.size() * sizeof(Vertex));
+      static_cast<UINT>(mModelGeometry.Vertices.size() * vertexStride);
+  std::ostringstream vertexMessage;
+  vertexMessage << "Vertex buffer: " << mModelGeometry.Vertices.size()
+                << " vertices, "
+                << mModelGeometry.Vertices.size() * sizeof(Vertex) / 1024.0
+                << " KB unpacked, " << mVertexBufferByteSize / 1024.0
+                << " KB used (" << vertexStride << " bytes per vertex"
+                << (mPackedVertices ? ", packed" : "") << ")\n";
+  OutputDebugStringA(vertexMessage.str().c_str());
   mIndexBufferByteSize =
       static_cast<UINT>(mModelGeometry.Indices.size() * sizeof(uint32_t));
   mIndexCount = static_cast<UINT>(mModelGeometry.Indices.size());
 
   // Вершинный буфер
   {
-    D3D12_HEAP_PROPERTIES heapProps =
-        CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
     D3D12_RESOURCE_DESC resourceDesc =
         CD3DX12_RESOURCE_DESC::Buffer(mVertexBufferByteSize);
 
-    ThrowIfFailed(mDevice->CreateCommittedResource(
-        &heapProps, D3D12_HEAP_FLAG_NONE, &resourceDesc,
-        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&mVertexBufferGPU)));
+    ThrowIfFailed(mGpuMemory.CreateResource(resourceDesc,
+                                            D3D12_RESOURCE_STATE_COMMON,
+                                            nullptr, mVertexBufferGPU));
 
     D3D12_HEAP_PROPERTIES uploadHeapProps =
         CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
@@ -590,7 +689,10 @@ void BoxApp::BuildBoxGeometry() {
         IID_PPV_ARGS(&mVertexBufferUploader)));
 
     D3D12_SUBRESOURCE_DATA vertexData = {};
-    vertexData.pData = mModelGeometry.Vertices.data();
+    vertexData.pData =
+        mPackedVertices
+            ? static_cast<const void*>(packedVertices.data())
+            : static_cast<const void*>(mModelGeometry.Vertices.data());
     vertexData.RowPitch = mVertexBufferByteSize;
     vertexData.SlicePitch = mVertexBufferByteSize;
 
@@ -604,19 +706,17 @@ void BoxApp::BuildBoxGeometry() {
 
     mVertexBufferView.BufferLocation = mVertexBufferGPU->GetGPUVirtualAddress();
     mVertexBufferView.SizeInBytes = mVertexBufferByteSize;
-    mVertexBufferView.StrideInBytes = sizeof(Vertex);
+    mVertexBufferView.StrideInBytes = vertexStride;
   }
 
   // Индексный буфер
   {
-    D3D12_HEAP_PROPERTIES heapProps =
-        CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
     D3D12_RESOURCE_DESC resourceDesc =
         CD3DX12_RESOURCE_DESC::Buffer(mIndexBufferByteSize);
 
-    ThrowIfFailed(mDevice->CreateCommittedResource(
-        &heapProps, D3D12_HEAP_FLAG_NONE, &resourceDesc,
-        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&mIndexBufferGPU)));
+    ThrowIfFailed(mGpuMemory.CreateResource(resourceDesc,
+                                            D3D12_RESOURCE_STATE_COMMON,
+                                            nullptr, mIndexBufferGPU));
 
     D3D12_HEAP_PROPERTIES uploadHeapProps =
         CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
@@ -815,15 +915,15 @@ void BoxApp::CreateFallbackCube() {
 // Загрузка текстур для всех материалов
 
 void BoxApp::LoadAllTextures() {
-  // Собираем уникальные пути текстур из материалов
+  // Собираем уникальные имена текстур из материалов; одинаковое содержимое
+  // под разными именами объединяет кэш TextureStreamer
   std::unordered_map<std::string, int> textureNameToIndex;
   std::vector<std::string> uniqueTexturePaths;
 
   auto addTextureName = [&](const std::string& textureName) {
     if (textureName.empty()) return;
     if (textureNameToIndex.find(textureName) == textureNameToIndex.end()) {
-      int index = static_cast<int>(uniqueTexturePaths.size());
-      textureNameToIndex[textureName] = index;
+      textureNameToIndex[textureName] = -1;
       uniqueTexturePaths.push_back(textureName);
     }
   };
@@ -840,31 +940,31 @@ void BoxApp::LoadAllTextures() {
     return;
   }
 
-  // Загружаем текстуры
+  // Загружаем текстуры: сначала только младшие мипы, старшие подгружаются
+  // потоково по мере приближения камеры
+  mTextureStreamer.Initialize(mDevice.Get(), &mGpuMemory, &mCbvHeap);
+  std::vector<std::wstring> fullPaths;
   for (const auto& texName : uniqueTexturePaths) {
     // Формируем полный путь к текстуре
-    std::wstring fullPath =
+    fullPaths.push_back(
         L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
         L"ComputerGraphics_ITMO_Lab4/textures/" +
-        std::wstring(texName.begin(), texName.end());
-
-    auto texture = std::make_unique<Texture>();
-    texture->name = texName;
-    texture->filepath = fullPath;
-
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(
-        mDevice.Get(), mCommandList.Get(), fullPath.c_str(), texture->Resource,
-        texture->UploadHeap));
-
-    // Сохраняем текстуру в вектор
-    int textureIndex = static_cast<int>(mTextures.size());
-    mTextures.push_back(std::move(texture));
+        std::wstring(texName.begin(), texName.end()));
+  }
 
-    // Создаём SRV для этой текстуры в куче по индексу
-    // (kTextureSrvHeapStart + textureIndex)
-    CreateSRV(mTextures[textureIndex]->Resource,
-              kTextureSrvHeapStart + textureIndex);
+  // Мелкие текстуры одного формата и размера складываются в общие
+  // Texture2DArray: меньше ресурсов и потерь на выравнивание
+  mTextureStreamer.PlanTextureArrays(fullPaths,
+                                     TextureArrayPlanner::Settings());
+  for (size_t i = 0; i < fullPaths.size(); ++i) {
+    // SRV текстуры получает свой слот в mCbvHeap (или слой общего массива),
+    // данные копируются пакетами на отдельной copy-очереди. Файлы с
+    // одинаковым содержимым получают один и тот же id
+    textureNameToIndex[uniqueTexturePaths[i]] =
+        mTextureStreamer.LoadTexture(fullPaths[i]);
   }
+  mTextureStreamer.FinishLoading();
+  mGpuMemory.LogStatistics();
 
   // После загрузки всех текстур связываем материалы с индексами текстур
   for (auto& mat : mModelGeometry.Materials) {
@@ -906,24 +1006,67 @@ void BoxApp::LoadAllTextures() {
     }
   }
 
+  // Индексы текстур для bindless-шейдеров. Диффузная текстура выбирается
+  // всегда, поэтому материал без неё берёт текстуру первого материала;
+  // остальные читаются только в перестановках с соответствующей картой
+  const int defaultTexture =
+      std::max(mModelGeometry.Materials[0].DiffuseTextureIndex, 0);
+  auto mapIndex = [this, defaultTexture](int texture, UINT& index,
+                                         UINT& slice) {
+    const int id = texture >= 0 ? texture : defaultTexture;
+    index = mTextureStreamer.GetSrvIndex(id);
+    slice = mTextureStreamer.GetArraySlice(id);
+  };
+  for (auto& mat : mModelGeometry.Materials) {
+    mapIndex(mat.DiffuseTextureIndex, mat.Data.DiffuseMapIndex,
+             mat.Data.DiffuseMapSlice);
+    mapIndex(mat.NormalTextureIndex, mat.Data.NormalMapIndex,
+             mat.Data.NormalMapSlice);
+    mapIndex(mat.DisplacementTextureIndex, mat.Data.DisplacementMapIndex,
+             mat.Data.DisplacementMapSlice);
+    mapIndex(mat.RoughnessTextureIndex, mat.Data.RoughnessMapIndex,
+             mat.Data.RoughnessMapSlice);
+  }
+
   OutputDebugStringA(
-      ("Loaded " + std::to_string(mTextures.size()) + " textures.\n").c_str());
+      ("Loaded " + std::to_string(mTextureStreamer.GetTextureCount()) +
+       " textures.\n")
+          .c_str());
 }
 
-void BoxApp::CreateSRV(ComPtr<ID3D12Resource> textureResource, int heapIndex) {
-  CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle(
-      mCbvHeap->GetCPUDescriptorHandleForHeapStart(), heapIndex,
-      mCbvSrvDescriptorSize);
-
-  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-  srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  srvDesc.Format = textureResource->GetDesc().Format;
-  srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-  srvDesc.Texture2D.MostDetailedMip = 0;
-  srvDesc.Texture2D.MipLevels = textureResource->GetDesc().MipLevels;
-  srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-  mDevice->CreateShaderResourceView(textureResource.Get(), &srvDesc, srvHandle);
+void BoxApp::BuildParticleEmitters() {
+  ParticleEmitterSet& emitters = mRenderingSystem.GetParticleEmitters();
+
+  // Красный фонтан, следующий за камерой
+  ParticleEmitterSet::EmitterDesc cameraFountain;
+  cameraFountain.PositionExtent = {4.0f, 0.0f, 4.0f};
+  cameraFountain.SpawnRate = 5760.0f;
+  cameraFountain.LifetimeMin = 2.0f;
+  cameraFountain.LifetimeMax = 3.4f;
+  cameraFountain.VelocityMean = {0.0f, 7.25f, 0.0f};
+  cameraFountain.VelocityExtent = {0.75f, 1.75f, 0.75f};
+  cameraFountain.Color[0] = 1.0f;
+  cameraFountain.Color[1] = 0.07f;
+  cameraFountain.Color[2] = 0.07f;
+  cameraFountain.SizeMin = 0.35f;
+  cameraFountain.SizeMax = 0.55f;
+  mCameraEmitter = emitters.AddEmitter(cameraFountain);
+
+  // Неподвижный широкий фонтан в центре сцены
+  ParticleEmitterSet::EmitterDesc sceneFountain;
+  sceneFountain.Position = {0.0f, 0.5f, 0.0f};
+  sceneFountain.PositionExtent = {0.5f, 0.0f, 0.5f};
+  sceneFountain.SpawnRate = 3000.0f;
+  sceneFountain.LifetimeMin = 1.5f;
+  sceneFountain.LifetimeMax = 2.5f;
+  sceneFountain.VelocityMean = {0.0f, 9.0f, 0.0f};
+  sceneFountain.VelocityExtent = {3.0f, 1.0f, 3.0f};
+  sceneFountain.Color[0] = 0.2f;
+  sceneFountain.Color[1] = 0.5f;
+  sceneFountain.Color[2] = 1.0f;
+  sceneFountain.SizeMin = 0.2f;
+  sceneFountain.SizeMax = 0.4f;
+  emitters.AddEmitter(sceneFountain);
 }
 
 void BoxApp::CreateSamplerHeap() {
@@ -998,8 +1141,6 @@ void BoxApp::CreateDevice() {
       mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
   mDsvDescriptorSize =
       mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
-  mCbvSrvDescriptorSize = mDevice->GetDescriptorHandleIncrementSize(
-      D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 }
 
 void BoxApp::CreateCommandObjects() {
@@ -1056,65 +1197,6 @@ void BoxApp::CreateRTVs() {
   }
 }
 
-void BoxApp::CreateDepthStencil() {
-  D3D12_RESOURCE_DESC depthStencilDesc = {};
-  depthStencilDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-  depthStencilDesc.Width = WIDTH;
-  depthStencilDesc.Height = HEIGHT;
-  depthStencilDesc.DepthOrArraySize = 1;
-  depthStencilDesc.MipLevels = 1;
-  depthStencilDesc.Format = DXGI_FORMAT_R24G8_TYPELESS;
-  depthStencilDesc.SampleDesc.Count = 1;
-  depthStencilDesc.SampleDesc.Quality = 0;
-  depthStencilDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-  depthStencilDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
-
-  D3D12_CLEAR_VALUE optClear = {};
-  optClear.Format = DepthStencilFormat;
-  optClear.DepthStencil.Depth = 1.0f;
-  optClear.DepthStencil.Stencil = 0;
-
-  CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
-
-  ThrowIfFailed(mDevice->CreateCommittedResource(
-      &heapProperties, D3D12_HEAP_FLAG_NONE, &depthStencilDesc,
-      D3D12_RESOURCE_STATE_COMMON, &optClear,
-      IID_PPV_ARGS(&mDepthStencilBuffer)));
-
-  D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
-  dsvDesc.Format = DepthStencilFormat;
-  dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-  dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
-  mDevice->CreateDepthStencilView(
-      mDepthStencilBuffer.Get(), &dsvDesc,
-      mDsvHeap->GetCPUDescriptorHandleForHeapStart());
-
-  D3D12_SHADER_RESOURCE_VIEW_DESC depthSrvDesc = {};
-  depthSrvDesc.Shader4ComponentMapping =
-      D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  depthSrvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
-  depthSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-  depthSrvDesc.Texture2D.MipLevels = 1;
-  CD3DX12_CPU_DESCRIPTOR_HANDLE depthSrvHandle(
-      mCbvHeap->GetCPUDescriptorHandleForHeapStart(),
-      static_cast<INT>(RenderingSystem::kDepthSrvIndex), mCbvSrvDescriptorSize);
-  mDevice->CreateShaderResourceView(mDepthStencilBuffer.Get(), &depthSrvDesc,
-                                    depthSrvHandle);
-
-  auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-      mDepthStencilBuffer.Get(), D3D12_RESOURCE_STATE_COMMON,
-      D3D12_RESOURCE_STATE_DEPTH_WRITE);
-
-  ThrowIfFailed(mCommandAllocator->Reset());
-  ThrowIfFailed(mCommandList->Reset(mCommandAllocator.Get(), nullptr));
-  mCommandList->ResourceBarrier(1, &barrier);
-  ThrowIfFailed(mCommandList->Close());
-
-  ID3D12CommandList* cmdLists[] = {mCommandList.Get()};
-  mCommandQueue->ExecuteCommandLists(1, cmdLists);
-  FlushCommandQueue();
-}
-
 void BoxApp::UpdateSceneObjectBounds() {
   for (auto& object : mSceneObjects) {
     object.WorldBounds = TransformBoundingBox(object.LocalBounds, object.World);
@@ -1264,6 +1346,48 @@ void BoxApp::Update(const GameTimer& gt) {
     mFrustumCullingEnabled = !mFrustumCullingEnabled;
   }
   mFrustumCullingToggleKeyWasDown = isToggleKeyDown;
+
+  // P переключает размер пула частиц: 16k -> 256k -> 1M. GPU простаивает,
+  // так как Draw завершается FlushCommandQueue.
+  const bool isParticleKeyDown = (GetAsyncKeyState('P') & 0x8000) != 0;
+  if (isParticleKeyDown && !mParticleCapacityKeyWasDown) {
+    const UINT capacity = mRenderingSystem.GetParticleCapacity();
+    const UINT nextCapacity = capacity < 256 * 1024    ? 256 * 1024
+                              : capacity < 1024 * 1024 ? 1024 * 1024
+                                                       : 16 * 1024;
+    mRenderingSystem.SetParticleCapacity(mDevice.Get(), nextCapacity);
+  }
+  mParticleCapacityKeyWasDown = isParticleKeyDown;
+  // O включает и выключает сортировку частиц по глубине
+  const bool isSortKeyDown = (GetAsyncKeyState('O') & 0x8000) != 0;
+  if (isSortKeyDown && !mParticleSortKeyWasDown) {
+    mRenderingSystem.SetParticleSortingEnabled(
+        !mRenderingSystem.IsParticleSortingEnabled());
+  }
+  mParticleSortKeyWasDown = isSortKeyDown;
+  // T включает и выключает отсечение патчей в hull shader'е
+  const bool isPatchCullingKeyDown = (GetAsyncKeyState('T') & 0x8000) != 0;
+  if (isPatchCullingKeyDown && !mPatchCullingKeyWasDown) {
+    mRenderingSystem.SetPatchCullingEnabled(
+        !mRenderingSystem.IsPatchCullingEnabled());
+  }
+  mPatchCullingKeyWasDown = isPatchCullingKeyDown;
+  // [ и ] уменьшают и увеличивают бюджет тесселяции
+  const bool isTessBudgetDownKeyDown =
+      (GetAsyncKeyState(VK_OEM_4) & 0x8000) != 0;
+  const bool isTessBudgetUpKeyDown = (GetAsyncKeyState(VK_OEM_6) & 0x8000) != 0;
+  if (isTessBudgetDownKeyDown && !mTessBudgetDownKeyWasDown) {
+    mRenderingSystem.SetTessellationBudget(
+        mRenderingSystem.GetTessellationBudget() * 0.8f);
+  }
+  if (isTessBudgetUpKeyDown && !mTessBudgetUpKeyWasDown) {
+    mRenderingSystem.SetTessellationBudget(
+        mRenderingSystem.GetTessellationBudget() * 1.25f);
+  }
+  mTessBudgetDownKeyWasDown = isTessBudgetDownKeyDown;
+  mTessBudgetUpKeyWasDown = isTessBudgetUpKeyDown;
+  mRenderingSystem.GetParticleEmitters().SetPosition(
+      mCameraEmitter, {mCamPos.x, mCamPos.y + 0.2f, mCamPos.z});
   // фрикам
   if (GetActiveWindow() == m_window.GetHWND()) {
     DirectX::SimpleMath::Vector3 lookDir(cosf(mCamPitch) * sinf(mCamYaw),
@@ -1312,6 +1436,9 @@ void BoxApp::Update(const GameTimer& gt) {
   DirectX::BoundingFrustum cameraFrustum;
   viewSpaceFrustum.Transform(cameraFrustum, invView);
   CollectVisibleObjects(cameraFrustum);
+  mTextureStreamer.RequestVisibleTextures(
+      mModelGeometry, mSubmeshInstances, mVisibleSubmeshInstanceIndices,
+      mCamPos, mProj._22, mScreenViewport.Height);
 
   for (size_t i = 0; i < mSceneObjects.size(); ++i) {
     ObjectConstants objConstants;
@@ -1439,20 +1566,25 @@ void BoxApp::Update(const GameTimer& gt) {
 void BoxApp::Draw(const GameTimer& gt) {
   ThrowIfFailed(mCommandAllocator->Reset());
   ThrowIfFailed(mCommandList->Reset(mCommandAllocator.Get(), nullptr));
+  mTextureStreamer.Update(mCommandList.Get());
+  // Заменённые текстуры освобождены; разреженные кучи сливаются
+  mGpuMemory.Defragment(mCommandList.Get());
+  // Прошлый кадр завершён, временные дескрипторы можно раздавать заново
+  mCbvHeap.BeginFrame();
   mRenderingSystem.Render(
-      mCommandList.Get(), CurrentBackBufferView(),
-      mSwapChainBuffers[mCurrBackBuffer].Get(), DepthStencilView(),
-      mCbvHeap.Get(), mSamplerHeap.Get(), mCbvSrvDescriptorSize,
+      mCommandList.Get(), mCommandAllocator.Get(), CurrentBackBufferView(),
+      mSwapChainBuffers[mCurrBackBuffer].Get(), mSamplerHeap.Get(),
       mScreenViewport, mScissorRect, mVertexBufferView, mIndexBufferView,
       mModelGeometry, mSceneObjects, mSubmeshInstances,
-      mVisibleSubmeshInstanceIndices, mMaterialCB.get(),
-      mDepthStencilBuffer.Get(), mComposeCB->Resource()->GetGPUVirtualAddress(),
-      gt.DeltaTime(), mView * mProj, mCamPos);
+      mVisibleSubmeshInstanceIndices, mObjectCB.get(), mMaterialCB.get(),
+      mComposeCB->Resource()->GetGPUVirtualAddress(), gt.DeltaTime(),
+      mView * mProj, mCamPos);
 
   ThrowIfFailed(mCommandList->Close());
 
   ID3D12CommandList* cmdLists[] = {mCommandList.Get()};
   mCommandQueue->ExecuteCommandLists(1, cmdLists);
+  mRenderingSystem.OnFrameSubmitted();
 
   ThrowIfFailed(mSwapChain->Present(1, 0));
   mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
@@ -19,23 +19,18 @@
 #include "Common.h"
 #include "D3DWindow.h"
 #include "DDSTextureLoader.h"
+#include "DescriptorHeap.h"
 #include "GameTimer.h"
+#include "GpuMemoryAllocator.h"
 #include "RenderingSystem.h"
 #include "Structures.h"
+#include "TextureStreamer.h"
 #include "UploadBuffer.h"
 #include "d3dx12.h"
 
 using Microsoft::WRL::ComPtr;
 using std::wstring;
 
-//    
-struct Texture {
-  std::string name;
-  std::wstring filepath;
-  ComPtr<ID3D12Resource> Resource = nullptr;
-  ComPtr<ID3D12Resource> UploadHeap = nullptr;
-};
-
 struct FallingPointLight {
   DirectX::SimpleMath::Vector3 Position;
   DirectX::SimpleMath::Vector3 Color;
@@ -76,15 +71,14 @@ class BoxApp {
 
   //  SRV         
   // 
-  void CreateSRV(ComPtr<ID3D12Resource> textureResource, int heapIndex);
 
   void CreateSamplerHeap();
+  void BuildParticleEmitters();
 
   void CreateDevice();
   void CreateCommandObjects();
   void CreateSwapChain();
   void CreateRTVs();
-  void CreateDepthStencil();
   void FlushCommandQueue();
   void CalculateFrameStats();
   void ResetFallingLight(FallingPointLight& light);
@@ -105,13 +99,19 @@ class BoxApp {
   ComPtr<ID3D12Fence> mFence;
   ComPtr<ID3D12DescriptorHeap> mRtvHeap;
   ComPtr<ID3D12DescriptorHeap> mDsvHeap;
-  ComPtr<ID3D12DescriptorHeap>
-      mCbvHeap;  //  2: object CBV, light CBV,  SRV 
+  // -  CBV/SRV/UAV;   .
+  // Bindless-      
+  DescriptorHeap mCbvHeap;
+  static constexpr uint32_t kPersistentDescriptorCount = 16384;
+  static constexpr uint32_t kTransientDescriptorCount = 1024;
   ComPtr<ID3D12DescriptorHeap> mSamplerHeap;  //  heap  
   ComPtr<ID3D12RootSignature> mRootSignature;
   ComPtr<ID3D12PipelineState> mPSO;
   ComPtr<ID3D12Resource> mSwapChainBuffers[SwapChainBufferCount];
-  ComPtr<ID3D12Resource> mDepthStencilBuffer;
+
+  //    placed-  ;   ,
+  //   
+  GpuMemoryAllocator mGpuMemory;
 
   //  
   ComPtr<ID3D12Resource> mVertexBufferGPU;
@@ -129,16 +129,14 @@ class BoxApp {
   std::unique_ptr<UploadBuffer<ComposeConstants>> mComposeCB;
   std::unique_ptr<UploadBuffer<MaterialConstants>> mMaterialCB = nullptr;
 
-  //    
-  std::vector<std::unique_ptr<Texture>> mTextures;
-  static constexpr int kTextureSrvHeapStart = RenderingSystem::kTextureSrvStart;
+  //      
+  TextureStreamer mTextureStreamer;
   //  
   std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
   // 
   UINT mRtvDescriptorSize = 0;
   UINT mDsvDescriptorSize = 0;
-  UINT mCbvSrvDescriptorSize = 0;
 
   //  
   D3D12_VIEWPORT mScreenViewport;
@@ -168,6 +166,8 @@ class BoxApp {
   ModelGeometry mModelGeometry;
   std::vector<SceneObject> mSceneObjects;
   UINT mVertexBufferByteSize = 0;
+  //    PackedVertex; ,    
+  bool mPackedVertices = true;
   UINT mIndexBufferByteSize = 0;
   D3D12_VERTEX_BUFFER_VIEW mVertexBufferView;
   D3D12_INDEX_BUFFER_VIEW mIndexBufferView;
@@ -189,6 +189,12 @@ class BoxApp {
   std::vector<SubmeshInstance> mSubmeshInstances;
   bool mFrustumCullingEnabled = true;
   bool mFrustumCullingToggleKeyWasDown = false;
+  ParticleEmitterSet::EmitterHandle mCameraEmitter = 0;
+  bool mParticleCapacityKeyWasDown = false;
+  bool mParticleSortKeyWasDown = false;
+  bool mPatchCullingKeyWasDown = false;
+  bool mTessBudgetDownKeyWasDown = false;
+  bool mTessBudgetUpKeyWasDown = false;
 
   static constexpr size_t kFallingLightCount = 58;
   std::array<FallingPointLight, kFallingLightCount> mFallingLights;
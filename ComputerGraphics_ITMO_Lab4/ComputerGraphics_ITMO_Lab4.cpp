@@ -1,15 +1,93 @@
-﻿#include "BoxApp.h"
+﻿#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include "BoxApp.h"
+#include "ShaderHelper.h"
+#include "ShaderManifest.h"
+
+namespace {
+// Value of --name in the command line, which may be quoted; empty if the
+// option is not given.
+std::string GetOption(const char* cmdLine, const std::string& name) {
+  const std::string line = cmdLine != nullptr ? cmdLine : "";
+  size_t position = line.find("--" + name);
+  if (position == std::string::npos) {
+    return {};
+  }
+  position = line.find_first_not_of(' ', position + name.size() + 2);
+  if (position == std::string::npos) {
+    return {};
+  }
+  if (line[position] == '"') {
+    const size_t end = line.find('"', position + 1);
+    return line.substr(position + 1, end == std::string::npos
+                                         ? std::string::npos
+                                         : end - position - 1);
+  }
+  return line.substr(position, line.find(' ', position) - position);
+}
+
+// The --shader-dir option if given. Otherwise the first of the
+// executable's directory and its parents that holds the shader sources,
+// directly or in the project directory: a build tree puts the executable
+// in <solution>/x64/<config>/. Falls back to the executable's directory,
+// where a package that ships only the cache keeps it.
+std::filesystem::path FindShaderSourceDirectory(
+    const std::filesystem::path& exeDirectory, const std::string& option) {
+  if (!option.empty()) {
+    return option;
+  }
+  const std::wstring marker = kShaderManifest[0].File;
+  std::filesystem::path directory = exeDirectory;
+  for (int level = 0; level < 4 && !directory.empty(); ++level) {
+    for (const std::filesystem::path& candidate :
+         {directory, directory / kShaderProjectDirectory}) {
+      if (std::filesystem::exists(candidate / marker)) {
+        return candidate;
+      }
+    }
+    if (directory == directory.parent_path()) {
+      break;
+    }
+    directory = directory.parent_path();
+  }
+  return exeDirectory;
+}
+}  // namespace
 
 int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE prevInstance,
                    _In_ LPSTR cmdLine, _In_ int showCmd) {
   (void)prevInstance;
-  (void)cmdLine;
 
 #if defined(DEBUG) || defined(_DEBUG)
   _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
   try {
+    wchar_t modulePath[MAX_PATH] = {};
+    GetModuleFileNameW(nullptr, modulePath, MAX_PATH);
+    const std::filesystem::path exeDirectory =
+        std::filesystem::path(modulePath).parent_path();
+    ShaderHelper::GetSourceDirectory() =
+        FindShaderSourceDirectory(exeDirectory,
+                                  GetOption(cmdLine, "shader-dir"))
+            .generic_wstring() +
+        L"/";
+    ShaderHelper::GetCachePath() = (exeDirectory / kShaderCachePath).string();
+
+    // Offline step: compile every shader in the manifest into the package.
+    if (cmdLine != nullptr &&
+        std::strstr(cmdLine, "--build-shader-cache") != nullptr) {
+      ShaderHelper::GetCache().Clear();
+      for (const auto& entry : kShaderManifest) {
+        ShaderHelper::CompileShader(entry.File, entry.EntryPoint, entry.Target,
+                                    entry.Defines);
+      }
+      ShaderHelper::GetCache().Save(ShaderHelper::GetCachePath());
+      return 0;
+    }
+
     BoxApp app(hInstance);
     if (!app.Initialize()) {
       return 1;
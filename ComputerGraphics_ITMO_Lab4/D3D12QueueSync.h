@@ -0,0 +1,49 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include "AsyncComputeScheduler.h"
+#include "Common.h"
+
+using Microsoft::WRL::ComPtr;
+
+class D3D12QueueSync : public CommandQueueSync {
+ public:
+  void Initialize(ID3D12Device* device, ID3D12CommandQueue* queue) {
+    mQueue = queue;
+    ThrowIfFailed(
+        device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+  }
+
+  void Signal(uint64_t value) override {
+    ThrowIfFailed(mQueue->Signal(mFence.Get(), value));
+  }
+
+  void Wait(CommandQueueSync& producer, uint64_t value) override {
+    auto& d3dProducer = static_cast<D3D12QueueSync&>(producer);
+    ThrowIfFailed(mQueue->Wait(d3dProducer.mFence.Get(), value));
+  }
+
+  uint64_t GetCompletedValue() const override {
+    return mFence != nullptr ? mFence->GetCompletedValue() : 0;
+  }
+
+  void WaitOnCpu(uint64_t value) override {
+    if (mFence->GetCompletedValue() >= value) {
+      return;
+    }
+    HANDLE eventHandle = CreateEventEx(nullptr, FALSE, FALSE, EVENT_ALL_ACCESS);
+    if (eventHandle) {
+      ThrowIfFailed(mFence->SetEventOnCompletion(value, eventHandle));
+      WaitForSingleObject(eventHandle, INFINITE);
+      CloseHandle(eventHandle);
+    }
+  }
+
+  ID3D12CommandQueue* Queue() const { return mQueue; }
+
+ private:
+  ID3D12CommandQueue* mQueue = nullptr;
+  ComPtr<ID3D12Fence> mFence;
+};
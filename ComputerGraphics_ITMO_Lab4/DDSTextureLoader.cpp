@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <vector>
 
 using namespace Microsoft::WRL;
 
@@ -1062,7 +1063,8 @@ static HRESULT CreateD3DResources12(
     _In_ DXGI_FORMAT format, _In_ bool forceSRGB, _In_ bool isCubeMap,
     _In_reads_opt_(mipCount* arraySize) D3D12_SUBRESOURCE_DATA* initData,
     ComPtr<ID3D12Resource>& texture,
-    ComPtr<ID3D12Resource>& textureUploadHeap) {
+    ComPtr<ID3D12Resource>& textureUploadHeap,
+    _In_opt_ const CreateTextureCallback& createTexture = nullptr) {
   if (device == nullptr) return E_POINTER;
 
   if (forceSRGB) format = MakeSRGB(format);
@@ -1085,15 +1087,21 @@ static HRESULT CreateD3DResources12(
       texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
       texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-      CD3DX12_HEAP_PROPERTIES heap_d =
-          CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-      hr = device->CreateCommittedResource(
-          &heap_d, D3D12_HEAP_FLAG_NONE, &texDesc, D3D12_RESOURCE_STATE_COMMON,
-          nullptr, IID_PPV_ARGS(&texture));
+      if (createTexture) {
+        hr = createTexture(texDesc, texture);
+      } else {
+        CD3DX12_HEAP_PROPERTIES heap_d =
+            CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+        hr = device->CreateCommittedResource(
+            &heap_d, D3D12_HEAP_FLAG_NONE, &texDesc,
+            D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&texture));
+      }
 
       if (FAILED(hr)) {
         texture = nullptr;
         return hr;
+      } else if (!cmdList) {
+        // The caller uploads initData itself; the texture stays in COMMON.
       } else {
         const UINT num2DSubresources =
             texDesc.DepthOrArraySize * texDesc.MipLevels;
@@ -1462,7 +1470,9 @@ static HRESULT CreateTextureFromDDS12(
     _In_ const DDS_HEADER* header,
     _In_reads_bytes_(bitSize) const uint8_t* bitData, _In_ size_t bitSize,
     _In_ size_t maxsize, _In_ bool forceSRGB, ComPtr<ID3D12Resource>& texture,
-    ComPtr<ID3D12Resource>& textureUploadHeap) {
+    ComPtr<ID3D12Resource>& textureUploadHeap,
+    _Out_opt_ std::vector<D3D12_SUBRESOURCE_DATA>* subresources = nullptr,
+    _In_opt_ const CreateTextureCallback& createTexture = nullptr) {
   HRESULT hr = S_OK;
 
   UINT width = header->width;
@@ -1622,7 +1632,11 @@ static HRESULT CreateTextureFromDDS12(
                               mipCount - skipMip, arraySize, format,
                               false,  // forceSRGB
                               isCubeMap, initData.get(), texture,
-                              textureUploadHeap);
+                              textureUploadHeap, createTexture);
+  }
+  if (SUCCEEDED(hr) && subresources) {
+    subresources->assign(initData.get(),
+                         initData.get() + (mipCount - skipMip) * arraySize);
   }
 
   return hr;
@@ -1714,6 +1728,60 @@ _Use_decl_annotations_ HRESULT DirectX::CreateDDSTextureFromMemory12(
   return hr;
 }
 
+_Use_decl_annotations_ HRESULT DirectX::LoadDDSTextureFromMemory12(
+    ID3D12Device* device, const uint8_t* ddsData, size_t ddsDataSize,
+    ComPtr<ID3D12Resource>& texture,
+    std::vector<D3D12_SUBRESOURCE_DATA>& subresources, size_t maxsize,
+    DDS_ALPHA_MODE* alphaMode, const CreateTextureCallback& createTexture) {
+  if (alphaMode) (*alphaMode) = DDS_ALPHA_MODE_UNKNOWN;
+  subresources.clear();
+
+  if (!device || !ddsData ||
+      ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER))) {
+    return E_INVALIDARG;
+  }
+
+  uint32_t dwMagicNumber = *(const uint32_t*)(ddsData);
+  if (dwMagicNumber != DDS_MAGIC) {
+    return E_FAIL;
+  }
+
+  auto header = reinterpret_cast<const DDS_HEADER*>(ddsData + sizeof(uint32_t));
+
+  // Verify header to validate DDS file
+  if (header->size != sizeof(DDS_HEADER) ||
+      header->ddspf.size != sizeof(DDS_PIXELFORMAT)) {
+    return E_FAIL;
+  }
+
+  // Check for DX10 extension
+  bool bDXT10Header = false;
+  if ((header->ddspf.flags & DDS_FOURCC) &&
+      (MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC)) {
+    // Must be long enough for both headers and magic value
+    if (ddsDataSize <
+        (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10))) {
+      return E_FAIL;
+    }
+
+    bDXT10Header = true;
+  }
+
+  ptrdiff_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER) +
+                     (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
+
+  ComPtr<ID3D12Resource> noUploadHeap;
+  HRESULT hr = CreateTextureFromDDS12(
+      device, nullptr, header, ddsData + offset, ddsDataSize - offset, maxsize,
+      false, texture, noUploadHeap, &subresources, createTexture);
+
+  if (SUCCEEDED(hr)) {
+    if (alphaMode) (*alphaMode) = GetAlphaMode(header);
+  }
+
+  return hr;
+}
+
 _Use_decl_annotations_ HRESULT DirectX::CreateDDSTextureFromMemory(
     ID3D11Device* d3dDevice, ID3D11DeviceContext* d3dContext,
     const uint8_t* ddsData, size_t ddsDataSize, ID3D11Resource** texture,
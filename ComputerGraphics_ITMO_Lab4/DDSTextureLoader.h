@@ -34,6 +34,9 @@
 
 #pragma warning(pop)
 
+#include <functional>
+#include <vector>
+
 #if defined(_MSC_VER) && (_MSC_VER < 1610) && !defined(_In_reads_)
 #define _In_reads_(exp)
 #define _Out_writes_(exp)
@@ -71,6 +74,25 @@ HRESULT CreateDDSTextureFromMemory12(
     _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& textureUploadHeap,
     _In_ size_t maxsize = 0, _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr);
 
+// Creates a texture in D3D12_RESOURCE_STATE_COMMON, e.g. as a placed
+// resource.
+using CreateTextureCallback = std::function<HRESULT(
+    const D3D12_RESOURCE_DESC& desc,
+    Microsoft::WRL::ComPtr<ID3D12Resource>& texture)>;
+
+// Creates the texture in D3D12_RESOURCE_STATE_COMMON without uploading
+// anything. subresources point into ddsData; the caller copies them into the
+// texture, e.g. on a copy queue. Without createTexture the texture is a
+// committed resource.
+HRESULT LoadDDSTextureFromMemory12(
+    _In_ ID3D12Device* device,
+    _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+    _In_ size_t ddsDataSize,
+    _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+    _Out_ std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+    _In_ size_t maxsize = 0, _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+    _In_opt_ const CreateTextureCallback& createTexture = nullptr);
+
 HRESULT CreateDDSTextureFromFile(
     _In_ ID3D11Device* d3dDevice, _In_z_ const wchar_t* szFileName,
     _Outptr_opt_ ID3D11Resource** texture,
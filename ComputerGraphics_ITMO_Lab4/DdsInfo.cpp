@@ -0,0 +1,306 @@
+#include "DdsInfo.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "LittleEndianIO.h"
+
+namespace {
+constexpr uint32_t kDdsMagic = 0x20534444;  // "DDS "
+constexpr uint32_t kHeaderSize = 124;
+constexpr uint32_t kPixelFormatSize = 32;
+constexpr size_t kDx10HeaderOffset = 4 + kHeaderSize;
+
+// DDS_HEADER and DDS_PIXELFORMAT flags.
+constexpr uint32_t kFlagVolume = 0x800000;
+constexpr uint32_t kPixelFormatAlphaPixels = 0x1;
+constexpr uint32_t kPixelFormatFourCc = 0x4;
+constexpr uint32_t kPixelFormatRgb = 0x40;
+constexpr uint32_t kPixelFormatLuminance = 0x20000;
+constexpr uint32_t kCaps2Cubemap = 0x200;
+constexpr uint32_t kCaps2AllFaces = 0xfc00;
+// DDS_HEADER_DXT10::miscFlag.
+constexpr uint32_t kMiscTextureCube = 0x4;
+
+// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and
+// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT.
+constexpr uint64_t kPitchAlignment = 256;
+constexpr uint64_t kPlacementAlignment = 512;
+
+// D3D12_REQ_TEXTURE1D_U_DIMENSION, D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION and
+// D3D12_REQ_TEXTURECUBE_DIMENSION; D3D12_REQ_TEXTURE3D_U_V_OR_W_DIMENSION;
+// D3D12_REQ_TEXTURE1D_ARRAY_AXIS_DIMENSION and
+// D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION.
+constexpr uint32_t kMaxDimension = 16384;
+constexpr uint32_t kMaxVolumeDimension = 2048;
+constexpr uint32_t kMaxArraySize = 2048;
+
+constexpr uint32_t MakeFourCc(char a, char b, char c, char d) {
+  return static_cast<uint32_t>(static_cast<uint8_t>(a)) |
+         static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8 |
+         static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16 |
+         static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24;
+}
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Size of one element: a 4x4 block for block-compressed formats, otherwise
+// a pixel. Returns 0 for formats the parser does not lay out (packed,
+// planar and video formats).
+uint32_t GetElementBytes(uint32_t format, bool& blockCompressed) {
+  blockCompressed = false;
+  if ((format >= 70 && format <= 84) || (format >= 94 && format <= 99)) {
+    blockCompressed = true;
+    // BC1 and BC4 use 8-byte blocks, BC2, BC3, BC5, BC6H and BC7 16-byte.
+    return (format <= 72 || (format >= 79 && format <= 81)) ? 8 : 16;
+  }
+  if (format >= 1 && format <= 4) {
+    return 16;  // R32G32B32A32
+  }
+  if (format >= 5 && format <= 8) {
+    return 12;  // R32G32B32
+  }
+  if (format >= 9 && format <= 22) {
+    return 8;  // R16G16B16A16, R32G32, R32G8X24
+  }
+  if ((format >= 23 && format <= 47) || format == 67 ||
+      (format >= 87 && format <= 93)) {
+    // R10G10B10A2, R11G11B10, R8G8B8A8, R16G16, R32, R24G8,
+    // R9G9B9E5, B8G8R8A8/X8, R10G10B10_XR_BIAS_A2.
+    return 4;
+  }
+  if ((format >= 48 && format <= 59) || format == 85 || format == 86 ||
+      format == 115) {
+    return 2;  // R8G8, R16, B5G6R5, B5G5R5A1, B4G4R4A4
+  }
+  if (format >= 60 && format <= 65) {
+    return 1;  // R8, A8
+  }
+  return 0;
+}
+
+// DXGI_FORMAT of a DDS file without the DX10 extension, for the layouts
+// common tools write. Returns 0 otherwise.
+uint32_t GetLegacyFormat(uint32_t flags, uint32_t fourCc, uint32_t bitCount,
+                         uint32_t rMask, uint32_t gMask, uint32_t bMask,
+                         uint32_t aMask) {
+  if (flags & kPixelFormatFourCc) {
+    if (fourCc == MakeFourCc('D', 'X', 'T', '1')) return 71;  // BC1_UNORM
+    if (fourCc == MakeFourCc('D', 'X', 'T', '2') ||
+        fourCc == MakeFourCc('D', 'X', 'T', '3')) {
+      return 74;  // BC2_UNORM
+    }
+    if (fourCc == MakeFourCc('D', 'X', 'T', '4') ||
+        fourCc == MakeFourCc('D', 'X', 'T', '5')) {
+      return 77;  // BC3_UNORM
+    }
+    if (fourCc == MakeFourCc('A', 'T', 'I', '1') ||
+        fourCc == MakeFourCc('B', 'C', '4', 'U')) {
+      return 80;  // BC4_UNORM
+    }
+    if (fourCc == MakeFourCc('B', 'C', '4', 'S')) return 81;  // BC4_SNORM
+    if (fourCc == MakeFourCc('A', 'T', 'I', '2') ||
+        fourCc == MakeFourCc('B', 'C', '5', 'U')) {
+      return 83;  // BC5_UNORM
+    }
+    if (fourCc == MakeFourCc('B', 'C', '5', 'S')) return 84;  // BC5_SNORM
+    // Direct3D 9 format numbers for float formats.
+    if (fourCc == 113) return 10;  // R16G16B16A16_FLOAT
+    if (fourCc == 116) return 2;   // R32G32B32A32_FLOAT
+    return 0;
+  }
+  if ((flags & kPixelFormatRgb) && bitCount == 32) {
+    if (rMask == 0xff && gMask == 0xff00 && bMask == 0xff0000 &&
+        aMask == 0xff000000) {
+      return 28;  // R8G8B8A8_UNORM
+    }
+    if (rMask == 0xff0000 && gMask == 0xff00 && bMask == 0xff) {
+      return (flags & kPixelFormatAlphaPixels) || aMask == 0xff000000
+                 ? 87   // B8G8R8A8_UNORM
+                 : 88;  // B8G8R8X8_UNORM
+    }
+    return 0;
+  }
+  if ((flags & kPixelFormatLuminance) && bitCount == 8 && rMask == 0xff) {
+    return 61;  // R8_UNORM
+  }
+  return 0;
+}
+
+void Fail(const std::string& message) {
+  throw std::runtime_error("DDS: " + message);
+}
+}  // namespace
+
+DdsInfo ParseDdsHeader(const std::vector<uint8_t>& header, uint64_t fileSize) {
+  std::vector<uint32_t> fields(kDx10HeaderOffset / 4);
+  size_t offset = 0;
+  for (uint32_t& field : fields) {
+    if (!ReadUint32LE(header, offset, field)) {
+      Fail("header is truncated");
+    }
+  }
+  // Field i is at byte offset 4 * i: the magic, then DDS_HEADER.
+  if (fields[0] != kDdsMagic) {
+    Fail("bad magic");
+  }
+  if (fields[1] != kHeaderSize || fields[19] != kPixelFormatSize) {
+    Fail("bad header size");
+  }
+  const uint32_t flags = fields[2];
+  const uint32_t pixelFormatFlags = fields[20];
+  const uint32_t fourCc = fields[21];
+  const uint32_t caps2 = fields[28];
+
+  DdsInfo info;
+  info.Height = fields[3];
+  info.Width = fields[4];
+  info.MipCount = std::max(fields[7], 1u);
+  info.FileSize = fileSize;
+
+  uint64_t dataOffset = kDx10HeaderOffset;
+  if ((pixelFormatFlags & kPixelFormatFourCc) &&
+      fourCc == MakeFourCc('D', 'X', '1', '0')) {
+    uint32_t format = 0;
+    uint32_t dimension = 0;
+    uint32_t miscFlag = 0;
+    uint32_t arraySize = 0;
+    offset = kDx10HeaderOffset;
+    if (!ReadUint32LE(header, offset, format) ||
+        !ReadUint32LE(header, offset, dimension) ||
+        !ReadUint32LE(header, offset, miscFlag) ||
+        !ReadUint32LE(header, offset, arraySize)) {
+      Fail("DX10 header is truncated");
+    }
+    dataOffset = kDdsMaxHeaderSize;
+    info.Format = format;
+    info.ArraySize = arraySize;
+    if (arraySize == 0) {
+      Fail("array size is zero");
+    }
+    if (arraySize > kMaxArraySize) {
+      Fail("array size " + std::to_string(arraySize) + " is too large");
+    }
+    switch (dimension) {
+      case static_cast<uint32_t>(DdsDimension::kTexture1D):
+        info.Dimension = DdsDimension::kTexture1D;
+        info.Height = 1;
+        break;
+      case static_cast<uint32_t>(DdsDimension::kTexture2D):
+        if (miscFlag & kMiscTextureCube) {
+          if (arraySize > kMaxArraySize / 6) {
+            Fail("cube count " + std::to_string(arraySize) + " is too large");
+          }
+          info.IsCubeMap = true;
+          info.ArraySize *= 6;
+        }
+        break;
+      case static_cast<uint32_t>(DdsDimension::kTexture3D):
+        if (!(flags & kFlagVolume) || arraySize != 1) {
+          Fail("bad volume texture");
+        }
+        info.Dimension = DdsDimension::kTexture3D;
+        info.Depth = fields[6];
+        break;
+      default:
+        Fail("bad resource dimension " + std::to_string(dimension));
+    }
+  } else {
+    info.Format = GetLegacyFormat(pixelFormatFlags, fourCc, fields[22],
+                                  fields[23], fields[24], fields[25],
+                                  fields[26]);
+    if (flags & kFlagVolume) {
+      info.Dimension = DdsDimension::kTexture3D;
+      info.Depth = fields[6];
+    } else if (caps2 & kCaps2Cubemap) {
+      if ((caps2 & kCaps2AllFaces) != kCaps2AllFaces) {
+        Fail("partial cube maps are not supported");
+      }
+      info.IsCubeMap = true;
+      info.ArraySize = 6;
+    }
+  }
+
+  bool blockCompressed = false;
+  const uint32_t elementBytes = GetElementBytes(info.Format, blockCompressed);
+  if (elementBytes == 0) {
+    Fail("unsupported format " + std::to_string(info.Format));
+  }
+  if (info.Width == 0 || info.Height == 0 || info.Depth == 0) {
+    Fail("texture is empty");
+  }
+  const uint32_t maxDimension = info.Dimension == DdsDimension::kTexture3D
+                                    ? kMaxVolumeDimension
+                                    : kMaxDimension;
+  if (std::max({info.Width, info.Height, info.Depth}) > maxDimension) {
+    Fail("texture is larger than " + std::to_string(maxDimension));
+  }
+  // Within the limits above a row is at most 16384 * 16 bytes; the check
+  // keeps RowBytes from wrapping should the limits or formats change.
+  if (info.Width > UINT32_MAX / elementBytes) {
+    Fail("row is too large");
+  }
+  uint32_t maxMipCount = 1;
+  while ((std::max({info.Width, info.Height, info.Depth}) >> maxMipCount) >
+         0) {
+    ++maxMipCount;
+  }
+  if (info.MipCount > maxMipCount) {
+    Fail("too many mips");
+  }
+
+  info.Subresources.reserve(static_cast<size_t>(info.ArraySize) *
+                            info.MipCount);
+  uint64_t fileOffset = dataOffset;
+  uint64_t stagingOffset = 0;
+  for (uint32_t slice = 0; slice < info.ArraySize; ++slice) {
+    for (uint32_t mip = 0; mip < info.MipCount; ++mip) {
+      DdsSubresource subresource;
+      subresource.Width = std::max(info.Width >> mip, 1u);
+      subresource.Height = std::max(info.Height >> mip, 1u);
+      subresource.Depth = std::max(info.Depth >> mip, 1u);
+      if (blockCompressed) {
+        subresource.RowBytes = (subresource.Width + 3) / 4 * elementBytes;
+        subresource.NumRows = (subresource.Height + 3) / 4;
+      } else {
+        subresource.RowBytes = subresource.Width * elementBytes;
+        subresource.NumRows = subresource.Height;
+      }
+      const uint64_t rows =
+          static_cast<uint64_t>(subresource.NumRows) * subresource.Depth;
+      subresource.FileOffset = fileOffset;
+      subresource.FileBytes = rows * subresource.RowBytes;
+      subresource.RowPitch =
+          static_cast<uint32_t>(AlignUp(subresource.RowBytes, kPitchAlignment));
+      subresource.StagingOffset = AlignUp(stagingOffset, kPlacementAlignment);
+      subresource.StagingBytes =
+          (rows - 1) * subresource.RowPitch + subresource.RowBytes;
+
+      fileOffset += subresource.FileBytes;
+      if (fileOffset > fileSize) {
+        Fail("pixel data is truncated");
+      }
+      stagingOffset = subresource.StagingOffset + subresource.StagingBytes;
+      info.Subresources.push_back(subresource);
+    }
+  }
+  info.StagingBytes = stagingOffset;
+  return info;
+}
+
+DdsInfo ScanDds(std::istream& file) {
+  std::vector<uint8_t> header(kDdsMaxHeaderSize);
+  file.read(reinterpret_cast<char*>(header.data()),
+            static_cast<std::streamsize>(header.size()));
+  header.resize(static_cast<size_t>(file.gcount()));
+  file.clear();
+  file.seekg(0, std::ios::end);
+  const std::streamoff fileSize = file.tellg();
+  if (!file || fileSize < 0) {
+    Fail("cannot read the file");
+  }
+  return ParseDdsHeader(header, static_cast<uint64_t>(fileSize));
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <vector>
+
+// Layout of a DDS file read from its header alone: the magic, DDS_HEADER and
+// the optional DDS_HEADER_DXT10, at most kDdsMaxHeaderSize bytes. Lets the
+// loader size resources and staging memory before any pixel data is read,
+// and then read just the subresources it needs. Has no D3D12 dependency;
+// formats and dimensions carry their DXGI_FORMAT and
+// D3D12_RESOURCE_DIMENSION values.
+
+constexpr size_t kDdsMaxHeaderSize = 4 + 124 + 20;
+
+// D3D12_RESOURCE_DIMENSION values.
+enum class DdsDimension : uint32_t {
+  kTexture1D = 2,
+  kTexture2D = 3,
+  kTexture3D = 4,
+};
+
+struct DdsSubresource {
+  uint32_t Width = 0;
+  uint32_t Height = 0;
+  uint32_t Depth = 0;
+  // Tightly packed pixel data in the file.
+  uint64_t FileOffset = 0;
+  uint64_t FileBytes = 0;
+  // Bytes per row of pixels or of 4x4 blocks, and rows per depth slice.
+  uint32_t RowBytes = 0;
+  uint32_t NumRows = 0;
+  // Placement in an upload buffer holding every subresource, as
+  // ID3D12Device::GetCopyableFootprints lays it out: rows aligned to
+  // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and subresources to
+  // D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT.
+  uint32_t RowPitch = 0;
+  uint64_t StagingOffset = 0;
+  // Staging size of this subresource alone, without trailing padding.
+  uint64_t StagingBytes = 0;
+};
+
+struct DdsInfo {
+  uint32_t Width = 0;
+  uint32_t Height = 0;
+  uint32_t Depth = 1;
+  // Cube maps count six slices per cube.
+  uint32_t ArraySize = 1;
+  uint32_t MipCount = 1;
+  uint32_t Format = 0;  // DXGI_FORMAT
+  DdsDimension Dimension = DdsDimension::kTexture2D;
+  bool IsCubeMap = false;
+  uint64_t FileSize = 0;
+  // Ordered like D3D12 subresource indices: every mip of slice 0, then of
+  // slice 1, and so on, which is also their order in the file.
+  std::vector<DdsSubresource> Subresources;
+  // Upload buffer size for every subresource.
+  uint64_t StagingBytes = 0;
+
+  const DdsSubresource& GetSubresource(uint32_t mip, uint32_t slice) const {
+    return Subresources[slice * MipCount + mip];
+  }
+};
+
+// Parses the first bytes of a DDS file; header may hold more than the header
+// or be truncated to it. fileSize is the size of the whole file, which must
+// hold every subresource. Throws std::runtime_error for malformed headers,
+// textures beyond the D3D12 size limits and formats without a known size.
+DdsInfo ParseDdsHeader(const std::vector<uint8_t>& header, uint64_t fileSize);
+// Reads the header from the start of file and takes the file size from its
+// end; no pixel data is read.
+DdsInfo ScanDds(std::istream& file);
@@ -20,27 +20,33 @@ struct DS_OUTPUT {
     float2 TexC : TEXCOORD;
 };
 
-cbuffer cbPerObject : register(b0) {
-    float4x4 gWorld;
-    float4x4 gWorldViewProj;
-    float4 gCameraPosition;
-    float4 gTessellationParams;
-    float4 gWaveParams;
+// Bindless: на отрисовку задаются только индексы объекта и материала в
+// корневых константах, данные читаются из структурированных буферов.
+cbuffer cbDraw : register(b0) {
+    uint gObjectIndex;
+    uint gMaterialIndex;
 };
 
-cbuffer cbMaterial : register(b2) {
-    float4 gDiffuseAlbedo;
-    float3 gFresnelR0;
-    float gRoughness;
-    float gHasNormalMap;
-    float gHasDisplacementMap;
-    float gHasRoughnessMap;
-    float gDisplacementScale;
-    float4x4 gTexTransform;
+struct ObjectData {
+    float4x4 World;
+    float4x4 WorldViewProj;
+    float4 CameraPosition;
+    float4 TessellationParams;
+    float4 WaveParams;
 };
+StructuredBuffer<ObjectData> gObjects : register(t0);
 
-Texture2D gDisplacementMap : register(t2);
-SamplerState gSampler : register(s0);
+#define gWorld gObjects[gObjectIndex].World
+#define gWorldViewProj gObjects[gObjectIndex].WorldViewProj
+#define gCameraPosition gObjects[gObjectIndex].CameraPosition
+#define gTessellationParams gObjects[gObjectIndex].TessellationParams
+#define gWaveParams gObjects[gObjectIndex].WaveParams
+
+// Волны включаются при компиляции (перестановка USE_WAVES), а не по
+// gWaveParams.x в рантайме.
+#ifndef USE_WAVES
+#define USE_WAVES 0
+#endif
 
 [domain("tri")]
 DS_OUTPUT DS(HS_CONSTANT_DATA_OUTPUT input,
@@ -54,12 +60,14 @@ DS_OUTPUT DS(HS_CONSTANT_DATA_OUTPUT input,
     float3 localBitangent = normalize(patch[0].Bitangent * bary.x + patch[1].Bitangent * bary.y + patch[2].Bitangent * bary.z);
     float2 texC = patch[0].TexC * bary.x + patch[1].TexC * bary.y + patch[2].TexC * bary.z;
 
-     if (gWaveParams.x > 0.0f) { //немного поясню формулу для допа
+#if USE_WAVES
+    { //немного поясню формулу для допа
         float wavePhase = gWaveParams.w * gWaveParams.z;//фаза = время на скорость 
         float waveSpatial = (localPos.x + localPos.z) * gWaveParams.y; //это пространственная координата. Волна распространяется в плоскости XZ
         float waveOffset = sin(waveSpatial + wavePhase) * gWaveParams.x; //итоговое смещение вдоль нормали, умноженное на амплитуду.
         localPos += localNormal * waveOffset;
     }
+#endif
 
     float4 worldPos = mul(float4(localPos, 1.0f), gWorld);
     output.Pos = mul(worldPos, gWorldViewProj);
@@ -11,25 +11,98 @@ struct HS_CONSTANT_DATA_OUTPUT {
     float InsideTess : SV_InsideTessFactor;
 };
 
-cbuffer cbPerObject : register(b0) {
-    float4x4 gWorld;
-    float4x4 gWorldViewProj;
-    float4 gCameraPosition;
-    float4 gTessellationParams; // x=minDist, y=maxDist, z=maxTess, w=minTess
+// Bindless: на отрисовку задаются только индексы объекта и материала в
+// корневых константах, данные читаются из структурированных буферов.
+cbuffer cbDraw : register(b0) {
+    uint gObjectIndex;
+    uint gMaterialIndex;
 };
 
-float ComputeTessLevel(float3 worldPos) {
-    float minDist = gTessellationParams.x;
-    float maxDist = gTessellationParams.y;
-    float maxTess = gTessellationParams.z;
-    float minTess = gTessellationParams.w;
+struct ObjectData {
+    float4x4 World;
+    float4x4 WorldViewProj;
+    float4 CameraPosition;
+    float4 TessellationParams; // z=maxTess, w=minTess; x, y не используются
+    float4 WaveParams;
+};
+StructuredBuffer<ObjectData> gObjects : register(t0);
+
+#define gWorld gObjects[gObjectIndex].World
+#define gWorldViewProj gObjects[gObjectIndex].WorldViewProj
+#define gCameraPosition gObjects[gObjectIndex].CameraPosition
+#define gTessellationParams gObjects[gObjectIndex].TessellationParams
+#define gWaveParams gObjects[gObjectIndex].WaveParams
+
+cbuffer cbGeometryPass : register(b1) {
+    float4 gFrustumPlanes[6]; // мировое пространство, нормали внутрь
+    float4 gPatchCullParams;  // x=отсечение по фрустуму, y=по обратной стороне
+    // x=пикселей на единицу мира с расстояния 1, y=целевых пикселей на ребро,
+    // z=глобальный множитель (бюджет)
+    float4 gTessScreenParams;
+};
+
+// Повторяет MaterialConstants из Material.h.
+struct MaterialData {
+    float4 DiffuseAlbedo;
+    float3 FresnelR0;
+    float Roughness;
+    float HasNormalMap;
+    float HasDisplacementMap;
+    float HasRoughnessMap;
+    float DisplacementScale;
+    float4x4 TexTransform;
+    uint DiffuseMapIndex;
+    uint NormalMapIndex;
+    uint DisplacementMapIndex;
+    uint RoughnessMapIndex;
+    uint DiffuseMapSlice;
+    uint NormalMapSlice;
+    uint DisplacementMapSlice;
+    uint RoughnessMapSlice;
+};
+StructuredBuffer<MaterialData> gMaterials : register(t1);
+
+#define gDisplacementScale gMaterials[gMaterialIndex].DisplacementScale
 
-    float distToCamera = distance(worldPos, gCameraPosition.xyz);
-    float factor = saturate((maxDist - distToCamera) / max(maxDist - minDist, 1e-4f));
+// Ребро делится так, чтобы каждый отрезок занимал на экране примерно
+// gTessScreenParams.y пикселей. Фактор зависит только от концов ребра, поэтому
+// у соседних патчей он совпадает и трещин нет.
+// CPU-версия: TessellationFactors::ComputeEdgeFactor, держать в синхроне.
+float ComputeEdgeTessFactor(float3 a, float3 b) {
+    float minTess = max(gTessellationParams.w, 1.0f);
+    float maxTess = max(gTessellationParams.z, minTess);
 
-    // Квадратичная кривая делает рост детализации заметным при подлете к поверхности.
-    float tessLevel = lerp(minTess, maxTess, factor * factor);
-    return max(1.0f, tessLevel);
+    float3 mid = 0.5f * (a + b);
+    float distToCamera = max(distance(mid, gCameraPosition.xyz), 1e-3f);
+    float edgePixels = distance(a, b) * gTessScreenParams.x / distToCamera;
+    float factor = edgePixels / max(gTessScreenParams.y, 1e-3f) * gTessScreenParams.z;
+    return clamp(factor, minTess, maxTess);
+}
+
+// Патч невидим, если все его вершины, сдвинутые на максимальное смещение
+// domain shader'а, лежат снаружи одной из плоскостей фрустума.
+bool IsPatchOutsideFrustum(float3 p0, float3 p1, float3 p2, float expand) {
+    [unroll]
+    for (int i = 0; i < 6; ++i) {
+        float4 plane = gFrustumPlanes[i];
+        if (dot(plane.xyz, p0) + plane.w < -expand &&
+            dot(plane.xyz, p1) + plane.w < -expand &&
+            dot(plane.xyz, p2) + plane.w < -expand) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Консервативно: патч отбрасывается, только если нормали всех трех вершин
+// смотрят от камеры, иначе смещение может открыть его край.
+bool IsPatchBackfacing(float3 p0, float3 p1, float3 p2,
+                       float3 n0, float3 n1, float3 n2) {
+    const float kTolerance = -0.05f;
+    float3 eye = gCameraPosition.xyz;
+    return dot(normalize(n0), normalize(eye - p0)) < kTolerance &&
+           dot(normalize(n1), normalize(eye - p1)) < kTolerance &&
+           dot(normalize(n2), normalize(eye - p2)) < kTolerance;
 }
 
 
@@ -41,14 +114,34 @@ HS_CONSTANT_DATA_OUTPUT CalcHSPatchConstants(
     float3 p0 = mul(float4(patch[0].Pos, 1.0f), gWorld).xyz;
     float3 p1 = mul(float4(patch[1].Pos, 1.0f), gWorld).xyz;
     float3 p2 = mul(float4(patch[2].Pos, 1.0f), gWorld).xyz;
-    
-    float3 edgeMid01 = 0.5f * (p0 + p1);
-    float3 edgeMid12 = 0.5f * (p1 + p2);
-    float3 edgeMid20 = 0.5f * (p2 + p0);
-
-    output.EdgeTess[0] = ComputeTessLevel(edgeMid12);
-    output.EdgeTess[1] = ComputeTessLevel(edgeMid20);
-    output.EdgeTess[2] = ComputeTessLevel(edgeMid01);
+
+    // Смещение задается в пространстве объекта, а плоскости фрустума в
+    // мировом, поэтому запас переводится в мировые единицы по самой длинной
+    // оси gWorld (строки матрицы - образы осей объекта).
+    float worldScale = max(length(gWorld[0].xyz),
+                           max(length(gWorld[1].xyz), length(gWorld[2].xyz)));
+    float maxDisplacement =
+        (abs(gDisplacementScale) + abs(gWaveParams.x)) * worldScale;
+    bool culled = gPatchCullParams.x > 0.0f &&
+                  IsPatchOutsideFrustum(p0, p1, p2, maxDisplacement);
+    if (!culled && gPatchCullParams.y > 0.0f) {
+        float3 n0 = mul(float4(patch[0].Normal, 0.0f), gWorld).xyz;
+        float3 n1 = mul(float4(patch[1].Normal, 0.0f), gWorld).xyz;
+        float3 n2 = mul(float4(patch[2].Normal, 0.0f), gWorld).xyz;
+        culled = IsPatchBackfacing(p0, p1, p2, n0, n1, n2);
+    }
+    if (culled) {
+        // Нулевые факторы отбрасывают патч до тесселятора и domain shader'а.
+        output.EdgeTess[0] = 0.0f;
+        output.EdgeTess[1] = 0.0f;
+        output.EdgeTess[2] = 0.0f;
+        output.InsideTess = 0.0f;
+        return output;
+    }
+
+    output.EdgeTess[0] = ComputeEdgeTessFactor(p1, p2);
+    output.EdgeTess[1] = ComputeEdgeTessFactor(p2, p0);
+    output.EdgeTess[2] = ComputeEdgeTessFactor(p0, p1);
     output.InsideTess = (output.EdgeTess[0] + output.EdgeTess[1] + output.EdgeTess[2]) / 3.0f;
 
     return output;
@@ -12,45 +12,74 @@ struct PS_OUTPUT {
     float4 Normal : SV_Target1;
 };
 
-cbuffer cbMaterial : register(b2) {
-    float4 gDiffuseAlbedo;
-    float3 gFresnelR0;
-    float gRoughness;
-    float gHasNormalMap;
-    float gHasDisplacementMap;
-    float gHasRoughnessMap;
-    float gDisplacementScale;
-    float4x4 gTexTransform;
+// Bindless: материал выбирается по индексу из корневых констант, текстуры
+// берутся из общего диапазона SRV по индексам, записанным в материале.
+cbuffer cbDraw : register(b0) {
+    uint gObjectIndex;
+    uint gMaterialIndex;
 };
 
-Texture2D gDiffuseMap : register(t0);
-Texture2D gNormalMap : register(t1);
-Texture2D gDisplacementMap : register(t2);
-Texture2D gRoughnessMap : register(t3);
+// Повторяет MaterialConstants из Material.h.
+struct MaterialData {
+    float4 DiffuseAlbedo;
+    float3 FresnelR0;
+    float Roughness;
+    float HasNormalMap;
+    float HasDisplacementMap;
+    float HasRoughnessMap;
+    float DisplacementScale;
+    float4x4 TexTransform;
+    uint DiffuseMapIndex;
+    uint NormalMapIndex;
+    uint DisplacementMapIndex;
+    uint RoughnessMapIndex;
+    uint DiffuseMapSlice;
+    uint NormalMapSlice;
+    uint DisplacementMapSlice;
+    uint RoughnessMapSlice;
+};
+StructuredBuffer<MaterialData> gMaterials : register(t1);
+
+// Перестановки шейдера: флаги материала задаются при компиляции, а не
+// проверяются в рантайме (см. RenderingSystem::GetGeometryPermutation).
+#ifndef USE_NORMAL_MAP
+#define USE_NORMAL_MAP 0
+#endif
+#ifndef USE_ROUGHNESS_MAP
+#define USE_ROUGHNESS_MAP 0
+#endif
+
+// Вся куча CBV/SRV/UAV, индексы материалов — номера слотов в ней; индекс
+// одинаков для всей отрисовки, поэтому NonUniformResourceIndex не нужен.
+Texture2DArray gTextures[] : register(t0, space1);
 SamplerState gSampler : register(s0);
 
 PS_OUTPUT PS(PS_INPUT input) {
     PS_OUTPUT output;
+    MaterialData material = gMaterials[gMaterialIndex];
 
-    float2 transformedTexC = mul(float4(input.TexC, 0.0f, 1.0f), gTexTransform).xy;
-    float4 texColor = gDiffuseMap.Sample(gSampler, transformedTexC);
+    float2 transformedTexC = mul(float4(input.TexC, 0.0f, 1.0f), material.TexTransform).xy;
+    float4 texColor = gTextures[material.DiffuseMapIndex].Sample(gSampler, float3(transformedTexC, material.DiffuseMapSlice));
 
-    output.Albedo = float4(gDiffuseAlbedo.rgb * texColor.rgb, gDiffuseAlbedo.a * texColor.a);
+    output.Albedo = float4(material.DiffuseAlbedo.rgb * texColor.rgb, material.DiffuseAlbedo.a * texColor.a);
 
     float3 worldNormal = normalize(input.Normal);
-    if (gHasNormalMap > 0.5f) {
-        float3 tangent = normalize(input.Tangent);
-        float3 bitangent = normalize(input.Bitangent);
-        float3x3 tbn = float3x3(tangent, bitangent, worldNormal);
-
-        float3 mapNormal = gNormalMap.Sample(gSampler, transformedTexC).xyz * 2.0f - 1.0f;
-        worldNormal = normalize(mul(mapNormal, tbn));
-    }
-
-    float roughness = saturate(gRoughness);
-    if (gHasRoughnessMap > 0.5f) {
-        roughness = saturate(gRoughnessMap.Sample(gSampler, transformedTexC).r);
-    }
+#if USE_NORMAL_MAP
+    float3 tangent = normalize(input.Tangent);
+    float3 bitangent = normalize(input.Bitangent);
+    float3x3 tbn = float3x3(tangent, bitangent, worldNormal);
+
+    // z восстанавливается из xy: в BC5 хранятся только два канала
+    float2 mapNormalXY = gTextures[material.NormalMapIndex].Sample(gSampler, float3(transformedTexC, material.NormalMapSlice)).xy * 2.0f - 1.0f;
+    float3 mapNormal = float3(mapNormalXY, sqrt(saturate(1.0f - dot(mapNormalXY, mapNormalXY))));
+    worldNormal = normalize(mul(mapNormal, tbn));
+#endif
+
+#if USE_ROUGHNESS_MAP
+    float roughness = saturate(gTextures[material.RoughnessMapIndex].Sample(gSampler, float3(transformedTexC, material.RoughnessMapSlice)).r);
+#else
+    float roughness = saturate(material.Roughness);
+#endif
 
     output.Normal = float4(worldNormal * 0.5f + 0.5f, roughness);
     return output;
@@ -1,3 +1,17 @@
+// Упакованный формат вершины (PackedVertex, 20 байт вместо 76) включается
+// при компиляции; см. RenderingSystem::SetPackedVertices.
+#ifndef PACKED_VERTICES
+#define PACKED_VERTICES 0
+#endif
+
+#if PACKED_VERTICES
+struct VS_INPUT {
+    float4 Pos : POSITION;     // snorm внутри границ сабмеша, w: знак битангенса
+    float2 Normal : NORMAL;    // октаэдрическая развёртка
+    float2 Tangent : TANGENT;  // октаэдрическая развёртка
+    float2 TexC : TEXCOORD;    // half
+};
+#else
 struct VS_INPUT {
     float3 Pos : POSITION;
     float3 Normal : NORMAL;
@@ -6,6 +20,7 @@ struct VS_INPUT {
     float2 TexC : TEXCOORD;
     float4 Color : COLOR;
 };
+#endif
 
 struct VS_OUTPUT {
     float3 Pos : POSITION;
@@ -15,12 +30,82 @@ struct VS_OUTPUT {
     float2 TexC : TEXCOORD;
 };
 
-VS_OUTPUT VS(VS_INPUT input) {
+// Bindless: на отрисовку задаются только индексы объекта и материала в
+// корневых константах, данные читаются из структурированных буферов.
+// Границы сабмеша нужны только для распаковки позиций.
+cbuffer cbDraw : register(b0) {
+    uint gObjectIndex;
+    uint gMaterialIndex;
+    float4 gPositionCenter;
+    float4 gPositionExtents;
+};
+
+float3 DecodeOctahedral(float2 e) {
+    float3 v = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    float fold = saturate(-v.z);
+    v.xy += v.xy >= 0.0f ? -fold : fold;
+    return normalize(v);
+}
+
+// Распаковывает вершину в локальные координаты; то же, что UnpackVertex на
+// CPU. Дальше (в том числе в HS/DS) идут обычные float3.
+VS_OUTPUT DecodeVertex(VS_INPUT input) {
     VS_OUTPUT output;
+#if PACKED_VERTICES
+    output.Pos = gPositionCenter.xyz + gPositionExtents.xyz * input.Pos.xyz;
+    output.Normal = DecodeOctahedral(input.Normal);
+    output.Tangent = DecodeOctahedral(input.Tangent);
+    output.Bitangent = normalize(cross(output.Normal, output.Tangent)) *
+                       (input.Pos.w >= 0.0f ? 1.0f : -1.0f);
+#else
     output.Pos = input.Pos;
     output.Normal = input.Normal;
     output.Tangent = input.Tangent;
     output.Bitangent = input.Bitangent;
+#endif
     output.TexC = input.TexC;
     return output;
-}
\ No newline at end of file
+}
+
+VS_OUTPUT VS(VS_INPUT input) {
+    return DecodeVertex(input);
+}
+
+struct PLAIN_VS_OUTPUT {
+    float4 Pos : SV_POSITION;
+    float3 WorldPos : WORLDPOS;
+    float3 Normal : NORMAL;
+    float3 Tangent : TANGENT;
+    float3 Bitangent : BITANGENT;
+    float2 TexC : TEXCOORD;
+};
+
+struct ObjectData {
+    float4x4 World;
+    float4x4 WorldViewProj;
+    float4 CameraPosition;
+    float4 TessellationParams;
+    float4 WaveParams;
+};
+StructuredBuffer<ObjectData> gObjects : register(t0);
+
+#define gWorld gObjects[gObjectIndex].World
+#define gWorldViewProj gObjects[gObjectIndex].WorldViewProj
+#define gCameraPosition gObjects[gObjectIndex].CameraPosition
+#define gTessellationParams gObjects[gObjectIndex].TessellationParams
+#define gWaveParams gObjects[gObjectIndex].WaveParams
+
+// Вариант без тесселяции: делает то же, что DeferredGeometryDS для вершины
+// без смещения, и используется материалами без displacement и волн.
+PLAIN_VS_OUTPUT PlainVS(VS_INPUT input) {
+    PLAIN_VS_OUTPUT output;
+    VS_OUTPUT local = DecodeVertex(input);
+    float4 worldPos = mul(float4(local.Pos, 1.0f), gWorld);
+    output.Pos = mul(worldPos, gWorldViewProj);
+    output.WorldPos = worldPos.xyz;
+    output.Normal = normalize(mul(float4(local.Normal, 0.0f), gWorld).xyz);
+    output.Tangent = normalize(mul(float4(local.Tangent, 0.0f), gWorld).xyz);
+    output.Bitangent = normalize(mul(float4(local.Bitangent, 0.0f), gWorld).xyz);
+    output.TexC = local.TexC;
+    return output;
+}
@@ -0,0 +1,103 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+DescriptorAllocator::DescriptorAllocator(uint32_t persistentCount,
+                                         uint32_t transientCount)
+    : mPersistentCount(persistentCount),
+      mTransientCount(transientCount),
+      mAllocatedCounts(persistentCount, 0) {
+  if (persistentCount > 0) {
+    mFreeRanges.push_back({0, persistentCount});
+  }
+}
+
+uint32_t DescriptorAllocator::AllocatePersistent(uint32_t count) {
+  if (count == 0) {
+    throw std::invalid_argument("Descriptor allocations need a size");
+  }
+  const auto it = std::find_if(
+      mFreeRanges.begin(), mFreeRanges.end(),
+      [count](const Range& range) { return range.Count >= count; });
+  if (it == mFreeRanges.end()) {
+    throw std::runtime_error(
+        "Persistent descriptors exhausted: " + std::to_string(count) +
+        " requested, " + std::to_string(mPersistentUsed) + " of " +
+        std::to_string(mPersistentCount) + " used in " +
+        std::to_string(mFreeRanges.size()) + " free ranges");
+  }
+
+  const uint32_t index = it->Start;
+  it->Start += count;
+  it->Count -= count;
+  if (it->Count == 0) {
+    mFreeRanges.erase(it);
+  }
+  mAllocatedCounts[index] = count;
+  mPersistentUsed += count;
+  mPersistentPeak = std::max(mPersistentPeak, mPersistentUsed);
+  return index;
+}
+
+void DescriptorAllocator::FreePersistent(uint32_t index) {
+  if (index >= mPersistentCount || mAllocatedCounts[index] == 0) {
+    throw std::invalid_argument("Descriptor " + std::to_string(index) +
+                                " is not a persistent allocation");
+  }
+  const uint32_t count = mAllocatedCounts[index];
+  mAllocatedCounts[index] = 0;
+  mPersistentUsed -= count;
+
+  auto next = std::lower_bound(
+      mFreeRanges.begin(), mFreeRanges.end(), index,
+      [](const Range& range, uint32_t start) { return range.Start < start; });
+  const bool mergePrevious =
+      next != mFreeRanges.begin() &&
+      std::prev(next)->Start + std::prev(next)->Count == index;
+  const bool mergeNext =
+      next != mFreeRanges.end() && index + count == next->Start;
+  if (mergePrevious && mergeNext) {
+    std::prev(next)->Count += count + next->Count;
+    mFreeRanges.erase(next);
+  } else if (mergePrevious) {
+    std::prev(next)->Count += count;
+  } else if (mergeNext) {
+    next->Start = index;
+    next->Count += count;
+  } else {
+    mFreeRanges.insert(next, {index, count});
+  }
+}
+
+uint32_t DescriptorAllocator::AllocateTransient(uint32_t count) {
+  if (count == 0) {
+    throw std::invalid_argument("Descriptor allocations need a size");
+  }
+  if (count > mTransientCount - mTransientUsed) {
+    throw std::runtime_error(
+        "Transient descriptors exhausted: " + std::to_string(count) +
+        " requested, " + std::to_string(mTransientUsed) + " of " +
+        std::to_string(mTransientCount) + " used this frame");
+  }
+  const uint32_t index = mPersistentCount + mTransientUsed;
+  mTransientUsed += count;
+  mTransientPeak = std::max(mTransientPeak, mTransientUsed);
+  return index;
+}
+
+void DescriptorAllocator::Reset() { mTransientUsed = 0; }
+
+DescriptorAllocator::Stats DescriptorAllocator::GetStats() const {
+  Stats stats;
+  stats.PersistentCapacity = mPersistentCount;
+  stats.PersistentUsed = mPersistentUsed;
+  stats.PersistentPeak = mPersistentPeak;
+  stats.PersistentFreeRanges = static_cast<uint32_t>(mFreeRanges.size());
+  stats.TransientCapacity = mTransientCount;
+  stats.TransientUsed = mTransientUsed;
+  stats.TransientPeak = mTransientPeak;
+  return stats;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Index bookkeeping for one shader-visible descriptor heap, split into two
+// regions. The persistent region [0, persistentCount) holds long-lived views:
+// ranges are handed out first fit from a free list and merged with their
+// neighbours when freed. The transient region that follows is a linear
+// allocator for views that live for one frame; Reset() hands it out again
+// from the start. DescriptorHeap creates the ID3D12DescriptorHeap and the
+// views themselves.
+//
+// Neither region grows: the heap's GPU handles are baked into descriptor
+// tables and written views, so running out throws std::runtime_error with
+// the sizes instead.
+class DescriptorAllocator {
+ public:
+  static constexpr uint32_t kInvalidIndex = UINT32_MAX;
+
+  struct Stats {
+    uint32_t PersistentCapacity = 0;
+    uint32_t PersistentUsed = 0;
+    uint32_t PersistentPeak = 0;
+    uint32_t PersistentFreeRanges = 0;
+    uint32_t TransientCapacity = 0;
+    uint32_t TransientUsed = 0;
+    uint32_t TransientPeak = 0;
+  };
+
+  DescriptorAllocator() = default;
+  DescriptorAllocator(uint32_t persistentCount, uint32_t transientCount);
+
+  // Returns the first index of count contiguous persistent descriptors.
+  uint32_t AllocatePersistent(uint32_t count = 1);
+  // Releases the whole range that AllocatePersistent() returned at index.
+  void FreePersistent(uint32_t index);
+  // Returns the first index of count contiguous descriptors that stay valid
+  // until the next Reset().
+  uint32_t AllocateTransient(uint32_t count);
+  // Starts a new frame of transient allocations. Views handed out before must
+  // no longer be in use by the GPU.
+  void Reset();
+
+  uint32_t GetCapacity() const { return mPersistentCount + mTransientCount; }
+  Stats GetStats() const;
+
+ private:
+  struct Range {
+    uint32_t Start = 0;
+    uint32_t Count = 0;
+  };
+
+  uint32_t mPersistentCount = 0;
+  uint32_t mTransientCount = 0;
+  // Free persistent ranges sorted by Start, never adjacent.
+  std::vector<Range> mFreeRanges;
+  // Count of the allocated range starting at each persistent index; 0 if
+  // none starts there.
+  std::vector<uint32_t> mAllocatedCounts;
+  uint32_t mPersistentUsed = 0;
+  uint32_t mPersistentPeak = 0;
+  uint32_t mTransientUsed = 0;
+  uint32_t mTransientPeak = 0;
+};
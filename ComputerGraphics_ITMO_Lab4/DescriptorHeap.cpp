@@ -0,0 +1,29 @@
+#include "DescriptorHeap.h"
+
+void DescriptorHeap::Initialize(ID3D12Device* device,
+                                D3D12_DESCRIPTOR_HEAP_TYPE type,
+                                uint32_t persistentCount,
+                                uint32_t transientCount) {
+  D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+  heapDesc.NumDescriptors = persistentCount + transientCount;
+  heapDesc.Type = type;
+  heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+  heapDesc.NodeMask = 0;
+  ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mHeap)));
+
+  mAllocator = DescriptorAllocator(persistentCount, transientCount);
+  mCpuStart = mHeap->GetCPUDescriptorHandleForHeapStart();
+  mGpuStart = mHeap->GetGPUDescriptorHandleForHeapStart();
+  mDescriptorSize = device->GetDescriptorHandleIncrementSize(type);
+}
+
+void DescriptorHeap::LogStatistics() const {
+  const DescriptorAllocator::Stats stats = mAllocator.GetStats();
+  std::ostringstream message;
+  message << "Descriptors: persistent " << stats.PersistentUsed << " of "
+          << stats.PersistentCapacity << " (peak " << stats.PersistentPeak
+          << ", " << stats.PersistentFreeRanges << " free ranges); transient "
+          << stats.TransientUsed << " of " << stats.TransientCapacity
+          << " (peak " << stats.TransientPeak << ")\n";
+  OutputDebugStringA(message.str().c_str());
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Common.h"
+#include "DescriptorAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+// A shader-visible CBV/SRV/UAV (or sampler) heap whose slots are handed out
+// by DescriptorAllocator instead of fixed indices. Owners of long-lived views
+// allocate persistent slots once and free them when the views go away;
+// views needed for a single frame come from the transient region, which
+// BeginFrame() recycles. Relies on the frame structure of BoxApp: the GPU is
+// idle when BeginFrame() is called.
+class DescriptorHeap {
+ public:
+  void Initialize(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+                  uint32_t persistentCount, uint32_t transientCount);
+
+  // Both throw std::runtime_error when the region is exhausted.
+  uint32_t AllocatePersistent(uint32_t count = 1) {
+    return mAllocator.AllocatePersistent(count);
+  }
+  void FreePersistent(uint32_t index) { mAllocator.FreePersistent(index); }
+  uint32_t AllocateTransient(uint32_t count) {
+    return mAllocator.AllocateTransient(count);
+  }
+  void BeginFrame() { mAllocator.Reset(); }
+
+  D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(uint32_t index) const {
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mCpuStart, static_cast<INT>(index),
+                                         mDescriptorSize);
+  }
+  D3D12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(uint32_t index) const {
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(mGpuStart, static_cast<INT>(index),
+                                         mDescriptorSize);
+  }
+  ID3D12DescriptorHeap* GetHeap() const { return mHeap.Get(); }
+  UINT GetDescriptorSize() const { return mDescriptorSize; }
+  DescriptorAllocator::Stats GetStats() const {
+    return mAllocator.GetStats();
+  }
+  void LogStatistics() const;
+
+ private:
+  ComPtr<ID3D12DescriptorHeap> mHeap;
+  DescriptorAllocator mAllocator;
+  D3D12_CPU_DESCRIPTOR_HANDLE mCpuStart = {};
+  D3D12_GPU_DESCRIPTOR_HANDLE mGpuStart = {};
+  UINT mDescriptorSize = 0;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a over a stream of fields. Integers are fed in little-endian
+// byte order, so a hash is the same on every platform.
+class Fnv1aHash {
+ public:
+  void AddBytes(const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      mHash ^= bytes[i];
+      mHash *= 1099511628211ull;
+    }
+  }
+
+  void AddUint32(uint32_t value) {
+    const uint8_t bytes[4] = {
+        static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+        static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+    AddBytes(bytes, sizeof(bytes));
+  }
+
+  void AddUint64(uint64_t value) {
+    AddUint32(static_cast<uint32_t>(value));
+    AddUint32(static_cast<uint32_t>(value >> 32));
+  }
+
+  // Length-prefixed so that ("ab", "c") and ("a", "bc") differ.
+  void AddString(const std::string& value) {
+    AddUint32(static_cast<uint32_t>(value.size()));
+    AddBytes(value.data(), value.size());
+  }
+
+  uint64_t Get() const { return mHash; }
+
+ private:
+  uint64_t mHash = 14695981039346656037ull;
+};
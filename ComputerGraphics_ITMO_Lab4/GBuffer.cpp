@@ -1,16 +1,22 @@
 #include "GBuffer.h"
 
+namespace {
+const float kAlbedoClear[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+const float kNormalClear[4] = {0.5f, 0.5f, 1.0f, 1.0f};
+// Premultiplied: an empty particle target leaves the back buffer unchanged.
+const float kParticleClear[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+}  // namespace
+
 void GBuffer::Initialize(ID3D12Device* device, UINT width, UINT height,
                          ID3D12DescriptorHeap* rtvHeap,
-                         ID3D12DescriptorHeap* cbvSrvHeap,
-                         UINT rtvDescriptorSize, UINT cbvSrvDescriptorSize,
-                         UINT rtvStartIndex, UINT srvStartIndex) {
+                         DescriptorHeap* cbvSrvHeap, UINT rtvDescriptorSize,
+                         UINT rtvStartIndex,
+                         D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle) {
   mRtvHeap = rtvHeap;
   mCbvSrvHeap = cbvSrvHeap;
   mRtvDescriptorSize = rtvDescriptorSize;
-  mCbvSrvDescriptorSize = cbvSrvDescriptorSize;
   mRtvStartIndex = rtvStartIndex;
-  mSrvStartIndex = srvStartIndex;
+  mDsvHandle = dsvHandle;
 
   CreateResources(device, width, height);
   CreateDescriptors(device);
@@ -25,115 +31,127 @@ void GBuffer::CreateResources(ID3D12Device* device, UINT width, UINT height) {
   mWidth = width;
   mHeight = height;
 
-  D3D12_CLEAR_VALUE albedoClear = {};
-  albedoClear.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-  albedoClear.Color[0] = 0.0f;
-  albedoClear.Color[1] = 0.0f;
-  albedoClear.Color[2] = 0.0f;
-  albedoClear.Color[3] = 1.0f;
-
-  D3D12_CLEAR_VALUE normalClear = {};
-  normalClear.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-  normalClear.Color[0] = 0.5f;
-  normalClear.Color[1] = 0.5f;
-  normalClear.Color[2] = 1.0f;
-  normalClear.Color[3] = 1.0f;
-
-  auto albedoDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+  D3D12_RESOURCE_DESC descs[kTargetCount];
+  descs[kAlbedo] = CD3DX12_RESOURCE_DESC::Tex2D(
       DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1, 1, 0,
       D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
-  auto normalDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+  descs[kNormal] = CD3DX12_RESOURCE_DESC::Tex2D(
       DXGI_FORMAT_R16G16B16A16_FLOAT, width, height, 1, 1, 1, 0,
       D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+  descs[kDepth] = CD3DX12_RESOURCE_DESC::Tex2D(
+      DXGI_FORMAT_R24G8_TYPELESS, width, height, 1, 1, 1, 0,
+      D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+  descs[kParticleColor] = CD3DX12_RESOURCE_DESC::Tex2D(
+      kParticleColorFormat, width, height, 1, 1, 1, 0,
+      D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
 
-  auto defaultHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-
-  ThrowIfFailed(device->CreateCommittedResource(
-      &defaultHeap, D3D12_HEAP_FLAG_NONE, &albedoDesc,
-      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, &albedoClear,
-      IID_PPV_ARGS(&mAlbedo)));
-
-  ThrowIfFailed(device->CreateCommittedResource(
-      &defaultHeap, D3D12_HEAP_FLAG_NONE, &normalDesc,
-      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, &normalClear,
-      IID_PPV_ARGS(&mNormal)));
+  D3D12_CLEAR_VALUE clears[kTargetCount] = {};
+  clears[kAlbedo] = CD3DX12_CLEAR_VALUE(DXGI_FORMAT_R8G8B8A8_UNORM,
+                                        kAlbedoClear);
+  clears[kNormal] = CD3DX12_CLEAR_VALUE(DXGI_FORMAT_R16G16B16A16_FLOAT,
+                                        kNormalClear);
+  clears[kDepth] = CD3DX12_CLEAR_VALUE(DepthStencilFormat, 1.0f, 0);
+  clears[kParticleColor] =
+      CD3DX12_CLEAR_VALUE(kParticleColorFormat, kParticleClear);
+
+  const D3D12_RESOURCE_STATES initialStates[kTargetCount] = {
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+      D3D12_RESOURCE_STATE_DEPTH_WRITE,
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE};
+  const char* names[kTargetCount] = {"GBufferAlbedo", "GBufferNormal",
+                                     "Depth", "ParticleColor"};
+
+  mTransientPlanner.Reset();
+  UINT64 heapAlignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+  for (UINT target = 0; target < kTargetCount; ++target) {
+    const D3D12_RESOURCE_ALLOCATION_INFO info =
+        device->GetResourceAllocationInfo(0, 1, &descs[target]);
+    mTransientPlanner.DeclareResource(names[target], info.SizeInBytes,
+                                      info.Alignment);
+    heapAlignment = std::max(heapAlignment, info.Alignment);
+  }
+  // The passes of RenderingSystem::Render that touch these targets, in
+  // order. Particle simulation uses none of them.
+  mTransientPlanner.AddPass("Geometry", {}, {kAlbedo, kNormal, kDepth});
+  mTransientPlanner.AddPass("Compose", {kAlbedo, kNormal, kDepth}, {});
+  mTransientPlanner.AddPass("ParticleRender", {kDepth}, {kParticleColor});
+  mTransientPlanner.AddPass("ParticleComposite", {kParticleColor}, {});
+  mTransientPlanner.AddPass("ParticleDepthCopy", {kDepth}, {});
+  mTransientPlanner.Compile();
+  OutputDebugStringA(mTransientPlanner.BuildReport().c_str());
+
+  const UINT64 heapSize =
+      (mTransientPlanner.GetHeapSize() + heapAlignment - 1) &
+      ~(heapAlignment - 1);
+
+  for (auto& target : mTargets) {
+    target.Reset();
+  }
+  if (mTransientHeap == nullptr || heapSize > mTransientHeapSize) {
+    D3D12_HEAP_DESC heapDesc = {};
+    heapDesc.SizeInBytes = heapSize;
+    heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    heapDesc.Alignment = heapAlignment;
+    heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+    mTransientHeap.Reset();
+    ThrowIfFailed(
+        device->CreateHeap(&heapDesc, IID_PPV_ARGS(&mTransientHeap)));
+    mTransientHeapSize = heapSize;
+  }
+
+  for (UINT target = 0; target < kTargetCount; ++target) {
+    ThrowIfFailed(device->CreatePlacedResource(
+        mTransientHeap.Get(), mTransientPlanner.GetPlacement(target).HeapOffset,
+        &descs[target], initialStates[target], &clears[target],
+        IID_PPV_ARGS(&mTargets[target])));
+  }
 }
 
 void GBuffer::CreateDescriptors(ID3D12Device* device) {
-  mRtvHandles[0] = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-      mRtvHeap->GetCPUDescriptorHandleForHeapStart(),
-      static_cast<INT>(mRtvStartIndex), mRtvDescriptorSize);
-  mRtvHandles[1] = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-      mRtvHeap->GetCPUDescriptorHandleForHeapStart(),
-      static_cast<INT>(mRtvStartIndex + 1), mRtvDescriptorSize);
-
-  mSrvHandles[0] = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-      mCbvSrvHeap->GetCPUDescriptorHandleForHeapStart(),
-      static_cast<INT>(mSrvStartIndex), mCbvSrvDescriptorSize);
-  mSrvHandles[1] = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-      mCbvSrvHeap->GetCPUDescriptorHandleForHeapStart(),
-      static_cast<INT>(mSrvStartIndex + 1), mCbvSrvDescriptorSize);
-
-  mSrvStartGpuHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(
-      mCbvSrvHeap->GetGPUDescriptorHandleForHeapStart(),
-      static_cast<INT>(mSrvStartIndex), mCbvSrvDescriptorSize);
-
-  D3D12_RENDER_TARGET_VIEW_DESC albedoRtv = {};
-  albedoRtv.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-  albedoRtv.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
-  device->CreateRenderTargetView(mAlbedo.Get(), &albedoRtv, mRtvHandles[0]);
-
-  D3D12_RENDER_TARGET_VIEW_DESC normalRtv = {};
-  normalRtv.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-  normalRtv.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
-  device->CreateRenderTargetView(mNormal.Get(), &normalRtv, mRtvHandles[1]);
-
-  D3D12_SHADER_RESOURCE_VIEW_DESC albedoSrv = {};
-  albedoSrv.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  albedoSrv.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-  albedoSrv.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-  albedoSrv.Texture2D.MipLevels = 1;
-  device->CreateShaderResourceView(mAlbedo.Get(), &albedoSrv, mSrvHandles[0]);
-
-  D3D12_SHADER_RESOURCE_VIEW_DESC normalSrv = {};
-  normalSrv.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-  normalSrv.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-  normalSrv.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-  normalSrv.Texture2D.MipLevels = 1;
-  device->CreateShaderResourceView(mNormal.Get(), &normalSrv, mSrvHandles[1]);
+  const Target rtvTargets[kRtvCount] = {kAlbedo, kNormal, kParticleColor};
+  for (UINT i = 0; i < kRtvCount; ++i) {
+    mRtvHandles[i] = CD3DX12_CPU_DESCRIPTOR_HANDLE(
+        mRtvHeap->GetCPUDescriptorHandleForHeapStart(),
+        static_cast<INT>(mRtvStartIndex + i), mRtvDescriptorSize);
+    device->CreateRenderTargetView(mTargets[rtvTargets[i]].Get(), nullptr,
+                                   mRtvHandles[i]);
+  }
+
+  D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+  dsvDesc.Format = DepthStencilFormat;
+  dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+  device->CreateDepthStencilView(mTargets[kDepth].Get(), &dsvDesc, mDsvHandle);
+}
+
+void GBuffer::CreateSrvs(ID3D12Device* device, UINT srvStartIndex) const {
+  const DXGI_FORMAT srvFormats[kSrvCount] = {
+      DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R16G16B16A16_FLOAT,
+      DXGI_FORMAT_R24_UNORM_X8_TYPELESS, kParticleColorFormat};
+  for (UINT target = 0; target < kSrvCount; ++target) {
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Format = srvFormats[target];
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MipLevels = 1;
+    device->CreateShaderResourceView(
+        mTargets[target].Get(), &srvDesc,
+        mCbvSrvHeap->GetCpuHandle(srvStartIndex + target));
+  }
 }
 
-void GBuffer::BeginGeometryPass(ID3D12GraphicsCommandList* cmdList,
-                                D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle) const {
-  std::array<D3D12_RESOURCE_BARRIER, 2> toRt = {
-      CD3DX12_RESOURCE_BARRIER::Transition(
-          mAlbedo.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-          D3D12_RESOURCE_STATE_RENDER_TARGET),
-      CD3DX12_RESOURCE_BARRIER::Transition(
-          mNormal.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-          D3D12_RESOURCE_STATE_RENDER_TARGET)};
-  cmdList->ResourceBarrier(static_cast<UINT>(toRt.size()), toRt.data());
-
-  const float albedoClear[4] = {0.0f, 0.0f, 0.0f, 1.0f};
-  const float normalClear[4] = {0.5f, 0.5f, 1.0f, 1.0f};
-
-  cmdList->ClearRenderTargetView(mRtvHandles[0], albedoClear, 0, nullptr);
-  cmdList->ClearRenderTargetView(mRtvHandles[1], normalClear, 0, nullptr);
+void GBuffer::BeginGeometryPass(ID3D12GraphicsCommandList* cmdList) const {
+  cmdList->ClearRenderTargetView(mRtvHandles[0], kAlbedoClear, 0, nullptr);
+  cmdList->ClearRenderTargetView(mRtvHandles[1], kNormalClear, 0, nullptr);
   cmdList->ClearDepthStencilView(
-      dsvHandle, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0,
-      nullptr);
+      mDsvHandle, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0,
+      0, nullptr);
 
   cmdList->OMSetRenderTargets(kRenderTargetCount, mRtvHandles, true,
-                              &dsvHandle);
+                              &mDsvHandle);
 }
 
-void GBuffer::EndGeometryPass(ID3D12GraphicsCommandList* cmdList) const {
-  std::array<D3D12_RESOURCE_BARRIER, 2> toSrv = {
-      CD3DX12_RESOURCE_BARRIER::Transition(
-          mAlbedo.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET,
-          D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
-      CD3DX12_RESOURCE_BARRIER::Transition(
-          mNormal.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET,
-          D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE)};
-  cmdList->ResourceBarrier(static_cast<UINT>(toSrv.size()), toSrv.data());
+void GBuffer::BeginParticlePass(ID3D12GraphicsCommandList* cmdList) const {
+  cmdList->ClearRenderTargetView(mRtvHandles[2], kParticleClear, 0, nullptr);
+  cmdList->OMSetRenderTargets(1, &mRtvHandles[2], true, &mDsvHandle);
 }
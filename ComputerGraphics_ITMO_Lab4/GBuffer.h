@@ -16,29 +16,69 @@
 #include "Common.h"
 #include "D3DWindow.h"
 #include "DDSTextureLoader.h"
+#include "DescriptorHeap.h"
 #include "GameTimer.h"
 #include "Structures.h"
+#include "TransientResourcePlanner.h"
 #include "UploadBuffer.h"
 #include "d3dx12.h"
 
+// Owns the frame's transient targets: the G-buffer, the depth buffer and
+// the off-screen particle target. They are placed in one heap laid out by
+// TransientResourcePlanner, so the particle target reuses G-buffer memory
+// once the compose pass has read it.
 class GBuffer {
  public:
+  // Render targets bound by the geometry pass.
   static constexpr UINT kRenderTargetCount = 2;
+  // RTVs written from rtvStartIndex: the two above, then the particle target.
+  static constexpr UINT kRtvCount = 3;
+  // SRVs written by CreateSrvs(), in Target order.
+  static constexpr UINT kSrvCount = 4;
+  static constexpr DXGI_FORMAT kParticleColorFormat =
+      DXGI_FORMAT_R8G8B8A8_UNORM;
 
+  // Declaration order in the planner, so also planner handles.
+  enum Target : UINT { kAlbedo, kNormal, kDepth, kParticleColor, kTargetCount };
+
+  // The RTVs go to rtvHeap slots rtvStartIndex..+2 and the DSV to
+  // dsvHandle. Albedo and normal start in PIXEL_SHADER_RESOURCE state, depth
+  // in DEPTH_WRITE and the particle target in PIXEL_SHADER_RESOURCE.
   void Initialize(ID3D12Device* device, UINT width, UINT height,
-                  ID3D12DescriptorHeap* rtvHeap,
-                  ID3D12DescriptorHeap* cbvSrvHeap, UINT rtvDescriptorSize,
-                  UINT cbvSrvDescriptorSize, UINT rtvStartIndex,
-                  UINT srvStartIndex);
+                  ID3D12DescriptorHeap* rtvHeap, DescriptorHeap* cbvSrvHeap,
+                  UINT rtvDescriptorSize, UINT rtvStartIndex,
+                  D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle);
+  // Writes the SRVs to cbvSrvHeap slots srvStartIndex..+3. The targets are
+  // transient, so the renderer takes these slots from the heap's transient
+  // region every frame.
+  void CreateSrvs(ID3D12Device* device, UINT srvStartIndex) const;
 
+  // Recreates the targets and rewrites the RTVs and the DSV in place; the
+  // next frame's CreateSrvs() picks up the new targets. The heap only grows,
+  // so an equal or smaller resolution reuses its memory. The GPU must be
+  // idle.
   void Resize(ID3D12Device* device, UINT width, UINT height);
 
-  void BeginGeometryPass(ID3D12GraphicsCommandList* cmdList,
-                         D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle) const;
-  void EndGeometryPass(ID3D12GraphicsCommandList* cmdList) const;
+  // Targets are expected to already be in RENDER_TARGET or DEPTH_WRITE
+  // state; transitions and aliasing barriers are issued by the render graph.
+  // Both clear their targets, which is also what makes a target valid after
+  // an aliasing barrier.
+  void BeginGeometryPass(ID3D12GraphicsCommandList* cmdList) const;
+  // Clears the particle target and binds it with depth for testing only.
+  void BeginParticlePass(ID3D12GraphicsCommandList* cmdList) const;
+
+  ID3D12Resource* GetTarget(Target target) const {
+    return mTargets[target].Get();
+  }
+  ID3D12Resource* GetAlbedo() const { return GetTarget(kAlbedo); }
+  ID3D12Resource* GetNormal() const { return GetTarget(kNormal); }
+  ID3D12Resource* GetDepth() const { return GetTarget(kDepth); }
+  ID3D12Resource* GetParticleColor() const { return GetTarget(kParticleColor); }
+  D3D12_CPU_DESCRIPTOR_HANDLE GetDsvHandle() const { return mDsvHandle; }
 
-  D3D12_GPU_DESCRIPTOR_HANDLE GetSrvStartGpuHandle() const {
-    return mSrvStartGpuHandle;
+  // Passes are declared in RenderingSystem::Render's order.
+  const TransientResourcePlanner& GetTransientPlanner() const {
+    return mTransientPlanner;
   }
 
  private:
@@ -49,16 +89,17 @@ class GBuffer {
   UINT mHeight = 0;
 
   ID3D12DescriptorHeap* mRtvHeap = nullptr;
-  ID3D12DescriptorHeap* mCbvSrvHeap = nullptr;
+  DescriptorHeap* mCbvSrvHeap = nullptr;
   UINT mRtvDescriptorSize = 0;
-  UINT mCbvSrvDescriptorSize = 0;
   UINT mRtvStartIndex = 0;
-  UINT mSrvStartIndex = 0;
 
-  ComPtr<ID3D12Resource> mAlbedo;
-  ComPtr<ID3D12Resource> mNormal;
+  // Render targets are placed resources in a shared heap that only grows,
+  // so Resize to an equal or smaller resolution reuses the same memory.
+  TransientResourcePlanner mTransientPlanner;
+  ComPtr<ID3D12Heap> mTransientHeap;
+  UINT64 mTransientHeapSize = 0;
+  std::array<ComPtr<ID3D12Resource>, kTargetCount> mTargets;
 
-  D3D12_CPU_DESCRIPTOR_HANDLE mRtvHandles[kRenderTargetCount] = {};
-  D3D12_CPU_DESCRIPTOR_HANDLE mSrvHandles[kRenderTargetCount] = {};
-  D3D12_GPU_DESCRIPTOR_HANDLE mSrvStartGpuHandle = {};
+  D3D12_CPU_DESCRIPTOR_HANDLE mRtvHandles[kRtvCount] = {};
+  D3D12_CPU_DESCRIPTOR_HANDLE mDsvHandle = {};
 };
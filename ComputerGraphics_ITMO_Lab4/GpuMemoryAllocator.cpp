@@ -0,0 +1,194 @@
+#include "GpuMemoryAllocator.h"
+
+void GpuMemoryAllocator::Initialize(ID3D12Device* device) {
+  mDevice = device;
+  // Resource heap tier 1 hardware cannot mix these in one heap.
+  mPools[kBufferPool].Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+  mPools[kTexturePool].Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+  mPools[kTargetPool].Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+}
+
+HRESULT GpuMemoryAllocator::CreateResource(
+    const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* clearValue, ComPtr<ID3D12Resource>& resource) {
+  if (desc.SampleDesc.Count > 1) {
+    const CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
+    return mDevice->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
+                                            &desc, initialState, clearValue,
+                                            IID_PPV_ARGS(&resource));
+  }
+
+  Pool pool = kTexturePool;
+  if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) {
+    pool = kBufferPool;
+  } else if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET |
+                           D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) {
+    pool = kTargetPool;
+  }
+
+  D3D12_RESOURCE_DESC placedDesc = desc;
+  D3D12_RESOURCE_ALLOCATION_INFO info = {};
+  if (pool == kTexturePool && desc.Alignment == 0) {
+    // Allowed when the most detailed mip fits in 64 KB; the runtime reports
+    // a larger alignment otherwise.
+    placedDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+    info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+    if (info.Alignment == D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT) {
+      ++mSmallAlignedTextures;
+    } else {
+      placedDesc.Alignment = 0;
+    }
+  }
+  if (placedDesc.Alignment == 0) {
+    info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+  }
+  if (info.SizeInBytes == UINT64_MAX) {
+    return E_INVALIDARG;
+  }
+
+  PoolState& state = mPools[pool];
+  const HeapSuballocator::Allocation allocation =
+      state.Allocator.Allocate(info.SizeInBytes, info.Alignment, false);
+  ID3D12Heap* heap = GetHeap(pool, allocation.Heap);
+  const HRESULT hr =
+      heap != nullptr
+          ? mDevice->CreatePlacedResource(heap, allocation.Offset, &placedDesc,
+                                          initialState, clearValue,
+                                          IID_PPV_ARGS(&resource))
+          : E_OUTOFMEMORY;
+  if (FAILED(hr)) {
+    state.Allocator.Free(allocation.Id);
+    resource = nullptr;
+    return hr;
+  }
+
+  Entry entry;
+  entry.ResourcePool = pool;
+  entry.Allocation = allocation.Id;
+  entry.Desc = placedDesc;
+  mEntries[resource.Get()] = entry;
+  mResources[MakeKey(pool, allocation.Id)] = resource.Get();
+  return S_OK;
+}
+
+void GpuMemoryAllocator::Free(ID3D12Resource* resource) {
+  const auto it = mEntries.find(resource);
+  if (it == mEntries.end()) {
+    return;
+  }
+  const Entry& entry = it->second;
+  mPools[entry.ResourcePool].Allocator.Free(entry.Allocation);
+  mResources.erase(MakeKey(entry.ResourcePool, entry.Allocation));
+  mEntries.erase(it);
+}
+
+void GpuMemoryAllocator::SetRelocatable(ID3D12Resource* resource,
+                                        RelocateCallback callback) {
+  const auto it = mEntries.find(resource);
+  if (it == mEntries.end()) {
+    return;
+  }
+  Entry& entry = it->second;
+  mPools[entry.ResourcePool].Allocator.SetMovable(entry.Allocation,
+                                                  callback != nullptr);
+  entry.Relocate = std::move(callback);
+}
+
+void GpuMemoryAllocator::Defragment(ID3D12GraphicsCommandList* cmdList,
+                                    uint64_t maxBytes) {
+  // The copies recorded last time have executed: the old resources and the
+  // heaps they emptied can go.
+  mRetired.clear();
+  for (PoolState& state : mPools) {
+    for (uint32_t heap : state.Allocator.ReleaseRetiredHeaps()) {
+      state.Heaps[heap] = nullptr;
+    }
+  }
+
+  for (int pool = 0; pool < kPoolCount; ++pool) {
+    const std::vector<HeapSuballocator::Move> moves =
+        mPools[pool].Allocator.Defragment(maxBytes);
+    for (const HeapSuballocator::Move& move : moves) {
+      const uint64_t key = MakeKey(static_cast<Pool>(pool), move.Id);
+      ID3D12Resource* oldResource = mResources[key];
+      Entry entry = mEntries[oldResource];
+
+      // Created in COMMON; the copy promotes it to COPY_DEST and the source
+      // to COPY_SOURCE.
+      ComPtr<ID3D12Resource> resource;
+      ThrowIfFailed(mDevice->CreatePlacedResource(
+          GetHeap(static_cast<Pool>(pool), move.ToHeap), move.ToOffset,
+          &entry.Desc, D3D12_RESOURCE_STATE_COMMON, nullptr,
+          IID_PPV_ARGS(&resource)));
+      cmdList->CopyResource(resource.Get(), oldResource);
+      const auto toCommon = CD3DX12_RESOURCE_BARRIER::Transition(
+          resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+          D3D12_RESOURCE_STATE_COMMON);
+      cmdList->ResourceBarrier(1, &toCommon);
+
+      mRetired.emplace_back(oldResource);
+      mEntries.erase(oldResource);
+      mEntries[resource.Get()] = entry;
+      mResources[key] = resource.Get();
+      entry.Relocate(resource);
+    }
+
+    if (!moves.empty()) {
+      uint64_t movedBytes = 0;
+      for (const HeapSuballocator::Move& move : moves) {
+        movedBytes += move.Size;
+      }
+      std::ostringstream message;
+      message << "GPU memory: moved " << moves.size() << " resources, "
+              << movedBytes / (1024.0 * 1024.0) << " MB\n";
+      OutputDebugStringA(message.str().c_str());
+    }
+  }
+}
+
+GpuMemoryAllocator::Stats GpuMemoryAllocator::GetStats() const {
+  Stats stats;
+  stats.Buffers = mPools[kBufferPool].Allocator.GetStats();
+  stats.Textures = mPools[kTexturePool].Allocator.GetStats();
+  stats.Targets = mPools[kTargetPool].Allocator.GetStats();
+  stats.SmallAlignedTextures = mSmallAlignedTextures;
+  return stats;
+}
+
+void GpuMemoryAllocator::LogStatistics() const {
+  const Stats stats = GetStats();
+  std::ostringstream message;
+  const char* names[kPoolCount] = {"buffers", "textures", "targets"};
+  const HeapSuballocator::Stats* pools[kPoolCount] = {
+      &stats.Buffers, &stats.Textures, &stats.Targets};
+  message << "GPU memory:";
+  for (int pool = 0; pool < kPoolCount; ++pool) {
+    message << " " << names[pool] << " "
+            << pools[pool]->UsedBytes / (1024.0 * 1024.0) << " of "
+            << pools[pool]->HeapBytes / (1024.0 * 1024.0) << " MB in "
+            << pools[pool]->Heaps << " heaps ("
+            << pools[pool]->Allocations << " resources);";
+  }
+  message << " " << stats.SmallAlignedTextures
+          << " textures with 4 KB alignment\n";
+  OutputDebugStringA(message.str().c_str());
+}
+
+ID3D12Heap* GpuMemoryAllocator::GetHeap(Pool pool, uint32_t heap) {
+  PoolState& state = mPools[pool];
+  if (heap >= state.Heaps.size()) {
+    state.Heaps.resize(heap + 1);
+  }
+  if (state.Heaps[heap] == nullptr) {
+    D3D12_HEAP_DESC heapDesc = {};
+    heapDesc.SizeInBytes = state.Allocator.GetHeapSize(heap);
+    heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    heapDesc.Flags = state.Flags;
+    if (FAILED(mDevice->CreateHeap(&heapDesc,
+                                   IID_PPV_ARGS(&state.Heaps[heap])))) {
+      return nullptr;
+    }
+  }
+  return state.Heaps[heap].Get();
+}
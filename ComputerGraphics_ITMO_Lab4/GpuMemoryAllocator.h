@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "Common.h"
+#include "HeapSuballocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Places default-heap resources in shared ID3D12Heaps instead of giving each
+// one a committed allocation. Buffers, textures and render targets live in
+// separate heap pools, which resource heap tier 1 requires. Textures small
+// enough for D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT get 4 KB alignment
+// instead of 64 KB. The placement bookkeeping is HeapSuballocator.
+//
+// Resources registered with SetRelocatable() may be moved by Defragment():
+// the allocator creates a replacement in another heap, copies the data on
+// the given command list and hands the replacement to the callback, which
+// swaps its pointer and rewrites its views. Such resources must be in
+// D3D12_RESOURCE_STATE_COMMON between command lists.
+class GpuMemoryAllocator {
+ public:
+  using RelocateCallback =
+      std::function<void(const ComPtr<ID3D12Resource>& replacement)>;
+
+  struct Stats {
+    HeapSuballocator::Stats Buffers;
+    HeapSuballocator::Stats Textures;
+    HeapSuballocator::Stats Targets;
+    uint32_t SmallAlignedTextures = 0;
+  };
+
+  static constexpr uint64_t kDefragmentBytesPerCall = 16ull * 1024 * 1024;
+
+  void Initialize(ID3D12Device* device);
+
+  // Creates a placed resource; multisampled resources, which need 4 MB heap
+  // alignment, fall back to a committed resource.
+  HRESULT CreateResource(const D3D12_RESOURCE_DESC& desc,
+                         D3D12_RESOURCE_STATES initialState,
+                         const D3D12_CLEAR_VALUE* clearValue,
+                         ComPtr<ID3D12Resource>& resource);
+  // Returns the resource's range to its heap. The GPU must be done with it;
+  // resources not created here are ignored.
+  void Free(ID3D12Resource* resource);
+  // An empty callback pins the resource again.
+  void SetRelocatable(ID3D12Resource* resource, RelocateCallback callback);
+
+  // Releases the heaps emptied by the previous call and moves relocatable
+  // resources out of sparsely used heaps, at most maxBytes per pool. The
+  // command list recorded by the previous call must have completed.
+  void Defragment(ID3D12GraphicsCommandList* cmdList,
+                  uint64_t maxBytes = kDefragmentBytesPerCall);
+
+  Stats GetStats() const;
+  void LogStatistics() const;
+
+ private:
+  enum Pool { kBufferPool, kTexturePool, kTargetPool, kPoolCount };
+
+  struct PoolState {
+    HeapSuballocator Allocator;
+    D3D12_HEAP_FLAGS Flags = D3D12_HEAP_FLAG_NONE;
+    // Indexed like HeapSuballocator's heaps.
+    std::vector<ComPtr<ID3D12Heap>> Heaps;
+  };
+  struct Entry {
+    Pool ResourcePool = kBufferPool;
+    uint32_t Allocation = 0;
+    D3D12_RESOURCE_DESC Desc = {};
+    RelocateCallback Relocate;
+  };
+
+  ID3D12Heap* GetHeap(Pool pool, uint32_t heap);
+  static uint64_t MakeKey(Pool pool, uint32_t allocation) {
+    return (static_cast<uint64_t>(pool) << 32) | allocation;
+  }
+
+  ID3D12Device* mDevice = nullptr;
+  PoolState mPools[kPoolCount];
+  std::unordered_map<ID3D12Resource*, Entry> mEntries;
+  // MakeKey(pool, allocation) -> resource.
+  std::unordered_map<uint64_t, ID3D12Resource*> mResources;
+  // Moved-out resources still referenced by the command list being
+  // recorded.
+  std::vector<ComPtr<ID3D12Resource>> mRetired;
+  uint32_t mSmallAlignedTextures = 0;
+};
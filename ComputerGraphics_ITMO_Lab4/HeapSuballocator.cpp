@@ -0,0 +1,280 @@
+#include "HeapSuballocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+HeapSuballocator::HeapSuballocator(const Settings& settings)
+    : mSettings(settings) {
+  if (mSettings.HeapBytes == 0) {
+    throw std::invalid_argument("Heaps need a size");
+  }
+}
+
+HeapSuballocator::Allocation HeapSuballocator::Allocate(uint64_t size,
+                                                        uint64_t alignment,
+                                                        bool movable) {
+  Allocation placement;
+  bool created = false;
+  if (size > mSettings.HeapBytes) {
+    const uint32_t heap = CreateHeap(size, true);
+    created = true;
+    placement.Heap = heap;
+    placement.Offset = mHeaps[heap].Allocator.Allocate(size, alignment);
+  } else {
+    std::vector<uint32_t> heaps;
+    for (uint32_t i = 0; i < mHeaps.size(); ++i) {
+      if (mHeaps[i].Alive && !mHeaps[i].Dedicated && !mHeaps[i].Retired) {
+        heaps.push_back(i);
+      }
+    }
+    if (!TryAllocate(heaps, size, alignment, placement)) {
+      const uint32_t heap = CreateHeap(mSettings.HeapBytes, false);
+      created = true;
+      placement.Heap = heap;
+      placement.Offset = mHeaps[heap].Allocator.Allocate(size, alignment);
+    }
+  }
+  if (placement.Offset == TlsfAllocator::kInvalidOffset) {
+    // A fresh heap places any request at offset 0, so this is not expected;
+    // should it happen, the heap the caller never saw is given back rather
+    // than left alive and empty.
+    if (created) {
+      Heap& heap = mHeaps[placement.Heap];
+      heap.Alive = false;
+      heap.Dedicated = false;
+      heap.Allocator.Reset(0);
+    }
+    throw std::invalid_argument("Alignment exceeds the heap size");
+  }
+
+  placement.Id = mNextId++;
+  placement.Size = size;
+  Record record;
+  record.Placement = placement;
+  record.Alignment = alignment;
+  record.Movable = movable;
+  mRecords[placement.Id] = record;
+  if (!movable) {
+    ++mHeaps[placement.Heap].PinnedAllocations;
+  }
+  return placement;
+}
+
+void HeapSuballocator::Free(uint32_t id) {
+  const auto it = mRecords.find(id);
+  if (it == mRecords.end()) {
+    throw std::invalid_argument("Unknown allocation");
+  }
+  Heap& heap = mHeaps[it->second.Placement.Heap];
+  heap.Allocator.Free(it->second.Placement.Offset);
+  if (!it->second.Movable) {
+    --heap.PinnedAllocations;
+  }
+  mRecords.erase(it);
+}
+
+void HeapSuballocator::SetMovable(uint32_t id, bool movable) {
+  Record& record = mRecords.at(id);
+  if (record.Movable == movable) {
+    return;
+  }
+  record.Movable = movable;
+  uint32_t& pinned = mHeaps[record.Placement.Heap].PinnedAllocations;
+  pinned = movable ? pinned - 1 : pinned + 1;
+}
+
+const HeapSuballocator::Allocation& HeapSuballocator::GetAllocation(
+    uint32_t id) const {
+  return mRecords.at(id).Placement;
+}
+
+std::vector<HeapSuballocator::Move> HeapSuballocator::Defragment(
+    uint64_t maxBytes) {
+  std::vector<uint32_t> candidates;
+  for (uint32_t i = 0; i < mHeaps.size(); ++i) {
+    const Heap& heap = mHeaps[i];
+    const uint64_t used = heap.Allocator.GetUsedBytes();
+    if (heap.Alive && !heap.Dedicated && !heap.Retired &&
+        heap.PinnedAllocations == 0 && used > 0 &&
+        used < mSettings.DefragmentUtilization * heap.Allocator.GetSize()) {
+      candidates.push_back(i);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+    return mHeaps[a].Allocator.GetUsedBytes() <
+           mHeaps[b].Allocator.GetUsedBytes();
+  });
+
+  std::vector<Move> moves;
+  std::vector<bool> receiving(mHeaps.size(), false);
+  uint64_t budget = maxBytes;
+  for (uint32_t source : candidates) {
+    // Moving the same data twice in one pass would only waste copies.
+    if (receiving[source] ||
+        mHeaps[source].Allocator.GetUsedBytes() > budget) {
+      continue;
+    }
+
+    // Fill the fullest heaps first so the emptiest ones drain.
+    std::vector<uint32_t> targets;
+    for (uint32_t i = 0; i < mHeaps.size(); ++i) {
+      if (i != source && mHeaps[i].Alive && !mHeaps[i].Dedicated &&
+          !mHeaps[i].Retired) {
+        targets.push_back(i);
+      }
+    }
+    std::sort(targets.begin(), targets.end(), [&](uint32_t a, uint32_t b) {
+      return mHeaps[a].Allocator.GetUsedBytes() >
+             mHeaps[b].Allocator.GetUsedBytes();
+    });
+
+    std::vector<uint32_t> ids;
+    for (const auto& entry : mRecords) {
+      if (entry.second.Placement.Heap == source) {
+        ids.push_back(entry.first);
+      }
+    }
+    // Largest first, ids break ties so the plan does not depend on hashing.
+    std::sort(ids.begin(), ids.end(), [&](uint32_t a, uint32_t b) {
+      const uint64_t sizeA = mRecords[a].Placement.Size;
+      const uint64_t sizeB = mRecords[b].Placement.Size;
+      return sizeA != sizeB ? sizeA > sizeB : a < b;
+    });
+
+    std::vector<Allocation> placements;
+    for (uint32_t id : ids) {
+      const Record& record = mRecords[id];
+      Allocation placement;
+      if (!TryAllocate(targets, record.Placement.Size, record.Alignment,
+                       placement)) {
+        break;
+      }
+      placements.push_back(placement);
+    }
+    if (placements.size() != ids.size()) {
+      for (const Allocation& placement : placements) {
+        mHeaps[placement.Heap].Allocator.Free(placement.Offset);
+      }
+      continue;
+    }
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+      Record& record = mRecords[ids[i]];
+      Move move;
+      move.Id = ids[i];
+      move.FromHeap = source;
+      move.FromOffset = record.Placement.Offset;
+      move.ToHeap = placements[i].Heap;
+      move.ToOffset = placements[i].Offset;
+      move.Size = record.Placement.Size;
+      moves.push_back(move);
+
+      mHeaps[source].Allocator.Free(record.Placement.Offset);
+      record.Placement.Heap = move.ToHeap;
+      record.Placement.Offset = move.ToOffset;
+      receiving[move.ToHeap] = true;
+      budget -= move.Size;
+      ++mMoves;
+      mMovedBytes += move.Size;
+    }
+    mHeaps[source].Retired = true;
+  }
+  return moves;
+}
+
+std::vector<uint32_t> HeapSuballocator::ReleaseRetiredHeaps() {
+  std::vector<uint32_t> released;
+  bool keptEmptyHeap = false;
+  for (uint32_t i = 0; i < mHeaps.size(); ++i) {
+    Heap& heap = mHeaps[i];
+    if (!heap.Alive || heap.Allocator.GetAllocationCount() > 0) {
+      continue;
+    }
+    // One empty shared heap is kept so that a free followed by an
+    // allocation does not recreate it.
+    if (!heap.Retired && !heap.Dedicated && !keptEmptyHeap) {
+      keptEmptyHeap = true;
+      continue;
+    }
+    heap.Alive = false;
+    heap.Retired = false;
+    heap.Dedicated = false;
+    heap.Allocator.Reset(0);
+    released.push_back(i);
+  }
+  return released;
+}
+
+HeapSuballocator::Stats HeapSuballocator::GetStats() const {
+  Stats stats;
+  for (const Heap& heap : mHeaps) {
+    if (heap.Alive) {
+      ++stats.Heaps;
+      stats.HeapBytes += heap.Allocator.GetSize();
+      stats.UsedBytes += heap.Allocator.GetUsedBytes();
+    }
+  }
+  stats.Allocations = static_cast<uint32_t>(mRecords.size());
+  stats.Moves = mMoves;
+  stats.MovedBytes = mMovedBytes;
+  return stats;
+}
+
+bool HeapSuballocator::Validate() const {
+  std::vector<uint32_t> allocations(mHeaps.size(), 0);
+  std::vector<uint32_t> pinned(mHeaps.size(), 0);
+  for (const auto& entry : mRecords) {
+    const Allocation& placement = entry.second.Placement;
+    if (placement.Id != entry.first || !IsHeapAlive(placement.Heap) ||
+        mHeaps[placement.Heap].Retired ||
+        placement.Offset % entry.second.Alignment != 0 ||
+        mHeaps[placement.Heap].Allocator.GetAllocationSize(
+            placement.Offset) != placement.Size) {
+      return false;
+    }
+    ++allocations[placement.Heap];
+    if (!entry.second.Movable) {
+      ++pinned[placement.Heap];
+    }
+  }
+  for (uint32_t i = 0; i < mHeaps.size(); ++i) {
+    const Heap& heap = mHeaps[i];
+    if (!heap.Allocator.Validate() ||
+        heap.Allocator.GetAllocationCount() != allocations[i] ||
+        heap.PinnedAllocations != pinned[i] ||
+        (!heap.Alive && heap.Allocator.GetSize() != 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t HeapSuballocator::CreateHeap(uint64_t size, bool dedicated) {
+  uint32_t heap = 0;
+  while (heap < mHeaps.size() && mHeaps[heap].Alive) {
+    ++heap;
+  }
+  if (heap == mHeaps.size()) {
+    mHeaps.emplace_back();
+  }
+  mHeaps[heap].Allocator.Reset(size);
+  mHeaps[heap].Alive = true;
+  mHeaps[heap].Dedicated = dedicated;
+  mHeaps[heap].Retired = false;
+  mHeaps[heap].PinnedAllocations = 0;
+  return heap;
+}
+
+bool HeapSuballocator::TryAllocate(const std::vector<uint32_t>& heaps,
+                                   uint64_t size, uint64_t alignment,
+                                   Allocation& placement) {
+  for (uint32_t heap : heaps) {
+    const uint64_t offset = mHeaps[heap].Allocator.Allocate(size, alignment);
+    if (offset != TlsfAllocator::kInvalidOffset) {
+      placement.Heap = heap;
+      placement.Offset = offset;
+      return true;
+    }
+  }
+  return false;
+}
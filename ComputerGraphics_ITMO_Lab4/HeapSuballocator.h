@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "TlsfAllocator.h"
+
+// Bookkeeping for a pool of equally sized GPU heaps carved into placed
+// resources with TlsfAllocator. Only heap indices and offsets are managed;
+// GpuMemoryAllocator creates the ID3D12Heaps and resources. A heap index
+// returned by Allocate() that the caller has not seen yet names a new heap
+// of GetHeapSize(heap) bytes. Requests larger than Settings::HeapBytes get a
+// dedicated heap of their own size.
+//
+// Defragment() empties sparsely used heaps by moving their allocations into
+// the other heaps. The evacuated heaps are retired: nothing is placed in them
+// until the caller has finished the copies and calls ReleaseRetiredHeaps().
+class HeapSuballocator {
+ public:
+  struct Settings {
+    uint64_t HeapBytes = 64ull * 1024 * 1024;
+    // Heaps used below this fraction are emptied by Defragment().
+    double DefragmentUtilization = 0.5;
+  };
+
+  struct Allocation {
+    uint32_t Id = 0;
+    uint32_t Heap = 0;
+    uint64_t Offset = 0;
+    uint64_t Size = 0;
+  };
+
+  struct Move {
+    uint32_t Id = 0;
+    uint32_t FromHeap = 0;
+    uint64_t FromOffset = 0;
+    uint32_t ToHeap = 0;
+    uint64_t ToOffset = 0;
+    uint64_t Size = 0;
+  };
+
+  struct Stats {
+    uint32_t Heaps = 0;
+    uint64_t HeapBytes = 0;
+    uint64_t UsedBytes = 0;
+    uint32_t Allocations = 0;
+    uint64_t Moves = 0;
+    uint64_t MovedBytes = 0;
+  };
+
+  HeapSuballocator() = default;
+  explicit HeapSuballocator(const Settings& settings);
+
+  const Settings& GetSettings() const { return mSettings; }
+
+  // Places size bytes aligned to alignment. Only movable allocations are
+  // relocated by Defragment().
+  Allocation Allocate(uint64_t size, uint64_t alignment, bool movable);
+  void Free(uint32_t id);
+  void SetMovable(uint32_t id, bool movable);
+  const Allocation& GetAllocation(uint32_t id) const;
+
+  // Plans moves of at most maxBytes that empty the least used heaps. The
+  // bookkeeping is updated right away; the caller copies every move's data
+  // before the source heaps are released.
+  std::vector<Move> Defragment(uint64_t maxBytes);
+  // Heaps that are retired or empty. The caller destroys them; their indices
+  // may be handed out again by Allocate().
+  std::vector<uint32_t> ReleaseRetiredHeaps();
+
+  bool IsHeapAlive(uint32_t heap) const {
+    return heap < mHeaps.size() && mHeaps[heap].Alive;
+  }
+  uint64_t GetHeapSize(uint32_t heap) const {
+    return mHeaps[heap].Allocator.GetSize();
+  }
+  uint32_t GetHeapCount() const { return static_cast<uint32_t>(mHeaps.size()); }
+  Stats GetStats() const;
+
+  // Validates every heap's TlsfAllocator and the allocation table. Meant for
+  // tests.
+  bool Validate() const;
+
+ private:
+  struct Heap {
+    TlsfAllocator Allocator;
+    bool Alive = false;
+    bool Dedicated = false;
+    bool Retired = false;
+    uint32_t PinnedAllocations = 0;
+  };
+  struct Record {
+    Allocation Placement;
+    uint64_t Alignment = 1;
+    bool Movable = false;
+  };
+
+  uint32_t CreateHeap(uint64_t size, bool dedicated);
+  // Tries the heaps in order; returns false if none has room.
+  bool TryAllocate(const std::vector<uint32_t>& heaps, uint64_t size,
+                   uint64_t alignment, Allocation& placement);
+
+  Settings mSettings;
+  std::vector<Heap> mHeaps;
+  std::unordered_map<uint32_t, Record> mRecords;
+  uint32_t mNextId = 1;
+  uint64_t mMoves = 0;
+  uint64_t mMovedBytes = 0;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed little-endian encoding for the on-disk caches, independent of the
+// host byte order. Readers return false instead of reading past the end.
+inline void WriteUint32LE(std::vector<uint8_t>& out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+inline void WriteUint64LE(std::vector<uint8_t>& out, uint64_t value) {
+  WriteUint32LE(out, static_cast<uint32_t>(value));
+  WriteUint32LE(out, static_cast<uint32_t>(value >> 32));
+}
+
+inline bool ReadUint32LE(const std::vector<uint8_t>& in, size_t& offset,
+                         uint32_t& value) {
+  if (offset > in.size() || in.size() - offset < 4) {
+    return false;
+  }
+  value = 0;
+  for (int i = 0; i < 4; ++i) {
+    value |= static_cast<uint32_t>(in[offset + i]) << (8 * i);
+  }
+  offset += 4;
+  return true;
+}
+
+inline bool ReadUint64LE(const std::vector<uint8_t>& in, size_t& offset,
+                         uint64_t& value) {
+  uint32_t low = 0;
+  uint32_t high = 0;
+  if (!ReadUint32LE(in, offset, low) || !ReadUint32LE(in, offset, high)) {
+    return false;
+  }
+  value = (static_cast<uint64_t>(high) << 32) | low;
+  return true;
+}
@@ -0,0 +1,89 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::wstring& path) {
+  Close();
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  mFile = file;
+  LARGE_INTEGER size = {};
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 ||
+      static_cast<uint64_t>(size.QuadPart) > SIZE_MAX) {
+    Close();
+    return false;
+  }
+  mMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mMapping == nullptr) {
+    Close();
+    return false;
+  }
+  mData = static_cast<const uint8_t*>(
+      MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+  if (mData == nullptr) {
+    Close();
+    return false;
+  }
+  mSize = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (mData != nullptr) {
+    UnmapViewOfFile(mData);
+  }
+  if (mMapping != nullptr) {
+    CloseHandle(mMapping);
+  }
+  if (mFile != nullptr) {
+    CloseHandle(mFile);
+  }
+  mData = nullptr;
+  mSize = 0;
+  mMapping = nullptr;
+  mFile = nullptr;
+}
+#else
+bool MappedFile::Open(const std::string& path) {
+  Close();
+  const int file = open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+  struct stat status = {};
+  void* data = MAP_FAILED;
+  if (fstat(file, &status) == 0 && status.st_size > 0) {
+    data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ,
+                MAP_PRIVATE, file, 0);
+  }
+  // The mapping keeps the file referenced.
+  close(file);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  madvise(data, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+  mData = static_cast<const uint8_t*>(data);
+  mSize = static_cast<size_t>(status.st_size);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (mData != nullptr) {
+    munmap(const_cast<uint8_t*>(mData), mSize);
+  }
+  mData = nullptr;
+  mSize = 0;
+}
+#endif
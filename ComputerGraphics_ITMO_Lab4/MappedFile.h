@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are read from disk as they
+// are first touched, straight into the page cache, so copying out of the
+// mapping needs no intermediate buffer. Implemented for Win32 and POSIX.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { Close(); }
+
+  // Returns false if the file cannot be opened or is empty.
+#ifdef _WIN32
+  bool Open(const std::wstring& path);
+#else
+  bool Open(const std::string& path);
+#endif
+  void Close();
+
+  const uint8_t* GetData() const { return mData; }
+  size_t GetSize() const { return mSize; }
+
+ private:
+  const uint8_t* mData = nullptr;
+  size_t mSize = 0;
+#ifdef _WIN32
+  void* mFile = nullptr;
+  void* mMapping = nullptr;
+#endif
+};
@@ -14,13 +14,24 @@ struct MaterialConstants {
   float DisplacementScale = 0.0f;
   DirectX::SimpleMath::Matrix TexTransform =
       DirectX::SimpleMath::Matrix::Identity;
+  //  SRV    CBV/SRV/UAV (TextureStreamer::GetSrvIndex);
+  //    MaterialData  
+  UINT DiffuseMapIndex = 0;
+  UINT NormalMapIndex = 0;
+  UINT DisplacementMapIndex = 0;
+  UINT RoughnessMapIndex = 0;
+  //     Texture2DArray (TextureStreamer::GetArraySlice)
+  UINT DiffuseMapSlice = 0;
+  UINT NormalMapSlice = 0;
+  UINT DisplacementMapSlice = 0;
+  UINT RoughnessMapSlice = 0;
 };
 
 struct Material {
   std::string Name;
-  int MatCBIndex = -1;           //     
+  int MatCBIndex = -1;           //    
   std::string DiffuseTexture;    //     ( .mtl)
-  int DiffuseTextureIndex = -1;  //    mTextures ( )
+  int DiffuseTextureIndex = -1;  // id  TextureStreamer ( )
   std::string NormalTexture;
   int NormalTextureIndex = -1;
   std::string DisplacementTexture;
@@ -0,0 +1,14 @@
+Texture2D gParticleColor : register(t0);
+
+struct PSIn
+{
+    float4 Pos : SV_POSITION;
+    float2 TexC : TEXCOORD;
+};
+
+// The particle target holds premultiplied color; the PSO blends it over the
+// back buffer with ONE / INV_SRC_ALPHA.
+float4 PS(PSIn input) : SV_TARGET
+{
+    return gParticleColor.Load(int3(input.Pos.xy, 0));
+}
@@ -0,0 +1,326 @@
+#include "ParticleCpuSimulator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+#if !defined(PARTICLE_CPU_NO_SIMD) &&        \
+    (defined(__SSE2__) || defined(_M_X64) || \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define PARTICLE_CPU_SSE2 1
+#endif
+
+static_assert(sizeof(ParticleCpuSimulator::Particle) == 64,
+              "Particle must match ParticleGpuData");
+
+namespace {
+
+constexpr float kGravity = -9.8f;
+constexpr float kKillHeight = -5.0f;
+
+// Matches NextRandom in ParticleEmitCS.hlsl.
+float NextRandom(uint32_t& rng) {
+  rng = ParticleEmitterSet::Hash(rng);
+  return static_cast<float>(rng) * (1.0f / 4294967296.0f);
+}
+
+ParticleFloat3 NextSigned3(uint32_t& rng) {
+  const float x = NextRandom(rng);
+  const float y = NextRandom(rng);
+  const float z = NextRandom(rng);
+  return {x * 2.0f - 1.0f, y * 2.0f - 1.0f, z * 2.0f - 1.0f};
+}
+
+float Lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+}  // namespace
+
+ParticleCpuSimulator::ParticleCpuSimulator(uint32_t capacity,
+                                           uint32_t workerCount)
+    : mCapacity(capacity) {
+  if (capacity == 0) {
+    throw std::invalid_argument("Particle capacity must be positive");
+  }
+  if (workerCount == 0) {
+    workerCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  mWorkerCount = workerCount;
+  mChunkSize = ((mCapacity + mWorkerCount - 1) / mWorkerCount + 3) & ~3u;
+  // Reserved up front so workers never allocate.
+  mChunkOutputs.resize(mWorkerCount);
+  for (ChunkOutput& output : mChunkOutputs) {
+    output.Dead.reserve(mChunkSize);
+    output.Alive.reserve(mChunkSize);
+  }
+
+  for (auto* channel : {&mPositionX, &mPositionY, &mPositionZ, &mVelocityX,
+                        &mVelocityY, &mVelocityZ, &mLifetime, &mSize}) {
+    channel->assign(capacity, 0.0f);
+  }
+  mAge.assign(capacity, -1.0f);
+  mColor.assign(static_cast<size_t>(capacity) * 4, 0.0f);
+
+  // ParticleInitCS: every slot starts dead and on the dead list.
+  mDeadList.resize(capacity);
+  for (uint32_t i = 0; i < capacity; ++i) {
+    mDeadList[i] = i;
+  }
+  mAliveList.reserve(capacity);
+
+  try {
+    for (uint32_t chunk = 0; chunk + 1 < mWorkerCount; ++chunk) {
+      mWorkers.emplace_back(&ParticleCpuSimulator::WorkerLoop, this, chunk);
+    }
+  } catch (...) {
+    StopWorkers();
+    throw;
+  }
+}
+
+ParticleCpuSimulator::~ParticleCpuSimulator() { StopWorkers(); }
+
+void ParticleCpuSimulator::StopWorkers() {
+  {
+    std::lock_guard<std::mutex> lock(mWorkMutex);
+    mStopping = true;
+  }
+  mWorkReady.notify_all();
+  for (std::thread& worker : mWorkers) {
+    worker.join();
+  }
+  mWorkers.clear();
+}
+
+void ParticleCpuSimulator::WorkerLoop(uint32_t chunk) {
+  uint64_t seenGeneration = 0;
+  for (;;) {
+    float deltaTime;
+    {
+      std::unique_lock<std::mutex> lock(mWorkMutex);
+      mWorkReady.wait(lock, [&] {
+        return mStopping || mWorkGeneration != seenGeneration;
+      });
+      if (mStopping) {
+        return;
+      }
+      seenGeneration = mWorkGeneration;
+      deltaTime = mWorkDeltaTime;
+    }
+    SimulateChunk(chunk, deltaTime);
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(mWorkMutex);
+      last = --mPendingWorkers == 0;
+    }
+    if (last) {
+      mWorkDone.notify_one();
+    }
+  }
+}
+
+void ParticleCpuSimulator::Step(
+    float deltaTime, const std::vector<ParticleEmitterSet::GpuRecord>& emitters,
+    uint32_t spawnCount) {
+  Emit(emitters, spawnCount);
+  Simulate(deltaTime);
+}
+
+void ParticleCpuSimulator::Emit(
+    const std::vector<ParticleEmitterSet::GpuRecord>& emitters,
+    uint32_t spawnCount) {
+  if (emitters.empty()) {
+    return;
+  }
+  // Threads past the dead count return early on the GPU.
+  const uint32_t emitCount =
+      std::min(spawnCount, static_cast<uint32_t>(mDeadList.size()));
+  for (uint32_t spawnIndex = 0; spawnIndex < emitCount; ++spawnIndex) {
+    auto it = std::upper_bound(
+        emitters.begin(), emitters.end(), spawnIndex,
+        [](uint32_t value, const ParticleEmitterSet::GpuRecord& record) {
+          return value < record.FirstSpawn;
+        });
+    const ParticleEmitterSet::GpuRecord& e =
+        it == emitters.begin() ? emitters.front() : *(it - 1);
+
+    uint32_t rng = e.Seed ^ ParticleEmitterSet::Hash(spawnIndex - e.FirstSpawn);
+    const uint32_t index = mDeadList.back();
+    mDeadList.pop_back();
+
+    const ParticleFloat3 offset = NextSigned3(rng);
+    const ParticleFloat3 jitter = NextSigned3(rng);
+    mPositionX[index] = e.Position.X + offset.X * e.PositionExtent.X;
+    mPositionY[index] = e.Position.Y + offset.Y * e.PositionExtent.Y;
+    mPositionZ[index] = e.Position.Z + offset.Z * e.PositionExtent.Z;
+    mVelocityX[index] = e.VelocityMean.X + jitter.X * e.VelocityExtent.X;
+    mVelocityY[index] = e.VelocityMean.Y + jitter.Y * e.VelocityExtent.Y;
+    mVelocityZ[index] = e.VelocityMean.Z + jitter.Z * e.VelocityExtent.Z;
+    mAge[index] = 0.0f;
+    mLifetime[index] = Lerp(e.LifetimeMin, e.LifetimeMax, NextRandom(rng));
+    std::copy(e.Color, e.Color + 4, &mColor[static_cast<size_t>(index) * 4]);
+    mSize[index] = Lerp(e.SizeMin, e.SizeMax, NextRandom(rng));
+  }
+}
+
+void ParticleCpuSimulator::Simulate(float deltaTime) {
+  const auto start = std::chrono::steady_clock::now();
+
+  if (!mWorkers.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(mWorkMutex);
+      mWorkDeltaTime = deltaTime;
+      mPendingWorkers = static_cast<uint32_t>(mWorkers.size());
+      ++mWorkGeneration;
+    }
+    mWorkReady.notify_all();
+  }
+  SimulateChunk(mWorkerCount - 1, deltaTime);
+  if (!mWorkers.empty()) {
+    std::unique_lock<std::mutex> lock(mWorkMutex);
+    mWorkDone.wait(lock, [&] { return mPendingWorkers == 0; });
+  }
+
+  // Append in chunk order so results do not depend on thread timing.
+  mAliveList.clear();
+  for (const ChunkOutput& output : mChunkOutputs) {
+    mDeadList.insert(mDeadList.end(), output.Dead.begin(), output.Dead.end());
+    mAliveList.insert(mAliveList.end(), output.Alive.begin(),
+                      output.Alive.end());
+  }
+
+  mLastSimulateMs = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+}
+
+void ParticleCpuSimulator::SimulateChunk(uint32_t chunk, float deltaTime) {
+  const uint32_t begin = std::min(mCapacity, chunk * mChunkSize);
+  const uint32_t end = std::min(mCapacity, begin + mChunkSize);
+  ChunkOutput& output = mChunkOutputs[chunk];
+  output.Dead.clear();
+  output.Alive.clear();
+  SimulateRange(begin, end, deltaTime, output);
+}
+
+void ParticleCpuSimulator::SimulateRange(uint32_t begin, uint32_t end,
+                                         float deltaTime,
+                                         ChunkOutput& output) {
+  const float gravityStep = kGravity * deltaTime;
+  uint32_t i = begin;
+
+#ifdef PARTICLE_CPU_SSE2
+  const __m128 dt = _mm_set1_ps(deltaTime);
+  const __m128 gravity = _mm_set1_ps(gravityStep);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 minusOne = _mm_set1_ps(-1.0f);
+  const __m128 killHeight = _mm_set1_ps(kKillHeight);
+  auto select = [](__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  };
+
+  for (; i + 4 <= end; i += 4) {
+    const __m128 age = _mm_loadu_ps(&mAge[i]);
+    const __m128 live = _mm_cmpge_ps(age, zero);
+    const int liveBits = _mm_movemask_ps(live);
+    if (liveBits == 0) {
+      continue;
+    }
+
+    const __m128 vx = _mm_loadu_ps(&mVelocityX[i]);
+    const __m128 vy = _mm_add_ps(_mm_loadu_ps(&mVelocityY[i]), gravity);
+    const __m128 vz = _mm_loadu_ps(&mVelocityZ[i]);
+    const __m128 px = _mm_add_ps(_mm_loadu_ps(&mPositionX[i]),
+                                 _mm_mul_ps(vx, dt));
+    const __m128 py = _mm_add_ps(_mm_loadu_ps(&mPositionY[i]),
+                                 _mm_mul_ps(vy, dt));
+    const __m128 pz = _mm_add_ps(_mm_loadu_ps(&mPositionZ[i]),
+                                 _mm_mul_ps(vz, dt));
+    const __m128 newAge = _mm_add_ps(age, dt);
+    const __m128 dies =
+        _mm_or_ps(_mm_cmpge_ps(newAge, _mm_loadu_ps(&mLifetime[i])),
+                  _mm_cmplt_ps(py, killHeight));
+
+    _mm_storeu_ps(&mAge[i], select(live, select(dies, minusOne, newAge), age));
+    _mm_storeu_ps(&mVelocityY[i],
+                  select(live, vy, _mm_loadu_ps(&mVelocityY[i])));
+    _mm_storeu_ps(&mPositionX[i],
+                  select(live, px, _mm_loadu_ps(&mPositionX[i])));
+    _mm_storeu_ps(&mPositionY[i],
+                  select(live, py, _mm_loadu_ps(&mPositionY[i])));
+    _mm_storeu_ps(&mPositionZ[i],
+                  select(live, pz, _mm_loadu_ps(&mPositionZ[i])));
+
+    const int dieBits = _mm_movemask_ps(dies) & liveBits;
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+      if ((liveBits & (1 << lane)) == 0) {
+        continue;
+      }
+      if (dieBits & (1 << lane)) {
+        output.Dead.push_back(i + lane);
+      } else {
+        output.Alive.push_back(i + lane);
+      }
+    }
+  }
+#endif
+
+  for (; i < end; ++i) {
+    if (mAge[i] < 0.0f) {
+      continue;
+    }
+    mAge[i] += deltaTime;
+    mVelocityY[i] += gravityStep;
+    mPositionX[i] += mVelocityX[i] * deltaTime;
+    mPositionY[i] += mVelocityY[i] * deltaTime;
+    mPositionZ[i] += mVelocityZ[i] * deltaTime;
+    if (mAge[i] >= mLifetime[i] || mPositionY[i] < kKillHeight) {
+      mAge[i] = -1.0f;
+      output.Dead.push_back(i);
+    } else {
+      output.Alive.push_back(i);
+    }
+  }
+}
+
+ParticleCpuSimulator::Particle ParticleCpuSimulator::GetParticle(
+    uint32_t index) const {
+  if (index >= mCapacity) {
+    throw std::out_of_range("Particle index out of range");
+  }
+  Particle particle;
+  particle.Position = {mPositionX[index], mPositionY[index], mPositionZ[index]};
+  particle.Age = mAge[index];
+  particle.Velocity = {mVelocityX[index], mVelocityY[index], mVelocityZ[index]};
+  particle.Lifetime = mLifetime[index];
+  std::copy(&mColor[static_cast<size_t>(index) * 4],
+            &mColor[static_cast<size_t>(index) * 4] + 4, particle.Color);
+  particle.Size = mSize[index];
+  return particle;
+}
+
+std::vector<uint32_t> ParticleCpuSimulator::SortAliveBackToFront(
+    const float viewDepthColumn[4]) const {
+  std::vector<std::pair<float, uint32_t>> entries;
+  entries.reserve(mAliveList.size());
+  for (uint32_t index : mAliveList) {
+    const float depth = mPositionX[index] * viewDepthColumn[0] +
+                        mPositionY[index] * viewDepthColumn[1] +
+                        mPositionZ[index] * viewDepthColumn[2] +
+                        viewDepthColumn[3];
+    entries.emplace_back(depth, index);
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const std::pair<float, uint32_t>& a,
+                      const std::pair<float, uint32_t>& b) {
+                     return a.first > b.first;
+                   });
+
+  std::vector<uint32_t> sorted;
+  sorted.reserve(entries.size());
+  for (const auto& entry : entries) {
+    sorted.push_back(entry.second);
+  }
+  return sorted;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ParticleEmitterSet.h"
+
+// CPU implementation of the particle pool driven by ParticleInitCS,
+// ParticleEmitCS and ParticleSimulateCS: the same dead list, emitter
+// lookup, random sequence and update rules, so it can serve as a
+// regression oracle for GPU readbacks and as a headless throughput
+// benchmark. The pool is stored as structure-of-arrays; Simulate runs SSE2
+// where available (unless PARTICLE_CPU_NO_SIMD is defined) and splits the
+// pool across worker threads that live as long as the simulator.
+//
+// GPU append/consume order is unspecified. Here the dead list is a stack
+// filled in ascending index order, so a run is deterministic but the slot
+// a given spawn lands in can differ from the GPU; compare pools by
+// contents, not by slot. Depth-buffer collision is not modelled; compare
+// against GPU runs with collision disabled.
+class ParticleCpuSimulator {
+ public:
+  // Same layout as ParticleGpuData in RenderingSystem.h.
+  struct Particle {
+    ParticleFloat3 Position;
+    float Age = -1.0f;
+    ParticleFloat3 Velocity;
+    float Lifetime = 0.0f;
+    float Color[4] = {};
+    float Size = 0.0f;
+    float OccludedFrames = 0.0f;
+    float Padding[2] = {};
+  };
+
+  // workerCount 0 uses one worker per hardware thread. The calling thread
+  // is one of them; the others are started here.
+  explicit ParticleCpuSimulator(uint32_t capacity, uint32_t workerCount = 0);
+  ~ParticleCpuSimulator();
+
+  ParticleCpuSimulator(const ParticleCpuSimulator&) = delete;
+  ParticleCpuSimulator& operator=(const ParticleCpuSimulator&) = delete;
+
+  // One GPU frame: emit from the records (see
+  // ParticleEmitterSet::BuildSpawnBatch), then simulate every slot.
+  void Step(float deltaTime,
+            const std::vector<ParticleEmitterSet::GpuRecord>& emitters,
+            uint32_t spawnCount);
+  void Emit(const std::vector<ParticleEmitterSet::GpuRecord>& emitters,
+            uint32_t spawnCount);
+  void Simulate(float deltaTime);
+
+  uint32_t GetCapacity() const { return mCapacity; }
+  uint32_t GetWorkerCount() const { return mWorkerCount; }
+  Particle GetParticle(uint32_t index) const;
+  uint32_t GetDeadCount() const {
+    return static_cast<uint32_t>(mDeadList.size());
+  }
+  // Indices that survived the last Simulate, as the GPU alive list.
+  const std::vector<uint32_t>& GetAliveList() const { return mAliveList; }
+  double GetLastSimulateMs() const { return mLastSimulateMs; }
+
+  // Reference for the GPU depth sort: the alive list ordered back to front
+  // by view depth, depth = dot(float4(position, 1), viewDepthColumn) where
+  // viewDepthColumn is the fourth column of the view-projection matrix (the
+  // clip-space w). Equal depths keep alive-list order; the GPU bitonic sort
+  // does not guarantee that, so compare depths rather than indices there.
+  std::vector<uint32_t> SortAliveBackToFront(
+      const float viewDepthColumn[4]) const;
+
+ private:
+  struct ChunkOutput {
+    std::vector<uint32_t> Dead;
+    std::vector<uint32_t> Alive;
+  };
+
+  void SimulateChunk(uint32_t chunk, float deltaTime);
+  void SimulateRange(uint32_t begin, uint32_t end, float deltaTime,
+                     ChunkOutput& output);
+  void WorkerLoop(uint32_t chunk);
+  void StopWorkers();
+
+  uint32_t mCapacity = 0;
+  uint32_t mWorkerCount = 1;
+  // Multiple of 4 so SIMD loads stay lane-aligned.
+  uint32_t mChunkSize = 0;
+
+  std::vector<float> mPositionX, mPositionY, mPositionZ;
+  std::vector<float> mVelocityX, mVelocityY, mVelocityZ;
+  std::vector<float> mAge, mLifetime, mSize;
+  std::vector<float> mColor;  // 4 floats per particle
+
+  std::vector<uint32_t> mDeadList;
+  std::vector<uint32_t> mAliveList;
+  std::vector<ChunkOutput> mChunkOutputs;
+  double mLastSimulateMs = 0.0;
+
+  // Worker i simulates chunk i; the calling thread takes the last chunk.
+  // A new generation wakes the workers; each one decrements the pending
+  // count when its chunk is done.
+  std::vector<std::thread> mWorkers;
+  std::mutex mWorkMutex;
+  std::condition_variable mWorkReady;
+  std::condition_variable mWorkDone;
+  uint64_t mWorkGeneration = 0;
+  uint32_t mPendingWorkers = 0;
+  float mWorkDeltaTime = 0.0f;
+  bool mStopping = false;
+};
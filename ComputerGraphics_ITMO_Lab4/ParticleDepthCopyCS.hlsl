@@ -0,0 +1,15 @@
+// Copies the scene depth into a texture the particle simulation can read
+// next frame, possibly on the async compute queue, while the graphics queue
+// already writes the new frame's depth.
+Texture2D<float> gSceneDepth : register(t0);
+RWTexture2D<float> gCollisionDepth : register(u0);
+
+[numthreads(8,8,1)]
+void CS(uint3 dtid : SV_DispatchThreadID)
+{
+    uint width, height;
+    gCollisionDepth.GetDimensions(width, height);
+    if (dtid.x >= width || dtid.y >= height) return;
+
+    gCollisionDepth[dtid.xy] = gSceneDepth[dtid.xy];
+}
@@ -6,12 +6,33 @@ struct Particle
     float Lifetime;
     float4 Color;
     float Size;
-    float3 Padding;
+    float OccludedFrames;
+    float2 Padding;
+};
+
+struct Emitter
+{
+    float3 Position;
+    uint FirstSpawn;
+    float3 PositionExtent;
+    uint SpawnCount;
+    float3 VelocityMean;
+    float LifetimeMin;
+    float3 VelocityExtent;
+    float LifetimeMax;
+    float4 Color;
+    float SizeMin;
+    float SizeMax;
+    uint Seed;
+    float Padding;
 };
 
 ConsumeStructuredBuffer<uint> gDeadListConsume : register(u2);
 RWStructuredBuffer<Particle> gParticlePool : register(u0);
-AppendStructuredBuffer<uint> gDeadListAppend : register(u1);
+StructuredBuffer<Emitter> gEmitters : register(t0);
+// Dead list counter copied before this dispatch; threads past it would
+// consume from an empty list.
+ByteAddressBuffer gDeadCount : register(t1);
 
 cbuffer SimCB : register(b0)
 {
@@ -19,28 +40,62 @@ cbuffer SimCB : register(b0)
     float gTotalTime;
     uint gSpawnCount;
     uint gMaxParticles;
-    float3 gEmitterPosition;
-    float gEmitterSpread;
+    uint gEmitterCount;
+    float3 gSimPadding;
 };
 
+uint Hash(uint value)
+{
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float NextRandom(inout uint rng)
+{
+    rng = Hash(rng);
+    return rng * (1.0 / 4294967296.0);
+}
+
+float3 NextSigned3(inout uint rng)
+{
+    float x = NextRandom(rng);
+    float y = NextRandom(rng);
+    float z = NextRandom(rng);
+    return float3(x, y, z) * 2.0 - 1.0;
+}
+
 [numthreads(64,1,1)]
 void CS(uint3 dtid : SV_DispatchThreadID)
 {
-    if (dtid.x >= gSpawnCount) return;
+    uint spawnIndex = dtid.x;
+    if (spawnIndex >= min(gSpawnCount, gDeadCount.Load(0))) return;
 
-    uint particleIndex = gDeadListConsume.Consume();
+    // Last emitter whose range starts at or before this thread.
+    uint lo = 0;
+    uint hi = gEmitterCount - 1;
+    while (lo < hi)
+    {
+        uint mid = (lo + hi + 1) / 2;
+        if (gEmitters[mid].FirstSpawn <= spawnIndex)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    Emitter e = gEmitters[lo];
 
-    float seed = frac(sin((dtid.x + 1) * 12.9898 + gTotalTime * 78.233) * 43758.5453);
-    float seed2 = frac(sin((dtid.x + 1) * 63.7264 + gTotalTime * 17.371) * 12345.6789);
+    uint rng = e.Seed ^ Hash(spawnIndex - e.FirstSpawn);
+    uint particleIndex = gDeadListConsume.Consume();
 
     Particle p;
-    p.Position = gEmitterPosition + float3((seed - 0.5) * gEmitterSpread, 0.2, (seed2 - 0.5) * gEmitterSpread);
-    p.Velocity = float3((seed - 0.5) * 1.5, 5.5 + seed2 * 3.5, (seed2 - 0.5) * 1.5);
+    p.Position = e.Position + NextSigned3(rng) * e.PositionExtent;
+    p.Velocity = e.VelocityMean + NextSigned3(rng) * e.VelocityExtent;
     p.Age = 0.0;
-    p.Lifetime = 2.0 + seed * 1.4;
-    p.Color = float4(1.0, 0.07, 0.07, 1.0);
-    p.Size = 0.35 + seed2 * 0.2;
-    p.Padding = 0.0.xxx;
+    p.Lifetime = lerp(e.LifetimeMin, e.LifetimeMax, NextRandom(rng));
+    p.Color = e.Color;
+    p.Size = lerp(e.SizeMin, e.SizeMax, NextRandom(rng));
+    p.OccludedFrames = 0.0;
+    p.Padding = 0.0.xx;
 
     gParticlePool[particleIndex] = p;
 }
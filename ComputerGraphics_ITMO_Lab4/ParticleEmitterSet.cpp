@@ -0,0 +1,126 @@
+#include "ParticleEmitterSet.h"
+
+#include <cmath>
+#include <stdexcept>
+
+static_assert(sizeof(ParticleEmitterSet::GpuRecord) == 96,
+              "GpuRecord must match the Emitter struct in ParticleEmitCS");
+
+ParticleEmitterSet::EmitterHandle ParticleEmitterSet::AddEmitter(
+    const EmitterDesc& desc) {
+  if (desc.SpawnRate < 0.0f || desc.LifetimeMin <= 0.0f ||
+      desc.LifetimeMax < desc.LifetimeMin || desc.SizeMax < desc.SizeMin) {
+    throw std::invalid_argument("Invalid particle emitter description");
+  }
+
+  for (EmitterHandle handle = 0; handle < mSlots.size(); ++handle) {
+    if (!mSlots[handle].Alive) {
+      mSlots[handle] = Slot{desc, 0.0f, true};
+      return handle;
+    }
+  }
+  if (mSlots.size() >= kMaxEmitters) {
+    throw std::length_error("Too many particle emitters");
+  }
+  mSlots.push_back(Slot{desc, 0.0f, true});
+  return static_cast<EmitterHandle>(mSlots.size() - 1);
+}
+
+void ParticleEmitterSet::RemoveEmitter(EmitterHandle handle) {
+  GetSlot(handle).Alive = false;
+}
+
+ParticleEmitterSet::EmitterDesc& ParticleEmitterSet::GetEmitter(
+    EmitterHandle handle) {
+  return GetSlot(handle).Desc;
+}
+
+const ParticleEmitterSet::EmitterDesc& ParticleEmitterSet::GetEmitter(
+    EmitterHandle handle) const {
+  return GetSlot(handle).Desc;
+}
+
+void ParticleEmitterSet::SetPosition(EmitterHandle handle,
+                                     const ParticleFloat3& position) {
+  GetSlot(handle).Desc.Position = position;
+}
+
+uint32_t ParticleEmitterSet::GetEmitterCount() const {
+  uint32_t count = 0;
+  for (const Slot& slot : mSlots) {
+    if (slot.Alive) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+uint32_t ParticleEmitterSet::BuildSpawnBatch(float deltaTime,
+                                             uint32_t maxSpawn,
+                                             std::vector<GpuRecord>& records) {
+  records.clear();
+  ++mFrameIndex;
+
+  uint32_t totalSpawn = 0;
+  for (uint32_t slotIndex = 0; slotIndex < mSlots.size(); ++slotIndex) {
+    Slot& slot = mSlots[slotIndex];
+    if (!slot.Alive || !slot.Desc.Enabled) {
+      continue;
+    }
+
+    slot.SpawnAccumulator += slot.Desc.SpawnRate * deltaTime;
+    const float wholeSpawns = std::floor(slot.SpawnAccumulator);
+    slot.SpawnAccumulator -= wholeSpawns;
+
+    uint32_t spawnCount = static_cast<uint32_t>(wholeSpawns);
+    if (spawnCount > maxSpawn - totalSpawn) {
+      spawnCount = maxSpawn - totalSpawn;
+    }
+    if (spawnCount == 0) {
+      continue;
+    }
+
+    const EmitterDesc& desc = slot.Desc;
+    GpuRecord record;
+    record.Position = desc.Position;
+    record.FirstSpawn = totalSpawn;
+    record.PositionExtent = desc.PositionExtent;
+    record.SpawnCount = spawnCount;
+    record.VelocityMean = desc.VelocityMean;
+    record.LifetimeMin = desc.LifetimeMin;
+    record.VelocityExtent = desc.VelocityExtent;
+    record.LifetimeMax = desc.LifetimeMax;
+    for (int i = 0; i < 4; ++i) {
+      record.Color[i] = desc.Color[i];
+    }
+    record.SizeMin = desc.SizeMin;
+    record.SizeMax = desc.SizeMax;
+    record.Seed = Hash(mFrameIndex * kMaxEmitters + slotIndex);
+    records.push_back(record);
+
+    totalSpawn += spawnCount;
+  }
+  return totalSpawn;
+}
+
+uint32_t ParticleEmitterSet::Hash(uint32_t value) {
+  // PCG output permutation.
+  const uint32_t state = value * 747796405u + 2891336453u;
+  const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+ParticleEmitterSet::Slot& ParticleEmitterSet::GetSlot(EmitterHandle handle) {
+  if (handle >= mSlots.size() || !mSlots[handle].Alive) {
+    throw std::out_of_range("Unknown particle emitter");
+  }
+  return mSlots[handle];
+}
+
+const ParticleEmitterSet::Slot& ParticleEmitterSet::GetSlot(
+    EmitterHandle handle) const {
+  if (handle >= mSlots.size() || !mSlots[handle].Alive) {
+    throw std::out_of_range("Unknown particle emitter");
+  }
+  return mSlots[handle];
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct ParticleFloat3 {
+  float X = 0.0f;
+  float Y = 0.0f;
+  float Z = 0.0f;
+};
+
+// CPU side of the particle emitters. Emitters share one particle pool; each
+// frame BuildSpawnBatch turns their spawn rates into a compact table of
+// records so that a single emit dispatch can serve all of them: thread i
+// belongs to the record whose [FirstSpawn, FirstSpawn + SpawnCount) range
+// contains i. Has no D3D12 dependency.
+class ParticleEmitterSet {
+ public:
+  using EmitterHandle = uint32_t;
+  static constexpr uint32_t kMaxEmitters = 64;
+
+  struct EmitterDesc {
+    ParticleFloat3 Position;
+    // Particles start uniformly inside Position +- PositionExtent.
+    ParticleFloat3 PositionExtent;
+    // Particles per second; fractional remainders carry over to the next
+    // frame.
+    float SpawnRate = 0.0f;
+    float LifetimeMin = 1.0f;
+    float LifetimeMax = 1.0f;
+    // Initial velocity is uniform in VelocityMean +- VelocityExtent.
+    ParticleFloat3 VelocityMean;
+    ParticleFloat3 VelocityExtent;
+    float Color[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float SizeMin = 0.5f;
+    float SizeMax = 0.5f;
+    bool Enabled = true;
+  };
+
+  // Layout of one element of the emitter StructuredBuffer read by
+  // ParticleEmitCS.hlsl.
+  struct GpuRecord {
+    ParticleFloat3 Position;
+    uint32_t FirstSpawn = 0;
+    ParticleFloat3 PositionExtent;
+    uint32_t SpawnCount = 0;
+    ParticleFloat3 VelocityMean;
+    float LifetimeMin = 0.0f;
+    ParticleFloat3 VelocityExtent;
+    float LifetimeMax = 0.0f;
+    float Color[4] = {};
+    float SizeMin = 0.0f;
+    float SizeMax = 0.0f;
+    uint32_t Seed = 0;
+    float Padding = 0.0f;
+  };
+
+  EmitterHandle AddEmitter(const EmitterDesc& desc);
+  void RemoveEmitter(EmitterHandle handle);
+  EmitterDesc& GetEmitter(EmitterHandle handle);
+  const EmitterDesc& GetEmitter(EmitterHandle handle) const;
+  void SetPosition(EmitterHandle handle, const ParticleFloat3& position);
+  uint32_t GetEmitterCount() const;
+
+  // Fills records with the emitters that spawn this frame and returns the
+  // total spawn count, which is at most maxSpawn. Spawns that do not fit
+  // are dropped rather than deferred so a saturated pool does not build up
+  // a backlog.
+  uint32_t BuildSpawnBatch(float deltaTime, uint32_t maxSpawn,
+                           std::vector<GpuRecord>& records);
+
+  // Integer hash shared with the emit shader.
+  static uint32_t Hash(uint32_t value);
+
+ private:
+  struct Slot {
+    EmitterDesc Desc;
+    float SpawnAccumulator = 0.0f;
+    bool Alive = false;
+  };
+
+  Slot& GetSlot(EmitterHandle handle);
+  const Slot& GetSlot(EmitterHandle handle) const;
+
+  std::vector<Slot> mSlots;
+  uint32_t mFrameIndex = 0;
+};
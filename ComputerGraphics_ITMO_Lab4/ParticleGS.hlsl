@@ -6,7 +6,8 @@ struct Particle
     float Lifetime;
     float4 Color;
     float Size;
-    float3 Padding;
+    float OccludedFrames;
+    float2 Padding;
 };
 
 StructuredBuffer<Particle> gParticlePool : register(t0);
@@ -17,7 +18,8 @@ cbuffer ParticleRenderCB : register(b0)
     float3 gCameraPosition;
     float gBillboardSize;
     uint gMaxParticles;
-    float3 gPad;
+    uint gOpaqueParticles;
+    float2 gPad;
 };
 
 struct VSOut
@@ -6,7 +6,8 @@ struct Particle
     float Lifetime;
     float4 Color;
     float Size;
-    float3 Padding;
+    float OccludedFrames;
+    float2 Padding;
 };
 
 RWStructuredBuffer<Particle> gParticlePool : register(u0);
@@ -18,8 +19,8 @@ cbuffer SimCB : register(b0)
     float gTotalTime;
     uint gSpawnCount;
     uint gMaxParticles;
-    float3 gEmitterPosition;
-    float gEmitterSpread;
+    uint gEmitterCount;
+    float3 gSimPadding;
 };
 
 [numthreads(128,1,1)]
@@ -35,7 +36,8 @@ void CS(uint3 dtid : SV_DispatchThreadID)
     p.Lifetime = 0.0;
     p.Color = float4(1.0, 0.0, 0.0, 1.0);
     p.Size = 0.4;
-    p.Padding = 0.0.xxx;
+    p.OccludedFrames = 0.0;
+    p.Padding = 0.0.xx;
     gParticlePool[idx] = p;
     gDeadListAppend.Append(idx);
 }
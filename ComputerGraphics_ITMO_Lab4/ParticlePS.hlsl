@@ -1,3 +1,13 @@
+cbuffer ParticleRenderCB : register(b0)
+{
+    float4x4 gViewProj;
+    float3 gCameraPosition;
+    float gBillboardSize;
+    uint gMaxParticles;
+    uint gOpaqueParticles;
+    float2 gPad;
+};
+
 struct PSIn
 {
     float4 PositionH : SV_POSITION;
@@ -11,5 +21,8 @@ float4 PS(PSIn input) : SV_TARGET
     float dist = length(centered);
     float sdf = 1.0 - smoothstep(0.85, 1.0, dist);
     clip(sdf - 0.02);
-    return float4(input.Color.rgb, 1.0);
+    // The off-screen target's alpha is coverage: the blended PSO for
+    // depth-sorted particles accumulates it, the opaque one writes it whole.
+    float alpha = gOpaqueParticles != 0 ? 1.0 : input.Color.a * sdf;
+    return float4(input.Color.rgb, alpha);
 }
@@ -6,11 +6,15 @@ struct Particle
     float Lifetime;
     float4 Color;
     float Size;
-    float3 Padding;
+    float OccludedFrames;
+    float2 Padding;
 };
 
 RWStructuredBuffer<Particle> gParticlePool : register(u0);
 AppendStructuredBuffer<uint> gDeadListAppend : register(u1);
+AppendStructuredBuffer<uint> gAliveListAppend : register(u3);
+// Scene depth of the previous frame, copied by ParticleDepthCopyCS.
+Texture2D<float> gCollisionDepth : register(t2);
 
 cbuffer SimCB : register(b0)
 {
@@ -18,10 +22,92 @@ cbuffer SimCB : register(b0)
     float gTotalTime;
     uint gSpawnCount;
     uint gMaxParticles;
-    float3 gEmitterPosition;
-    float gEmitterSpread;
+    uint gEmitterCount;
+    float3 gSimPadding;
+    float4x4 gDepthViewProj;
+    float4x4 gDepthInvViewProj;
+    float gRestitution;
+    float gCollisionThickness;
+    uint gOccludedFramesToDie;
+    uint gCollisionEnabled;
+    float2 gDepthSize;
+    float2 gCollisionPadding;
 };
 
+float3 ReconstructWorld(float2 ndc, float depth)
+{
+    float4 world = mul(float4(ndc, depth, 1.0), gDepthInvViewProj);
+    return world.xyz / world.w;
+}
+
+// Collides the particle against the depth buffer. Returns false if the
+// particle has to die.
+bool CollideWithDepth(inout Particle p)
+{
+    float4 clip = mul(float4(p.Position, 1.0), gDepthViewProj);
+    if (clip.w <= 0.0)
+    {
+        p.OccludedFrames = 0.0;
+        return true;
+    }
+
+    float2 ndc = clip.xy / clip.w;
+    float2 uv = float2(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5);
+    if (any(uv < 0.0) || any(uv > 1.0))
+    {
+        // Off screen: no depth information.
+        p.OccludedFrames = 0.0;
+        return true;
+    }
+
+    int2 texel = min(int2(uv * gDepthSize), int2(gDepthSize) - 1);
+    float sceneDepth = gCollisionDepth[texel];
+    if (sceneDepth >= 1.0)
+    {
+        p.OccludedFrames = 0.0;
+        return true;
+    }
+
+    float3 sceneWorld = ReconstructWorld(ndc, sceneDepth);
+    float sceneW = mul(float4(sceneWorld, 1.0), gDepthViewProj).w;
+    float behind = clip.w - sceneW;
+    if (behind <= 0.0)
+    {
+        p.OccludedFrames = 0.0;
+        return true;
+    }
+
+    if (behind > gCollisionThickness)
+    {
+        // Hidden behind geometry rather than touching it.
+        p.OccludedFrames += 1.0;
+        return p.OccludedFrames < gOccludedFramesToDie;
+    }
+
+    if (gRestitution <= 0.0)
+    {
+        return false;
+    }
+
+    int2 texelX = min(texel + int2(1, 0), int2(gDepthSize) - 1);
+    int2 texelY = min(texel + int2(0, 1), int2(gDepthSize) - 1);
+    float2 texelNdc = float2(2.0, -2.0) / gDepthSize;
+    float3 worldX = ReconstructWorld(ndc + float2(texelNdc.x, 0.0),
+                                     gCollisionDepth[texelX]);
+    float3 worldY = ReconstructWorld(ndc + float2(0.0, texelNdc.y),
+                                     gCollisionDepth[texelY]);
+    float3 normal = normalize(cross(worldX - sceneWorld, worldY - sceneWorld));
+    if (dot(normal, p.Velocity) > 0.0)
+    {
+        normal = -normal;
+    }
+
+    p.Position = sceneWorld + normal * 0.02;
+    p.Velocity = reflect(p.Velocity, normal) * gRestitution;
+    p.OccludedFrames = 0.0;
+    return true;
+}
+
 [numthreads(128,1,1)]
 void CS(uint3 dtid : SV_DispatchThreadID)
 {
@@ -38,11 +124,21 @@ void CS(uint3 dtid : SV_DispatchThreadID)
     p.Velocity += float3(0.0, -9.8, 0.0) * gDeltaTime;
     p.Position += p.Velocity * gDeltaTime;
 
-    if (p.Age >= p.Lifetime || p.Position.y < -5.0)
+    bool survives = true;
+    if (gCollisionEnabled != 0)
+    {
+        survives = CollideWithDepth(p);
+    }
+
+    if (!survives || p.Age >= p.Lifetime || p.Position.y < -5.0)
     {
         p.Age = -1.0;
         gDeadListAppend.Append(idx);
     }
+    else
+    {
+        gAliveListAppend.Append(idx);
+    }
 
     gParticlePool[idx] = p;
 }
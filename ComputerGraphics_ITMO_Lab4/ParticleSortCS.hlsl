@@ -0,0 +1,160 @@
+struct Particle
+{
+    float3 Position;
+    float Age;
+    float3 Velocity;
+    float Lifetime;
+    float4 Color;
+    float Size;
+    float OccludedFrames;
+    float2 Padding;
+};
+
+struct SortEntry
+{
+    float Depth;
+    uint Index;
+};
+
+cbuffer SortCB : register(b0)
+{
+    uint gSortCount;
+    uint gSortK;
+    uint gSortJ;
+    uint gSortPad;
+};
+
+cbuffer ParticleRenderCB : register(b1)
+{
+    float4x4 gViewProj;
+    float3 gCameraPosition;
+    float gBillboardSize;
+    uint gMaxParticles;
+    uint gOpaqueParticles;
+    float2 gPad;
+};
+
+RWStructuredBuffer<SortEntry> gSortEntries : register(u0);
+RWStructuredBuffer<uint> gAliveList : register(u1);
+RWByteAddressBuffer gDrawArgs : register(u2);
+RWStructuredBuffer<Particle> gParticlePool : register(u3);
+
+#define LOCAL_SORT_SIZE 1024
+
+groupshared SortEntry gsEntries[LOCAL_SORT_SIZE];
+
+// Entries are sorted by descending view depth (back to front). Padding
+// entries use -FLT_MAX and end up after every alive particle.
+void CompareAndSwap(inout SortEntry a, inout SortEntry b, bool descending)
+{
+    if ((a.Depth < b.Depth) == descending)
+    {
+        SortEntry t = a;
+        a = b;
+        b = t;
+    }
+}
+
+// Index of the lower element of compare pair t for stride j.
+uint PairLow(uint t, uint j)
+{
+    return ((t & ~(j - 1)) << 1) | (t & (j - 1));
+}
+
+[numthreads(256,1,1)]
+void BuildKeysCS(uint3 dtid : SV_DispatchThreadID)
+{
+    uint i = dtid.x;
+    if (i >= gSortCount) return;
+
+    SortEntry e;
+    e.Depth = -3.402823466e+38;
+    e.Index = 0xffffffff;
+    if (i < gDrawArgs.Load(0))
+    {
+        e.Index = gAliveList[i];
+        e.Depth = mul(float4(gParticlePool[e.Index].Position, 1.0), gViewProj).w;
+    }
+    gSortEntries[i] = e;
+}
+
+// Sorts each 1024-entry block completely (all k <= 1024) in group shared
+// memory, with blocks alternating direction as the bitonic network needs.
+[numthreads(LOCAL_SORT_SIZE / 2,1,1)]
+void PreSortCS(uint3 gid : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    uint baseIndex = gid.x * LOCAL_SORT_SIZE;
+    gsEntries[gi] = gSortEntries[baseIndex + gi];
+    gsEntries[gi + LOCAL_SORT_SIZE / 2] =
+        gSortEntries[baseIndex + gi + LOCAL_SORT_SIZE / 2];
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint k = 2; k <= LOCAL_SORT_SIZE; k <<= 1)
+    {
+        for (uint j = k >> 1; j > 0; j >>= 1)
+        {
+            uint lo = PairLow(gi, j);
+            bool descending = ((baseIndex + lo) & k) == 0;
+            SortEntry a = gsEntries[lo];
+            SortEntry b = gsEntries[lo + j];
+            CompareAndSwap(a, b, descending);
+            gsEntries[lo] = a;
+            gsEntries[lo + j] = b;
+            GroupMemoryBarrierWithGroupSync();
+        }
+    }
+
+    gSortEntries[baseIndex + gi] = gsEntries[gi];
+    gSortEntries[baseIndex + gi + LOCAL_SORT_SIZE / 2] =
+        gsEntries[gi + LOCAL_SORT_SIZE / 2];
+}
+
+// One compare step of the bitonic network for strides that span blocks.
+[numthreads(256,1,1)]
+void GlobalStepCS(uint3 dtid : SV_DispatchThreadID)
+{
+    uint t = dtid.x;
+    if (t >= gSortCount / 2) return;
+
+    uint lo = PairLow(t, gSortJ);
+    SortEntry a = gSortEntries[lo];
+    SortEntry b = gSortEntries[lo + gSortJ];
+    CompareAndSwap(a, b, (lo & gSortK) == 0);
+    gSortEntries[lo] = a;
+    gSortEntries[lo + gSortJ] = b;
+}
+
+// Remaining steps j = 512 .. 1 of merge stage k, inside one block.
+[numthreads(LOCAL_SORT_SIZE / 2,1,1)]
+void LocalStepCS(uint3 gid : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    uint baseIndex = gid.x * LOCAL_SORT_SIZE;
+    gsEntries[gi] = gSortEntries[baseIndex + gi];
+    gsEntries[gi + LOCAL_SORT_SIZE / 2] =
+        gSortEntries[baseIndex + gi + LOCAL_SORT_SIZE / 2];
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint j = LOCAL_SORT_SIZE / 2; j > 0; j >>= 1)
+    {
+        uint lo = PairLow(gi, j);
+        bool descending = ((baseIndex + lo) & gSortK) == 0;
+        SortEntry a = gsEntries[lo];
+        SortEntry b = gsEntries[lo + j];
+        CompareAndSwap(a, b, descending);
+        gsEntries[lo] = a;
+        gsEntries[lo + j] = b;
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    gSortEntries[baseIndex + gi] = gsEntries[gi];
+    gSortEntries[baseIndex + gi + LOCAL_SORT_SIZE / 2] =
+        gsEntries[gi + LOCAL_SORT_SIZE / 2];
+}
+
+[numthreads(256,1,1)]
+void WriteBackCS(uint3 dtid : SV_DispatchThreadID)
+{
+    uint i = dtid.x;
+    if (i >= gDrawArgs.Load(0)) return;
+    gAliveList[i] = gSortEntries[i].Index;
+}
@@ -1,3 +1,5 @@
+StructuredBuffer<uint> gAliveList : register(t1);
+
 struct VSOut
 {
     uint ParticleIndex : PARTICLEINDEX;
@@ -6,6 +8,6 @@ struct VSOut
 VSOut VS(uint vertexId : SV_VertexID)
 {
     VSOut o;
-    o.ParticleIndex = vertexId;
+    o.ParticleIndex = gAliveList[vertexId];
     return o;
 }
@@ -0,0 +1,114 @@
+#include "PipelineCacheIndex.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "Fnv1aHash.h"
+#include "LittleEndianIO.h"
+
+namespace {
+constexpr char kMagic[4] = {'P', 'S', 'O', 'C'};
+
+uint64_t HashLibrary(const std::vector<uint8_t>& data) {
+  Fnv1aHash hash;
+  hash.AddBytes(data.data(), data.size());
+  return hash.Get();
+}
+}  // namespace
+
+std::string PipelineCacheIndex::KeyToName(uint64_t key) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string name(16, '0');
+  for (int i = 15; i >= 0; --i) {
+    name[i] = kDigits[key & 0xf];
+    key >>= 4;
+  }
+  return name;
+}
+
+bool PipelineCacheIndex::Load(const std::string& path,
+                              const AdapterIdentity& adapter) {
+  Clear();
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+
+  size_t offset = sizeof(kMagic);
+  uint32_t version = 0;
+  AdapterIdentity stored;
+  uint32_t keyCount = 0;
+  if (data.size() < sizeof(kMagic) ||
+      !std::equal(kMagic, kMagic + sizeof(kMagic), data.begin()) ||
+      !ReadUint32LE(data, offset, version) || version != kVersion ||
+      !ReadUint32LE(data, offset, stored.VendorId) ||
+      !ReadUint32LE(data, offset, stored.DeviceId) ||
+      !ReadUint64LE(data, offset, stored.DriverVersion) ||
+      stored != adapter || !ReadUint32LE(data, offset, keyCount)) {
+    return false;
+  }
+
+  // A corrupt count must not drive the allocation below.
+  if (keyCount > (data.size() - offset) / sizeof(uint64_t)) {
+    return false;
+  }
+  std::vector<uint64_t> keys(keyCount);
+  for (auto& key : keys) {
+    if (!ReadUint64LE(data, offset, key)) {
+      return false;
+    }
+  }
+
+  uint64_t librarySize = 0;
+  uint64_t libraryHash = 0;
+  if (!ReadUint64LE(data, offset, librarySize) ||
+      !ReadUint64LE(data, offset, libraryHash) ||
+      data.size() - offset != librarySize) {
+    return false;
+  }
+  std::vector<uint8_t> library(data.begin() + offset, data.end());
+  if (HashLibrary(library) != libraryHash) {
+    return false;
+  }
+
+  mAdapter = stored;
+  mKeys = std::move(keys);
+  mLibraryData = std::move(library);
+  return true;
+}
+
+void PipelineCacheIndex::Save(const std::string& path) const {
+  std::vector<uint8_t> data(kMagic, kMagic + sizeof(kMagic));
+  WriteUint32LE(data, kVersion);
+  WriteUint32LE(data, mAdapter.VendorId);
+  WriteUint32LE(data, mAdapter.DeviceId);
+  WriteUint64LE(data, mAdapter.DriverVersion);
+  WriteUint32LE(data, static_cast<uint32_t>(mKeys.size()));
+  for (uint64_t key : mKeys) {
+    WriteUint64LE(data, key);
+  }
+  WriteUint64LE(data, mLibraryData.size());
+  WriteUint64LE(data, HashLibrary(mLibraryData));
+  data.insert(data.end(), mLibraryData.begin(), mLibraryData.end());
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    throw std::runtime_error("Cannot write pipeline cache " + path);
+  }
+  file.write(reinterpret_cast<const char*>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+}
+
+void PipelineCacheIndex::Clear() {
+  mAdapter = AdapterIdentity();
+  mKeys.clear();
+  mLibraryData.clear();
+}
+
+bool PipelineCacheIndex::Contains(uint64_t key) const {
+  return std::find(mKeys.begin(), mKeys.end(), key) != mKeys.end();
+}
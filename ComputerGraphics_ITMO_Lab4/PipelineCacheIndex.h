@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// On-disk companion of an ID3D12PipelineLibrary: the serialized library blob
+// plus the adapter and driver it was produced on and the keys stored in it.
+// The file is little-endian regardless of the host:
+//   char[4] "PSOC", uint32 version,
+//   uint32 vendor id, uint32 device id, uint64 driver version,
+//   uint32 key count, uint64 keys[count],
+//   uint64 library size, uint64 library hash, library bytes.
+// Has no D3D12 dependency.
+class PipelineCacheIndex {
+ public:
+  struct AdapterIdentity {
+    uint32_t VendorId = 0;
+    uint32_t DeviceId = 0;
+    uint64_t DriverVersion = 0;
+
+    bool operator==(const AdapterIdentity& other) const {
+      return VendorId == other.VendorId && DeviceId == other.DeviceId &&
+             DriverVersion == other.DriverVersion;
+    }
+    bool operator!=(const AdapterIdentity& other) const {
+      return !(*this == other);
+    }
+  };
+
+  static constexpr uint32_t kVersion = 1;
+
+  // Pipeline names inside the library: the key as 16 lowercase hex digits.
+  static std::string KeyToName(uint64_t key);
+
+  // Replaces the contents with the file at path. Returns false and leaves the
+  // index empty if the file is missing, malformed, or was written for a
+  // different adapter or driver version.
+  bool Load(const std::string& path, const AdapterIdentity& adapter);
+  // Throws std::runtime_error if the file cannot be written.
+  void Save(const std::string& path) const;
+
+  void Clear();
+
+  const AdapterIdentity& GetAdapter() const { return mAdapter; }
+  void SetAdapter(const AdapterIdentity& adapter) { mAdapter = adapter; }
+
+  const std::vector<uint64_t>& GetKeys() const { return mKeys; }
+  void SetKeys(std::vector<uint64_t> keys) { mKeys = std::move(keys); }
+  bool Contains(uint64_t key) const;
+
+  const std::vector<uint8_t>& GetLibraryData() const { return mLibraryData; }
+  void SetLibraryData(std::vector<uint8_t> data) {
+    mLibraryData = std::move(data);
+  }
+
+ private:
+  AdapterIdentity mAdapter;
+  std::vector<uint64_t> mKeys;
+  std::vector<uint8_t> mLibraryData;
+};
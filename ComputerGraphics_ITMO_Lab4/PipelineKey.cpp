@@ -0,0 +1,151 @@
+#include "PipelineKey.h"
+
+#include <cstring>
+
+#include "Fnv1aHash.h"
+
+namespace {
+void AddFloat(Fnv1aHash& hash, float value) {
+  uint32_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  hash.AddUint32(bits);
+}
+
+void AddCString(Fnv1aHash& hash, const char* value) {
+  hash.AddString(value != nullptr ? value : "");
+}
+
+void AddShader(Fnv1aHash& hash, const PipelineKey::Shader& shader) {
+  hash.AddUint64(shader.Size);
+  if (shader.Bytecode != nullptr) {
+    hash.AddBytes(shader.Bytecode, shader.Size);
+  }
+}
+
+void AddStreamOutput(Fnv1aHash& hash, const PipelineKey::StreamOutputDesc& so) {
+  hash.AddUint32(static_cast<uint32_t>(so.Entries.size()));
+  for (const auto& entry : so.Entries) {
+    hash.AddUint32(entry.Stream);
+    AddCString(hash, entry.SemanticName);
+    hash.AddUint32(entry.SemanticIndex);
+    hash.AddUint32(entry.StartComponent);
+    hash.AddUint32(entry.ComponentCount);
+    hash.AddUint32(entry.OutputSlot);
+  }
+  hash.AddUint32(static_cast<uint32_t>(so.BufferStrides.size()));
+  for (uint32_t stride : so.BufferStrides) {
+    hash.AddUint32(stride);
+  }
+  hash.AddUint32(so.RasterizedStream);
+}
+
+void AddBlend(Fnv1aHash& hash, const PipelineKey::BlendDesc& blend) {
+  hash.AddUint32(blend.AlphaToCoverageEnable);
+  hash.AddUint32(blend.IndependentBlendEnable);
+  for (const auto& target : blend.RenderTarget) {
+    hash.AddUint32(target.BlendEnable);
+    hash.AddUint32(target.LogicOpEnable);
+    hash.AddUint32(target.SrcBlend);
+    hash.AddUint32(target.DestBlend);
+    hash.AddUint32(target.BlendOp);
+    hash.AddUint32(target.SrcBlendAlpha);
+    hash.AddUint32(target.DestBlendAlpha);
+    hash.AddUint32(target.BlendOpAlpha);
+    hash.AddUint32(target.LogicOp);
+    hash.AddUint32(target.RenderTargetWriteMask);
+  }
+}
+
+void AddRasterizer(Fnv1aHash& hash, const PipelineKey::RasterizerDesc& rast) {
+  hash.AddUint32(rast.FillMode);
+  hash.AddUint32(rast.CullMode);
+  hash.AddUint32(rast.FrontCounterClockwise);
+  hash.AddUint32(static_cast<uint32_t>(rast.DepthBias));
+  AddFloat(hash, rast.DepthBiasClamp);
+  AddFloat(hash, rast.SlopeScaledDepthBias);
+  hash.AddUint32(rast.DepthClipEnable);
+  hash.AddUint32(rast.MultisampleEnable);
+  hash.AddUint32(rast.AntialiasedLineEnable);
+  hash.AddUint32(rast.ForcedSampleCount);
+  hash.AddUint32(rast.ConservativeRaster);
+}
+
+void AddStencilOp(Fnv1aHash& hash, const PipelineKey::StencilOp& op) {
+  hash.AddUint32(op.StencilFailOp);
+  hash.AddUint32(op.StencilDepthFailOp);
+  hash.AddUint32(op.StencilPassOp);
+  hash.AddUint32(op.StencilFunc);
+}
+
+void AddDepthStencil(Fnv1aHash& hash, const PipelineKey::DepthStencilDesc& ds) {
+  hash.AddUint32(ds.DepthEnable);
+  hash.AddUint32(ds.DepthWriteMask);
+  hash.AddUint32(ds.DepthFunc);
+  hash.AddUint32(ds.StencilEnable);
+  hash.AddUint32(ds.StencilReadMask);
+  hash.AddUint32(ds.StencilWriteMask);
+  AddStencilOp(hash, ds.FrontFace);
+  AddStencilOp(hash, ds.BackFace);
+}
+
+void AddInputLayout(Fnv1aHash& hash,
+                    const std::vector<PipelineKey::InputElement>& layout) {
+  hash.AddUint32(static_cast<uint32_t>(layout.size()));
+  for (const auto& element : layout) {
+    AddCString(hash, element.SemanticName);
+    hash.AddUint32(element.SemanticIndex);
+    hash.AddUint32(element.Format);
+    hash.AddUint32(element.InputSlot);
+    hash.AddUint32(element.AlignedByteOffset);
+    hash.AddUint32(element.InputSlotClass);
+    hash.AddUint32(element.InstanceDataStepRate);
+  }
+}
+}  // namespace
+
+uint64_t PipelineKey::ComputeGraphics(const GraphicsDesc& desc) {
+  Fnv1aHash hash;
+  hash.AddUint32(kVersion);
+  hash.AddUint32(0);  // Graphics.
+  hash.AddUint64(desc.RootSignatureHash);
+  AddShader(hash, desc.VS);
+  AddShader(hash, desc.PS);
+  AddShader(hash, desc.DS);
+  AddShader(hash, desc.HS);
+  AddShader(hash, desc.GS);
+  AddStreamOutput(hash, desc.StreamOutput);
+  AddBlend(hash, desc.BlendState);
+  hash.AddUint32(desc.SampleMask);
+  AddRasterizer(hash, desc.RasterizerState);
+  AddDepthStencil(hash, desc.DepthStencilState);
+  AddInputLayout(hash, desc.InputLayout);
+  hash.AddUint32(desc.IBStripCutValue);
+  hash.AddUint32(desc.PrimitiveTopologyType);
+  hash.AddUint32(desc.NumRenderTargets);
+  for (uint32_t format : desc.RTVFormats) {
+    hash.AddUint32(format);
+  }
+  hash.AddUint32(desc.DSVFormat);
+  hash.AddUint32(desc.SampleCount);
+  hash.AddUint32(desc.SampleQuality);
+  hash.AddUint32(desc.NodeMask);
+  hash.AddUint32(desc.Flags);
+  return hash.Get();
+}
+
+uint64_t PipelineKey::ComputeCompute(const ComputeDesc& desc) {
+  Fnv1aHash hash;
+  hash.AddUint32(kVersion);
+  hash.AddUint32(1);  // Compute.
+  hash.AddUint64(desc.RootSignatureHash);
+  AddShader(hash, desc.CS);
+  hash.AddUint32(desc.NodeMask);
+  hash.AddUint32(desc.Flags);
+  return hash.Get();
+}
+
+uint64_t PipelineKey::HashRootSignature(const void* serialized, size_t size) {
+  Fnv1aHash hash;
+  hash.AddBytes(serialized, size);
+  return hash.Get();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Keys PipelineStateCache names pipelines by. The descriptions mirror
+// D3D12_GRAPHICS_PIPELINE_STATE_DESC and D3D12_COMPUTE_PIPELINE_STATE_DESC
+// field for field, with enums as their integer values, the root signature
+// replaced by the hash of its serialized form and arrays behind pointers
+// held as vectors. Fields are hashed one at a time in declaration order:
+// struct padding makes raw bytes unreliable, and pointers must be followed.
+// Has no D3D12 dependency.
+class PipelineKey {
+ public:
+  // Bumped whenever the key layout changes.
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kRenderTargetCount = 8;
+
+  struct Shader {
+    const void* Bytecode = nullptr;
+    size_t Size = 0;
+  };
+
+  struct StreamOutputEntry {
+    uint32_t Stream = 0;
+    const char* SemanticName = nullptr;
+    uint32_t SemanticIndex = 0;
+    uint32_t StartComponent = 0;
+    uint32_t ComponentCount = 0;
+    uint32_t OutputSlot = 0;
+  };
+
+  struct StreamOutputDesc {
+    std::vector<StreamOutputEntry> Entries;
+    std::vector<uint32_t> BufferStrides;
+    uint32_t RasterizedStream = 0;
+  };
+
+  struct RenderTargetBlend {
+    uint32_t BlendEnable = 0;
+    uint32_t LogicOpEnable = 0;
+    uint32_t SrcBlend = 0;
+    uint32_t DestBlend = 0;
+    uint32_t BlendOp = 0;
+    uint32_t SrcBlendAlpha = 0;
+    uint32_t DestBlendAlpha = 0;
+    uint32_t BlendOpAlpha = 0;
+    uint32_t LogicOp = 0;
+    uint32_t RenderTargetWriteMask = 0;
+  };
+
+  struct BlendDesc {
+    uint32_t AlphaToCoverageEnable = 0;
+    uint32_t IndependentBlendEnable = 0;
+    RenderTargetBlend RenderTarget[kRenderTargetCount];
+  };
+
+  struct RasterizerDesc {
+    uint32_t FillMode = 0;
+    uint32_t CullMode = 0;
+    uint32_t FrontCounterClockwise = 0;
+    int32_t DepthBias = 0;
+    float DepthBiasClamp = 0.0f;
+    float SlopeScaledDepthBias = 0.0f;
+    uint32_t DepthClipEnable = 0;
+    uint32_t MultisampleEnable = 0;
+    uint32_t AntialiasedLineEnable = 0;
+    uint32_t ForcedSampleCount = 0;
+    uint32_t ConservativeRaster = 0;
+  };
+
+  struct StencilOp {
+    uint32_t StencilFailOp = 0;
+    uint32_t StencilDepthFailOp = 0;
+    uint32_t StencilPassOp = 0;
+    uint32_t StencilFunc = 0;
+  };
+
+  struct DepthStencilDesc {
+    uint32_t DepthEnable = 0;
+    uint32_t DepthWriteMask = 0;
+    uint32_t DepthFunc = 0;
+    uint32_t StencilEnable = 0;
+    uint32_t StencilReadMask = 0;
+    uint32_t StencilWriteMask = 0;
+    StencilOp FrontFace;
+    StencilOp BackFace;
+  };
+
+  struct InputElement {
+    const char* SemanticName = nullptr;
+    uint32_t SemanticIndex = 0;
+    uint32_t Format = 0;
+    uint32_t InputSlot = 0;
+    uint32_t AlignedByteOffset = 0;
+    uint32_t InputSlotClass = 0;
+    uint32_t InstanceDataStepRate = 0;
+  };
+
+  struct GraphicsDesc {
+    uint64_t RootSignatureHash = 0;
+    Shader VS;
+    Shader PS;
+    Shader DS;
+    Shader HS;
+    Shader GS;
+    StreamOutputDesc StreamOutput;
+    BlendDesc BlendState;
+    uint32_t SampleMask = 0;
+    RasterizerDesc RasterizerState;
+    DepthStencilDesc DepthStencilState;
+    std::vector<InputElement> InputLayout;
+    uint32_t IBStripCutValue = 0;
+    uint32_t PrimitiveTopologyType = 0;
+    uint32_t NumRenderTargets = 0;
+    uint32_t RTVFormats[kRenderTargetCount] = {};
+    uint32_t DSVFormat = 0;
+    uint32_t SampleCount = 0;
+    uint32_t SampleQuality = 0;
+    uint32_t NodeMask = 0;
+    uint32_t Flags = 0;
+  };
+
+  struct ComputeDesc {
+    uint64_t RootSignatureHash = 0;
+    Shader CS;
+    uint32_t NodeMask = 0;
+    uint32_t Flags = 0;
+  };
+
+  static uint64_t ComputeGraphics(const GraphicsDesc& desc);
+  static uint64_t ComputeCompute(const ComputeDesc& desc);
+  // Hash of a serialized root signature, as RootSignatureHash expects.
+  static uint64_t HashRootSignature(const void* serialized, size_t size);
+};
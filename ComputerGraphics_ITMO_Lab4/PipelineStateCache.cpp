@@ -0,0 +1,334 @@
+#include "PipelineStateCache.h"
+
+#include <chrono>
+
+#include "PipelineKey.h"
+
+namespace {
+PipelineKey::Shader ToKeyShader(const D3D12_SHADER_BYTECODE& shader) {
+  PipelineKey::Shader key;
+  key.Bytecode = shader.pShaderBytecode;
+  key.Size = shader.BytecodeLength;
+  return key;
+}
+
+// The descriptions are copied field by field into PipelineKey's plain
+// structs, which hash them; PipelineKey lists the fields in the same order.
+PipelineKey::GraphicsDesc ToKeyDesc(
+    const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+    uint64_t rootSignatureHash) {
+  PipelineKey::GraphicsDesc key;
+  key.RootSignatureHash = rootSignatureHash;
+  key.VS = ToKeyShader(desc.VS);
+  key.PS = ToKeyShader(desc.PS);
+  key.DS = ToKeyShader(desc.DS);
+  key.HS = ToKeyShader(desc.HS);
+  key.GS = ToKeyShader(desc.GS);
+
+  const D3D12_STREAM_OUTPUT_DESC& so = desc.StreamOutput;
+  for (UINT i = 0; i < so.NumEntries; ++i) {
+    const D3D12_SO_DECLARATION_ENTRY& entry = so.pSODeclaration[i];
+    PipelineKey::StreamOutputEntry keyEntry;
+    keyEntry.Stream = entry.Stream;
+    keyEntry.SemanticName = entry.SemanticName;
+    keyEntry.SemanticIndex = entry.SemanticIndex;
+    keyEntry.StartComponent = entry.StartComponent;
+    keyEntry.ComponentCount = entry.ComponentCount;
+    keyEntry.OutputSlot = entry.OutputSlot;
+    key.StreamOutput.Entries.push_back(keyEntry);
+  }
+  key.StreamOutput.BufferStrides.assign(so.pBufferStrides,
+                                        so.pBufferStrides + so.NumStrides);
+  key.StreamOutput.RasterizedStream = so.RasterizedStream;
+
+  const D3D12_BLEND_DESC& blend = desc.BlendState;
+  key.BlendState.AlphaToCoverageEnable = blend.AlphaToCoverageEnable;
+  key.BlendState.IndependentBlendEnable = blend.IndependentBlendEnable;
+  for (UINT i = 0; i < PipelineKey::kRenderTargetCount; ++i) {
+    const D3D12_RENDER_TARGET_BLEND_DESC& target = blend.RenderTarget[i];
+    PipelineKey::RenderTargetBlend& keyTarget = key.BlendState.RenderTarget[i];
+    keyTarget.BlendEnable = target.BlendEnable;
+    keyTarget.LogicOpEnable = target.LogicOpEnable;
+    keyTarget.SrcBlend = target.SrcBlend;
+    keyTarget.DestBlend = target.DestBlend;
+    keyTarget.BlendOp = target.BlendOp;
+    keyTarget.SrcBlendAlpha = target.SrcBlendAlpha;
+    keyTarget.DestBlendAlpha = target.DestBlendAlpha;
+    keyTarget.BlendOpAlpha = target.BlendOpAlpha;
+    keyTarget.LogicOp = target.LogicOp;
+    keyTarget.RenderTargetWriteMask = target.RenderTargetWriteMask;
+  }
+  key.SampleMask = desc.SampleMask;
+
+  const D3D12_RASTERIZER_DESC& rast = desc.RasterizerState;
+  key.RasterizerState.FillMode = rast.FillMode;
+  key.RasterizerState.CullMode = rast.CullMode;
+  key.RasterizerState.FrontCounterClockwise = rast.FrontCounterClockwise;
+  key.RasterizerState.DepthBias = rast.DepthBias;
+  key.RasterizerState.DepthBiasClamp = rast.DepthBiasClamp;
+  key.RasterizerState.SlopeScaledDepthBias = rast.SlopeScaledDepthBias;
+  key.RasterizerState.DepthClipEnable = rast.DepthClipEnable;
+  key.RasterizerState.MultisampleEnable = rast.MultisampleEnable;
+  key.RasterizerState.AntialiasedLineEnable = rast.AntialiasedLineEnable;
+  key.RasterizerState.ForcedSampleCount = rast.ForcedSampleCount;
+  key.RasterizerState.ConservativeRaster = rast.ConservativeRaster;
+
+  const D3D12_DEPTH_STENCIL_DESC& ds = desc.DepthStencilState;
+  key.DepthStencilState.DepthEnable = ds.DepthEnable;
+  key.DepthStencilState.DepthWriteMask = ds.DepthWriteMask;
+  key.DepthStencilState.DepthFunc = ds.DepthFunc;
+  key.DepthStencilState.StencilEnable = ds.StencilEnable;
+  key.DepthStencilState.StencilReadMask = ds.StencilReadMask;
+  key.DepthStencilState.StencilWriteMask = ds.StencilWriteMask;
+  const auto toKeyStencilOp = [](const D3D12_DEPTH_STENCILOP_DESC& op) {
+    PipelineKey::StencilOp keyOp;
+    keyOp.StencilFailOp = op.StencilFailOp;
+    keyOp.StencilDepthFailOp = op.StencilDepthFailOp;
+    keyOp.StencilPassOp = op.StencilPassOp;
+    keyOp.StencilFunc = op.StencilFunc;
+    return keyOp;
+  };
+  key.DepthStencilState.FrontFace = toKeyStencilOp(ds.FrontFace);
+  key.DepthStencilState.BackFace = toKeyStencilOp(ds.BackFace);
+
+  for (UINT i = 0; i < desc.InputLayout.NumElements; ++i) {
+    const D3D12_INPUT_ELEMENT_DESC& element =
+        desc.InputLayout.pInputElementDescs[i];
+    PipelineKey::InputElement keyElement;
+    keyElement.SemanticName = element.SemanticName;
+    keyElement.SemanticIndex = element.SemanticIndex;
+    keyElement.Format = element.Format;
+    keyElement.InputSlot = element.InputSlot;
+    keyElement.AlignedByteOffset = element.AlignedByteOffset;
+    keyElement.InputSlotClass = element.InputSlotClass;
+    keyElement.InstanceDataStepRate = element.InstanceDataStepRate;
+    key.InputLayout.push_back(keyElement);
+  }
+
+  key.IBStripCutValue = desc.IBStripCutValue;
+  key.PrimitiveTopologyType = desc.PrimitiveTopologyType;
+  key.NumRenderTargets = desc.NumRenderTargets;
+  for (UINT i = 0; i < PipelineKey::kRenderTargetCount; ++i) {
+    key.RTVFormats[i] = desc.RTVFormats[i];
+  }
+  key.DSVFormat = desc.DSVFormat;
+  key.SampleCount = desc.SampleDesc.Count;
+  key.SampleQuality = desc.SampleDesc.Quality;
+  key.NodeMask = desc.NodeMask;
+  key.Flags = desc.Flags;
+  return key;
+}
+
+PipelineKey::ComputeDesc ToKeyDesc(
+    const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc,
+    uint64_t rootSignatureHash) {
+  PipelineKey::ComputeDesc key;
+  key.RootSignatureHash = rootSignatureHash;
+  key.CS = ToKeyShader(desc.CS);
+  key.NodeMask = desc.NodeMask;
+  key.Flags = desc.Flags;
+  return key;
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+}  // namespace
+
+void PipelineStateCache::Initialize(ID3D12Device* device,
+                                    const std::string& path) {
+  mDevice = device;
+  mPath = path;
+  if (FAILED(device->QueryInterface(IID_PPV_ARGS(&mDevice1)))) {
+    return;
+  }
+
+  const PipelineCacheIndex::AdapterIdentity adapter = QueryAdapterIdentity();
+  if (mIndex.Load(path, adapter)) {
+    const std::vector<uint8_t>& data = mIndex.GetLibraryData();
+    // Fails with D3D12_ERROR_DRIVER_VERSION_MISMATCH or
+    // D3D12_ERROR_ADAPTER_NOT_FOUND if the blob no longer fits this device.
+    if (FAILED(mDevice1->CreatePipelineLibrary(data.data(), data.size(),
+                                               IID_PPV_ARGS(&mLibrary)))) {
+      mLibrary.Reset();
+    }
+  }
+  if (mLibrary == nullptr) {
+    mIndex.Clear();
+    mIndex.SetAdapter(adapter);
+    // Not every driver implements pipeline libraries.
+    if (FAILED(mDevice1->CreatePipelineLibrary(nullptr, 0,
+                                               IID_PPV_ARGS(&mLibrary)))) {
+      mLibrary.Reset();
+    }
+  }
+}
+
+PipelineCacheIndex::AdapterIdentity PipelineStateCache::QueryAdapterIdentity()
+    const {
+  PipelineCacheIndex::AdapterIdentity identity;
+  ComPtr<IDXGIFactory4> factory;
+  ComPtr<IDXGIAdapter1> adapter;
+  if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))) ||
+      FAILED(factory->EnumAdapterByLuid(mDevice->GetAdapterLuid(),
+                                        IID_PPV_ARGS(&adapter)))) {
+    return identity;
+  }
+
+  DXGI_ADAPTER_DESC1 desc = {};
+  if (SUCCEEDED(adapter->GetDesc1(&desc))) {
+    identity.VendorId = desc.VendorId;
+    identity.DeviceId = desc.DeviceId;
+  }
+  // Querying IDXGIDevice support reports the user-mode driver version.
+  LARGE_INTEGER driverVersion = {};
+  if (SUCCEEDED(adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice),
+                                               &driverVersion))) {
+    identity.DriverVersion = static_cast<uint64_t>(driverVersion.QuadPart);
+  }
+  return identity;
+}
+
+void PipelineStateCache::RegisterRootSignature(
+    ID3D12RootSignature* rootSignature, ID3DBlob* serialized) {
+  mRootSignatureHashes[rootSignature] = PipelineKey::HashRootSignature(
+      serialized->GetBufferPointer(), serialized->GetBufferSize());
+}
+
+uint64_t PipelineStateCache::GetRootSignatureHash(
+    ID3D12RootSignature* rootSignature) const {
+  const auto it = mRootSignatureHashes.find(rootSignature);
+  if (it == mRootSignatureHashes.end()) {
+    throw std::runtime_error(
+        "Root signature is not registered with the pipeline cache");
+  }
+  return it->second;
+}
+
+uint64_t PipelineStateCache::ComputeGraphicsKey(
+    const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) const {
+  return PipelineKey::ComputeGraphics(
+      ToKeyDesc(desc, GetRootSignatureHash(desc.pRootSignature)));
+}
+
+uint64_t PipelineStateCache::ComputeComputeKey(
+    const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc) const {
+  return PipelineKey::ComputeCompute(
+      ToKeyDesc(desc, GetRootSignatureHash(desc.pRootSignature)));
+}
+
+void PipelineStateCache::CreateGraphicsPipelineState(
+    const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+    ComPtr<ID3D12PipelineState>& pso) {
+  const auto start = std::chrono::steady_clock::now();
+  if (mLibrary == nullptr) {
+    ThrowIfFailed(mDevice->CreateGraphicsPipelineState(&desc,
+                                                        IID_PPV_ARGS(&pso)));
+    ++mMisses;
+    mMilliseconds += ElapsedMs(start);
+    return;
+  }
+
+  const uint64_t key = ComputeGraphicsKey(desc);
+  const std::string name = PipelineCacheIndex::KeyToName(key);
+  const std::wstring wideName(name.begin(), name.end());
+  if (SUCCEEDED(mLibrary->LoadGraphicsPipeline(wideName.c_str(), &desc,
+                                               IID_PPV_ARGS(&pso)))) {
+    ++mHits;
+  } else {
+    ThrowIfFailed(mDevice->CreateGraphicsPipelineState(&desc,
+                                                        IID_PPV_ARGS(&pso)));
+    Store(key, wideName, pso.Get());
+    ++mMisses;
+  }
+  mPipelines[key] = pso;
+  mMilliseconds += ElapsedMs(start);
+}
+
+void PipelineStateCache::CreateComputePipelineState(
+    const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc,
+    ComPtr<ID3D12PipelineState>& pso) {
+  const auto start = std::chrono::steady_clock::now();
+  if (mLibrary == nullptr) {
+    ThrowIfFailed(mDevice->CreateComputePipelineState(&desc,
+                                                       IID_PPV_ARGS(&pso)));
+    ++mMisses;
+    mMilliseconds += ElapsedMs(start);
+    return;
+  }
+
+  const uint64_t key = ComputeComputeKey(desc);
+  const std::string name = PipelineCacheIndex::KeyToName(key);
+  const std::wstring wideName(name.begin(), name.end());
+  if (SUCCEEDED(mLibrary->LoadComputePipeline(wideName.c_str(), &desc,
+                                              IID_PPV_ARGS(&pso)))) {
+    ++mHits;
+  } else {
+    ThrowIfFailed(mDevice->CreateComputePipelineState(&desc,
+                                                       IID_PPV_ARGS(&pso)));
+    Store(key, wideName, pso.Get());
+    ++mMisses;
+  }
+  mPipelines[key] = pso;
+  mMilliseconds += ElapsedMs(start);
+}
+
+void PipelineStateCache::Store(uint64_t key, const std::wstring& name,
+                               ID3D12PipelineState* pso) {
+  // A name that is already taken means the stored pipeline no longer matches
+  // its description; the rebuild on save replaces it.
+  if (mPipelines.count(key) != 0 ||
+      FAILED(mLibrary->StorePipeline(name.c_str(), pso))) {
+    mNeedsRebuild = true;
+  }
+  mDirty = true;
+}
+
+void PipelineStateCache::Save() {
+  if (mLibrary == nullptr) {
+    return;
+  }
+  for (uint64_t key : mIndex.GetKeys()) {
+    if (mPipelines.count(key) == 0) {
+      mNeedsRebuild = true;
+      break;
+    }
+  }
+  if (!mDirty && !mNeedsRebuild) {
+    return;
+  }
+
+  if (mNeedsRebuild) {
+    ComPtr<ID3D12PipelineLibrary> library;
+    ThrowIfFailed(
+        mDevice1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&library)));
+    for (const auto& pipeline : mPipelines) {
+      const std::string name = PipelineCacheIndex::KeyToName(pipeline.first);
+      const std::wstring wideName(name.begin(), name.end());
+      ThrowIfFailed(
+          library->StorePipeline(wideName.c_str(), pipeline.second.Get()));
+    }
+    mLibrary = library;
+    mNeedsRebuild = false;
+  }
+
+  std::vector<uint8_t> data(mLibrary->GetSerializedSize());
+  ThrowIfFailed(mLibrary->Serialize(data.data(), data.size()));
+
+  std::vector<uint64_t> keys;
+  keys.reserve(mPipelines.size());
+  for (const auto& pipeline : mPipelines) {
+    keys.push_back(pipeline.first);
+  }
+
+  // The loaded bytes stay in mIndex while a library created from them may
+  // still be alive.
+  PipelineCacheIndex index;
+  index.SetAdapter(mIndex.GetAdapter());
+  index.SetKeys(std::move(keys));
+  index.SetLibraryData(std::move(data));
+  index.Save(mPath);
+  mDirty = false;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "Common.h"
+#include "PipelineCacheIndex.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Creates pipeline states through an ID3D12PipelineLibrary persisted next to
+// the executable. A pipeline is named by a hash of its description, the
+// serialized root signature and every shader's bytecode (see PipelineKey),
+// so recompiled shaders get a new name. The whole file is dropped when the adapter or
+// driver version changes. Without ID3D12Device1 support pipelines are
+// created directly.
+class PipelineStateCache {
+ public:
+  void Initialize(ID3D12Device* device, const std::string& path);
+
+  // Root signatures are identified by their serialized form; every root
+  // signature used in a description must be registered first.
+  void RegisterRootSignature(ID3D12RootSignature* rootSignature,
+                             ID3DBlob* serialized);
+
+  void CreateGraphicsPipelineState(
+      const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+      ComPtr<ID3D12PipelineState>& pso);
+  void CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc,
+                                  ComPtr<ID3D12PipelineState>& pso);
+
+  // Writes the library if pipelines were added or stale ones should be
+  // dropped. Stale entries are removed by rebuilding the library from the
+  // pipelines requested during this run.
+  void Save();
+
+  UINT GetHits() const { return mHits; }
+  UINT GetMisses() const { return mMisses; }
+  double GetMilliseconds() const { return mMilliseconds; }
+
+ private:
+  PipelineCacheIndex::AdapterIdentity QueryAdapterIdentity() const;
+  uint64_t GetRootSignatureHash(ID3D12RootSignature* rootSignature) const;
+  uint64_t ComputeGraphicsKey(
+      const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) const;
+  uint64_t ComputeComputeKey(
+      const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc) const;
+  void Store(uint64_t key, const std::wstring& name, ID3D12PipelineState* pso);
+
+  ID3D12Device* mDevice = nullptr;
+  ComPtr<ID3D12Device1> mDevice1;
+  ComPtr<ID3D12PipelineLibrary> mLibrary;
+  std::string mPath;
+  // Owns the bytes the library was created from; they must outlive it.
+  PipelineCacheIndex mIndex;
+
+  std::unordered_map<ID3D12RootSignature*, uint64_t> mRootSignatureHashes;
+  std::unordered_map<uint64_t, ComPtr<ID3D12PipelineState>> mPipelines;
+  bool mDirty = false;
+  bool mNeedsRebuild = false;
+
+  UINT mHits = 0;
+  UINT mMisses = 0;
+  double mMilliseconds = 0.0;
+};
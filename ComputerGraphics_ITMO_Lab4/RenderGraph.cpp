@@ -0,0 +1,212 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void RenderGraph::Reset() {
+  mResources.clear();
+  mPasses.clear();
+  mSubmitBoundaries.clear();
+  mPassBarriers.clear();
+  mFinalBarriers.clear();
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportResource(
+    const std::string& name, ResourceState initialState,
+    ResourceState finalState) {
+  Resource resource;
+  resource.Name = name;
+  resource.InitialState = initialState;
+  resource.FinalState = finalState;
+  mResources.push_back(resource);
+  return static_cast<ResourceHandle>(mResources.size() - 1);
+}
+
+uint32_t RenderGraph::AddPass(const std::string& name,
+                              const std::vector<Usage>& usages) {
+  for (size_t i = 0; i < usages.size(); ++i) {
+    if (usages[i].Resource >= mResources.size()) {
+      throw std::out_of_range("Pass '" + name + "' uses unknown resource");
+    }
+    for (size_t j = 0; j < i; ++j) {
+      if (usages[j].Resource == usages[i].Resource) {
+        throw std::invalid_argument("Pass '" + name + "' declares resource '" +
+                                    mResources[usages[i].Resource].Name +
+                                    "' twice");
+      }
+    }
+  }
+
+  Pass pass;
+  pass.Name = name;
+  pass.Usages = usages;
+  mPasses.push_back(pass);
+  return static_cast<uint32_t>(mPasses.size() - 1);
+}
+
+void RenderGraph::SetAliasedPredecessor(ResourceHandle resource,
+                                        ResourceHandle predecessor) {
+  if (resource >= mResources.size() || predecessor >= mResources.size()) {
+    throw std::out_of_range("Unknown render graph resource");
+  }
+  if (resource == predecessor) {
+    throw std::invalid_argument("Resource '" + mResources[resource].Name +
+                                "' cannot alias itself");
+  }
+  mResources[resource].AliasedPredecessor = predecessor;
+}
+
+void RenderGraph::SetNoSplitBarriers(ResourceHandle resource) {
+  if (resource >= mResources.size()) {
+    throw std::out_of_range("Unknown render graph resource");
+  }
+  mResources[resource].NoSplitBarriers = true;
+}
+
+void RenderGraph::AddSubmitBoundary() {
+  const uint32_t firstPass = static_cast<uint32_t>(mPasses.size());
+  if (mSubmitBoundaries.empty() || mSubmitBoundaries.back() != firstPass) {
+    mSubmitBoundaries.push_back(firstPass);
+  }
+}
+
+void RenderGraph::Compile(bool useSplitBarriers) {
+  mPassBarriers.assign(mPasses.size(), {});
+  mFinalBarriers.clear();
+  for (ResourceHandle handle = 0; handle < mResources.size(); ++handle) {
+    CompileResource(handle, useSplitBarriers);
+  }
+}
+
+void RenderGraph::CompileResource(ResourceHandle handle,
+                                  bool useSplitBarriers) {
+  std::vector<std::pair<uint32_t, ResourceState>> uses;
+  for (uint32_t passIndex = 0; passIndex < mPasses.size(); ++passIndex) {
+    for (const auto& usage : mPasses[passIndex].Usages) {
+      if (usage.Resource == handle) {
+        uses.emplace_back(passIndex, usage.State);
+      }
+    }
+  }
+
+  ResourceState current = mResources[handle].InitialState;
+  int lastUsePass = -1;
+  const ResourceHandle predecessor = mResources[handle].AliasedPredecessor;
+  if (predecessor != kNoResource && !uses.empty()) {
+    Barrier barrier;
+    barrier.Type = BarrierType::Aliasing;
+    barrier.Resource = handle;
+    barrier.AliasedResource = predecessor;
+    mPassBarriers[uses.front().first].push_back(barrier);
+    // The memory is not ours before the aliasing barrier, so the first
+    // transition cannot begin any earlier.
+    lastUsePass = static_cast<int>(uses.front().first) - 1;
+  }
+  for (size_t useIndex = 0; useIndex < uses.size(); ++useIndex) {
+    const uint32_t passIndex = uses[useIndex].first;
+    const ResourceState required = uses[useIndex].second;
+
+    if (IsReadOnlyState(required)) {
+      if (!IsReadOnlyState(current) || (required & ~current) != 0) {
+        // Consecutive reads are merged into one combined read state so the
+        // resource is transitioned once for all of them.
+        ResourceState merged = required;
+        for (size_t next = useIndex + 1;
+             next < uses.size() && IsReadOnlyState(uses[next].second);
+             ++next) {
+          merged |= uses[next].second;
+        }
+        AddTransition(handle, current, merged, lastUsePass, passIndex,
+                      useSplitBarriers);
+        current = merged;
+      }
+    } else if (current == required) {
+      if (required == kStateUnorderedAccess && useIndex > 0) {
+        Barrier barrier;
+        barrier.Type = BarrierType::Uav;
+        barrier.Resource = handle;
+        barrier.Before = current;
+        barrier.After = current;
+        mPassBarriers[passIndex].push_back(barrier);
+      }
+    } else {
+      AddTransition(handle, current, required, lastUsePass, passIndex,
+                    useSplitBarriers);
+      current = required;
+    }
+    lastUsePass = static_cast<int>(passIndex);
+  }
+
+  const ResourceState finalState = mResources[handle].FinalState;
+  if (current != finalState) {
+    Barrier barrier;
+    barrier.Resource = handle;
+    barrier.Before = current;
+    barrier.After = finalState;
+    mFinalBarriers.push_back(barrier);
+  }
+}
+
+void RenderGraph::AddTransition(ResourceHandle handle, ResourceState before,
+                                ResourceState after, int lastUsePass,
+                                uint32_t passIndex, bool useSplitBarriers) {
+  Barrier barrier;
+  barrier.Resource = handle;
+  barrier.Before = before;
+  barrier.After = after;
+
+  uint32_t beginPass = static_cast<uint32_t>(lastUsePass + 1);
+  for (uint32_t boundary : mSubmitBoundaries) {
+    if (boundary <= passIndex) {
+      beginPass = std::max(beginPass, boundary);
+    }
+  }
+  if (useSplitBarriers && !mResources[handle].NoSplitBarriers &&
+      beginPass < passIndex) {
+    barrier.Split = BarrierSplit::BeginOnly;
+    mPassBarriers[beginPass].push_back(barrier);
+    barrier.Split = BarrierSplit::EndOnly;
+  }
+  mPassBarriers[passIndex].push_back(barrier);
+}
+
+const std::vector<RenderGraph::Barrier>& RenderGraph::GetBarriersBeforePass(
+    uint32_t passIndex) const {
+  if (passIndex >= mPassBarriers.size()) {
+    throw std::out_of_range("RenderGraph pass index out of range");
+  }
+  return mPassBarriers[passIndex];
+}
+
+RenderGraph::ResourceState RenderGraph::GetFinalState(
+    ResourceHandle handle) const {
+  if (handle >= mResources.size()) {
+    throw std::out_of_range("Unknown render graph resource");
+  }
+  return mResources[handle].FinalState;
+}
+
+const std::string& RenderGraph::GetPassName(uint32_t passIndex) const {
+  if (passIndex >= mPasses.size()) {
+    throw std::out_of_range("RenderGraph pass index out of range");
+  }
+  return mPasses[passIndex].Name;
+}
+
+size_t RenderGraph::GetBarrierCount() const {
+  size_t count = mFinalBarriers.size();
+  for (const auto& batch : mPassBarriers) {
+    count += batch.size();
+  }
+  return count;
+}
+
+size_t RenderGraph::GetBatchCount() const {
+  size_t count = mFinalBarriers.empty() ? 0 : 1;
+  for (const auto& batch : mPassBarriers) {
+    if (!batch.empty()) {
+      ++count;
+    }
+  }
+  return count;
+}
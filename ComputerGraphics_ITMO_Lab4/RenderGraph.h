@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Frame-level pass list that derives resource state transitions from the
+// usages each pass declares. Compile() produces one batch of barriers per
+// pass (issued with a single ResourceBarrier call) plus a final batch that
+// returns resources to their expected end-of-frame state. State values use
+// the D3D12_RESOURCE_STATES bit layout, but the class itself does not
+// depend on D3D12.
+class RenderGraph {
+ public:
+  using ResourceHandle = uint32_t;
+  using ResourceState = uint32_t;
+  static constexpr ResourceHandle kNoResource = UINT32_MAX;
+
+  static constexpr ResourceState kStateCommon = 0x0;
+  static constexpr ResourceState kStateVertexAndConstantBuffer = 0x1;
+  static constexpr ResourceState kStateIndexBuffer = 0x2;
+  static constexpr ResourceState kStateRenderTarget = 0x4;
+  static constexpr ResourceState kStateUnorderedAccess = 0x8;
+  static constexpr ResourceState kStateDepthWrite = 0x10;
+  static constexpr ResourceState kStateDepthRead = 0x20;
+  static constexpr ResourceState kStateNonPixelShaderResource = 0x40;
+  static constexpr ResourceState kStatePixelShaderResource = 0x80;
+  static constexpr ResourceState kStateIndirectArgument = 0x200;
+  static constexpr ResourceState kStateCopyDest = 0x400;
+  static constexpr ResourceState kStateCopySource = 0x800;
+  static constexpr ResourceState kStatePresent = kStateCommon;
+  static constexpr ResourceState kReadOnlyStates =
+      kStateVertexAndConstantBuffer | kStateIndexBuffer | kStateDepthRead |
+      kStateNonPixelShaderResource | kStatePixelShaderResource |
+      kStateIndirectArgument | kStateCopySource;
+
+  enum class BarrierType { Transition, Uav, Aliasing };
+  enum class BarrierSplit { None, BeginOnly, EndOnly };
+
+  struct Barrier {
+    BarrierType Type = BarrierType::Transition;
+    BarrierSplit Split = BarrierSplit::None;
+    ResourceHandle Resource = 0;
+    ResourceState Before = kStateCommon;
+    ResourceState After = kStateCommon;
+    // For aliasing barriers, the resource that last used the memory that
+    // Resource is about to use.
+    ResourceHandle AliasedResource = kNoResource;
+  };
+
+  struct Usage {
+    ResourceHandle Resource = 0;
+    ResourceState State = kStateCommon;
+  };
+
+  void Reset();
+
+  ResourceHandle ImportResource(const std::string& name,
+                                ResourceState initialState,
+                                ResourceState finalState);
+  uint32_t AddPass(const std::string& name, const std::vector<Usage>& usages);
+  // resource is placed over memory that predecessor used earlier in the
+  // frame or in the previous one. An aliasing barrier is issued before the
+  // first pass that uses resource, ahead of its first transition, which is
+  // never split. Both resources should start and end the frame in their
+  // last-use state so that no barrier touches them while the other is live.
+  void SetAliasedPredecessor(ResourceHandle resource,
+                             ResourceHandle predecessor);
+  // Transitions of resource are never split. For resources another queue
+  // accesses during the frame: a split would leave the resource
+  // mid-transition while that queue reads or writes it.
+  void SetNoSplitBarriers(ResourceHandle resource);
+  // Passes added after this call are recorded in a command list that is
+  // submitted after the passes before it. No split barrier spans the
+  // boundary.
+  void AddSubmitBoundary();
+
+  // With split barriers enabled, a transition whose resource is idle for at
+  // least one pass is issued as BEGIN_ONLY right after its last use, or at
+  // the start of its submission if that is later, and END_ONLY right before
+  // its next use.
+  void Compile(bool useSplitBarriers);
+
+  const std::vector<Barrier>& GetBarriersBeforePass(uint32_t passIndex) const;
+  const std::vector<Barrier>& GetFinalBarriers() const {
+    return mFinalBarriers;
+  }
+  ResourceState GetFinalState(ResourceHandle handle) const;
+  size_t GetPassCount() const { return mPasses.size(); }
+  const std::string& GetPassName(uint32_t passIndex) const;
+
+  size_t GetBarrierCount() const;
+  size_t GetBatchCount() const;
+
+  static bool IsReadOnlyState(ResourceState state) {
+    return state != kStateCommon && (state & ~kReadOnlyStates) == 0;
+  }
+
+ private:
+  struct Resource {
+    std::string Name;
+    ResourceState InitialState = kStateCommon;
+    ResourceState FinalState = kStateCommon;
+    ResourceHandle AliasedPredecessor = kNoResource;
+    bool NoSplitBarriers = false;
+  };
+
+  struct Pass {
+    std::string Name;
+    std::vector<Usage> Usages;
+  };
+
+  void CompileResource(ResourceHandle handle, bool useSplitBarriers);
+  void AddTransition(ResourceHandle handle, ResourceState before,
+                     ResourceState after, int lastUsePass, uint32_t passIndex,
+                     bool useSplitBarriers);
+
+  std::vector<Resource> mResources;
+  std::vector<Pass> mPasses;
+  // First pass of each submission after the first, ascending.
+  std::vector<uint32_t> mSubmitBoundaries;
+  std::vector<std::vector<Barrier>> mPassBarriers;
+  std::vector<Barrier> mFinalBarriers;
+};
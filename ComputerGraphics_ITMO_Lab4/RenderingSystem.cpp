@@ -1,81 +1,299 @@
 #include "RenderingSystem.h"
 
-void RenderingSystem::Initialize(ID3D12Device* device, UINT width, UINT height,
-                                 ID3D12DescriptorHeap* rtvHeap,
-                                 ID3D12DescriptorHeap* cbvSrvHeap,
+#include <chrono>
+
+#include "ShaderManifest.h"
+
+static_assert(RenderGraph::kStateRenderTarget ==
+                  D3D12_RESOURCE_STATE_RENDER_TARGET &&
+              RenderGraph::kStateUnorderedAccess ==
+                  D3D12_RESOURCE_STATE_UNORDERED_ACCESS &&
+              RenderGraph::kStateDepthWrite ==
+                  D3D12_RESOURCE_STATE_DEPTH_WRITE &&
+              RenderGraph::kStateDepthRead == D3D12_RESOURCE_STATE_DEPTH_READ &&
+              RenderGraph::kStateNonPixelShaderResource ==
+                  D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE &&
+              RenderGraph::kStatePixelShaderResource ==
+                  D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE &&
+              RenderGraph::kStateIndirectArgument ==
+                  D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT &&
+              RenderGraph::kStateCopyDest == D3D12_RESOURCE_STATE_COPY_DEST &&
+              RenderGraph::kStateCopySource ==
+                  D3D12_RESOURCE_STATE_COPY_SOURCE &&
+              RenderGraph::kStatePresent == D3D12_RESOURCE_STATE_PRESENT,
+              "RenderGraph state bits must match D3D12_RESOURCE_STATES");
+
+namespace {
+// cbDraw of the geometry shaders, set as root constants. HLSL starts each
+// float4 on a 16-byte boundary.
+struct GeometryDrawConstants {
+  UINT ObjectIndex = 0;
+  UINT MaterialIndex = 0;
+  UINT Padding[2] = {};
+  // Bounds the packed vertex positions of the draw are quantized in.
+  DirectX::XMFLOAT4 PositionCenter = {};
+  DirectX::XMFLOAT4 PositionExtents = {};
+};
+constexpr UINT kGeometryDrawConstantCount =
+    sizeof(GeometryDrawConstants) / sizeof(UINT);
+
+// Planes of the clip volume of a row-vector view-projection matrix, with
+// normals pointing inside.
+void ExtractFrustumPlanes(const DirectX::SimpleMath::Matrix& viewProj,
+                          DirectX::SimpleMath::Vector4 planes[6]) {
+  const DirectX::SimpleMath::Vector4 column0(viewProj._11, viewProj._21,
+                                             viewProj._31, viewProj._41);
+  const DirectX::SimpleMath::Vector4 column1(viewProj._12, viewProj._22,
+                                             viewProj._32, viewProj._42);
+  const DirectX::SimpleMath::Vector4 column2(viewProj._13, viewProj._23,
+                                             viewProj._33, viewProj._43);
+  const DirectX::SimpleMath::Vector4 column3(viewProj._14, viewProj._24,
+                                             viewProj._34, viewProj._44);
+  planes[0] = column3 + column0;  // left
+  planes[1] = column3 - column0;  // right
+  planes[2] = column3 + column1;  // bottom
+  planes[3] = column3 - column1;  // top
+  planes[4] = column2;            // near, z >= 0 in D3D clip space
+  planes[5] = column3 - column2;  // far
+  for (int i = 0; i < 6; ++i) {
+    const float length =
+        DirectX::SimpleMath::Vector3(planes[i].x, planes[i].y, planes[i].z)
+            .Length();
+    planes[i] /= length;
+  }
+}
+}  // namespace
+
+// Tessellation only changes the output of displaced or wave-animated
+// surfaces; everything else is drawn with the plain VS/PS pipeline. The DS
+// samples no displacement map, so displacement only selects the tessellated
+// pipeline and is redundant next to waves.
+UINT RenderingSystem::GetGeometryPermutation(const SceneObject& object,
+                                             const Material* material) {
+  UINT permutation = 0;
+  if (object.WaveParams.x > 0.0f) {
+    permutation |= kGeometryWaves;
+  }
+  if (material != nullptr) {
+    const MaterialConstants& data = material->Data;
+    if (data.HasNormalMap > 0.5f) {
+      permutation |= kGeometryNormalMap;
+    }
+    if (data.HasRoughnessMap > 0.5f) {
+      permutation |= kGeometryRoughnessMap;
+    }
+    if (data.HasDisplacementMap > 0.5f && data.DisplacementScale != 0.0f &&
+        (permutation & kGeometryWaves) == 0) {
+      permutation |= kGeometryDisplacement;
+    }
+  }
+  return permutation;
+}
+
+void RenderingSystem::Initialize(ID3D12Device* device,
+                                 ID3D12CommandQueue* graphicsQueue, UINT width,
+                                 UINT height, ID3D12DescriptorHeap* rtvHeap,
+                                 DescriptorHeap* cbvSrvHeap,
                                  UINT rtvDescriptorSize,
-                                 UINT cbvSrvDescriptorSize) {
+                                 D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle,
+                                 const ModelGeometry& modelGeometry,
+                                 const std::vector<SceneObject>& sceneObjects) {
+  mPipelineCache.Initialize(device, kPipelineCachePath);
   BuildShaders();
   BuildInputLayout();
   BuildGeometryRootSignature(device);
   BuildComposeRootSignature(device);
   BuildParticlesComputeRootSignature(device);
   BuildParticlesRenderRootSignature(device);
-  BuildGeometryPSO(device);
+  BuildParticlesSortRootSignature(device);
+  BuildParticleDepthCopyRootSignature(device);
+  BuildParticleCompositeRootSignature(device);
+  // Only the permutations the scene uses are compiled up front; one that
+  // shows up later is built on its first draw.
+  for (const SceneObject& object : sceneObjects) {
+    for (UINT i = 0; i < object.SubmeshCount; ++i) {
+      const UINT submeshIndex = object.SubmeshStart + i;
+      if (submeshIndex >= modelGeometry.Submeshes.size()) {
+        break;
+      }
+      const UINT materialIndex =
+          modelGeometry.Submeshes[submeshIndex].MaterialIndex;
+      const Material* material =
+          materialIndex < modelGeometry.Materials.size()
+              ? &modelGeometry.Materials[materialIndex]
+              : nullptr;
+      BuildGeometryPermutation(device,
+                               GetGeometryPermutation(object, material));
+    }
+  }
   BuildComposePSO(device);
   BuildParticlesEmitPSO(device);
   BuildParticlesInitPSO(device);
   BuildParticlesSimulatePSO(device);
   BuildParticlesRenderPSO(device);
+  BuildParticlesSortPSOs(device);
+  BuildParticleDepthCopyPSO(device);
+  BuildParticleCompositePSO(device);
+  mPipelineCache.Save();
+  std::ostringstream psoMessage;
+  psoMessage << "PSOs: " << mPipelineCache.GetHits() << " from cache, "
+             << mPipelineCache.GetMisses() << " created, "
+             << mPipelineCache.GetMilliseconds() << " ms; "
+             << mGeometryPermutationsBuilt << " of "
+             << kGeometryPermutationCount << " geometry permutations used\n";
+  OutputDebugStringA(psoMessage.str().c_str());
+  BuildGeometryPassResources(device);
+
+  mWidth = width;
+  mHeight = height;
+  mCbvSrvHeap = cbvSrvHeap;
+  mGBuffer.Initialize(device, width, height, rtvHeap, mCbvSrvHeap,
+                      rtvDescriptorSize, kGBufferRtvStart, dsvHandle);
+  BuildParticleResources(device);
+  BuildParticleCollisionResources(device);
+  BuildAsyncCompute(device, graphicsQueue);
+}
+
+void RenderingSystem::BuildAsyncCompute(ID3D12Device* device,
+                                        ID3D12CommandQueue* graphicsQueue) {
+  D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+  queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+  queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+  ThrowIfFailed(
+      device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mComputeQueue)));
+  ThrowIfFailed(device->CreateCommandAllocator(
+      D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS(&mComputeAllocator)));
+  ThrowIfFailed(device->CreateCommandList(
+      0, D3D12_COMMAND_LIST_TYPE_COMPUTE, mComputeAllocator.Get(), nullptr,
+      IID_PPV_ARGS(&mComputeCommandList)));
+  ThrowIfFailed(mComputeCommandList->Close());
+
+  ThrowIfFailed(
+      graphicsQueue->GetTimestampFrequency(&mGraphicsTimestampFrequency));
+  ThrowIfFailed(
+      mComputeQueue->GetTimestampFrequency(&mComputeTimestampFrequency));
 
-  mGBuffer.Initialize(device, width, height, rtvHeap, cbvSrvHeap,
-                      rtvDescriptorSize, cbvSrvDescriptorSize, kGBufferRtvStart,
-                      kGBufferSrvStart);
-  BuildParticleResources(device, cbvSrvHeap, cbvSrvDescriptorSize);
+  mGraphicsQueueSync.Initialize(device, graphicsQueue);
+  mComputeQueueSync.Initialize(device, mComputeQueue.Get());
+  mAsyncComputeScheduler.Initialize(&mGraphicsQueueSync, &mComputeQueueSync);
 }
 
 void RenderingSystem::BuildShaders() {
+  const D3D_SHADER_MACRO* vsDefines =
+      kGeometryVSDefines[mPackedVertices ? 1 : 0];
   mGeometryVS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/DeferredGeometryVS.hlsl",
-      "VS", "vs_5_0");
-  mGeometryPS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/DeferredGeometryPS.hlsl",
-      "PS", "ps_5_0");
+      L"DeferredGeometryVS.hlsl", "VS", "vs_5_1", vsDefines);
+  mGeometryPlainVS = ShaderHelper::CompileShader(
+      L"DeferredGeometryVS.hlsl", "PlainVS", "vs_5_1", vsDefines);
   mGeometryHS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/DeferredGeometryHS.hlsl",
-      "HS", "hs_5_0");
-  mGeometryDS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/DeferredGeometryDS.hlsl",
-      "DS", "ds_5_0");
+      L"DeferredGeometryHS.hlsl", "HS", "hs_5_1");
   mComposeVS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/DeferredComposeVS.hlsl",
-      "VS", "vs_5_0");
+      L"DeferredComposeVS.hlsl", "VS", "vs_5_0");
   mComposePS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/DeferredComposePS.hlsl",
-      "PS", "ps_5_0");
+      L"DeferredComposePS.hlsl", "PS", "ps_5_0");
   mParticlesEmitCS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/ParticleEmitCS.hlsl",
-      "CS", "cs_5_0");
+      L"ParticleEmitCS.hlsl", "CS", "cs_5_0");
   mParticlesInitCS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/ParticleInitCS.hlsl",
-      "CS", "cs_5_0");
+      L"ParticleInitCS.hlsl", "CS", "cs_5_0");
   mParticlesSimulateCS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/ParticleSimulateCS.hlsl",
-      "CS", "cs_5_0");
+      L"ParticleSimulateCS.hlsl", "CS", "cs_5_0");
   mParticlesVS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/ParticleVS.hlsl",
-      "VS", "vs_5_0");
+      L"ParticleVS.hlsl", "VS", "vs_5_0");
   mParticlesGS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/ParticleGS.hlsl",
-      "GS", "gs_5_0");
+      L"ParticleGS.hlsl", "GS", "gs_5_0");
   mParticlesPS = ShaderHelper::CompileShader(
-      L"C:/Users/grish/source/repos/ComputerGraphics_ITMO_Lab4/"
-      L"ComputerGraphics_ITMO_Lab4/ParticlePS.hlsl",
-      "PS", "ps_5_0");
+      L"ParticlePS.hlsl", "PS", "ps_5_0");
+  mParticleCompositePS = ShaderHelper::CompileShader(
+      L"ParticleCompositePS.hlsl", "PS", "ps_5_0");
+  mParticlesSortKeysCS = ShaderHelper::CompileShader(
+      L"ParticleSortCS.hlsl", "BuildKeysCS", "cs_5_0");
+  mParticlesPreSortCS = ShaderHelper::CompileShader(
+      L"ParticleSortCS.hlsl", "PreSortCS", "cs_5_0");
+  mParticlesSortGlobalStepCS = ShaderHelper::CompileShader(
+      L"ParticleSortCS.hlsl", "GlobalStepCS", "cs_5_0");
+  mParticlesSortLocalStepCS = ShaderHelper::CompileShader(
+      L"ParticleSortCS.hlsl", "LocalStepCS", "cs_5_0");
+  mParticlesSortWriteBackCS = ShaderHelper::CompileShader(
+      L"ParticleSortCS.hlsl", "WriteBackCS", "cs_5_0");
+  mParticleDepthCopyCS = ShaderHelper::CompileShader(
+      L"ParticleDepthCopyCS.hlsl", "CS", "cs_5_0");
+}
+
+void RenderingSystem::BuildGeometryPassResources(ID3D12Device* device) {
+  mGeometryPassCB = std::make_unique<UploadBuffer<GeometryPassConstants>>(
+      device, 1, true);
+
+  D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+  queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_PIPELINE_STATISTICS;
+  queryHeapDesc.Count = 1;
+  ThrowIfFailed(device->CreateQueryHeap(&queryHeapDesc,
+                                        IID_PPV_ARGS(&mGeometryStatsHeap)));
+  const CD3DX12_HEAP_PROPERTIES readbackHeapProps(D3D12_HEAP_TYPE_READBACK);
+  const CD3DX12_RESOURCE_DESC statsDesc = CD3DX12_RESOURCE_DESC::Buffer(
+      sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS));
+  ThrowIfFailed(device->CreateCommittedResource(
+      &readbackHeapProps, D3D12_HEAP_FLAG_NONE, &statsDesc,
+      D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+      IID_PPV_ARGS(&mGeometryStatsReadback)));
+}
+
+void RenderingSystem::ReadGeometryStatistics() {
+  // The previous frame has completed: Draw flushes the queue.
+  if (!mGeometryStatsPending) {
+    return;
+  }
+  mGeometryStatsPending = false;
+
+  D3D12_QUERY_DATA_PIPELINE_STATISTICS* stats = nullptr;
+  const D3D12_RANGE readRange = {0,
+                                 sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS)};
+  ThrowIfFailed(mGeometryStatsReadback->Map(
+      0, &readRange, reinterpret_cast<void**>(&stats)));
+  mHsInvocationsAccum += stats->HSInvocations;
+  mDsInvocationsAccum += stats->DSInvocations;
+  const D3D12_RANGE writeRange = {0, 0};
+  mGeometryStatsReadback->Unmap(0, &writeRange);
+
+  if (++mGeometryStatsSamples < kGeometryStatsWindow) {
+    return;
+  }
+  std::ostringstream message;
+  message << "Geometry: patch culling "
+          << (mPatchCullingEnabled ? "on" : "off") << ", HS invocations "
+          << mHsInvocationsAccum / mGeometryStatsSamples
+          << ", DS invocations "
+          << mDsInvocationsAccum / mGeometryStatsSamples
+          << " per frame; last frame "
+          << mGeometryDraws.size() - mTessellatedGeometryDrawCount
+          << " plain and " << mTessellatedGeometryDrawCount
+          << " tessellated draws in " << mGeometryPipelineSwitches
+          << " PSO groups; PSO selection "
+          << (mGeometrySelectionDrawsAccum > 0
+                  ? mGeometrySelectionMsAccum * 1000.0 /
+                        mGeometrySelectionDrawsAccum
+                  : 0.0)
+          << " us per draw\n";
+  OutputDebugStringA(message.str().c_str());
+  mHsInvocationsAccum = 0;
+  mDsInvocationsAccum = 0;
+  mGeometryStatsSamples = 0;
+  mGeometrySelectionMsAccum = 0.0;
+  mGeometrySelectionDrawsAccum = 0;
 }
 
 void RenderingSystem::BuildInputLayout() {
+  if (mPackedVertices) {
+    // PackedVertex; the VS decodes it.
+    mInputLayout = {{"POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0,
+                     D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+                    {"NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8,
+                     D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+                    {"TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12,
+                     D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+                    {"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 16,
+                     D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}};
+    return;
+  }
   mInputLayout = {{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
                    D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
                   {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12,
@@ -91,36 +309,34 @@ void RenderingSystem::BuildInputLayout() {
 }
 
 void RenderingSystem::BuildGeometryRootSignature(ID3D12Device* device) {
-  CD3DX12_ROOT_PARAMETER params[7];
-
-  CD3DX12_DESCRIPTOR_RANGE cbvTable0;
-  cbvTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
-  params[0].InitAsDescriptorTable(1, &cbvTable0);
-
-  CD3DX12_DESCRIPTOR_RANGE diffuseSrvTable;
-  diffuseSrvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
-  params[1].InitAsDescriptorTable(1, &diffuseSrvTable);
-
-  CD3DX12_DESCRIPTOR_RANGE normalSrvTable;
-  normalSrvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
-  params[2].InitAsDescriptorTable(1, &normalSrvTable);
-
-  CD3DX12_DESCRIPTOR_RANGE displacementSrvTable;
-  displacementSrvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2);
-  params[3].InitAsDescriptorTable(1, &displacementSrvTable);
-
-  CD3DX12_DESCRIPTOR_RANGE roughnessSrvTable;
-  roughnessSrvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3);
-  params[4].InitAsDescriptorTable(1, &roughnessSrvTable);
+  // Bindless: a draw only sets its object and material index; everything
+  // else is bound once per pass.
+  CD3DX12_ROOT_PARAMETER params[6];
+  params[0].InitAsConstants(kGeometryDrawConstantCount, 0);
+
+  // Every material texture, indexed by MaterialConstants::*MapIndex. Tier 1
+  // limits a table to 128 SRVs, so the unbounded range needs tier 2.
+  D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+  ThrowIfFailed(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS,
+                                            &options, sizeof(options)));
+  if (options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_2) {
+    throw std::runtime_error("Bindless textures need resource binding tier 2");
+  }
+  CD3DX12_DESCRIPTOR_RANGE textureSrvTable;
+  textureSrvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 1);
+  params[1].InitAsDescriptorTable(1, &textureSrvTable,
+                                  D3D12_SHADER_VISIBILITY_PIXEL);
 
   CD3DX12_DESCRIPTOR_RANGE samplerTable;
   samplerTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, 0);
-  params[5].InitAsDescriptorTable(1, &samplerTable);
+  params[2].InitAsDescriptorTable(1, &samplerTable);
 
-  params[6].InitAsConstantBufferView(2);
+  params[3].InitAsShaderResourceView(0);  // objects
+  params[4].InitAsShaderResourceView(1);  // materials
+  params[5].InitAsConstantBufferView(1);
 
   CD3DX12_ROOT_SIGNATURE_DESC desc(
-      7, params, 0, nullptr,
+      6, params, 0, nullptr,
       D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
   ComPtr<ID3DBlob> serialized;
@@ -130,6 +346,8 @@ void RenderingSystem::BuildGeometryRootSignature(ID3D12Device* device) {
   ThrowIfFailed(device->CreateRootSignature(
       0, serialized->GetBufferPointer(), serialized->GetBufferSize(),
       IID_PPV_ARGS(&mGeometryRootSignature)));
+  mPipelineCache.RegisterRootSignature(mGeometryRootSignature.Get(),
+                                       serialized.Get());
 }
 
 void RenderingSystem::BuildComposeRootSignature(ID3D12Device* device) {
@@ -156,10 +374,12 @@ void RenderingSystem::BuildComposeRootSignature(ID3D12Device* device) {
   ThrowIfFailed(device->CreateRootSignature(
       0, serialized->GetBufferPointer(), serialized->GetBufferSize(),
       IID_PPV_ARGS(&mComposeRootSignature)));
+  mPipelineCache.RegisterRootSignature(mComposeRootSignature.Get(),
+                                       serialized.Get());
 }
 
 void RenderingSystem::BuildParticlesComputeRootSignature(ID3D12Device* device) {
-  CD3DX12_ROOT_PARAMETER params[4];
+  CD3DX12_ROOT_PARAMETER params[8];
   CD3DX12_DESCRIPTOR_RANGE particlePoolUavRange;
   particlePoolUavRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
   params[0].InitAsDescriptorTable(1, &particlePoolUavRange);  // u0
@@ -174,7 +394,18 @@ void RenderingSystem::BuildParticlesComputeRootSignature(ID3D12Device* device) {
 
   params[3].InitAsConstantBufferView(0);  // b0
 
-  CD3DX12_ROOT_SIGNATURE_DESC desc(4, params, 0, nullptr,
+  CD3DX12_DESCRIPTOR_RANGE aliveAppendUavRange;
+  aliveAppendUavRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 3);
+  params[4].InitAsDescriptorTable(1, &aliveAppendUavRange);  // u3
+
+  params[5].InitAsShaderResourceView(0);  // t0, emitter records
+  params[6].InitAsShaderResourceView(1);  // t1, dead list count snapshot
+
+  CD3DX12_DESCRIPTOR_RANGE collisionDepthSrvRange;
+  collisionDepthSrvRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2);
+  params[7].InitAsDescriptorTable(1, &collisionDepthSrvRange);  // t2
+
+  CD3DX12_ROOT_SIGNATURE_DESC desc(8, params, 0, nullptr,
                                    D3D12_ROOT_SIGNATURE_FLAG_NONE);
 
   ComPtr<ID3DBlob> serialized;
@@ -184,15 +415,18 @@ void RenderingSystem::BuildParticlesComputeRootSignature(ID3D12Device* device) {
   ThrowIfFailed(device->CreateRootSignature(
       0, serialized->GetBufferPointer(), serialized->GetBufferSize(),
       IID_PPV_ARGS(&mParticlesComputeRootSignature)));
+  mPipelineCache.RegisterRootSignature(mParticlesComputeRootSignature.Get(),
+                                       serialized.Get());
 }
 
 void RenderingSystem::BuildParticlesRenderRootSignature(ID3D12Device* device) {
-  CD3DX12_ROOT_PARAMETER params[2];
+  CD3DX12_ROOT_PARAMETER params[3];
   params[0].InitAsShaderResourceView(0);
   params[1].InitAsConstantBufferView(0);
+  params[2].InitAsShaderResourceView(1);
 
   CD3DX12_ROOT_SIGNATURE_DESC desc(
-      2, params, 0, nullptr,
+      3, params, 0, nullptr,
       D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
   ComPtr<ID3DBlob> serialized;
@@ -202,21 +436,124 @@ void RenderingSystem::BuildParticlesRenderRootSignature(ID3D12Device* device) {
   ThrowIfFailed(device->CreateRootSignature(
       0, serialized->GetBufferPointer(), serialized->GetBufferSize(),
       IID_PPV_ARGS(&mParticlesRenderRootSignature)));
+  mPipelineCache.RegisterRootSignature(mParticlesRenderRootSignature.Get(),
+                                       serialized.Get());
 }
 
-void RenderingSystem::BuildGeometryPSO(ID3D12Device* device) {
+void RenderingSystem::BuildParticlesSortRootSignature(ID3D12Device* device) {
+  CD3DX12_ROOT_PARAMETER params[6];
+  params[0].InitAsConstants(4, 0);  // b0, count / k / j
+  params[1].InitAsConstantBufferView(1);  // b1, render constants
+  params[2].InitAsUnorderedAccessView(0);  // u0, sort entries
+  params[3].InitAsUnorderedAccessView(1);  // u1, alive list
+  params[4].InitAsUnorderedAccessView(2);  // u2, draw args (alive count)
+  params[5].InitAsUnorderedAccessView(3);  // u3, particle pool
+
+  CD3DX12_ROOT_SIGNATURE_DESC desc(6, params, 0, nullptr,
+                                   D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+  ComPtr<ID3DBlob> serialized;
+  ComPtr<ID3DBlob> error;
+  ThrowIfFailed(D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1,
+                                            &serialized, &error));
+  ThrowIfFailed(device->CreateRootSignature(
+      0, serialized->GetBufferPointer(), serialized->GetBufferSize(),
+      IID_PPV_ARGS(&mParticlesSortRootSignature)));
+  mPipelineCache.RegisterRootSignature(mParticlesSortRootSignature.Get(),
+                                       serialized.Get());
+}
+
+void RenderingSystem::BuildParticleDepthCopyRootSignature(
+    ID3D12Device* device) {
+  CD3DX12_ROOT_PARAMETER params[2];
+  CD3DX12_DESCRIPTOR_RANGE sceneDepthSrvRange;
+  sceneDepthSrvRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+  params[0].InitAsDescriptorTable(1, &sceneDepthSrvRange);  // t0
+
+  CD3DX12_DESCRIPTOR_RANGE collisionDepthUavRange;
+  collisionDepthUavRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+  params[1].InitAsDescriptorTable(1, &collisionDepthUavRange);  // u0
+
+  CD3DX12_ROOT_SIGNATURE_DESC desc(2, params, 0, nullptr,
+                                   D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+  ComPtr<ID3DBlob> serialized;
+  ComPtr<ID3DBlob> error;
+  ThrowIfFailed(D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1,
+                                            &serialized, &error));
+  ThrowIfFailed(device->CreateRootSignature(
+      0, serialized->GetBufferPointer(), serialized->GetBufferSize(),
+      IID_PPV_ARGS(&mParticleDepthCopyRootSignature)));
+  mPipelineCache.RegisterRootSignature(mParticleDepthCopyRootSignature.Get(),
+                                       serialized.Get());
+}
+
+void RenderingSystem::BuildParticleCompositeRootSignature(
+    ID3D12Device* device) {
+  CD3DX12_ROOT_PARAMETER params[1];
+
+  CD3DX12_DESCRIPTOR_RANGE particleSrvTable;
+  particleSrvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+  params[0].InitAsDescriptorTable(1, &particleSrvTable,
+                                  D3D12_SHADER_VISIBILITY_PIXEL);
+
+  CD3DX12_ROOT_SIGNATURE_DESC desc(1, params, 0, nullptr,
+                                   D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+  ComPtr<ID3DBlob> serialized;
+  ComPtr<ID3DBlob> error;
+  ThrowIfFailed(D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1,
+                                            &serialized, &error));
+  ThrowIfFailed(device->CreateRootSignature(
+      0, serialized->GetBufferPointer(), serialized->GetBufferSize(),
+      IID_PPV_ARGS(&mParticleCompositeRootSignature)));
+  mPipelineCache.RegisterRootSignature(mParticleCompositeRootSignature.Get(),
+                                       serialized.Get());
+}
+
+void RenderingSystem::BuildGeometryPermutation(ID3D12Device* device,
+                                               UINT permutation) {
+  if (mGeometryPSOs[permutation] != nullptr) {
+    return;
+  }
+  const bool tessellated = (permutation & kGeometryTessellatedFeatures) != 0;
+
+  const UINT psVariant =
+      permutation & (kGeometryNormalMap | kGeometryRoughnessMap);
+  if (mGeometryPSVariants[psVariant] == nullptr) {
+    mGeometryPSVariants[psVariant] = ShaderHelper::CompileShader(
+        L"DeferredGeometryPS.hlsl", "PS", "ps_5_1",
+        kGeometryPSDefines[psVariant]);
+  }
+  const UINT dsVariant = (permutation & kGeometryWaves) != 0 ? 1 : 0;
+  if (tessellated && mGeometryDSVariants[dsVariant] == nullptr) {
+    mGeometryDSVariants[dsVariant] = ShaderHelper::CompileShader(
+        L"DeferredGeometryDS.hlsl", "DS", "ds_5_1",
+        kGeometryDSDefines[dsVariant]);
+  }
+
   D3D12_GRAPHICS_PIPELINE_STATE_DESC pso = {};
   pso.InputLayout = {mInputLayout.data(),
                      static_cast<UINT>(mInputLayout.size())};
   pso.pRootSignature = mGeometryRootSignature.Get();
-  pso.VS = {reinterpret_cast<BYTE*>(mGeometryVS->GetBufferPointer()),
-            mGeometryVS->GetBufferSize()};
-  pso.PS = {reinterpret_cast<BYTE*>(mGeometryPS->GetBufferPointer()),
-            mGeometryPS->GetBufferSize()};
-  pso.HS = {reinterpret_cast<BYTE*>(mGeometryHS->GetBufferPointer()),
-            mGeometryHS->GetBufferSize()};
-  pso.DS = {reinterpret_cast<BYTE*>(mGeometryDS->GetBufferPointer()),
-            mGeometryDS->GetBufferSize()};
+  ID3DBlob* ps = mGeometryPSVariants[psVariant].Get();
+  pso.PS = {reinterpret_cast<BYTE*>(ps->GetBufferPointer()),
+            ps->GetBufferSize()};
+  if (tessellated) {
+    ID3DBlob* ds = mGeometryDSVariants[dsVariant].Get();
+    pso.VS = {reinterpret_cast<BYTE*>(mGeometryVS->GetBufferPointer()),
+              mGeometryVS->GetBufferSize()};
+    pso.HS = {reinterpret_cast<BYTE*>(mGeometryHS->GetBufferPointer()),
+              mGeometryHS->GetBufferSize()};
+    pso.DS = {reinterpret_cast<BYTE*>(ds->GetBufferPointer()),
+              ds->GetBufferSize()};
+    pso.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_PATCH;
+  } else {
+    // Surfaces that tessellation does not change skip HS/DS entirely.
+    pso.VS = {reinterpret_cast<BYTE*>(mGeometryPlainVS->GetBufferPointer()),
+              mGeometryPlainVS->GetBufferSize()};
+    pso.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+  }
 
   CD3DX12_RASTERIZER_DESC rast(D3D12_DEFAULT);
   rast.CullMode = D3D12_CULL_MODE_NONE;
@@ -224,15 +561,14 @@ void RenderingSystem::BuildGeometryPSO(ID3D12Device* device) {
   pso.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
   pso.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
   pso.SampleMask = UINT_MAX;
-  pso.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_PATCH;
   pso.NumRenderTargets = 2;
   pso.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
   pso.RTVFormats[1] = DXGI_FORMAT_R16G16B16A16_FLOAT;
   pso.DSVFormat = DepthStencilFormat;
   pso.SampleDesc.Count = 1;
 
-  ThrowIfFailed(
-      device->CreateGraphicsPipelineState(&pso, IID_PPV_ARGS(&mGeometryPSO)));
+  mPipelineCache.CreateGraphicsPipelineState(pso, mGeometryPSOs[permutation]);
+  ++mGeometryPermutationsBuilt;
 }
 
 void RenderingSystem::BuildComposePSO(ID3D12Device* device) {
@@ -261,8 +597,7 @@ void RenderingSystem::BuildComposePSO(ID3D12Device* device) {
   pso.DSVFormat = DepthStencilFormat;
   pso.SampleDesc.Count = 1;
 
-  ThrowIfFailed(
-      device->CreateGraphicsPipelineState(&pso, IID_PPV_ARGS(&mComposePSO)));
+  mPipelineCache.CreateGraphicsPipelineState(pso, mComposePSO);
 }
 
 void RenderingSystem::BuildParticlesEmitPSO(ID3D12Device* device) {
@@ -270,8 +605,7 @@ void RenderingSystem::BuildParticlesEmitPSO(ID3D12Device* device) {
   desc.pRootSignature = mParticlesComputeRootSignature.Get();
   desc.CS = {reinterpret_cast<BYTE*>(mParticlesEmitCS->GetBufferPointer()),
              mParticlesEmitCS->GetBufferSize()};
-  ThrowIfFailed(device->CreateComputePipelineState(
-      &desc, IID_PPV_ARGS(&mParticlesEmitPSO)));
+  mPipelineCache.CreateComputePipelineState(desc, mParticlesEmitPSO);
 }
 
 void RenderingSystem::BuildParticlesSimulatePSO(ID3D12Device* device) {
@@ -279,8 +613,7 @@ void RenderingSystem::BuildParticlesSimulatePSO(ID3D12Device* device) {
   desc.pRootSignature = mParticlesComputeRootSignature.Get();
   desc.CS = {reinterpret_cast<BYTE*>(mParticlesSimulateCS->GetBufferPointer()),
              mParticlesSimulateCS->GetBufferSize()};
-  ThrowIfFailed(device->CreateComputePipelineState(
-      &desc, IID_PPV_ARGS(&mParticlesSimulatePSO)));
+  mPipelineCache.CreateComputePipelineState(desc, mParticlesSimulatePSO);
 }
 
 void RenderingSystem::BuildParticlesInitPSO(ID3D12Device* device) {
@@ -288,8 +621,7 @@ void RenderingSystem::BuildParticlesInitPSO(ID3D12Device* device) {
   desc.pRootSignature = mParticlesComputeRootSignature.Get();
   desc.CS = {reinterpret_cast<BYTE*>(mParticlesInitCS->GetBufferPointer()),
              mParticlesInitCS->GetBufferSize()};
-  ThrowIfFailed(device->CreateComputePipelineState(
-      &desc, IID_PPV_ARGS(&mParticlesInitPSO)));
+  mPipelineCache.CreateComputePipelineState(desc, mParticlesInitPSO);
 }
 
 void RenderingSystem::BuildParticlesRenderPSO(ID3D12Device* device) {
@@ -311,21 +643,102 @@ void RenderingSystem::BuildParticlesRenderPSO(ID3D12Device* device) {
   pso.SampleMask = UINT_MAX;
   pso.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT;
   pso.NumRenderTargets = 1;
-  pso.RTVFormats[0] = BackBufferFormat;
+  pso.RTVFormats[0] = GBuffer::kParticleColorFormat;
   pso.DSVFormat = DepthStencilFormat;
   pso.SampleDesc.Count = 1;
 
-  ThrowIfFailed(device->CreateGraphicsPipelineState(
-      &pso, IID_PPV_ARGS(&mParticlesRenderPSO)));
+  mPipelineCache.CreateGraphicsPipelineState(pso, mParticlesRenderPSO);
+
+  // Depth-sorted particles are drawn back to front with alpha blending. The
+  // cleared target accumulates premultiplied color and coverage.
+  D3D12_RENDER_TARGET_BLEND_DESC& blend = pso.BlendState.RenderTarget[0];
+  blend.BlendEnable = TRUE;
+  blend.SrcBlend = D3D12_BLEND_SRC_ALPHA;
+  blend.DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+  blend.BlendOp = D3D12_BLEND_OP_ADD;
+  blend.SrcBlendAlpha = D3D12_BLEND_ONE;
+  blend.DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA;
+  blend.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+  mPipelineCache.CreateGraphicsPipelineState(pso, mParticlesRenderBlendedPSO);
+
+  D3D12_INDIRECT_ARGUMENT_DESC drawArgument = {};
+  drawArgument.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+  D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+  signatureDesc.ByteStride = sizeof(D3D12_DRAW_ARGUMENTS);
+  signatureDesc.NumArgumentDescs = 1;
+  signatureDesc.pArgumentDescs = &drawArgument;
+  ThrowIfFailed(device->CreateCommandSignature(
+      &signatureDesc, nullptr, IID_PPV_ARGS(&mParticlesDrawSignature)));
+}
+
+void RenderingSystem::BuildParticlesSortPSOs(ID3D12Device* device) {
+  auto buildPSO = [&](ID3DBlob* shader, ComPtr<ID3D12PipelineState>& pso) {
+    D3D12_COMPUTE_PIPELINE_STATE_DESC desc = {};
+    desc.pRootSignature = mParticlesSortRootSignature.Get();
+    desc.CS = {reinterpret_cast<BYTE*>(shader->GetBufferPointer()),
+               shader->GetBufferSize()};
+    mPipelineCache.CreateComputePipelineState(desc, pso);
+  };
+  buildPSO(mParticlesSortKeysCS.Get(), mParticlesSortKeysPSO);
+  buildPSO(mParticlesPreSortCS.Get(), mParticlesPreSortPSO);
+  buildPSO(mParticlesSortGlobalStepCS.Get(), mParticlesSortGlobalStepPSO);
+  buildPSO(mParticlesSortLocalStepCS.Get(), mParticlesSortLocalStepPSO);
+  buildPSO(mParticlesSortWriteBackCS.Get(), mParticlesSortWriteBackPSO);
+}
+
+void RenderingSystem::BuildParticleDepthCopyPSO(ID3D12Device* device) {
+  D3D12_COMPUTE_PIPELINE_STATE_DESC desc = {};
+  desc.pRootSignature = mParticleDepthCopyRootSignature.Get();
+  desc.CS = {reinterpret_cast<BYTE*>(mParticleDepthCopyCS->GetBufferPointer()),
+             mParticleDepthCopyCS->GetBufferSize()};
+  mPipelineCache.CreateComputePipelineState(desc, mParticleDepthCopyPSO);
+}
+
+void RenderingSystem::BuildParticleCompositePSO(ID3D12Device* device) {
+  D3D12_GRAPHICS_PIPELINE_STATE_DESC pso = {};
+  pso.InputLayout = {nullptr, 0};
+  pso.pRootSignature = mParticleCompositeRootSignature.Get();
+  pso.VS = {reinterpret_cast<BYTE*>(mComposeVS->GetBufferPointer()),
+            mComposeVS->GetBufferSize()};
+  pso.PS = {reinterpret_cast<BYTE*>(mParticleCompositePS->GetBufferPointer()),
+            mParticleCompositePS->GetBufferSize()};
+
+  CD3DX12_RASTERIZER_DESC rast(D3D12_DEFAULT);
+  rast.CullMode = D3D12_CULL_MODE_NONE;
+  pso.RasterizerState = rast;
+  pso.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+  D3D12_RENDER_TARGET_BLEND_DESC& blend = pso.BlendState.RenderTarget[0];
+  blend.BlendEnable = TRUE;
+  blend.SrcBlend = D3D12_BLEND_ONE;
+  blend.DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+  blend.BlendOp = D3D12_BLEND_OP_ADD;
+  blend.SrcBlendAlpha = D3D12_BLEND_ZERO;
+  blend.DestBlendAlpha = D3D12_BLEND_ONE;
+  blend.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+
+  auto depthState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+  depthState.DepthEnable = false;
+  depthState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+  pso.DepthStencilState = depthState;
+
+  pso.SampleMask = UINT_MAX;
+  pso.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+  pso.NumRenderTargets = 1;
+  pso.RTVFormats[0] = BackBufferFormat;
+  pso.DSVFormat = DXGI_FORMAT_UNKNOWN;
+  pso.SampleDesc.Count = 1;
+
+  mPipelineCache.CreateGraphicsPipelineState(pso, mParticleCompositePSO);
 }
 
-void RenderingSystem::BuildParticleResources(ID3D12Device* device,
-                                             ID3D12DescriptorHeap* cbvSrvHeap,
-                                             UINT cbvSrvDescriptorSize) {
+void RenderingSystem::BuildParticleResources(ID3D12Device* device) {
   const UINT particleStride = sizeof(ParticleGpuData);
   const UINT deadListStride = sizeof(UINT);
-  const UINT particlePoolSize = kParticleMaxCount * particleStride;
-  const UINT deadListSize = kParticleMaxCount * deadListStride;
+  const UINT64 particlePoolSize =
+      static_cast<UINT64>(mParticleCapacity) * particleStride;
+  const UINT64 deadListSize =
+      static_cast<UINT64>(mParticleCapacity) * deadListStride;
+  const UINT64 aliveListSize = deadListSize;
 
   auto createDefaultBuffer =
       [&](UINT64 size, D3D12_RESOURCE_STATES initialState,
@@ -343,16 +756,32 @@ void RenderingSystem::BuildParticleResources(ID3D12Device* device,
                       mParticlePoolBuffer);
   createDefaultBuffer(deadListSize, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
                       D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-                      mDeadListABuffer);
-  createDefaultBuffer(deadListSize, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-                      D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-                      mDeadListBBuffer);
+                      mDeadListBuffer);
   createDefaultBuffer(sizeof(UINT), D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
                       D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-                      mDeadListACounterBuffer);
-  createDefaultBuffer(sizeof(UINT), D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                      mDeadListCounterBuffer);
+  createDefaultBuffer(sizeof(UINT),
+                      D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                      D3D12_RESOURCE_FLAG_NONE, mDeadCountSnapshotBuffer);
+
+  // Bitonic sort needs a power-of-two key count of at least one block.
+  mParticleSortCount = kParticleLocalSortSize;
+  while (mParticleSortCount < mParticleCapacity) {
+    mParticleSortCount <<= 1;
+  }
+  createDefaultBuffer(static_cast<UINT64>(mParticleSortCount) * 2 *
+                          sizeof(UINT),
+                      D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                      D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+                      mParticleSortBuffer);
+  createDefaultBuffer(aliveListSize, D3D12_RESOURCE_STATE_COMMON,
+                      D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+                      mAliveListBuffer);
+  // The alive list's UAV counter sits in the VertexCountPerInstance field of
+  // a D3D12_DRAW_ARGUMENTS record, so the buffer feeds ExecuteIndirect as is.
+  createDefaultBuffer(sizeof(D3D12_DRAW_ARGUMENTS), D3D12_RESOURCE_STATE_COMMON,
                       D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-                      mDeadListBCounterBuffer);
+                      mParticleDrawArgsBuffer);
 
   const CD3DX12_HEAP_PROPERTIES uploadHeapProps(D3D12_HEAP_TYPE_UPLOAD);
   const CD3DX12_RESOURCE_DESC simCbDesc =
@@ -383,33 +812,71 @@ void RenderingSystem::BuildParticleResources(ID3D12Device* device,
   mappedCounterReset[0] = 0u;
   mParticleCounterResetBuffer->Unmap(0, nullptr);
 
-  CD3DX12_CPU_DESCRIPTOR_HANDLE cpuStart(
-      cbvSrvHeap->GetCPUDescriptorHandleForHeapStart());
+  const CD3DX12_RESOURCE_DESC drawArgsInitDesc =
+      CD3DX12_RESOURCE_DESC::Buffer(sizeof(D3D12_DRAW_ARGUMENTS));
+  ThrowIfFailed(device->CreateCommittedResource(
+      &uploadHeapProps, D3D12_HEAP_FLAG_NONE, &drawArgsInitDesc,
+      D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+      IID_PPV_ARGS(&mParticleDrawArgsInitBuffer)));
+  D3D12_DRAW_ARGUMENTS* mappedDrawArgs = nullptr;
+  ThrowIfFailed(mParticleDrawArgsInitBuffer->Map(
+      0, nullptr, reinterpret_cast<void**>(&mappedDrawArgs)));
+  mappedDrawArgs->VertexCountPerInstance = 0;
+  mappedDrawArgs->InstanceCount = 1;
+  mappedDrawArgs->StartVertexLocation = 0;
+  mappedDrawArgs->StartInstanceLocation = 0;
+  mParticleDrawArgsInitBuffer->Unmap(0, nullptr);
+
+  const CD3DX12_RESOURCE_DESC emitterDesc = CD3DX12_RESOURCE_DESC::Buffer(
+      sizeof(ParticleEmitterSet::GpuRecord) * ParticleEmitterSet::kMaxEmitters);
+  ThrowIfFailed(device->CreateCommittedResource(
+      &uploadHeapProps, D3D12_HEAP_FLAG_NONE, &emitterDesc,
+      D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+      IID_PPV_ARGS(&mParticleEmitterBuffer)));
+  ThrowIfFailed(mParticleEmitterBuffer->Map(
+      0, nullptr, reinterpret_cast<void**>(&mMappedParticleEmitters)));
+
+  D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+  queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+  queryHeapDesc.Count = kParticleTimestampCount;
+  ThrowIfFailed(device->CreateQueryHeap(
+      &queryHeapDesc, IID_PPV_ARGS(&mParticleTimestampHeap)));
+  const CD3DX12_HEAP_PROPERTIES readbackHeapProps(D3D12_HEAP_TYPE_READBACK);
+  const CD3DX12_RESOURCE_DESC timestampDesc =
+      CD3DX12_RESOURCE_DESC::Buffer(kParticleTimestampCount * sizeof(UINT64));
+  ThrowIfFailed(device->CreateCommittedResource(
+      &readbackHeapProps, D3D12_HEAP_FLAG_NONE, &timestampDesc,
+      D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+      IID_PPV_ARGS(&mParticleTimestampReadback)));
+
+  // The views are rewritten in place when the capacity changes.
+  if (mParticleDescriptors == DescriptorAllocator::kInvalidIndex) {
+    mParticleDescriptors =
+        mCbvSrvHeap->AllocatePersistent(kParticleDescriptorCount);
+  }
 
   D3D12_SHADER_RESOURCE_VIEW_DESC particleSrvDesc = {};
   particleSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
   particleSrvDesc.Shader4ComponentMapping =
       D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
   particleSrvDesc.Buffer.FirstElement = 0;
-  particleSrvDesc.Buffer.NumElements = kParticleMaxCount;
+  particleSrvDesc.Buffer.NumElements = mParticleCapacity;
   particleSrvDesc.Buffer.StructureByteStride = particleStride;
   particleSrvDesc.Format = DXGI_FORMAT_UNKNOWN;
-  CD3DX12_CPU_DESCRIPTOR_HANDLE particleSrvCpu(cpuStart, kParticlePoolSrvIndex,
-                                               cbvSrvDescriptorSize);
-  device->CreateShaderResourceView(mParticlePoolBuffer.Get(), &particleSrvDesc,
-                                   particleSrvCpu);
+  device->CreateShaderResourceView(
+      mParticlePoolBuffer.Get(), &particleSrvDesc,
+      mCbvSrvHeap->GetCpuHandle(mParticleDescriptors + kParticlePoolSrvOffset));
 
   D3D12_UNORDERED_ACCESS_VIEW_DESC particlePoolUavDesc = {};
   particlePoolUavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
   particlePoolUavDesc.Buffer.FirstElement = 0;
-  particlePoolUavDesc.Buffer.NumElements = kParticleMaxCount;
+  particlePoolUavDesc.Buffer.NumElements = mParticleCapacity;
   particlePoolUavDesc.Buffer.StructureByteStride = particleStride;
   particlePoolUavDesc.Format = DXGI_FORMAT_UNKNOWN;
-  mParticlePoolUavCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-      cpuStart, kParticlePoolUavIndex, cbvSrvDescriptorSize);
-  mParticlePoolUavGpuHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(
-      cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), kParticlePoolUavIndex,
-      cbvSrvDescriptorSize);
+  mParticlePoolUavCpuHandle =
+      mCbvSrvHeap->GetCpuHandle(mParticleDescriptors + kParticlePoolUavOffset);
+  mParticlePoolUavGpuHandle =
+      mCbvSrvHeap->GetGpuHandle(mParticleDescriptors + kParticlePoolUavOffset);
   device->CreateUnorderedAccessView(mParticlePoolBuffer.Get(), nullptr,
                                     &particlePoolUavDesc,
                                     mParticlePoolUavCpuHandle);
@@ -417,131 +884,364 @@ void RenderingSystem::BuildParticleResources(ID3D12Device* device,
   D3D12_UNORDERED_ACCESS_VIEW_DESC deadUavDesc = {};
   deadUavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
   deadUavDesc.Buffer.FirstElement = 0;
-  deadUavDesc.Buffer.NumElements = kParticleMaxCount;
+  deadUavDesc.Buffer.NumElements = mParticleCapacity;
   deadUavDesc.Buffer.StructureByteStride = deadListStride;
   deadUavDesc.Format = DXGI_FORMAT_UNKNOWN;
   device->CreateUnorderedAccessView(
-      mDeadListABuffer.Get(), mDeadListACounterBuffer.Get(), &deadUavDesc,
-      CD3DX12_CPU_DESCRIPTOR_HANDLE(cpuStart, kDeadListAUavIndex,
-                                    cbvSrvDescriptorSize));
-  mDeadListAUavCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-      cpuStart, kDeadListAUavIndex, cbvSrvDescriptorSize);
-  mDeadListAUavGpuHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(
-      cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), kDeadListAUavIndex,
-      cbvSrvDescriptorSize);
+      mDeadListBuffer.Get(), mDeadListCounterBuffer.Get(), &deadUavDesc,
+      mCbvSrvHeap->GetCpuHandle(mParticleDescriptors + kDeadListUavOffset));
+  mDeadListUavGpuHandle =
+      mCbvSrvHeap->GetGpuHandle(mParticleDescriptors + kDeadListUavOffset);
+
   device->CreateUnorderedAccessView(
-      mDeadListBBuffer.Get(), mDeadListBCounterBuffer.Get(), &deadUavDesc,
-      CD3DX12_CPU_DESCRIPTOR_HANDLE(cpuStart, kDeadListBUavIndex,
-                                    cbvSrvDescriptorSize));
-  mDeadListBUavCpuHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(
-      cpuStart, kDeadListBUavIndex, cbvSrvDescriptorSize);
-  mDeadListBUavGpuHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(
-      cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(), kDeadListBUavIndex,
-      cbvSrvDescriptorSize);
-}
-
-void RenderingSystem::SimulateParticles(
-    ID3D12GraphicsCommandList* cmdList, float deltaTime,
-    const DirectX::SimpleMath::Vector3& cameraPosition) {
-  mParticlesTotalTime += deltaTime;
-  mMappedParticleSimConstants->DeltaTime = deltaTime;
-  mMappedParticleSimConstants->TotalTime = mParticlesTotalTime;
-  mMappedParticleSimConstants->SpawnCount = 96;
-  mMappedParticleSimConstants->MaxParticles = kParticleMaxCount;
-  mMappedParticleSimConstants->EmitterPosition = cameraPosition;
-  mMappedParticleSimConstants->EmitterSpread = 8.0f;
+      mAliveListBuffer.Get(), mParticleDrawArgsBuffer.Get(), &deadUavDesc,
+      mCbvSrvHeap->GetCpuHandle(mParticleDescriptors + kAliveListUavOffset));
+  mAliveListUavGpuHandle =
+      mCbvSrvHeap->GetGpuHandle(mParticleDescriptors + kAliveListUavOffset);
+}
 
-  auto appendDeadUavGpu =
-      mUseDeadListAAsConsume ? mDeadListBUavGpuHandle : mDeadListAUavGpuHandle;
+void RenderingSystem::BuildParticleCollisionResources(ID3D12Device* device) {
+  // The simulation cannot sample the depth buffer itself: with async compute
+  // it runs while the graphics queue renders the next frame's depth.
+  const CD3DX12_HEAP_PROPERTIES defaultHeapProps(D3D12_HEAP_TYPE_DEFAULT);
+  const CD3DX12_RESOURCE_DESC depthDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+      DXGI_FORMAT_R32_FLOAT, mWidth, mHeight, 1, 1, 1, 0,
+      D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+  ThrowIfFailed(device->CreateCommittedResource(
+      &defaultHeapProps, D3D12_HEAP_FLAG_NONE, &depthDesc,
+      D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr,
+      IID_PPV_ARGS(&mCollisionDepthTexture)));
+  mCollisionDepthState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+  mCollisionDepthValid = false;
+
+  // SRV, then UAV.
+  const UINT descriptors = mCbvSrvHeap->AllocatePersistent(2);
+
+  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+  srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+  srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+  srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+  srvDesc.Texture2D.MipLevels = 1;
+  device->CreateShaderResourceView(
+      mCollisionDepthTexture.Get(), &srvDesc,
+      mCbvSrvHeap->GetCpuHandle(descriptors));
+
+  D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+  uavDesc.Format = DXGI_FORMAT_R32_FLOAT;
+  uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+  device->CreateUnorderedAccessView(
+      mCollisionDepthTexture.Get(), nullptr, &uavDesc,
+      mCbvSrvHeap->GetCpuHandle(descriptors + 1));
 
-  auto toCompute = CD3DX12_RESOURCE_BARRIER::Transition(
-      mParticlePoolBuffer.Get(), mParticlePoolState,
-      D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-  cmdList->ResourceBarrier(1, &toCompute);
-  mParticlePoolState = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+  mCollisionDepthSrvGpuHandle = mCbvSrvHeap->GetGpuHandle(descriptors);
+  mCollisionDepthUavGpuHandle = mCbvSrvHeap->GetGpuHandle(descriptors + 1);
+}
 
+void RenderingSystem::CopyCollisionDepth(
+    ID3D12GraphicsCommandList* cmdList,
+    const DirectX::SimpleMath::Matrix& viewProj) {
+  cmdList->SetPipelineState(mParticleDepthCopyPSO.Get());
+  cmdList->SetComputeRootSignature(mParticleDepthCopyRootSignature.Get());
+  cmdList->SetComputeRootDescriptorTable(
+      0, mCbvSrvHeap->GetGpuHandle(mComposeSrvStart + GBuffer::kDepth));
+  cmdList->SetComputeRootDescriptorTable(1, mCollisionDepthUavGpuHandle);
+  cmdList->Dispatch((mWidth + 7) / 8, (mHeight + 7) / 8, 1);
+
+  mCollisionViewProj = viewProj;
+  mCollisionDepthValid = true;
+}
+
+void RenderingSystem::SimulateParticles(ID3D12GraphicsCommandList* cmdList,
+                                        float deltaTime,
+                                        UINT64 timestampFrequency) {
+  ReadParticleTimings();
+
+  const UINT spawnCount = mParticleEmitters.BuildSpawnBatch(
+      deltaTime, mParticleCapacity, mParticleEmitterRecords);
+  std::copy(mParticleEmitterRecords.begin(), mParticleEmitterRecords.end(),
+            mMappedParticleEmitters);
+
+  mParticlesTotalTime += deltaTime;
+  mMappedParticleSimConstants->DeltaTime = deltaTime;
+  mMappedParticleSimConstants->TotalTime = mParticlesTotalTime;
+  mMappedParticleSimConstants->SpawnCount = spawnCount;
+  mMappedParticleSimConstants->MaxParticles = mParticleCapacity;
+  mMappedParticleSimConstants->EmitterCount =
+      static_cast<UINT>(mParticleEmitterRecords.size());
+  mMappedParticleSimConstants->DepthViewProj = mCollisionViewProj.Transpose();
+  mMappedParticleSimConstants->DepthInvViewProj =
+      mCollisionViewProj.Invert().Transpose();
+  mMappedParticleSimConstants->Restitution = mParticleCollision.Restitution;
+  mMappedParticleSimConstants->CollisionThickness =
+      mParticleCollision.Thickness;
+  mMappedParticleSimConstants->OccludedFramesToDie =
+      mParticleCollision.OccludedFramesToDie;
+  mMappedParticleSimConstants->CollisionEnabled =
+      mParticleCollision.Enabled && mCollisionDepthValid ? 1u : 0u;
+  mMappedParticleSimConstants->DepthSize = DirectX::SimpleMath::Vector2(
+      static_cast<float>(mWidth), static_cast<float>(mHeight));
+
+  auto copyBuffer = [&](ID3D12Resource* dest, D3D12_RESOURCE_STATES destState,
+                        ID3D12Resource* source,
+                        D3D12_RESOURCE_STATES sourceState, UINT64 size) {
+    CD3DX12_RESOURCE_BARRIER before[2];
+    UINT beforeCount = 0;
+    before[beforeCount++] = CD3DX12_RESOURCE_BARRIER::Transition(
+        dest, destState, D3D12_RESOURCE_STATE_COPY_DEST);
+    if (sourceState != D3D12_RESOURCE_STATE_GENERIC_READ) {
+      before[beforeCount++] = CD3DX12_RESOURCE_BARRIER::Transition(
+          source, sourceState, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    }
+    cmdList->ResourceBarrier(beforeCount, before);
+    cmdList->CopyBufferRegion(dest, 0, source, 0, size);
+    CD3DX12_RESOURCE_BARRIER after[2];
+    after[0] = CD3DX12_RESOURCE_BARRIER::Transition(
+        dest, D3D12_RESOURCE_STATE_COPY_DEST, destState);
+    if (beforeCount > 1) {
+      after[1] = CD3DX12_RESOURCE_BARRIER::Transition(
+          source, D3D12_RESOURCE_STATE_COPY_SOURCE, sourceState);
+    }
+    cmdList->ResourceBarrier(beforeCount, after);
+  };
   auto resetCounter = [&](ID3D12Resource* counterBuffer) {
-    auto toCopyDest = CD3DX12_RESOURCE_BARRIER::Transition(
-        counterBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        D3D12_RESOURCE_STATE_COPY_DEST);
-    cmdList->ResourceBarrier(1, &toCopyDest);
-    cmdList->CopyBufferRegion(
-        counterBuffer, 0, mParticleCounterResetBuffer.Get(), 0, sizeof(UINT));
-    auto toUav = CD3DX12_RESOURCE_BARRIER::Transition(
-        counterBuffer, D3D12_RESOURCE_STATE_COPY_DEST,
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-    cmdList->ResourceBarrier(1, &toUav);
+    copyBuffer(counterBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+               mParticleCounterResetBuffer.Get(),
+               D3D12_RESOURCE_STATE_GENERIC_READ, sizeof(UINT));
   };
 
+  cmdList->SetComputeRootSignature(mParticlesComputeRootSignature.Get());
+  cmdList->SetComputeRootDescriptorTable(0, mParticlePoolUavGpuHandle);
+  cmdList->SetComputeRootDescriptorTable(1, mDeadListUavGpuHandle);
+  cmdList->SetComputeRootDescriptorTable(2, mDeadListUavGpuHandle);
+  cmdList->SetComputeRootConstantBufferView(
+      3, mParticleSimConstantBuffer->GetGPUVirtualAddress());
+  cmdList->SetComputeRootDescriptorTable(4, mAliveListUavGpuHandle);
+  cmdList->SetComputeRootShaderResourceView(
+      5, mParticleEmitterBuffer->GetGPUVirtualAddress());
+  cmdList->SetComputeRootShaderResourceView(
+      6, mDeadCountSnapshotBuffer->GetGPUVirtualAddress());
+  cmdList->SetComputeRootDescriptorTable(7, mCollisionDepthSrvGpuHandle);
+
+  auto uavBarrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
   if (!mParticlesInitialized) {
+    resetCounter(mDeadListCounterBuffer.Get());
+    copyBuffer(mParticleDrawArgsBuffer.Get(),
+               D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+               mParticleDrawArgsInitBuffer.Get(),
+               D3D12_RESOURCE_STATE_GENERIC_READ, sizeof(D3D12_DRAW_ARGUMENTS));
     cmdList->SetPipelineState(mParticlesInitPSO.Get());
-    cmdList->SetComputeRootSignature(mParticlesComputeRootSignature.Get());
-    cmdList->SetComputeRootDescriptorTable(0, mParticlePoolUavGpuHandle);
-    cmdList->SetComputeRootDescriptorTable(1, mDeadListAUavGpuHandle);
-    cmdList->SetComputeRootDescriptorTable(2, mDeadListAUavGpuHandle);
-    cmdList->SetComputeRootConstantBufferView(
-        3, mParticleSimConstantBuffer->GetGPUVirtualAddress());
-    resetCounter(mDeadListACounterBuffer.Get());
-    resetCounter(mDeadListBCounterBuffer.Get());
-    cmdList->Dispatch((kParticleMaxCount + 127) / 128, 1, 1);
-    auto initBarrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
-    cmdList->ResourceBarrier(1, &initBarrier);
+    cmdList->Dispatch((mParticleCapacity + 127) / 128, 1, 1);
+    cmdList->ResourceBarrier(1, &uavBarrier);
     mParticlesInitialized = true;
-    mUseDeadListAAsConsume = true;
-    appendDeadUavGpu = mDeadListBUavGpuHandle;
   }
 
-  resetCounter(mUseDeadListAAsConsume ? mDeadListBCounterBuffer.Get()
-                                      : mDeadListACounterBuffer.Get());
+  cmdList->EndQuery(mParticleTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+                    0);
+  resetCounter(mParticleDrawArgsBuffer.Get());
+
+  // Emit consumes from the same dead list that simulate appends to, so free
+  // slots carry over between frames.
+  if (spawnCount > 0) {
+    copyBuffer(mDeadCountSnapshotBuffer.Get(),
+               D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+               mDeadListCounterBuffer.Get(),
+               D3D12_RESOURCE_STATE_UNORDERED_ACCESS, sizeof(UINT));
+    cmdList->SetPipelineState(mParticlesEmitPSO.Get());
+    cmdList->Dispatch((spawnCount + 63) / 64, 1, 1);
+    cmdList->ResourceBarrier(1, &uavBarrier);
+  }
 
-  cmdList->SetPipelineState(mParticlesEmitPSO.Get());
-  cmdList->SetComputeRootSignature(mParticlesComputeRootSignature.Get());
-  cmdList->SetComputeRootDescriptorTable(0, mParticlePoolUavGpuHandle);
-  cmdList->SetComputeRootDescriptorTable(1, appendDeadUavGpu);
-  cmdList->SetComputeRootDescriptorTable(2, mUseDeadListAAsConsume
-                                                ? mDeadListAUavGpuHandle
-                                                : mDeadListBUavGpuHandle);
-  cmdList->SetComputeRootConstantBufferView(
-      3, mParticleSimConstantBuffer->GetGPUVirtualAddress());
-  cmdList->Dispatch((mMappedParticleSimConstants->SpawnCount + 63) / 64, 1, 1);
+  cmdList->SetPipelineState(mParticlesSimulatePSO.Get());
+  cmdList->Dispatch((mParticleCapacity + 127) / 128, 1, 1);
+  cmdList->ResourceBarrier(1, &uavBarrier);
+
+  cmdList->EndQuery(mParticleTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+                    1);
+
+  mParticleSortTimed = mSortParticles;
+  if (mSortParticles) {
+    SortParticles(cmdList);
+  }
+
+  cmdList->ResolveQueryData(
+      mParticleTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0,
+      mParticleSortTimed ? kParticleTimestampCount : 2,
+      mParticleTimestampReadback.Get(), 0);
+  mParticleTimestampFrequency = timestampFrequency;
+  mParticleTimingPending = true;
+}
+
+void RenderingSystem::SortParticles(ID3D12GraphicsCommandList* cmdList) {
+  cmdList->EndQuery(mParticleTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+                    2);
 
+  cmdList->SetComputeRootSignature(mParticlesSortRootSignature.Get());
+  cmdList->SetComputeRootConstantBufferView(
+      1, mParticleRenderConstantBuffer->GetGPUVirtualAddress());
+  cmdList->SetComputeRootUnorderedAccessView(
+      2, mParticleSortBuffer->GetGPUVirtualAddress());
+  cmdList->SetComputeRootUnorderedAccessView(
+      3, mAliveListBuffer->GetGPUVirtualAddress());
+  cmdList->SetComputeRootUnorderedAccessView(
+      4, mParticleDrawArgsBuffer->GetGPUVirtualAddress());
+  cmdList->SetComputeRootUnorderedAccessView(
+      5, mParticlePoolBuffer->GetGPUVirtualAddress());
+
+  auto setStep = [&](UINT k, UINT j) {
+    const UINT constants[4] = {mParticleSortCount, k, j, 0};
+    cmdList->SetComputeRoot32BitConstants(0, 4, constants, 0);
+  };
   auto uavBarrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+  const UINT blockCount = mParticleSortCount / kParticleLocalSortSize;
+
+  setStep(0, 0);
+  cmdList->SetPipelineState(mParticlesSortKeysPSO.Get());
+  cmdList->Dispatch((mParticleSortCount + 255) / 256, 1, 1);
   cmdList->ResourceBarrier(1, &uavBarrier);
 
-  cmdList->SetPipelineState(mParticlesSimulatePSO.Get());
-  cmdList->SetComputeRootDescriptorTable(0, mParticlePoolUavGpuHandle);
-  cmdList->SetComputeRootDescriptorTable(1, appendDeadUavGpu);
-  cmdList->SetComputeRootDescriptorTable(2, mUseDeadListAAsConsume
-                                                ? mDeadListAUavGpuHandle
-                                                : mDeadListBUavGpuHandle);
-  cmdList->Dispatch((kParticleMaxCount + 127) / 128, 1, 1);
+  cmdList->SetPipelineState(mParticlesPreSortPSO.Get());
+  cmdList->Dispatch(blockCount, 1, 1);
   cmdList->ResourceBarrier(1, &uavBarrier);
 
-  auto toRender = CD3DX12_RESOURCE_BARRIER::Transition(
-      mParticlePoolBuffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-      D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-  cmdList->ResourceBarrier(1, &toRender);
-  mParticlePoolState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+  // Merge stages wider than a block: strides >= block size go through
+  // global memory, the rest of each stage runs in group shared memory.
+  for (UINT k = kParticleLocalSortSize * 2; k <= mParticleSortCount; k <<= 1) {
+    cmdList->SetPipelineState(mParticlesSortGlobalStepPSO.Get());
+    for (UINT j = k / 2; j >= kParticleLocalSortSize; j >>= 1) {
+      setStep(k, j);
+      cmdList->Dispatch((mParticleSortCount / 2 + 255) / 256, 1, 1);
+      cmdList->ResourceBarrier(1, &uavBarrier);
+    }
+    cmdList->SetPipelineState(mParticlesSortLocalStepPSO.Get());
+    cmdList->Dispatch(blockCount, 1, 1);
+    cmdList->ResourceBarrier(1, &uavBarrier);
+  }
 
-  mUseDeadListAAsConsume = !mUseDeadListAAsConsume;
+  cmdList->SetPipelineState(mParticlesSortWriteBackPSO.Get());
+  cmdList->Dispatch((mParticleCapacity + 255) / 256, 1, 1);
+  cmdList->ResourceBarrier(1, &uavBarrier);
+
+  cmdList->EndQuery(mParticleTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+                    3);
+}
+
+void RenderingSystem::ReadParticleTimings() {
+  // Called once the previous simulation has completed on the GPU.
+  if (!mParticleTimingPending || mParticleTimestampFrequency == 0) {
+    return;
+  }
+  mParticleTimingPending = false;
+
+  UINT64* timestamps = nullptr;
+  const D3D12_RANGE readRange = {0, kParticleTimestampCount * sizeof(UINT64)};
+  ThrowIfFailed(mParticleTimestampReadback->Map(
+      0, &readRange, reinterpret_cast<void**>(&timestamps)));
+  const UINT64 simulateTicks = timestamps[1] - timestamps[0];
+  const UINT64 sortTicks =
+      mParticleSortTimed ? timestamps[3] - timestamps[2] : 0;
+  const D3D12_RANGE writeRange = {0, 0};
+  mParticleTimestampReadback->Unmap(0, &writeRange);
+
+  const double ticksToMs = 1000.0 / mParticleTimestampFrequency;
+  mParticleSimulateMsAccum += simulateTicks * ticksToMs;
+  mParticleSortMsAccum += sortTicks * ticksToMs;
+  if (++mParticleSimulateSamples < kParticleTimingWindow) {
+    return;
+  }
+
+  const double averageMs = mParticleSimulateMsAccum / mParticleSimulateSamples;
+  std::ostringstream message;
+  message << "Particles: " << mParticleCapacity << " slots, "
+          << mParticleEmitters.GetEmitterCount() << " emitters, simulate "
+          << averageMs << " ms, "
+          << static_cast<UINT64>(averageMs > 0.0 ? mParticleCapacity / averageMs
+                                                 : 0.0)
+          << " particles/ms";
+  if (mSortParticles) {
+    message << ", sort " << mParticleSortMsAccum / mParticleSimulateSamples
+            << " ms for " << mParticleSortCount << " keys";
+  }
+  message << "\n";
+  OutputDebugStringA(message.str().c_str());
+  mParticleSimulateMsAccum = 0.0;
+  mParticleSortMsAccum = 0.0;
+  mParticleSimulateSamples = 0;
+}
+
+void RenderingSystem::SetParticleCapacity(ID3D12Device* device,
+                                          UINT capacity) {
+  if (capacity == 0) {
+    throw std::invalid_argument("Particle capacity must be positive");
+  }
+  mParticleCapacity = capacity;
+  BuildParticleResources(device);
+
+  mParticlesInitialized = false;
+  mParticlePoolState = D3D12_RESOURCE_STATE_COMMON;
+  mAliveListState = D3D12_RESOURCE_STATE_COMMON;
+  mParticleDrawArgsState = D3D12_RESOURCE_STATE_COMMON;
+  mParticleTimingPending = false;
+  mParticleSimulateMsAccum = 0.0;
+  mParticleSortMsAccum = 0.0;
+  mParticleSimulateSamples = 0;
 }
 
 void RenderingSystem::RenderParticles(ID3D12GraphicsCommandList* cmdList) {
-  cmdList->SetPipelineState(mParticlesRenderPSO.Get());
+  cmdList->SetPipelineState(mSortParticles ? mParticlesRenderBlendedPSO.Get()
+                                           : mParticlesRenderPSO.Get());
   cmdList->SetGraphicsRootSignature(mParticlesRenderRootSignature.Get());
   cmdList->SetGraphicsRootShaderResourceView(
       0, mParticlePoolBuffer->GetGPUVirtualAddress());
   cmdList->SetGraphicsRootConstantBufferView(
       1, mParticleRenderConstantBuffer->GetGPUVirtualAddress());
+  cmdList->SetGraphicsRootShaderResourceView(
+      2, mAliveListBuffer->GetGPUVirtualAddress());
   cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_POINTLIST);
-  cmdList->DrawInstanced(kParticleMaxCount, 1, 0, 0);
+  cmdList->ExecuteIndirect(mParticlesDrawSignature.Get(), 1,
+                           mParticleDrawArgsBuffer.Get(), 0, nullptr, 0);
 }
 
-void RenderingSystem::Render(
+void RenderingSystem::ExecuteBarriers(
     ID3D12GraphicsCommandList* cmdList,
+    const std::vector<RenderGraph::Barrier>& barriers,
+    const std::vector<ID3D12Resource*>& resources) const {
+  if (barriers.empty()) {
+    return;
+  }
+
+  std::vector<D3D12_RESOURCE_BARRIER> d3dBarriers;
+  d3dBarriers.reserve(barriers.size());
+  for (const auto& barrier : barriers) {
+    ID3D12Resource* resource = resources[barrier.Resource];
+    if (barrier.Type == RenderGraph::BarrierType::Uav) {
+      d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+      continue;
+    }
+    if (barrier.Type == RenderGraph::BarrierType::Aliasing) {
+      d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(
+          resources[barrier.AliasedResource], resource));
+      continue;
+    }
+
+    D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    if (barrier.Split == RenderGraph::BarrierSplit::BeginOnly) {
+      flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+    } else if (barrier.Split == RenderGraph::BarrierSplit::EndOnly) {
+      flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+    }
+    d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+        resource, static_cast<D3D12_RESOURCE_STATES>(barrier.Before),
+        static_cast<D3D12_RESOURCE_STATES>(barrier.After),
+        D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, flags));
+  }
+  cmdList->ResourceBarrier(static_cast<UINT>(d3dBarriers.size()),
+                           d3dBarriers.data());
+}
+
+void RenderingSystem::Render(
+    ID3D12GraphicsCommandList* cmdList, ID3D12CommandAllocator* cmdAllocator,
     D3D12_CPU_DESCRIPTOR_HANDLE backBufferRtv, ID3D12Resource* backBuffer,
-    D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle, ID3D12DescriptorHeap* cbvSrvHeap,
-    ID3D12DescriptorHeap* samplerHeap, UINT cbvSrvDescriptorSize,
+    ID3D12DescriptorHeap* samplerHeap,
     const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect,
     const D3D12_VERTEX_BUFFER_VIEW& vertexBufferView,
     const D3D12_INDEX_BUFFER_VIEW& indexBufferView,
@@ -549,53 +1249,172 @@ void RenderingSystem::Render(
     const std::vector<SceneObject>& sceneObjects,
     const std::vector<SubmeshInstance>& submeshInstances,
     const std::vector<UINT>& visibleSubmeshInstanceIndices,
-    UploadBuffer<MaterialConstants>* materialCB, ID3D12Resource* depthBuffer,
+    UploadBuffer<ObjectConstants>* objectBuffer,
+    UploadBuffer<MaterialConstants>* materialBuffer,
     D3D12_GPU_VIRTUAL_ADDRESS composeCBAddress, float deltaTime,
     const DirectX::SimpleMath::Matrix& viewProj,
     const DirectX::SimpleMath::Vector3& cameraPosition) {
   cmdList->RSSetViewports(1, &viewport);
   cmdList->RSSetScissorRects(1, &scissorRect);
 
-  ID3D12DescriptorHeap* heaps[] = {cbvSrvHeap, samplerHeap};
+  ID3D12DescriptorHeap* heaps[] = {mCbvSrvHeap->GetHeap(), samplerHeap};
   cmdList->SetDescriptorHeaps(2, heaps);
+  {
+    // The compose pass reads albedo, normal and depth as one table; the
+    // particle target's view follows them.
+    ComPtr<ID3D12Device> device;
+    ThrowIfFailed(cmdList->GetDevice(IID_PPV_ARGS(&device)));
+    mComposeSrvStart = mCbvSrvHeap->AllocateTransient(GBuffer::kSrvCount);
+    mGBuffer.CreateSrvs(device.Get(), mComposeSrvStart);
+  }
   mMappedParticleRenderConstants->CameraPosition = cameraPosition;
   mMappedParticleRenderConstants->BillboardSize = 0.55f;
-  mMappedParticleRenderConstants->MaxParticles = kParticleMaxCount;
+  mMappedParticleRenderConstants->MaxParticles = mParticleCapacity;
   mMappedParticleRenderConstants->ViewProj = viewProj.Transpose();
+  mMappedParticleRenderConstants->OpaqueParticles = mSortParticles ? 0u : 1u;
+
+  ReadGeometryStatistics();
+  GeometryPassConstants geometryPassConstants;
+  ExtractFrustumPlanes(viewProj, geometryPassConstants.FrustumPlanes);
+  const float patchCulling = mPatchCullingEnabled ? 1.0f : 0.0f;
+  geometryPassConstants.PatchCullParams = DirectX::SimpleMath::Vector4(
+      patchCulling, patchCulling, 0.0f, 0.0f);
+  geometryPassConstants.TessScreenParams = DirectX::SimpleMath::Vector4(
+      TessellationFactors::ComputePixelsPerUnit(mProj22, viewport.Height),
+      mTessellationParams.TargetPixelsPerEdge, mTessellationParams.Budget,
+      0.0f);
+  mGeometryPassCB->CopyData(0, geometryPassConstants);
+
+  const bool asyncSimulation = mUseAsyncCompute && mComputeQueue != nullptr;
+  if (asyncSimulation) {
+    SubmitAsyncParticleSimulation(deltaTime);
+  }
 
-  SimulateParticles(cmdList, deltaTime, cameraPosition);
+  mRenderGraph.Reset();
+  mRenderGraphResources.clear();
+  auto importResource = [&](const std::string& name, ID3D12Resource* resource,
+                            D3D12_RESOURCE_STATES initialState,
+                            D3D12_RESOURCE_STATES finalState) {
+    mRenderGraphResources.push_back(resource);
+    return mRenderGraph.ImportResource(name, initialState, finalState);
+  };
+  const ParticleGraphHandles particles =
+      ImportParticleResources(mRenderGraph, mRenderGraphResources);
+  if (asyncSimulation) {
+    // The compute queue may still be using these until the graphics queue
+    // waits for it, so their transitions stay whole.
+    for (RenderGraph::ResourceHandle handle :
+         {particles.Pool, particles.AliveList, particles.DrawArgs,
+          particles.CollisionDepth}) {
+      mRenderGraph.SetNoSplitBarriers(handle);
+    }
+  }
+  // Targets that share memory end the frame in the state of their last use,
+  // so no barrier touches one after another target has taken its memory.
+  const auto albedo = importResource(
+      "GBufferAlbedo", mGBuffer.GetAlbedo(),
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+  const auto normal = importResource(
+      "GBufferNormal", mGBuffer.GetNormal(),
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+  const auto depth = importResource(
+      "Depth", mGBuffer.GetDepth(), D3D12_RESOURCE_STATE_DEPTH_WRITE,
+      D3D12_RESOURCE_STATE_DEPTH_WRITE);
+  const auto particleColor = importResource(
+      "ParticleColor", mGBuffer.GetParticleColor(),
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+  const RenderGraph::ResourceHandle transientTargets[GBuffer::kTargetCount] =
+      {albedo, normal, depth, particleColor};
+  const TransientResourcePlanner& transientPlan =
+      mGBuffer.GetTransientPlanner();
+  for (UINT target = 0; target < GBuffer::kTargetCount; ++target) {
+    const auto predecessor =
+        transientPlan.GetPlacement(target).AliasedPredecessor;
+    if (predecessor != TransientResourcePlanner::kNoResource) {
+      mRenderGraph.SetAliasedPredecessor(transientTargets[target],
+                                         transientTargets[predecessor]);
+    }
+  }
+  const auto backBufferTarget =
+      importResource("BackBuffer", backBuffer, D3D12_RESOURCE_STATE_PRESENT,
+                     D3D12_RESOURCE_STATE_PRESENT);
+
+  uint32_t particleSimulatePass = 0;
+  if (!asyncSimulation) {
+    particleSimulatePass = mRenderGraph.AddPass(
+        "ParticleSimulate",
+        {{particles.Pool, D3D12_RESOURCE_STATE_UNORDERED_ACCESS},
+         {particles.AliveList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS},
+         {particles.DrawArgs, D3D12_RESOURCE_STATE_UNORDERED_ACCESS},
+         {particles.CollisionDepth,
+          D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE}});
+  }
+  const uint32_t geometryPass = mRenderGraph.AddPass(
+      "Geometry", {{albedo, D3D12_RESOURCE_STATE_RENDER_TARGET},
+                   {normal, D3D12_RESOURCE_STATE_RENDER_TARGET},
+                   {depth, D3D12_RESOURCE_STATE_DEPTH_WRITE}});
+  const uint32_t composePass = mRenderGraph.AddPass(
+      "Compose", {{albedo, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE},
+                  {normal, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE},
+                  {depth, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE},
+                  {backBufferTarget, D3D12_RESOURCE_STATE_RENDER_TARGET}});
+  if (asyncSimulation) {
+    // Geometry and compose are submitted before the wait for the simulation.
+    mRenderGraph.AddSubmitBoundary();
+  }
+  const uint32_t particleRenderPass = mRenderGraph.AddPass(
+      "ParticleRender",
+      {{particles.Pool, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE},
+       {particles.AliveList, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE},
+       {particles.DrawArgs, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT},
+       {depth, D3D12_RESOURCE_STATE_DEPTH_READ},
+       {particleColor, D3D12_RESOURCE_STATE_RENDER_TARGET}});
+  const uint32_t particleCompositePass = mRenderGraph.AddPass(
+      "ParticleComposite",
+      {{particleColor, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE},
+       {backBufferTarget, D3D12_RESOURCE_STATE_RENDER_TARGET}});
+  // Next frame's simulation collides against this frame's depth.
+  const uint32_t depthCopyPass = mRenderGraph.AddPass(
+      "ParticleDepthCopy",
+      {{depth, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE},
+       {particles.CollisionDepth, D3D12_RESOURCE_STATE_UNORDERED_ACCESS}});
+  mRenderGraph.Compile(mUseSplitBarriers);
+
+  if (!asyncSimulation) {
+    ExecuteBarriers(cmdList,
+                    mRenderGraph.GetBarriersBeforePass(particleSimulatePass),
+                    mRenderGraphResources);
+    SimulateParticles(cmdList, deltaTime, mGraphicsTimestampFrequency);
+  }
 
-  cmdList->SetPipelineState(mGeometryPSO.Get());
+  ExecuteBarriers(cmdList, mRenderGraph.GetBarriersBeforePass(geometryPass),
+                  mRenderGraphResources);
   cmdList->SetGraphicsRootSignature(mGeometryRootSignature.Get());
 
-  mGBuffer.BeginGeometryPass(cmdList, dsvHandle);
+  mGBuffer.BeginGeometryPass(cmdList);
 
+  // Materials index the whole heap; see MaterialConstants.
+  cmdList->SetGraphicsRootDescriptorTable(1, mCbvSrvHeap->GetGpuHandle(0));
   cmdList->SetGraphicsRootDescriptorTable(
-      5, samplerHeap->GetGPUDescriptorHandleForHeapStart());
+      2, samplerHeap->GetGPUDescriptorHandleForHeapStart());
+  cmdList->SetGraphicsRootShaderResourceView(
+      3, objectBuffer->Resource()->GetGPUVirtualAddress());
+  cmdList->SetGraphicsRootShaderResourceView(
+      4, materialBuffer->Resource()->GetGPUVirtualAddress());
+  cmdList->SetGraphicsRootConstantBufferView(
+      5, mGeometryPassCB->Resource()->GetGPUVirtualAddress());
+  cmdList->BeginQuery(mGeometryStatsHeap.Get(),
+                      D3D12_QUERY_TYPE_PIPELINE_STATISTICS, 0);
 
   cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
   cmdList->IASetIndexBuffer(&indexBufferView);
-  cmdList->IASetPrimitiveTopology(
-      D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-
-  const UINT cbMaterialSize = (sizeof(MaterialConstants) + 255) & ~255;
-
-  if (!modelGeometry.Materials.empty() &&
-      modelGeometry.Materials[0].DiffuseTextureIndex >= 0) {
-    CD3DX12_GPU_DESCRIPTOR_HANDLE defaultTextureHandle(
-        cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(),
-        static_cast<INT>(kTextureSrvStart +
-                         modelGeometry.Materials[0].DiffuseTextureIndex),
-        cbvSrvDescriptorSize);
-    cmdList->SetGraphicsRootDescriptorTable(1, defaultTextureHandle);
-    cmdList->SetGraphicsRootDescriptorTable(2, defaultTextureHandle);
-    cmdList->SetGraphicsRootDescriptorTable(3, defaultTextureHandle);
-    cmdList->SetGraphicsRootDescriptorTable(4, defaultTextureHandle);
-  }
 
-  for (UINT visibleInstanceIndex : visibleSubmeshInstanceIndices) {
+  auto drawSubmeshInstance = [&](UINT visibleInstanceIndex) {
     if (visibleInstanceIndex >= submeshInstances.size()) {
-      continue;
+      return;
     }
 
     const SubmeshInstance& submeshInstance =
@@ -604,14 +1423,9 @@ void RenderingSystem::Render(
     const UINT submeshIndex = submeshInstance.SubmeshIndex;
     if (objectIndex >= sceneObjects.size() ||
         submeshIndex >= modelGeometry.Submeshes.size()) {
-      continue;
+      return;
     }
 
-    CD3DX12_GPU_DESCRIPTOR_HANDLE objectCbHandle(
-        cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(),
-        static_cast<INT>(kObjectCbvStart + objectIndex), cbvSrvDescriptorSize);
-    cmdList->SetGraphicsRootDescriptorTable(0, objectCbHandle);
-
     const auto& submesh = modelGeometry.Submeshes[submeshIndex];
 
     float distanceToCamera =
@@ -633,62 +1447,114 @@ void RenderingSystem::Render(
             ? submesh.LodStartIndexLocation[lodLevel]
             : submesh.StartIndexLocation;
 
-    if (submesh.MaterialIndex < modelGeometry.Materials.size()) {
-      const auto& mat = modelGeometry.Materials[submesh.MaterialIndex];
+    // The only per-draw binding: the shaders fetch object and material data
+    // and the material's textures by these indices.
+    GeometryDrawConstants drawConstants;
+    drawConstants.ObjectIndex = objectIndex;
+    drawConstants.MaterialIndex =
+        submesh.MaterialIndex < modelGeometry.Materials.size()
+            ? static_cast<UINT>(
+                  modelGeometry.Materials[submesh.MaterialIndex].MatCBIndex)
+            : 0;
+    const DirectX::BoundingBox& positionBounds = submesh.PositionBounds;
+    drawConstants.PositionCenter =
+        DirectX::XMFLOAT4(positionBounds.Center.x, positionBounds.Center.y,
+                          positionBounds.Center.z, 0.0f);
+    drawConstants.PositionExtents =
+        DirectX::XMFLOAT4(positionBounds.Extents.x, positionBounds.Extents.y,
+                          positionBounds.Extents.z, 0.0f);
+    cmdList->SetGraphicsRoot32BitConstants(0, kGeometryDrawConstantCount,
+                                           &drawConstants, 0);
 
-      if (mat.DiffuseTextureIndex >= 0) {
-        CD3DX12_GPU_DESCRIPTOR_HANDLE diffuseHandle(
-            cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(),
-            static_cast<INT>(kTextureSrvStart + mat.DiffuseTextureIndex),
-            cbvSrvDescriptorSize);
-        cmdList->SetGraphicsRootDescriptorTable(1, diffuseHandle);
-      }
-
-      if (mat.NormalTextureIndex >= 0) {
-        CD3DX12_GPU_DESCRIPTOR_HANDLE normalHandle(
-            cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(),
-            static_cast<INT>(kTextureSrvStart + mat.NormalTextureIndex),
-            cbvSrvDescriptorSize);
-        cmdList->SetGraphicsRootDescriptorTable(2, normalHandle);
-      }
+    cmdList->DrawIndexedInstanced(lodIndexCount, 1, lodStartIndexLocation, 0,
+                                  0);
+  };
 
-      if (mat.DisplacementTextureIndex >= 0) {
-        CD3DX12_GPU_DESCRIPTOR_HANDLE displacementHandle(
-            cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(),
-            static_cast<INT>(kTextureSrvStart + mat.DisplacementTextureIndex),
-            cbvSrvDescriptorSize);
-        cmdList->SetGraphicsRootDescriptorTable(3, displacementHandle);
+  // Draws are grouped by permutation so that each PSO is bound once per
+  // frame; plain permutations sort before tessellated ones, so the topology
+  // also changes at most once.
+  const auto selectionStart = std::chrono::steady_clock::now();
+  mGeometryDraws.clear();
+  for (UINT visibleInstanceIndex : visibleSubmeshInstanceIndices) {
+    if (visibleInstanceIndex >= submeshInstances.size()) {
+      continue;
+    }
+    const SubmeshInstance& submeshInstance =
+        submeshInstances[visibleInstanceIndex];
+    if (submeshInstance.ObjectIndex >= sceneObjects.size() ||
+        submeshInstance.SubmeshIndex >= modelGeometry.Submeshes.size()) {
+      continue;
+    }
+    const UINT materialIndex =
+        modelGeometry.Submeshes[submeshInstance.SubmeshIndex].MaterialIndex;
+    const Material* material = materialIndex < modelGeometry.Materials.size()
+                                   ? &modelGeometry.Materials[materialIndex]
+                                   : nullptr;
+    mGeometryDraws.emplace_back(
+        GetGeometryPermutation(sceneObjects[submeshInstance.ObjectIndex],
+                               material),
+        visibleInstanceIndex);
+  }
+  auto sortKey = [](UINT permutation) {
+    return (permutation & kGeometryTessellatedFeatures) != 0
+               ? permutation + kGeometryPermutationCount
+               : permutation;
+  };
+  std::stable_sort(mGeometryDraws.begin(), mGeometryDraws.end(),
+                   [&](const std::pair<UINT, UINT>& a,
+                       const std::pair<UINT, UINT>& b) {
+                     return sortKey(a.first) < sortKey(b.first);
+                   });
+  mGeometrySelectionMsAccum +=
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - selectionStart)
+          .count();
+  mGeometrySelectionDrawsAccum += mGeometryDraws.size();
+
+  UINT boundPermutation = kGeometryPermutationCount;
+  bool boundTessellated = false;
+  mTessellatedGeometryDrawCount = 0;
+  mGeometryPipelineSwitches = 0;
+  for (const auto& draw : mGeometryDraws) {
+    const UINT permutation = draw.first;
+    const bool tessellated =
+        (permutation & kGeometryTessellatedFeatures) != 0;
+    if (permutation != boundPermutation) {
+      if (mGeometryPSOs[permutation] == nullptr) {
+        // A permutation the scene did not use at startup.
+        ComPtr<ID3D12Device> device;
+        ThrowIfFailed(cmdList->GetDevice(IID_PPV_ARGS(&device)));
+        BuildGeometryPermutation(device.Get(), permutation);
+        // Serializing the library takes milliseconds; it is written once
+        // the frame is submitted.
+        mPipelineCacheSavePending = true;
       }
-
-      if (mat.RoughnessTextureIndex >= 0) {
-        CD3DX12_GPU_DESCRIPTOR_HANDLE roughnessHandle(
-            cbvSrvHeap->GetGPUDescriptorHandleForHeapStart(),
-            static_cast<INT>(kTextureSrvStart + mat.RoughnessTextureIndex),
-            cbvSrvDescriptorSize);
-        cmdList->SetGraphicsRootDescriptorTable(4, roughnessHandle);
+      cmdList->SetPipelineState(mGeometryPSOs[permutation].Get());
+      if (boundPermutation == kGeometryPermutationCount ||
+          tessellated != boundTessellated) {
+        cmdList->IASetPrimitiveTopology(
+            tessellated ? D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST
+                        : D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
       }
-
-      D3D12_GPU_VIRTUAL_ADDRESS matCBAddress =
-          materialCB->Resource()->GetGPUVirtualAddress() +
-          static_cast<UINT64>(mat.MatCBIndex) * cbMaterialSize;
-      cmdList->SetGraphicsRootConstantBufferView(6, matCBAddress);
+      boundPermutation = permutation;
+      boundTessellated = tessellated;
+      ++mGeometryPipelineSwitches;
     }
-
-    cmdList->DrawIndexedInstanced(lodIndexCount, 1, lodStartIndexLocation, 0,
-                                  0);
+    if (tessellated) {
+      ++mTessellatedGeometryDrawCount;
+    }
+    drawSubmeshInstance(draw.second);
   }
 
-  mGBuffer.EndGeometryPass(cmdList);
-
-  auto depthToSrv = CD3DX12_RESOURCE_BARRIER::Transition(
-      depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE,
-      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-  cmdList->ResourceBarrier(1, &depthToSrv);
+  cmdList->EndQuery(mGeometryStatsHeap.Get(),
+                    D3D12_QUERY_TYPE_PIPELINE_STATISTICS, 0);
+  cmdList->ResolveQueryData(mGeometryStatsHeap.Get(),
+                            D3D12_QUERY_TYPE_PIPELINE_STATISTICS, 0, 1,
+                            mGeometryStatsReadback.Get(), 0);
+  mGeometryStatsPending = true;
 
-  auto toBackBuffer = CD3DX12_RESOURCE_BARRIER::Transition(
-      backBuffer, D3D12_RESOURCE_STATE_PRESENT,
-      D3D12_RESOURCE_STATE_RENDER_TARGET);
-  cmdList->ResourceBarrier(1, &toBackBuffer);
+  ExecuteBarriers(cmdList, mRenderGraph.GetBarriersBeforePass(composePass),
+                  mRenderGraphResources);
 
   const float clearColor[] = {0.0f, 0.2f, 0.4f, 1.0f};
   cmdList->ClearRenderTargetView(backBufferRtv, clearColor, 0, nullptr);
@@ -696,23 +1562,131 @@ void RenderingSystem::Render(
 
   cmdList->SetPipelineState(mComposePSO.Get());
   cmdList->SetGraphicsRootSignature(mComposeRootSignature.Get());
-  cmdList->SetGraphicsRootDescriptorTable(0, mGBuffer.GetSrvStartGpuHandle());
+  cmdList->SetGraphicsRootDescriptorTable(
+      0, mCbvSrvHeap->GetGpuHandle(mComposeSrvStart));
   cmdList->SetGraphicsRootDescriptorTable(
       1, samplerHeap->GetGPUDescriptorHandleForHeapStart());
   cmdList->SetGraphicsRootConstantBufferView(2, composeCBAddress);
   cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
   cmdList->DrawInstanced(3, 1, 0, 0);
 
-  cmdList->OMSetRenderTargets(1, &backBufferRtv, true, &dsvHandle);
+  if (asyncSimulation) {
+    // Geometry and compose do not touch the particles, so they are submitted
+    // before the graphics queue waits for the simulation.
+    ThrowIfFailed(cmdList->Close());
+    ID3D12CommandList* lists[] = {cmdList};
+    mGraphicsQueueSync.Queue()->ExecuteCommandLists(1, lists);
+    mAsyncComputeScheduler.BeginGraphicsConsume();
+
+    ThrowIfFailed(cmdList->Reset(cmdAllocator, nullptr));
+    cmdList->RSSetViewports(1, &viewport);
+    cmdList->RSSetScissorRects(1, &scissorRect);
+    cmdList->SetDescriptorHeaps(2, heaps);
+  }
+
+  ExecuteBarriers(cmdList,
+                  mRenderGraph.GetBarriersBeforePass(particleRenderPass),
+                  mRenderGraphResources);
+  mGBuffer.BeginParticlePass(cmdList);
   RenderParticles(cmdList);
 
-  auto depthToWrite = CD3DX12_RESOURCE_BARRIER::Transition(
-      depthBuffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-      D3D12_RESOURCE_STATE_DEPTH_WRITE);
-  cmdList->ResourceBarrier(1, &depthToWrite);
+  ExecuteBarriers(cmdList,
+                  mRenderGraph.GetBarriersBeforePass(particleCompositePass),
+                  mRenderGraphResources);
+  cmdList->OMSetRenderTargets(1, &backBufferRtv, true, nullptr);
+  cmdList->SetPipelineState(mParticleCompositePSO.Get());
+  cmdList->SetGraphicsRootSignature(mParticleCompositeRootSignature.Get());
+  cmdList->SetGraphicsRootDescriptorTable(
+      0, mCbvSrvHeap->GetGpuHandle(mComposeSrvStart + GBuffer::kParticleColor));
+  cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+  cmdList->DrawInstanced(3, 1, 0, 0);
+
+  ExecuteBarriers(cmdList, mRenderGraph.GetBarriersBeforePass(depthCopyPass),
+                  mRenderGraphResources);
+  CopyCollisionDepth(cmdList, viewProj);
+
+  ExecuteBarriers(cmdList, mRenderGraph.GetFinalBarriers(),
+                  mRenderGraphResources);
+  StoreParticleStates(mRenderGraph, particles);
+}
+
+void RenderingSystem::OnFrameSubmitted() {
+  if (mUseAsyncCompute && mComputeQueue != nullptr) {
+    mAsyncComputeScheduler.EndGraphicsConsume();
+  }
+  if (mPipelineCacheSavePending) {
+    mPipelineCacheSavePending = false;
+    mPipelineCache.Save();
+  }
+}
+
+void RenderingSystem::SubmitAsyncParticleSimulation(float deltaTime) {
+  mAsyncComputeScheduler.BeginComputeWork();
+  ThrowIfFailed(mComputeAllocator->Reset());
+  ThrowIfFailed(mComputeCommandList->Reset(mComputeAllocator.Get(), nullptr));
+  ID3D12DescriptorHeap* heaps[] = {mCbvSrvHeap->GetHeap()};
+  mComputeCommandList->SetDescriptorHeaps(1, heaps);
+
+  // The compute queue owns the pool's UAV phase and hands it back to the
+  // graphics queue in the state the particle draw reads it in.
+  mComputeGraph.Reset();
+  mComputeGraphResources.clear();
+  const ParticleGraphHandles particles =
+      ImportParticleResources(mComputeGraph, mComputeGraphResources);
+  const uint32_t simulatePass = mComputeGraph.AddPass(
+      "ParticleSimulate",
+      {{particles.Pool, D3D12_RESOURCE_STATE_UNORDERED_ACCESS},
+       {particles.AliveList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS},
+       {particles.DrawArgs, D3D12_RESOURCE_STATE_UNORDERED_ACCESS},
+       {particles.CollisionDepth,
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE}});
+  mComputeGraph.Compile(false);
+
+  ExecuteBarriers(mComputeCommandList.Get(),
+                  mComputeGraph.GetBarriersBeforePass(simulatePass),
+                  mComputeGraphResources);
+  SimulateParticles(mComputeCommandList.Get(), deltaTime,
+                    mComputeTimestampFrequency);
+  ExecuteBarriers(mComputeCommandList.Get(), mComputeGraph.GetFinalBarriers(),
+                  mComputeGraphResources);
+  ThrowIfFailed(mComputeCommandList->Close());
+
+  ID3D12CommandList* lists[] = {mComputeCommandList.Get()};
+  mComputeQueue->ExecuteCommandLists(1, lists);
+  mAsyncComputeScheduler.EndComputeWork();
+  StoreParticleStates(mComputeGraph, particles);
+}
+
+RenderingSystem::ParticleGraphHandles RenderingSystem::ImportParticleResources(
+    RenderGraph& graph, std::vector<ID3D12Resource*>& resources) const {
+  ParticleGraphHandles handles;
+  resources.push_back(mParticlePoolBuffer.Get());
+  handles.Pool = graph.ImportResource(
+      "ParticlePool", mParticlePoolState,
+      D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+  resources.push_back(mAliveListBuffer.Get());
+  handles.AliveList = graph.ImportResource(
+      "ParticleAliveList", mAliveListState,
+      D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+  resources.push_back(mParticleDrawArgsBuffer.Get());
+  handles.DrawArgs =
+      graph.ImportResource("ParticleDrawArgs", mParticleDrawArgsState,
+                           D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+  resources.push_back(mCollisionDepthTexture.Get());
+  handles.CollisionDepth =
+      graph.ImportResource("ParticleCollisionDepth", mCollisionDepthState,
+                           D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+  return handles;
+}
 
-  auto toPresent = CD3DX12_RESOURCE_BARRIER::Transition(
-      backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET,
-      D3D12_RESOURCE_STATE_PRESENT);
-  cmdList->ResourceBarrier(1, &toPresent);
+void RenderingSystem::StoreParticleStates(const RenderGraph& graph,
+                                          const ParticleGraphHandles& handles) {
+  mParticlePoolState =
+      static_cast<D3D12_RESOURCE_STATES>(graph.GetFinalState(handles.Pool));
+  mAliveListState = static_cast<D3D12_RESOURCE_STATES>(
+      graph.GetFinalState(handles.AliveList));
+  mParticleDrawArgsState = static_cast<D3D12_RESOURCE_STATES>(
+      graph.GetFinalState(handles.DrawArgs));
+  mCollisionDepthState = static_cast<D3D12_RESOURCE_STATES>(
+      graph.GetFinalState(handles.CollisionDepth));
 }
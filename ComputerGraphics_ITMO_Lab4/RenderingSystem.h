@@ -1,32 +1,40 @@
 #pragma once
 
+#include "AsyncComputeScheduler.h"
 #include "Common.h"
+#include "D3D12QueueSync.h"
+#include "DescriptorHeap.h"
 #include "GBuffer.h"
 #include "Material.h"
+#include "ParticleEmitterSet.h"
+#include "PipelineStateCache.h"
+#include "RenderGraph.h"
 #include "ShaderHelper.h"
 #include "Structures.h"
+#include "TessellationFactors.h"
 #include "UploadBuffer.h"
 
 class RenderingSystem {
  public:
   static constexpr UINT kGBufferRtvStart = SwapChainBufferCount;
-  static constexpr UINT kGBufferSrvStart = 2;
-  static constexpr UINT kObjectCbvStart = 5;
-  static constexpr UINT kObjectCbvReservedCount = 128;
-  static constexpr UINT kDepthSrvIndex =
-      kObjectCbvStart + kObjectCbvReservedCount;
-  static constexpr UINT kTextureSrvStart = kDepthSrvIndex + 1;
-
-  void Initialize(ID3D12Device* device, UINT width, UINT height,
-                  ID3D12DescriptorHeap* rtvHeap,
-                  ID3D12DescriptorHeap* cbvSrvHeap, UINT rtvDescriptorSize,
-                  UINT cbvSrvDescriptorSize);
 
+  // Views are allocated from cbvSrvHeap, which must outlive the system. The
+  // geometry pass binds the whole heap as its texture table, so material map
+  // indices are heap indices. The depth buffer is one of the G-buffer's
+  // transient targets; its DSV is written to dsvHandle.
+  void Initialize(ID3D12Device* device, ID3D12CommandQueue* graphicsQueue,
+                  UINT width, UINT height, ID3D12DescriptorHeap* rtvHeap,
+                  DescriptorHeap* cbvSrvHeap, UINT rtvDescriptorSize,
+                  D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle,
+                  const ModelGeometry& modelGeometry,
+                  const std::vector<SceneObject>& sceneObjects);
+
+  // With async compute enabled, cmdList is closed and submitted once midway
+  // through and reset with cmdAllocator for the particle draw.
   void Render(ID3D12GraphicsCommandList* cmdList,
+              ID3D12CommandAllocator* cmdAllocator,
               D3D12_CPU_DESCRIPTOR_HANDLE backBufferRtv,
-              ID3D12Resource* backBuffer, D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle,
-              ID3D12DescriptorHeap* cbvSrvHeap,
-              ID3D12DescriptorHeap* samplerHeap, UINT cbvSrvDescriptorSize,
+              ID3D12Resource* backBuffer, ID3D12DescriptorHeap* samplerHeap,
               const D3D12_VIEWPORT& viewport, const D3D12_RECT& scissorRect,
               const D3D12_VERTEX_BUFFER_VIEW& vertexBufferView,
               const D3D12_INDEX_BUFFER_VIEW& indexBufferView,
@@ -34,47 +42,162 @@ class RenderingSystem {
               const std::vector<SceneObject>& sceneObjects,
               const std::vector<SubmeshInstance>& submeshInstances,
               const std::vector<UINT>& visibleSubmeshInstanceIndices,
-              UploadBuffer<MaterialConstants>* materialCB,
-              ID3D12Resource* depthBuffer,
+              UploadBuffer<ObjectConstants>* objectBuffer,
+              UploadBuffer<MaterialConstants>* materialBuffer,
               D3D12_GPU_VIRTUAL_ADDRESS composeCBAddress, float deltaTime,
               const DirectX::SimpleMath::Matrix& viewProj,
               const DirectX::SimpleMath::Vector3& cameraPosition);
+  // Must be called right after the list passed to Render is executed. Also
+  // saves the pipeline cache if Render had to build a new permutation.
+  void OnFrameSubmitted();
+
+  // Whether the vertex buffer holds PackedVertex instead of Vertex, with
+  // positions quantized in Submesh::PositionBounds. Must be set before
+  // Initialize.
+  void SetPackedVertices(bool packed) { mPackedVertices = packed; }
+
+  ParticleEmitterSet& GetParticleEmitters() { return mParticleEmitters; }
+  UINT GetParticleCapacity() const { return mParticleCapacity; }
+  // Recreates the particle pool with room for capacity particles; all live
+  // particles are dropped. The GPU must be idle.
+  void SetParticleCapacity(ID3D12Device* device, UINT capacity);
+  // Sorted particles are drawn back to front with alpha blending; unsorted
+  // ones use the opaque clip-only PSO. Either way they are drawn into an
+  // off-screen target that is then blended over the back buffer.
+  void SetParticleSortingEnabled(bool enabled) { mSortParticles = enabled; }
+  bool IsParticleSortingEnabled() const { return mSortParticles; }
+
+  // The hull shader gives zero tess factors to patches outside the view
+  // frustum and to patches facing away from the camera.
+  void SetPatchCullingEnabled(bool enabled) { mPatchCullingEnabled = enabled; }
+  bool IsPatchCullingEnabled() const { return mPatchCullingEnabled; }
+
+  // Tess factors follow projected edge length: edges are split into segments
+  // of about targetPixelsPerEdge pixels, and every factor is then scaled by
+  // budget. Per-object TessellationParams.z/.w still clamp the result.
+  void SetTessellationTarget(float targetPixelsPerEdge) {
+    mTessellationParams.TargetPixelsPerEdge = targetPixelsPerEdge;
+  }
+  void SetTessellationBudget(float budget) {
+    mTessellationParams.Budget = budget;
+  }
+  float GetTessellationBudget() const { return mTessellationParams.Budget; }
+  void SetProjection(const DirectX::SimpleMath::Matrix& proj) {
+    mProj22 = proj._22;
+  }
+
+  // Particles bounce off the scene depth of the previous frame. Restitution
+  // <= 0 kills particles on impact instead; particles hidden behind geometry
+  // for OccludedFramesToDie frames in a row are killed early.
+  struct ParticleCollisionSettings {
+    bool Enabled = true;
+    float Restitution = 0.45f;
+    float Thickness = 1.5f;
+    UINT OccludedFramesToDie = 30;
+  };
+  void SetParticleCollision(const ParticleCollisionSettings& settings) {
+    mParticleCollision = settings;
+  }
+  const ParticleCollisionSettings& GetParticleCollision() const {
+    return mParticleCollision;
+  }
 
  private:
   void BuildGeometryRootSignature(ID3D12Device* device);
   void BuildComposeRootSignature(ID3D12Device* device);
   void BuildParticlesComputeRootSignature(ID3D12Device* device);
   void BuildParticlesRenderRootSignature(ID3D12Device* device);
-  void BuildGeometryPSO(ID3D12Device* device);
+  void BuildParticlesSortRootSignature(ID3D12Device* device);
+  void BuildParticleDepthCopyRootSignature(ID3D12Device* device);
+  void BuildParticleCompositeRootSignature(ID3D12Device* device);
+  // Geometry pass permutations: one bit per material or object feature that
+  // the geometry shaders receive as a define. Masks are canonical, so each
+  // distinct shader combination has exactly one permutation index.
+  static constexpr UINT kGeometryNormalMap = 1u << 0;
+  static constexpr UINT kGeometryRoughnessMap = 1u << 1;
+  static constexpr UINT kGeometryDisplacement = 1u << 2;
+  static constexpr UINT kGeometryWaves = 1u << 3;
+  static constexpr UINT kGeometryTessellatedFeatures =
+      kGeometryDisplacement | kGeometryWaves;
+  static constexpr UINT kGeometryPermutationCount = 1u << 4;
+  static UINT GetGeometryPermutation(const SceneObject& object,
+                                     const Material* material);
+  // Compiles the shaders and creates the PSO for a permutation if it does
+  // not exist yet.
+  void BuildGeometryPermutation(ID3D12Device* device, UINT permutation);
   void BuildComposePSO(ID3D12Device* device);
   void BuildParticlesEmitPSO(ID3D12Device* device);
   void BuildParticlesSimulatePSO(ID3D12Device* device);
   void BuildParticlesInitPSO(ID3D12Device* device);
   void BuildParticlesRenderPSO(ID3D12Device* device);
+  void BuildParticlesSortPSOs(ID3D12Device* device);
+  void BuildParticleDepthCopyPSO(ID3D12Device* device);
+  void BuildParticleCompositePSO(ID3D12Device* device);
   void BuildInputLayout();
   void BuildShaders();
-  void BuildParticleResources(ID3D12Device* device,
-                              ID3D12DescriptorHeap* cbvSrvHeap,
-                              UINT cbvSrvDescriptorSize);
+  void BuildGeometryPassResources(ID3D12Device* device);
+  void ReadGeometryStatistics();
+  void BuildParticleResources(ID3D12Device* device);
   void SimulateParticles(ID3D12GraphicsCommandList* cmdList, float deltaTime,
-                         const DirectX::SimpleMath::Vector3& cameraPosition);
+                         UINT64 timestampFrequency);
+  void BuildParticleCollisionResources(ID3D12Device* device);
+  void SortParticles(ID3D12GraphicsCommandList* cmdList);
+  void CopyCollisionDepth(ID3D12GraphicsCommandList* cmdList,
+                          const DirectX::SimpleMath::Matrix& viewProj);
+  void ReadParticleTimings();
   void RenderParticles(ID3D12GraphicsCommandList* cmdList);
+  void BuildAsyncCompute(ID3D12Device* device,
+                         ID3D12CommandQueue* graphicsQueue);
+  void SubmitAsyncParticleSimulation(float deltaTime);
+  struct ParticleGraphHandles {
+    RenderGraph::ResourceHandle Pool = 0;
+    RenderGraph::ResourceHandle AliveList = 0;
+    RenderGraph::ResourceHandle DrawArgs = 0;
+    RenderGraph::ResourceHandle CollisionDepth = 0;
+  };
+  ParticleGraphHandles ImportParticleResources(
+      RenderGraph& graph, std::vector<ID3D12Resource*>& resources) const;
+  void StoreParticleStates(const RenderGraph& graph,
+                           const ParticleGraphHandles& handles);
+  void ExecuteBarriers(ID3D12GraphicsCommandList* cmdList,
+                       const std::vector<RenderGraph::Barrier>& barriers,
+                       const std::vector<ID3D12Resource*>& resources) const;
+
+  static constexpr char kPipelineCachePath[] = "PipelineCache.bin";
+  PipelineStateCache mPipelineCache;
+  bool mPipelineCacheSavePending = false;
 
   ComPtr<ID3D12RootSignature> mGeometryRootSignature;
   ComPtr<ID3D12RootSignature> mComposeRootSignature;
   ComPtr<ID3D12RootSignature> mParticlesComputeRootSignature;
   ComPtr<ID3D12RootSignature> mParticlesRenderRootSignature;
-  ComPtr<ID3D12PipelineState> mGeometryPSO;
+  ComPtr<ID3D12RootSignature> mParticlesSortRootSignature;
+  ComPtr<ID3D12RootSignature> mParticleDepthCopyRootSignature;
+  ComPtr<ID3D12RootSignature> mParticleCompositeRootSignature;
+  std::array<ComPtr<ID3D12PipelineState>, kGeometryPermutationCount>
+      mGeometryPSOs;
+  UINT mGeometryPermutationsBuilt = 0;
   ComPtr<ID3D12PipelineState> mComposePSO;
   ComPtr<ID3D12PipelineState> mParticlesEmitPSO;
   ComPtr<ID3D12PipelineState> mParticlesSimulatePSO;
   ComPtr<ID3D12PipelineState> mParticlesInitPSO;
   ComPtr<ID3D12PipelineState> mParticlesRenderPSO;
+  ComPtr<ID3D12PipelineState> mParticlesRenderBlendedPSO;
+  ComPtr<ID3D12PipelineState> mParticlesSortKeysPSO;
+  ComPtr<ID3D12PipelineState> mParticlesPreSortPSO;
+  ComPtr<ID3D12PipelineState> mParticlesSortGlobalStepPSO;
+  ComPtr<ID3D12PipelineState> mParticlesSortLocalStepPSO;
+  ComPtr<ID3D12PipelineState> mParticlesSortWriteBackPSO;
+  ComPtr<ID3D12PipelineState> mParticleDepthCopyPSO;
+  ComPtr<ID3D12PipelineState> mParticleCompositePSO;
+  ComPtr<ID3D12CommandSignature> mParticlesDrawSignature;
 
   ComPtr<ID3DBlob> mGeometryVS;
-  ComPtr<ID3DBlob> mGeometryPS;
+  ComPtr<ID3DBlob> mGeometryPlainVS;
+  // Indexed like kGeometryPSDefines and kGeometryDSDefines.
+  std::array<ComPtr<ID3DBlob>, 4> mGeometryPSVariants;
   ComPtr<ID3DBlob> mGeometryHS;
-  ComPtr<ID3DBlob> mGeometryDS;
+  std::array<ComPtr<ID3DBlob>, 2> mGeometryDSVariants;
   ComPtr<ID3DBlob> mComposeVS;
   ComPtr<ID3DBlob> mComposePS;
   ComPtr<ID3DBlob> mParticlesEmitCS;
@@ -83,9 +206,65 @@ class RenderingSystem {
   ComPtr<ID3DBlob> mParticlesVS;
   ComPtr<ID3DBlob> mParticlesGS;
   ComPtr<ID3DBlob> mParticlesPS;
+  ComPtr<ID3DBlob> mParticlesSortKeysCS;
+  ComPtr<ID3DBlob> mParticlesPreSortCS;
+  ComPtr<ID3DBlob> mParticlesSortGlobalStepCS;
+  ComPtr<ID3DBlob> mParticlesSortLocalStepCS;
+  ComPtr<ID3DBlob> mParticlesSortWriteBackCS;
+  ComPtr<ID3DBlob> mParticleDepthCopyCS;
+  ComPtr<ID3DBlob> mParticleCompositePS;
 
   std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
   GBuffer mGBuffer;
+  DescriptorHeap* mCbvSrvHeap = nullptr;
+  // GBuffer::kSrvCount SRVs in GBuffer::Target order; the compose table is
+  // the first three. Transient descriptors, written again every frame.
+  UINT mComposeSrvStart = 0;
+  RenderGraph mRenderGraph;
+  std::vector<ID3D12Resource*> mRenderGraphResources;
+  bool mUseSplitBarriers = true;
+
+  ComPtr<ID3D12CommandQueue> mComputeQueue;
+  ComPtr<ID3D12CommandAllocator> mComputeAllocator;
+  ComPtr<ID3D12GraphicsCommandList> mComputeCommandList;
+  D3D12QueueSync mGraphicsQueueSync;
+  D3D12QueueSync mComputeQueueSync;
+  AsyncComputeScheduler mAsyncComputeScheduler;
+  RenderGraph mComputeGraph;
+  std::vector<ID3D12Resource*> mComputeGraphResources;
+  bool mUseAsyncCompute = true;
+  UINT64 mGraphicsTimestampFrequency = 0;
+  UINT64 mComputeTimestampFrequency = 0;
+
+  struct GeometryPassConstants {
+    // World-space planes with inward-facing normals.
+    DirectX::SimpleMath::Vector4 FrustumPlanes[6];
+    // x = frustum culling, y = backface culling.
+    DirectX::SimpleMath::Vector4 PatchCullParams;
+    // x = pixels per unit at distance 1, y = target pixels per edge,
+    // z = budget.
+    DirectX::SimpleMath::Vector4 TessScreenParams;
+  };
+
+  static constexpr UINT kGeometryStatsWindow = 120;
+  std::unique_ptr<UploadBuffer<GeometryPassConstants>> mGeometryPassCB;
+  ComPtr<ID3D12QueryHeap> mGeometryStatsHeap;
+  ComPtr<ID3D12Resource> mGeometryStatsReadback;
+  bool mGeometryStatsPending = false;
+  UINT64 mHsInvocationsAccum = 0;
+  UINT64 mDsInvocationsAccum = 0;
+  UINT mGeometryStatsSamples = 0;
+  bool mPatchCullingEnabled = true;
+  bool mPackedVertices = false;
+  // (permutation, visible instance index), sorted so that each PSO is bound
+  // once per frame and plain permutations come before tessellated ones.
+  std::vector<std::pair<UINT, UINT>> mGeometryDraws;
+  UINT mTessellatedGeometryDrawCount = 0;
+  UINT mGeometryPipelineSwitches = 0;
+  double mGeometrySelectionMsAccum = 0.0;
+  UINT64 mGeometrySelectionDrawsAccum = 0;
+  TessellationFactors::Params mTessellationParams;
+  float mProj22 = 1.0f;
 
   struct ParticleGpuData {
     DirectX::SimpleMath::Vector3 Position;
@@ -94,7 +273,8 @@ class RenderingSystem {
     float Lifetime;
     DirectX::SimpleMath::Vector4 Color;
     float Size;
-    DirectX::SimpleMath::Vector3 Padding;
+    float OccludedFrames;
+    DirectX::SimpleMath::Vector2 Padding;
   };
 
   struct ParticleSimConstants {
@@ -102,8 +282,16 @@ class RenderingSystem {
     float TotalTime = 0.0f;
     UINT SpawnCount = 0;
     UINT MaxParticles = 0;
-    DirectX::SimpleMath::Vector3 EmitterPosition;
-    float EmitterSpread = 1.0f;
+    UINT EmitterCount = 0;
+    DirectX::SimpleMath::Vector3 Padding;
+    DirectX::SimpleMath::Matrix DepthViewProj;
+    DirectX::SimpleMath::Matrix DepthInvViewProj;
+    float Restitution = 0.0f;
+    float CollisionThickness = 0.0f;
+    UINT OccludedFramesToDie = 0;
+    UINT CollisionEnabled = 0;
+    DirectX::SimpleMath::Vector2 DepthSize;
+    DirectX::SimpleMath::Vector2 Padding2;
   };
 
   struct ParticleRenderConstants {
@@ -111,33 +299,73 @@ class RenderingSystem {
     DirectX::SimpleMath::Vector3 CameraPosition;
     float BillboardSize = 1.0f;
     UINT MaxParticles = 0;
-    DirectX::SimpleMath::Vector3 Padding;
+    // Nonzero makes the pixel shader write full coverage for the unblended
+    // PSO.
+    UINT OpaqueParticles = 0;
+    DirectX::SimpleMath::Vector2 Padding;
   };
 
-  static constexpr UINT kParticleMaxCount = 16384;
-  static constexpr UINT kParticlePoolSrvIndex = kTextureSrvStart + 256;
-  static constexpr UINT kParticlePoolUavIndex = kParticlePoolSrvIndex + 1;
-  static constexpr UINT kDeadListAUavIndex = kParticlePoolSrvIndex + 2;
-  static constexpr UINT kDeadListBUavIndex = kParticlePoolSrvIndex + 3;
+  static constexpr UINT kDefaultParticleCapacity = 16384;
+  static constexpr UINT kParticleTimingWindow = 120;
+  // Simulate begin/end, sort begin/end.
+  static constexpr UINT kParticleTimestampCount = 4;
+  // Must match LOCAL_SORT_SIZE in ParticleSortCS.hlsl.
+  static constexpr UINT kParticleLocalSortSize = 1024;
+  // Offsets into the particle views' block of mCbvSrvHeap.
+  static constexpr UINT kParticlePoolSrvOffset = 0;
+  static constexpr UINT kParticlePoolUavOffset = 1;
+  static constexpr UINT kDeadListUavOffset = 2;
+  static constexpr UINT kAliveListUavOffset = 3;
+  static constexpr UINT kParticleDescriptorCount = 4;
+  UINT mParticleDescriptors = DescriptorAllocator::kInvalidIndex;
 
   ComPtr<ID3D12Resource> mParticlePoolBuffer;
-  ComPtr<ID3D12Resource> mDeadListABuffer;
-  ComPtr<ID3D12Resource> mDeadListBBuffer;
-  ComPtr<ID3D12Resource> mDeadListBCounterBuffer;
-  ComPtr<ID3D12Resource> mDeadListACounterBuffer;
+  ComPtr<ID3D12Resource> mDeadListBuffer;
+  ComPtr<ID3D12Resource> mDeadListCounterBuffer;
+  ComPtr<ID3D12Resource> mDeadCountSnapshotBuffer;
   ComPtr<ID3D12Resource> mParticleSimConstantBuffer;
   ComPtr<ID3D12Resource> mParticleRenderConstantBuffer;
   ComPtr<ID3D12Resource> mParticleCounterResetBuffer;
+  ComPtr<ID3D12Resource> mAliveListBuffer;
+  ComPtr<ID3D12Resource> mParticleDrawArgsBuffer;
+  ComPtr<ID3D12Resource> mParticleDrawArgsInitBuffer;
+  ComPtr<ID3D12Resource> mParticleEmitterBuffer;
+  ComPtr<ID3D12QueryHeap> mParticleTimestampHeap;
+  ComPtr<ID3D12Resource> mParticleTimestampReadback;
+  ComPtr<ID3D12Resource> mParticleSortBuffer;
+  UINT mParticleSortCount = 0;
+  bool mSortParticles = true;
+  bool mParticleSortTimed = false;
+  double mParticleSortMsAccum = 0.0;
+  ParticleEmitterSet mParticleEmitters;
+  std::vector<ParticleEmitterSet::GpuRecord> mParticleEmitterRecords;
+  ParticleEmitterSet::GpuRecord* mMappedParticleEmitters = nullptr;
+  UINT mParticleCapacity = kDefaultParticleCapacity;
+  UINT64 mParticleTimestampFrequency = 0;
+  bool mParticleTimingPending = false;
+  double mParticleSimulateMsAccum = 0.0;
+  UINT mParticleSimulateSamples = 0;
   ParticleSimConstants* mMappedParticleSimConstants = nullptr;
   ParticleRenderConstants* mMappedParticleRenderConstants = nullptr;
-  bool mUseDeadListAAsConsume = true;
   bool mParticlesInitialized = false;
   float mParticlesTotalTime = 0.0f;
   D3D12_RESOURCE_STATES mParticlePoolState = D3D12_RESOURCE_STATE_COMMON;
-  D3D12_CPU_DESCRIPTOR_HANDLE mDeadListAUavCpuHandle = {};
-  D3D12_CPU_DESCRIPTOR_HANDLE mDeadListBUavCpuHandle = {};
+  D3D12_RESOURCE_STATES mAliveListState = D3D12_RESOURCE_STATE_COMMON;
+  D3D12_RESOURCE_STATES mParticleDrawArgsState = D3D12_RESOURCE_STATE_COMMON;
   D3D12_CPU_DESCRIPTOR_HANDLE mParticlePoolUavCpuHandle = {};
-  D3D12_GPU_DESCRIPTOR_HANDLE mDeadListAUavGpuHandle = {};
-  D3D12_GPU_DESCRIPTOR_HANDLE mDeadListBUavGpuHandle = {};
+  D3D12_GPU_DESCRIPTOR_HANDLE mDeadListUavGpuHandle = {};
   D3D12_GPU_DESCRIPTOR_HANDLE mParticlePoolUavGpuHandle = {};
+  D3D12_GPU_DESCRIPTOR_HANDLE mAliveListUavGpuHandle = {};
+
+  ComPtr<ID3D12Resource> mCollisionDepthTexture;
+  D3D12_RESOURCE_STATES mCollisionDepthState =
+      D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+  D3D12_GPU_DESCRIPTOR_HANDLE mCollisionDepthSrvGpuHandle = {};
+  D3D12_GPU_DESCRIPTOR_HANDLE mCollisionDepthUavGpuHandle = {};
+  // View-projection the collision depth was rendered with.
+  DirectX::SimpleMath::Matrix mCollisionViewProj;
+  bool mCollisionDepthValid = false;
+  ParticleCollisionSettings mParticleCollision;
+  UINT mWidth = 0;
+  UINT mHeight = 0;
 };
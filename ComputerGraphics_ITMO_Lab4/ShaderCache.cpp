@@ -0,0 +1,174 @@
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "Fnv1aHash.h"
+#include "LittleEndianIO.h"
+
+namespace {
+constexpr char kMagic[4] = {'S', 'H', 'C', 'P'};
+}  // namespace
+
+uint64_t ShaderCache::ComputeKey(const std::string& source,
+                                 const std::string& entryPoint,
+                                 const std::string& target,
+                                 const std::vector<Define>& defines,
+                                 uint32_t compileFlags) {
+  Fnv1aHash hash;
+  hash.AddUint32(kVersion);
+  hash.AddString(source);
+  hash.AddString(entryPoint);
+  hash.AddString(target);
+  hash.AddUint32(static_cast<uint32_t>(defines.size()));
+  for (const auto& define : defines) {
+    hash.AddString(define.Name);
+    hash.AddString(define.Value);
+  }
+  hash.AddUint32(compileFlags);
+  return hash.Get();
+}
+
+uint64_t ShaderCache::ComputeRequestKey(const std::string& file,
+                                        const std::string& entryPoint,
+                                        const std::string& target,
+                                        const std::vector<Define>& defines,
+                                        uint32_t compileFlags) {
+  // The leading tag keeps request keys apart from content keys of a source
+  // whose text happens to equal the file name.
+  Fnv1aHash hash;
+  hash.AddString("request");
+  hash.AddUint32(kVersion);
+  hash.AddString(file);
+  hash.AddString(entryPoint);
+  hash.AddString(target);
+  hash.AddUint32(static_cast<uint32_t>(defines.size()));
+  for (const auto& define : defines) {
+    hash.AddString(define.Name);
+    hash.AddString(define.Value);
+  }
+  hash.AddUint32(compileFlags);
+  return hash.Get();
+}
+
+bool ShaderCache::Load(const std::string& path) {
+  Clear();
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+
+  size_t offset = sizeof(kMagic);
+  uint32_t version = 0;
+  uint32_t count = 0;
+  if (data.size() < sizeof(kMagic) ||
+      !std::equal(kMagic, kMagic + sizeof(kMagic), data.begin()) ||
+      !ReadUint32LE(data, offset, version) || version != kVersion ||
+      !ReadUint32LE(data, offset, count)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    uint64_t key = 0;
+    uint32_t size = 0;
+    if (!ReadUint64LE(data, offset, key) || !ReadUint32LE(data, offset, size) ||
+        data.size() - offset < size) {
+      Clear();
+      return false;
+    }
+    mEntries[key].assign(data.begin() + offset, data.begin() + offset + size);
+    offset += size;
+  }
+
+  uint32_t requestCount = 0;
+  if (!ReadUint32LE(data, offset, requestCount)) {
+    Clear();
+    return false;
+  }
+  for (uint32_t i = 0; i < requestCount; ++i) {
+    uint64_t requestKey = 0;
+    uint64_t key = 0;
+    if (!ReadUint64LE(data, offset, requestKey) ||
+        !ReadUint64LE(data, offset, key) || mEntries.count(key) == 0) {
+      Clear();
+      return false;
+    }
+    mRequests[requestKey] = key;
+  }
+  mDirty = false;
+  return true;
+}
+
+void ShaderCache::Save(const std::string& path) const {
+  std::vector<uint8_t> data(kMagic, kMagic + sizeof(kMagic));
+  WriteUint32LE(data, kVersion);
+  WriteUint32LE(data, static_cast<uint32_t>(mEntries.size()));
+  for (const auto& entry : mEntries) {
+    WriteUint64LE(data, entry.first);
+    WriteUint32LE(data, static_cast<uint32_t>(entry.second.size()));
+    data.insert(data.end(), entry.second.begin(), entry.second.end());
+  }
+  WriteUint32LE(data, static_cast<uint32_t>(mRequests.size()));
+  for (const auto& request : mRequests) {
+    WriteUint64LE(data, request.first);
+    WriteUint64LE(data, request.second);
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    throw std::runtime_error("Cannot write shader cache " + path);
+  }
+  file.write(reinterpret_cast<const char*>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+}
+
+const std::vector<uint8_t>* ShaderCache::Find(uint64_t key) const {
+  const auto it = mEntries.find(key);
+  return it != mEntries.end() ? &it->second : nullptr;
+}
+
+const std::vector<uint8_t>* ShaderCache::FindRequest(
+    uint64_t requestKey) const {
+  const auto it = mRequests.find(requestKey);
+  return it != mRequests.end() ? Find(it->second) : nullptr;
+}
+
+void ShaderCache::Insert(uint64_t key, std::vector<uint8_t> bytecode) {
+  mEntries[key] = std::move(bytecode);
+  mDirty = true;
+}
+
+void ShaderCache::SetRequest(uint64_t requestKey, uint64_t key) {
+  if (mEntries.count(key) == 0) {
+    throw std::invalid_argument("Shader request points at an uncached entry");
+  }
+  const auto it = mRequests.find(requestKey);
+  if (it != mRequests.end()) {
+    if (it->second == key) {
+      return;
+    }
+    const uint64_t previous = it->second;
+    it->second = key;
+    const bool stillUsed =
+        std::any_of(mRequests.begin(), mRequests.end(),
+                    [&](const auto& request) {
+                      return request.second == previous;
+                    });
+    if (!stillUsed) {
+      mEntries.erase(previous);
+    }
+  } else {
+    mRequests.emplace(requestKey, key);
+  }
+  mDirty = true;
+}
+
+void ShaderCache::Clear() {
+  mEntries.clear();
+  mRequests.clear();
+  mDirty = false;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compiled shader bytecode keyed by everything that affects compilation:
+// source text, entry point, target, defines and compile flags. Files pulled
+// in through #include are not part of the key.
+//
+// A second index maps request keys, which name the source file instead of
+// hashing its text, to the key of the bytecode last compiled for that
+// request. It lets a packaged build whose sources are not shipped find its
+// shaders; with the sources present the content key is checked first, and
+// a changed source replaces the stale entry.
+//
+// The package on disk is little-endian regardless of the host:
+//   char[4] "SHCP", uint32 version, uint32 entry count,
+//   per entry: uint64 key, uint32 byte count, bytes,
+//   uint32 request count, per request: uint64 request key, uint64 key.
+// Has no D3D12 dependency.
+class ShaderCache {
+ public:
+  struct Define {
+    std::string Name;
+    std::string Value;
+  };
+
+  static constexpr uint32_t kVersion = 2;
+
+  static uint64_t ComputeKey(const std::string& source,
+                             const std::string& entryPoint,
+                             const std::string& target,
+                             const std::vector<Define>& defines,
+                             uint32_t compileFlags);
+  // file is the path relative to the shader source directory, so the key
+  // does not change when the sources or the package move.
+  static uint64_t ComputeRequestKey(const std::string& file,
+                                    const std::string& entryPoint,
+                                    const std::string& target,
+                                    const std::vector<Define>& defines,
+                                    uint32_t compileFlags);
+
+  // Replaces the contents with the package at path. Returns false and
+  // leaves the cache empty if the file is missing or malformed.
+  bool Load(const std::string& path);
+  // Throws std::runtime_error if the file cannot be written.
+  void Save(const std::string& path) const;
+
+  const std::vector<uint8_t>* Find(uint64_t key) const;
+  // Bytecode last recorded for requestKey, or nullptr.
+  const std::vector<uint8_t>* FindRequest(uint64_t requestKey) const;
+  void Insert(uint64_t key, std::vector<uint8_t> bytecode);
+  // Points requestKey at the entry key, which must be cached. The entry the
+  // request pointed at before is removed once no request points at it.
+  void SetRequest(uint64_t requestKey, uint64_t key);
+  void Clear();
+
+  size_t GetEntryCount() const { return mEntries.size(); }
+  size_t GetRequestCount() const { return mRequests.size(); }
+  bool IsDirty() const { return mDirty; }
+  void MarkClean() { mDirty = false; }
+
+ private:
+  std::unordered_map<uint64_t, std::vector<uint8_t>> mEntries;
+  std::unordered_map<uint64_t, uint64_t> mRequests;
+  bool mDirty = false;
+};
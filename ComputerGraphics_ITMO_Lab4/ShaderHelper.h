@@ -4,18 +4,57 @@
 #include <d3dcompiler.h>
 #include <wrl.h>
 
+#include <chrono>
+#include <cstring>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "ShaderCache.h"
+
 using Microsoft::WRL::ComPtr;
 
 class ShaderHelper {
  public:
+  struct CacheStats {
+    UINT Hits = 0;
+    UINT Misses = 0;
+    double Milliseconds = 0.0;
+  };
+
+  // Bytecode shared by every CompileShader call. Load it before the first
+  // compile and save it afterwards if it IsDirty().
+  static ShaderCache& GetCache() {
+    static ShaderCache cache;
+    return cache;
+  }
+  static CacheStats& GetCacheStats() {
+    static CacheStats stats;
+    return stats;
+  }
+  // Directory, ending in a slash, that the file names given to
+  // CompileShader are relative to, and the package GetCache() is loaded
+  // from and saved to. Both are set once at startup, in WinMain.
+  static std::wstring& GetSourceDirectory() {
+    static std::wstring directory;
+    return directory;
+  }
+  static std::string& GetCachePath() {
+    static std::string path;
+    return path;
+  }
+
+  // file is relative to GetSourceDirectory(). Returns the cached bytecode if
+  // the source, entry point, target, defines and flags match an earlier
+  // compile, and compiles and caches it otherwise. Without the source file
+  // the bytecode last cached for the same file, entry point, target, defines
+  // and flags is used, so a package runs without its sources.
   static ComPtr<ID3DBlob> CompileShader(
-      const std::wstring& filename, const std::string& entryPoint,
+      const std::wstring& file, const std::string& entryPoint,
       const std::string& target, const D3D_SHADER_MACRO* defines = nullptr) {
+    const auto start = std::chrono::steady_clock::now();
     ComPtr<ID3DBlob> byteCode = nullptr;
     ComPtr<ID3DBlob> errors = nullptr;
 
@@ -24,6 +63,51 @@ class ShaderHelper {
     compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
 
+    std::vector<ShaderCache::Define> cacheDefines;
+    for (const D3D_SHADER_MACRO* macro = defines;
+         macro != nullptr && macro->Name != nullptr; ++macro) {
+      cacheDefines.push_back(
+          {macro->Name, macro->Definition ? macro->Definition : ""});
+    }
+    std::string fileName;
+    for (wchar_t c : file) {
+      fileName.push_back(static_cast<char>(c));
+    }
+    const uint64_t requestKey = ShaderCache::ComputeRequestKey(
+        fileName, entryPoint, target, cacheDefines, compileFlags);
+    const std::wstring filename = GetSourceDirectory() + file;
+    CacheStats& stats = GetCacheStats();
+
+    std::ifstream sourceFile(filename, std::ios::binary);
+    const std::vector<uint8_t>* cached = nullptr;
+    uint64_t key = 0;
+    if (sourceFile) {
+      const std::string source((std::istreambuf_iterator<char>(sourceFile)),
+                               std::istreambuf_iterator<char>());
+      key = ShaderCache::ComputeKey(source, entryPoint, target, cacheDefines,
+                                    compileFlags);
+      cached = GetCache().Find(key);
+      if (cached != nullptr) {
+        GetCache().SetRequest(requestKey, key);
+      }
+    } else {
+      cached = GetCache().FindRequest(requestKey);
+      if (cached == nullptr) {
+        throw std::runtime_error("Shader " + fileName +
+                                 " is neither on disk nor in the cache");
+      }
+    }
+    if (cached != nullptr) {
+      if (FAILED(D3DCreateBlob(cached->size(), &byteCode))) {
+        throw std::runtime_error("Failed to allocate shader blob");
+      }
+      std::memcpy(byteCode->GetBufferPointer(), cached->data(),
+                  cached->size());
+      ++stats.Hits;
+      stats.Milliseconds += ElapsedMs(start);
+      return byteCode;
+    }
+
     HRESULT hr = D3DCompileFromFile(filename.c_str(), defines,
                                     D3D_COMPILE_STANDARD_FILE_INCLUDE,
                                     entryPoint.c_str(), target.c_str(),
@@ -38,6 +122,13 @@ class ShaderHelper {
       throw std::runtime_error("Failed to compile shader");
     }
 
+    const auto* bytes =
+        static_cast<const uint8_t*>(byteCode->GetBufferPointer());
+    GetCache().Insert(key, std::vector<uint8_t>(
+                               bytes, bytes + byteCode->GetBufferSize()));
+    GetCache().SetRequest(requestKey, key);
+    ++stats.Misses;
+    stats.Milliseconds += ElapsedMs(start);
     return byteCode;
   }
 
@@ -81,4 +172,11 @@ class ShaderHelper {
 
     return byteCode;
   }
+
+ private:
+  static double ElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
 };
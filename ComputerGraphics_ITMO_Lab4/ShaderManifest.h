@@ -0,0 +1,71 @@
+#pragma once
+
+#include <d3dcommon.h>
+
+// Every shader entry point the application compiles. Running the executable
+// with --build-shader-cache compiles this list into kShaderCachePath, next to
+// the executable, ahead of time. Entry points missing here still work: they
+// are compiled on first launch and added to the package. Targets must match
+// the ones the renderer compiles with, since the target is part of the cache
+// key. File names are relative to the shader source directory.
+struct ShaderManifestEntry {
+  const wchar_t* File;
+  const char* EntryPoint;
+  const char* Target;
+  const D3D_SHADER_MACRO* Defines = nullptr;
+};
+
+constexpr char kShaderCachePath[] = "ShaderCache.bin";
+// Name of the project directory that holds the sources in a build tree.
+constexpr wchar_t kShaderProjectDirectory[] = L"ComputerGraphics_ITMO_Lab4";
+
+// Geometry pass permutations. Every define is always passed with an explicit
+// value so that the same permutation always maps to the same cache key.
+// Indexed by (normal map ? 1 : 0) | (roughness map ? 2 : 0).
+constexpr D3D_SHADER_MACRO kGeometryPSDefines[4][3] = {
+    {{"USE_NORMAL_MAP", "0"}, {"USE_ROUGHNESS_MAP", "0"}, {nullptr, nullptr}},
+    {{"USE_NORMAL_MAP", "1"}, {"USE_ROUGHNESS_MAP", "0"}, {nullptr, nullptr}},
+    {{"USE_NORMAL_MAP", "0"}, {"USE_ROUGHNESS_MAP", "1"}, {nullptr, nullptr}},
+    {{"USE_NORMAL_MAP", "1"}, {"USE_ROUGHNESS_MAP", "1"}, {nullptr, nullptr}},
+};
+// Indexed by (packed vertices ? 1 : 0).
+constexpr D3D_SHADER_MACRO kGeometryVSDefines[2][2] = {
+    {{"PACKED_VERTICES", "0"}, {nullptr, nullptr}},
+    {{"PACKED_VERTICES", "1"}, {nullptr, nullptr}},
+};
+// Indexed by (waves ? 1 : 0).
+constexpr D3D_SHADER_MACRO kGeometryDSDefines[2][2] = {
+    {{"USE_WAVES", "0"}, {nullptr, nullptr}},
+    {{"USE_WAVES", "1"}, {nullptr, nullptr}},
+};
+
+constexpr ShaderManifestEntry kShaderManifest[] = {
+    {L"DeferredGeometryVS.hlsl", "VS", "vs_5_1", kGeometryVSDefines[0]},
+    {L"DeferredGeometryVS.hlsl", "VS", "vs_5_1", kGeometryVSDefines[1]},
+    {L"DeferredGeometryVS.hlsl", "PlainVS", "vs_5_1", kGeometryVSDefines[0]},
+    {L"DeferredGeometryVS.hlsl", "PlainVS", "vs_5_1", kGeometryVSDefines[1]},
+    {L"DeferredGeometryPS.hlsl", "PS", "ps_5_1", kGeometryPSDefines[0]},
+    {L"DeferredGeometryPS.hlsl", "PS", "ps_5_1", kGeometryPSDefines[1]},
+    {L"DeferredGeometryPS.hlsl", "PS", "ps_5_1", kGeometryPSDefines[2]},
+    {L"DeferredGeometryPS.hlsl", "PS", "ps_5_1", kGeometryPSDefines[3]},
+    {L"DeferredGeometryHS.hlsl", "HS", "hs_5_1"},
+    {L"DeferredGeometryDS.hlsl", "DS", "ds_5_1", kGeometryDSDefines[0]},
+    {L"DeferredGeometryDS.hlsl", "DS", "ds_5_1", kGeometryDSDefines[1]},
+    {L"DeferredComposeVS.hlsl", "VS", "vs_5_0"},
+    {L"DeferredComposePS.hlsl", "PS", "ps_5_0"},
+    {L"ParticleEmitCS.hlsl", "CS", "cs_5_0"},
+    {L"ParticleInitCS.hlsl", "CS", "cs_5_0"},
+    {L"ParticleSimulateCS.hlsl", "CS", "cs_5_0"},
+    {L"ParticleVS.hlsl", "VS", "vs_5_0"},
+    {L"ParticleGS.hlsl", "GS", "gs_5_0"},
+    {L"ParticlePS.hlsl", "PS", "ps_5_0"},
+    {L"ParticleCompositePS.hlsl", "PS", "ps_5_0"},
+    {L"ParticleSortCS.hlsl", "BuildKeysCS", "cs_5_0"},
+    {L"ParticleSortCS.hlsl", "PreSortCS", "cs_5_0"},
+    {L"ParticleSortCS.hlsl", "GlobalStepCS", "cs_5_0"},
+    {L"ParticleSortCS.hlsl", "LocalStepCS", "cs_5_0"},
+    {L"ParticleSortCS.hlsl", "WriteBackCS", "cs_5_0"},
+    {L"ParticleDepthCopyCS.hlsl", "CS", "cs_5_0"},
+    {L"BoxVertexShader.hlsl", "VS", "vs_5_0"},
+    {L"BoxPixelShader.hlsl", "PS", "ps_5_0"},
+};
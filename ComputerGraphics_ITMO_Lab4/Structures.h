@@ -26,6 +26,8 @@ struct Submesh {
   std::array<UINT, kLodCount> LodIndexCount = {0, 0, 0};
   std::array<UINT, kLodCount> LodStartIndexLocation = {0, 0, 0};
   DirectX::BoundingBox Bounds;
+  // ,       (PackedVertex)
+  DirectX::BoundingBox PositionBounds;
 };
 
 struct ModelGeometry {
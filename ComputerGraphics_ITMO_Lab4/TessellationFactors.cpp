@@ -0,0 +1,47 @@
+#include "TessellationFactors.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+float Distance(const TessellationFactors::Float3& a,
+               const TessellationFactors::Float3& b) {
+  const float dx = a.X - b.X;
+  const float dy = a.Y - b.Y;
+  const float dz = a.Z - b.Z;
+  return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+}  // namespace
+
+float TessellationFactors::ComputePixelsPerUnit(float proj22,
+                                                float viewportHeight) {
+  return proj22 * viewportHeight * 0.5f;
+}
+
+float TessellationFactors::ComputeEdgeFactor(const Float3& a, const Float3& b,
+                                             const Float3& eye,
+                                             const Params& params) {
+  const Float3 mid = {0.5f * (a.X + b.X), 0.5f * (a.Y + b.Y),
+                      0.5f * (a.Z + b.Z)};
+  // Distance to the midpoint rather than view depth keeps the factor
+  // independent of camera rotation.
+  const float distToCamera = std::max(Distance(mid, eye), 1e-3f);
+  const float edgePixels = Distance(a, b) * params.PixelsPerUnit / distToCamera;
+  const float factor = edgePixels /
+                       std::max(params.TargetPixelsPerEdge, 1e-3f) *
+                       params.Budget;
+  const float minTess = std::max(params.MinTess, 1.0f);
+  const float maxTess = std::max(params.MaxTess, minTess);
+  return std::min(std::max(factor, minTess), maxTess);
+}
+
+TessellationFactors::PatchFactors TessellationFactors::ComputePatchFactors(
+    const Float3& p0, const Float3& p1, const Float3& p2, const Float3& eye,
+    const Params& params) {
+  PatchFactors factors;
+  factors.Edge[0] = ComputeEdgeFactor(p1, p2, eye, params);
+  factors.Edge[1] = ComputeEdgeFactor(p2, p0, eye, params);
+  factors.Edge[2] = ComputeEdgeFactor(p0, p1, eye, params);
+  factors.Inside = (factors.Edge[0] + factors.Edge[1] + factors.Edge[2]) / 3.0f;
+  return factors;
+}
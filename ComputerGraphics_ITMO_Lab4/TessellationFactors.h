@@ -0,0 +1,39 @@
+#pragma once
+
+// CPU reference for the tess factors computed by CalcHSPatchConstants in
+// DeferredGeometryHS.hlsl; the two must be kept in sync. An edge is split
+// so that each segment covers about TargetPixelsPerEdge pixels on screen.
+// The factor depends only on the edge's endpoints, so patches sharing an
+// edge get the same factor and no cracks appear. Has no D3D12 dependency.
+class TessellationFactors {
+ public:
+  struct Float3 {
+    float X = 0.0f;
+    float Y = 0.0f;
+    float Z = 0.0f;
+  };
+
+  struct Params {
+    // Pixels covered by one world unit seen from a distance of one unit:
+    // proj._22 * viewport height / 2.
+    float PixelsPerUnit = 0.0f;
+    float TargetPixelsPerEdge = 12.0f;
+    // Global multiplier on every factor.
+    float Budget = 1.0f;
+    float MinTess = 1.0f;
+    float MaxTess = 64.0f;
+  };
+
+  struct PatchFactors {
+    // Edge i is opposite control point i, as SV_TessFactor expects.
+    float Edge[3] = {};
+    float Inside = 0.0f;
+  };
+
+  static float ComputePixelsPerUnit(float proj22, float viewportHeight);
+  static float ComputeEdgeFactor(const Float3& a, const Float3& b,
+                                 const Float3& eye, const Params& params);
+  static PatchFactors ComputePatchFactors(const Float3& p0, const Float3& p1,
+                                          const Float3& p2, const Float3& eye,
+                                          const Params& params);
+};
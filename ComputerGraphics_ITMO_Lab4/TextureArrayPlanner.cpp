@@ -0,0 +1,96 @@
+#include "TextureArrayPlanner.h"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+uint64_t TextureArrayPlanner::GetAllocatedBytes(uint64_t bytes,
+                                                const Settings& settings) {
+  const uint64_t alignment = bytes <= settings.SmallResourceBytes
+                                 ? settings.SmallAlignment
+                                 : settings.Alignment;
+  return (bytes + alignment - 1) / alignment * alignment;
+}
+
+TextureArrayPlanner::Plan TextureArrayPlanner::Build(
+    const std::vector<Texture>& textures, const Settings& settings) {
+  if (settings.MinSlices == 0 || settings.MaxSlices < settings.MinSlices) {
+    throw std::invalid_argument("Bad array slice limits");
+  }
+
+  // Candidates by {format, width, height, mips}, in input order.
+  using GroupKey = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>;
+  std::map<GroupKey, std::vector<uint32_t>> groups;
+  for (uint32_t i = 0; i < textures.size(); ++i) {
+    const Texture& texture = textures[i];
+    if (std::max(texture.Width, texture.Height) <= settings.MaxDimension) {
+      groups[GroupKey(texture.Format, texture.Width, texture.Height,
+                      texture.MipCount)]
+          .push_back(i);
+    }
+  }
+
+  Plan plan;
+  plan.Placements.resize(textures.size());
+  for (const auto& group : groups) {
+    const std::vector<uint32_t>& members = group.second;
+    // Full arrays first; a remainder below MinSlices stays standalone.
+    for (size_t first = 0; first < members.size();
+         first += settings.MaxSlices) {
+      const size_t count =
+          std::min<size_t>(settings.MaxSlices, members.size() - first);
+      if (count < settings.MinSlices) {
+        break;
+      }
+      uint64_t arrayBytes = 0;
+      uint64_t standaloneBytes = 0;
+      for (size_t slice = 0; slice < count; ++slice) {
+        const uint64_t bytes = textures[members[first + slice]].Bytes;
+        arrayBytes += bytes;
+        standaloneBytes += GetAllocatedBytes(bytes, settings);
+      }
+      if (!settings.AllowGrowth &&
+          GetAllocatedBytes(arrayBytes, settings) > standaloneBytes) {
+        ++plan.PlanStats.GrowingGroups;
+        continue;
+      }
+      Array array;
+      std::tie(array.Format, array.Width, array.Height, array.MipCount) =
+          group.first;
+      const uint32_t arrayIndex = static_cast<uint32_t>(plan.Arrays.size());
+      for (size_t slice = 0; slice < count; ++slice) {
+        const uint32_t texture = members[first + slice];
+        array.Textures.push_back(texture);
+        plan.Placements[texture] = {arrayIndex,
+                                    static_cast<uint32_t>(slice)};
+      }
+      array.Bytes = arrayBytes;
+      plan.Arrays.push_back(std::move(array));
+    }
+  }
+
+  Stats& stats = plan.PlanStats;
+  stats.Textures = static_cast<uint32_t>(textures.size());
+  stats.Arrays = static_cast<uint32_t>(plan.Arrays.size());
+  stats.ResourcesBefore = stats.Textures;
+  for (uint32_t i = 0; i < textures.size(); ++i) {
+    const uint64_t allocated = GetAllocatedBytes(textures[i].Bytes, settings);
+    stats.BytesBefore += allocated;
+    stats.WastedBytesBefore += allocated - textures[i].Bytes;
+    if (plan.Placements[i].Array == kNotPacked) {
+      ++stats.ResourcesAfter;
+      stats.BytesAfter += allocated;
+      stats.WastedBytesAfter += allocated - textures[i].Bytes;
+    } else {
+      ++stats.PackedTextures;
+    }
+  }
+  for (const Array& array : plan.Arrays) {
+    const uint64_t allocated = GetAllocatedBytes(array.Bytes, settings);
+    ++stats.ResourcesAfter;
+    stats.BytesAfter += allocated;
+    stats.WastedBytesAfter += allocated - array.Bytes;
+  }
+  return plan;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Groups textures that share a format, size and mip count into
+// Texture2DArray resources. Fewer, larger resources waste less placement
+// alignment and take one SRV per array instead of one per texture. Sizes are
+// approximated by the linear upload footprint; the GPU's tiled layout
+// differs somewhat but is aligned the same way. Has no D3D12 dependency.
+class TextureArrayPlanner {
+ public:
+  static constexpr uint32_t kNotPacked = UINT32_MAX;
+
+  struct Settings {
+    // Larger textures stay standalone.
+    uint32_t MaxDimension = 256;
+    // Groups smaller than this stay standalone.
+    uint32_t MinSlices = 2;
+    // D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION.
+    uint32_t MaxSlices = 2048;
+    // D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, and the 4 KB alignment
+    // resources of at most SmallResourceBytes get.
+    uint64_t Alignment = 64 * 1024;
+    uint64_t SmallAlignment = 4 * 1024;
+    uint64_t SmallResourceBytes = 64 * 1024;
+    // Small textures get 4 KB alignment on their own but an array of them
+    // may need 64 KB; such arrays are only built if this is set.
+    bool AllowGrowth = false;
+  };
+
+  struct Texture {
+    uint32_t Format = 0;  // DXGI_FORMAT
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t MipCount = 0;
+    // One texture with all of its mips.
+    uint64_t Bytes = 0;
+  };
+
+  struct Array {
+    uint32_t Format = 0;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t MipCount = 0;
+    // Input indices, in slice order.
+    std::vector<uint32_t> Textures;
+    uint64_t Bytes = 0;
+  };
+
+  struct Placement {
+    uint32_t Array = kNotPacked;
+    uint32_t Slice = 0;
+  };
+
+  struct Stats {
+    uint32_t Textures = 0;
+    uint32_t PackedTextures = 0;
+    uint32_t Arrays = 0;
+    // Groups left standalone because packing them would take more memory.
+    uint32_t GrowingGroups = 0;
+    uint32_t ResourcesBefore = 0;
+    uint32_t ResourcesAfter = 0;
+    // Allocated bytes and the part of them lost to alignment.
+    uint64_t BytesBefore = 0;
+    uint64_t BytesAfter = 0;
+    uint64_t WastedBytesBefore = 0;
+    uint64_t WastedBytesAfter = 0;
+  };
+
+  struct Plan {
+    std::vector<Array> Arrays;
+    // Indexed like the input.
+    std::vector<Placement> Placements;
+    Stats PlanStats;
+  };
+
+  static Plan Build(const std::vector<Texture>& textures,
+                    const Settings& settings);
+  // Bytes a resource of the given size takes in a heap.
+  static uint64_t GetAllocatedBytes(uint64_t bytes, const Settings& settings);
+};
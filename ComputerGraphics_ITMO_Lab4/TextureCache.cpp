@@ -0,0 +1,94 @@
+#include "TextureCache.h"
+
+#include <stdexcept>
+
+#include "Fnv1aHash.h"
+
+TextureCache::Key TextureCache::MakeKey(const void* data, size_t size,
+                                        uint64_t paramsHash) {
+  Fnv1aHash hash;
+  hash.AddBytes(data, size);
+  Key key;
+  key.ContentHash = hash.Get();
+  key.ContentSize = size;
+  key.ParamsHash = paramsHash;
+  return key;
+}
+
+std::vector<uint32_t> TextureCache::SetSettings(const Settings& settings) {
+  mSettings = settings;
+  return Trim();
+}
+
+uint32_t TextureCache::Acquire(const Key& key) {
+  const auto it = mTextures.find(key);
+  if (it == mTextures.end()) {
+    ++mMisses;
+    return kNotFound;
+  }
+  Entry& entry = mEntries.at(it->second);
+  if (entry.References++ == 0) {
+    mUnreferenced.erase(entry.UnreferencedPosition);
+    mUnreferencedBytes -= entry.Bytes;
+  }
+  ++mHits;
+  mBytesSaved += entry.Bytes;
+  return it->second;
+}
+
+void TextureCache::Insert(const Key& key, uint32_t texture, uint64_t bytes) {
+  if (mTextures.count(key) != 0 || mEntries.count(texture) != 0) {
+    throw std::invalid_argument("Texture is already cached");
+  }
+  Entry entry;
+  entry.CacheKey = key;
+  entry.Bytes = bytes;
+  entry.References = 1;
+  mTextures.emplace(key, texture);
+  mEntries.emplace(texture, entry);
+}
+
+std::vector<uint32_t> TextureCache::Release(uint32_t texture) {
+  const auto it = mEntries.find(texture);
+  if (it == mEntries.end() || it->second.References == 0) {
+    throw std::invalid_argument("Texture is not referenced");
+  }
+  Entry& entry = it->second;
+  if (--entry.References == 0) {
+    entry.UnreferencedPosition =
+        mUnreferenced.insert(mUnreferenced.end(), texture);
+    mUnreferencedBytes += entry.Bytes;
+  }
+  return Trim();
+}
+
+std::vector<uint32_t> TextureCache::Trim() {
+  std::vector<uint32_t> evicted;
+  while (mUnreferencedBytes > mSettings.BudgetBytes) {
+    const uint32_t texture = mUnreferenced.front();
+    mUnreferenced.pop_front();
+    const auto it = mEntries.find(texture);
+    mUnreferencedBytes -= it->second.Bytes;
+    mTextures.erase(it->second.CacheKey);
+    mEntries.erase(it);
+    evicted.push_back(texture);
+    ++mEvictions;
+  }
+  return evicted;
+}
+
+TextureCache::Stats TextureCache::GetStats() const {
+  Stats stats;
+  stats.Hits = mHits;
+  stats.Misses = mMisses;
+  stats.BytesSaved = mBytesSaved;
+  stats.Textures = static_cast<uint32_t>(mEntries.size());
+  for (const auto& entry : mEntries) {
+    if (entry.second.References > 0) {
+      stats.ReferencedBytes += entry.second.Bytes;
+    }
+  }
+  stats.UnreferencedBytes = mUnreferencedBytes;
+  stats.Evictions = mEvictions;
+  return stats;
+}
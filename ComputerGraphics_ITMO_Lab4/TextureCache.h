@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Maps texture file contents to loaded textures so that identical images are
+// loaded once, whatever their file names and however often they are loaded.
+// Entries are keyed by a hash of the file bytes plus the load parameters and
+// are reference counted. Textures nobody references any more stay loaded for
+// later requests until the unreferenced ones exceed the budget; then the
+// least recently released are evicted and the caller destroys them. Has no
+// D3D12 dependency.
+class TextureCache {
+ public:
+  static constexpr uint32_t kNotFound = UINT32_MAX;
+
+  struct Key {
+    uint64_t ContentHash = 0;
+    uint64_t ContentSize = 0;
+    // Hash of the load parameters that change the loaded texture.
+    uint64_t ParamsHash = 0;
+
+    bool operator==(const Key& other) const {
+      return ContentHash == other.ContentHash &&
+             ContentSize == other.ContentSize &&
+             ParamsHash == other.ParamsHash;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return static_cast<size_t>(key.ContentHash ^ key.ParamsHash * 31 ^
+                                 key.ContentSize);
+    }
+  };
+
+  struct Settings {
+    // Bytes of unreferenced textures kept for reuse. Referenced textures do
+    // not count against it and are never evicted, so the cache holds at most
+    // the live textures plus this much; bounding the live set is up to the
+    // caller (TextureResidency budgets GPU memory).
+    uint64_t BudgetBytes = 64ull * 1024 * 1024;
+  };
+
+  struct Stats {
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+    // Bytes the hits did not have to load.
+    uint64_t BytesSaved = 0;
+    uint32_t Textures = 0;
+    uint64_t ReferencedBytes = 0;
+    uint64_t UnreferencedBytes = 0;
+    uint64_t Evictions = 0;
+  };
+
+  static Key MakeKey(const void* data, size_t size, uint64_t paramsHash);
+
+  // Changing the budget may evict; returns the evicted textures.
+  std::vector<uint32_t> SetSettings(const Settings& settings);
+  const Settings& GetSettings() const { return mSettings; }
+
+  // Returns the texture loaded for key and adds a reference to it, or
+  // kNotFound, which counts as a miss.
+  uint32_t Acquire(const Key& key);
+  // Records a texture just loaded for key, with one reference. bytes is what
+  // it costs to keep loaded. Throws std::invalid_argument if key or texture
+  // is already cached.
+  void Insert(const Key& key, uint32_t texture, uint64_t bytes);
+  // Drops a reference and returns the textures evicted to stay within the
+  // budget, possibly including this one. Throws std::invalid_argument if
+  // texture is not referenced.
+  std::vector<uint32_t> Release(uint32_t texture);
+
+  Stats GetStats() const;
+
+ private:
+  struct Entry {
+    Key CacheKey;
+    uint64_t Bytes = 0;
+    uint32_t References = 0;
+    // Position in mUnreferenced while References is 0.
+    std::list<uint32_t>::iterator UnreferencedPosition;
+  };
+
+  std::vector<uint32_t> Trim();
+
+  Settings mSettings;
+  std::unordered_map<Key, uint32_t, KeyHash> mTextures;
+  std::unordered_map<uint32_t, Entry> mEntries;
+  // Unreferenced textures, least recently released first.
+  std::list<uint32_t> mUnreferenced;
+  uint64_t mUnreferencedBytes = 0;
+  uint64_t mHits = 0;
+  uint64_t mMisses = 0;
+  uint64_t mBytesSaved = 0;
+  uint64_t mEvictions = 0;
+};
@@ -0,0 +1,222 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+float TextureResidency::ComputeScreenTexels(float boundsRadius, float distance,
+                                            float proj22,
+                                            float viewportHeight) {
+  // Inside the bounds the surface can fill the whole viewport.
+  const float clampedDistance = std::max(distance, boundsRadius);
+  if (clampedDistance <= 0.0f) {
+    return viewportHeight * proj22;
+  }
+  return boundsRadius * proj22 * viewportHeight / clampedDistance;
+}
+
+uint32_t TextureResidency::AddTexture(uint32_t width, uint32_t height,
+                                      std::vector<uint64_t> mipBytes,
+                                      bool pinned) {
+  if (width == 0 || height == 0 || mipBytes.empty()) {
+    throw std::invalid_argument("Texture needs a size and at least one mip");
+  }
+  TextureState texture;
+  texture.Width = width;
+  texture.Height = height;
+  texture.MipTailBytes.resize(mipBytes.size());
+  uint64_t tail = 0;
+  for (size_t i = mipBytes.size(); i-- > 0;) {
+    tail += mipBytes[i];
+    texture.MipTailBytes[i] = tail;
+  }
+
+  texture.Pinned = pinned;
+  const uint32_t lastMip = static_cast<uint32_t>(mipBytes.size()) - 1;
+  while (!pinned && texture.MinMip < lastMip &&
+         (std::max(width, height) >> texture.MinMip) >
+             mSettings.MinResidentDimension) {
+    ++texture.MinMip;
+  }
+  texture.ResidentMip = texture.MinMip;
+  texture.PendingMip = texture.MinMip;
+  texture.WantedMip = texture.MinMip;
+  mCommittedBytes += texture.MipTailBytes[texture.MinMip];
+
+  mTextures.push_back(std::move(texture));
+  return static_cast<uint32_t>(mTextures.size()) - 1;
+}
+
+void TextureResidency::RemoveTexture(uint32_t texture) {
+  TextureState& state = mTextures[texture];
+  if (state.Removed) {
+    return;
+  }
+  mCommittedBytes -= state.MipTailBytes[state.PendingMip];
+  state.PendingMip = state.ResidentMip;
+  state.RequestedThisFrame = false;
+  state.Removed = true;
+}
+
+uint32_t TextureResidency::ComputeWantedMip(const TextureState& texture,
+                                            float screenTexels) const {
+  // The smallest mip that still has at least one texel per pixel.
+  const uint32_t maxDimension = std::max(texture.Width, texture.Height);
+  const float texels = std::max(screenTexels, 1.0f);
+  uint32_t mip = 0;
+  while (mip < texture.MinMip &&
+         static_cast<float>(maxDimension >> (mip + 1)) >= texels) {
+    ++mip;
+  }
+  return mip;
+}
+
+void TextureResidency::RequestTexels(uint32_t texture, float screenTexels) {
+  TextureState& state = mTextures[texture];
+  if (state.Removed || state.Pinned) {
+    return;
+  }
+  const uint32_t mip = ComputeWantedMip(state, screenTexels);
+  state.WantedMip =
+      state.RequestedThisFrame ? std::min(state.WantedMip, mip) : mip;
+  state.RequestedThisFrame = true;
+}
+
+uint64_t TextureResidency::GetBytes(uint32_t texture, uint32_t topMip) const {
+  return mTextures[texture].MipTailBytes[topMip];
+}
+
+bool TextureResidency::MakeRoom(uint64_t needed, uint32_t requester,
+                                std::vector<Request>& requests) {
+  // Textures unused this frame fall back to their startup mips; textures in
+  // use only give up mips finer than they currently need.
+  std::vector<uint32_t> victims;
+  for (uint32_t i = 0; i < mTextures.size(); ++i) {
+    const TextureState& texture = mTextures[i];
+    if (i == requester || texture.Removed || texture.Pinned ||
+        IsInFlight(texture)) {
+      continue;
+    }
+    const uint32_t floorMip =
+        texture.LastUsedFrame == mFrame ? texture.WantedMip : texture.MinMip;
+    if (texture.PendingMip < floorMip) {
+      victims.push_back(i);
+    }
+  }
+  std::sort(victims.begin(), victims.end(), [&](uint32_t a, uint32_t b) {
+    if (mTextures[a].LastUsedFrame != mTextures[b].LastUsedFrame) {
+      return mTextures[a].LastUsedFrame < mTextures[b].LastUsedFrame;
+    }
+    return a < b;
+  });
+
+  for (uint32_t victim : victims) {
+    if (mCommittedBytes + needed <= mSettings.BudgetBytes) {
+      break;
+    }
+    TextureState& texture = mTextures[victim];
+    const uint32_t floorMip =
+        texture.LastUsedFrame == mFrame ? texture.WantedMip : texture.MinMip;
+    mCommittedBytes -= texture.MipTailBytes[texture.PendingMip] -
+                       texture.MipTailBytes[floorMip];
+    texture.PendingMip = floorMip;
+    requests.push_back({victim, floorMip});
+    ++mEvictions;
+  }
+  return mCommittedBytes + needed <= mSettings.BudgetBytes;
+}
+
+std::vector<TextureResidency::Request> TextureResidency::Update() {
+  ++mFrame;
+  uint32_t streamInsInFlight = 0;
+  std::vector<uint32_t> candidates;
+  for (uint32_t i = 0; i < mTextures.size(); ++i) {
+    TextureState& texture = mTextures[i];
+    if (texture.Removed || texture.Pinned) {
+      continue;
+    }
+    if (texture.RequestedThisFrame) {
+      texture.LastUsedFrame = mFrame;
+      texture.RequestedThisFrame = false;
+    } else {
+      texture.WantedMip = texture.MinMip;
+    }
+    if (texture.PendingMip < texture.ResidentMip) {
+      ++streamInsInFlight;
+    } else if (!IsInFlight(texture) &&
+               texture.WantedMip < texture.ResidentMip) {
+      candidates.push_back(i);
+    }
+  }
+
+  // Textures missing the most detail go first.
+  std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+    const uint32_t gapA = mTextures[a].ResidentMip - mTextures[a].WantedMip;
+    const uint32_t gapB = mTextures[b].ResidentMip - mTextures[b].WantedMip;
+    if (gapA != gapB) {
+      return gapA > gapB;
+    }
+    return a < b;
+  });
+
+  std::vector<Request> requests;
+  for (uint32_t candidate : candidates) {
+    if (streamInsInFlight >= mSettings.MaxInFlight) {
+      break;
+    }
+    TextureState& texture = mTextures[candidate];
+    uint32_t target = texture.WantedMip;
+    auto needed = [&]() {
+      return texture.MipTailBytes[target] -
+             texture.MipTailBytes[texture.PendingMip];
+    };
+    if (mCommittedBytes + needed() > mSettings.BudgetBytes &&
+        !MakeRoom(needed(), candidate, requests)) {
+      // Settle for fewer extra mips if the full request does not fit.
+      while (target < texture.PendingMip &&
+             mCommittedBytes + needed() > mSettings.BudgetBytes) {
+        ++target;
+      }
+      if (target == texture.PendingMip) {
+        ++mBudgetMisses;
+        continue;
+      }
+    }
+    mCommittedBytes += needed();
+    texture.PendingMip = target;
+    requests.push_back({candidate, target});
+    ++mStreamIns;
+    ++streamInsInFlight;
+  }
+  return requests;
+}
+
+void TextureResidency::OnStreamCompleted(uint32_t texture, uint32_t topMip) {
+  TextureState& state = mTextures[texture];
+  if (!state.Removed && state.PendingMip == topMip) {
+    state.ResidentMip = topMip;
+  }
+}
+
+void TextureResidency::OnStreamFailed(uint32_t texture) {
+  TextureState& state = mTextures[texture];
+  if (state.Removed) {
+    return;
+  }
+  mCommittedBytes = mCommittedBytes - state.MipTailBytes[state.PendingMip] +
+                    state.MipTailBytes[state.ResidentMip];
+  state.PendingMip = state.ResidentMip;
+}
+
+TextureResidency::Stats TextureResidency::GetStats() const {
+  Stats stats;
+  stats.ResidentBytes = mCommittedBytes;
+  for (const TextureState& texture : mTextures) {
+    if (IsInFlight(texture)) {
+      ++stats.InFlight;
+    }
+  }
+  stats.StreamIns = mStreamIns;
+  stats.Evictions = mEvictions;
+  stats.BudgetMisses = mBudgetMisses;
+  return stats;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Decides which mip levels of each texture should be resident. Every frame
+// the renderer reports how many texels each visible texture covers on
+// screen; Update() then turns those requests into stream-in and eviction
+// requests that keep the resident set within a memory budget. Textures not
+// requested recently are evicted first (LRU), down to the low mips loaded at
+// startup. Has no D3D12 dependency.
+//
+// A texture is resident from some top mip down to its smallest mip; a
+// request names the new top mip. Until OnStreamCompleted() reports it, the
+// texture is in flight and budgeted at its new size.
+class TextureResidency {
+ public:
+  struct Settings {
+    uint64_t BudgetBytes = 256ull * 1024 * 1024;
+    // Mips no larger than this are loaded at startup and never evicted.
+    uint32_t MinResidentDimension = 256;
+    // Stream-in requests in flight at once; evictions are not limited.
+    uint32_t MaxInFlight = 2;
+  };
+
+  struct Request {
+    uint32_t Texture = 0;
+    uint32_t TopMip = 0;
+  };
+
+  struct Stats {
+    uint64_t ResidentBytes = 0;
+    uint32_t InFlight = 0;
+    uint64_t StreamIns = 0;
+    uint64_t Evictions = 0;
+    // Stream-ins that could not fit even after evicting.
+    uint64_t BudgetMisses = 0;
+  };
+
+  // Texels of a surface along one axis that map to one pixel each: the
+  // projected diameter in pixels of a bounding sphere. proj22 is the
+  // projection matrix's y scale.
+  static float ComputeScreenTexels(float boundsRadius, float distance,
+                                   float proj22, float viewportHeight);
+
+  void SetSettings(const Settings& settings) { mSettings = settings; }
+  const Settings& GetSettings() const { return mSettings; }
+
+  // mipBytes[i] is the size of mip i; mip 0 is width x height. Returns the
+  // texture id. The texture starts resident at GetMinMip().
+  //
+  // A pinned texture is resident with all of its mips for its whole life:
+  // it counts against the budget but is never streamed or evicted. Used
+  // for textures whose mips cannot be replaced on their own, such as
+  // slices of a Texture2DArray or cube maps.
+  uint32_t AddTexture(uint32_t width, uint32_t height,
+                      std::vector<uint64_t> mipBytes, bool pinned = false);
+  uint32_t GetTextureCount() const {
+    return static_cast<uint32_t>(mTextures.size());
+  }
+  // Stops tracking the texture: its bytes leave the budget, its in-flight
+  // request is dropped and later calls for it are ignored. The id is not
+  // reused.
+  void RemoveTexture(uint32_t texture);
+
+  // Records that the texture covers screenTexels pixels along its larger
+  // axis this frame. Several requests keep the finest one.
+  void RequestTexels(uint32_t texture, float screenTexels);
+
+  // Closes the frame: returns the stream-ins and evictions to start now.
+  std::vector<Request> Update();
+  void OnStreamCompleted(uint32_t texture, uint32_t topMip);
+  // Drops the in-flight request, e.g. after a read error; the texture keeps
+  // its resident mips.
+  void OnStreamFailed(uint32_t texture);
+
+  uint32_t GetResidentMip(uint32_t texture) const {
+    return mTextures[texture].ResidentMip;
+  }
+  uint32_t GetMinMip(uint32_t texture) const {
+    return mTextures[texture].MinMip;
+  }
+  bool IsPinned(uint32_t texture) const { return mTextures[texture].Pinned; }
+  // Top mip the texture will have once its in-flight request completes.
+  uint32_t GetCommittedMip(uint32_t texture) const {
+    return mTextures[texture].PendingMip;
+  }
+  uint64_t GetBytes(uint32_t texture, uint32_t topMip) const;
+  Stats GetStats() const;
+
+ private:
+  struct TextureState {
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    // MipTailBytes[i] is the size of mips i and below.
+    std::vector<uint64_t> MipTailBytes;
+    uint32_t MinMip = 0;
+    uint32_t ResidentMip = 0;
+    uint32_t PendingMip = 0;
+    uint32_t WantedMip = 0;
+    uint64_t LastUsedFrame = 0;
+    bool RequestedThisFrame = false;
+    bool Pinned = false;
+    bool Removed = false;
+  };
+
+  bool IsInFlight(const TextureState& texture) const {
+    return texture.PendingMip != texture.ResidentMip;
+  }
+  uint32_t ComputeWantedMip(const TextureState& texture,
+                            float screenTexels) const;
+  // Evicts textures, least recently used first, until needed bytes fit.
+  // Returns false if they cannot.
+  bool MakeRoom(uint64_t needed, uint32_t requester,
+                std::vector<Request>& requests);
+
+  Settings mSettings;
+  std::vector<TextureState> mTextures;
+  uint64_t mFrame = 0;
+  uint64_t mCommittedBytes = 0;
+  uint64_t mStreamIns = 0;
+  uint64_t mEvictions = 0;
+  uint64_t mBudgetMisses = 0;
+};
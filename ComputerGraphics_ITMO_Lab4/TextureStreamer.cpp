@@ -0,0 +1,620 @@
+#include "TextureStreamer.h"
+
+#include <psapi.h>
+
+#include <chrono>
+
+#include "DDSTextureLoader.h"
+#include "Fnv1aHash.h"
+#include "MappedFile.h"
+
+namespace {
+std::vector<uint8_t> ReadFileBytes(const std::wstring& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return {};
+  }
+  // Sized up front: one read instead of a byte-wise copy into a growing
+  // vector.
+  std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  if (!file.read(reinterpret_cast<char*>(data.data()),
+                 static_cast<std::streamsize>(data.size()))) {
+    return {};
+  }
+  return data;
+}
+
+// Reads size bytes at offset; empty if the file is shorter.
+std::vector<uint8_t> ReadFileRange(const std::wstring& path, uint64_t offset,
+                                   uint64_t size) {
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> data(static_cast<size_t>(size));
+  if (!file.seekg(static_cast<std::streamoff>(offset)) ||
+      !file.read(reinterpret_cast<char*>(data.data()),
+                 static_cast<std::streamsize>(size))) {
+    return {};
+  }
+  return data;
+}
+
+// Views of slice 0's mips from firstMip down, in data that holds the file
+// from dataOffset on.
+std::vector<D3D12_SUBRESOURCE_DATA> GetMipData(const DdsInfo& layout,
+                                               const uint8_t* data,
+                                               uint64_t dataOffset,
+                                               uint32_t firstMip) {
+  std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+  for (uint32_t mip = firstMip; mip < layout.MipCount; ++mip) {
+    const DdsSubresource& subresource = layout.GetSubresource(mip, 0);
+    D3D12_SUBRESOURCE_DATA subresourceData = {};
+    subresourceData.pData = data + (subresource.FileOffset - dataOffset);
+    // Rows are tightly packed in the file.
+    subresourceData.RowPitch = subresource.RowBytes;
+    subresourceData.SlicePitch = static_cast<LONG_PTR>(subresource.FileBytes);
+    subresources.push_back(subresourceData);
+  }
+  return subresources;
+}
+
+void AppendPeakMemory(std::ostringstream& message) {
+  PROCESS_MEMORY_COUNTERS counters = {};
+  counters.cb = sizeof(counters);
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    message << ", peak working set "
+            << counters.PeakWorkingSetSize / (1024.0 * 1024.0)
+            << " MB, peak private "
+            << counters.PeakPagefileUsage / (1024.0 * 1024.0) << " MB";
+  }
+}
+}  // namespace
+
+void TextureStreamer::Initialize(ID3D12Device* device,
+                                 GpuMemoryAllocator* allocator,
+                                 DescriptorHeap* srvHeap) {
+  mDevice = device;
+  mAllocator = allocator;
+  mSrvHeap = srvHeap;
+  mUploader.Initialize(device);
+  mLoadStart = std::chrono::steady_clock::now();
+}
+
+int TextureStreamer::LoadTexture(const std::wstring& path) {
+  // A mapped file is copied by the uploader straight from the page cache
+  // into staging; otherwise it is read into a buffer first.
+  MappedFile mapping;
+  std::vector<uint8_t> buffer;
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  if (mMemoryMappedLoads && mapping.Open(path)) {
+    data = mapping.GetData();
+    size = mapping.GetSize();
+  } else {
+    buffer = ReadFileBytes(path);
+    data = buffer.data();
+    size = buffer.size();
+  }
+  if (size == 0) {
+    throw std::runtime_error("Cannot read DDS texture");
+  }
+  StreamedTexture texture;
+  texture.Path = path;
+  // DDSTextureLoader reads more formats than the header parser lays out;
+  // such files are loaded whole and never streamed or packed.
+  bool parsed = true;
+  try {
+    texture.Layout = ParseDdsHeader(
+        std::vector<uint8_t>(data, data + std::min(size, kDdsMaxHeaderSize)),
+        size);
+  } catch (const std::runtime_error&) {
+    parsed = false;
+  }
+  texture.Width = texture.Layout.Width;
+  texture.Height = texture.Layout.Height;
+  texture.MipCount = texture.Layout.MipCount;
+
+  const TextureCache::Key key = MakeCacheKey(data, size);
+  const uint32_t cached = mCache.Acquire(key);
+  if (cached != TextureCache::kNotFound) {
+    // A planned duplicate shares the cached texture's slice.
+    mPlannedSlices.erase(path);
+    return static_cast<int>(cached);
+  }
+
+  const auto planned = mPlannedSlices.find(path);
+  if (!parsed || planned == mPlannedSlices.end() ||
+      !LoadIntoArray(texture, data, planned->second)) {
+    // The loader skips every mip larger than maxsize, which matches the
+    // startup mips TextureResidency assumes.
+    std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+    ThrowIfFailed(DirectX::LoadDDSTextureFromMemory12(
+        mDevice, data, size, texture.Resource, subresources,
+        mResidency.GetSettings().MinResidentDimension, nullptr,
+        [this](const D3D12_RESOURCE_DESC& desc,
+               ComPtr<ID3D12Resource>& resource) {
+          return CreateTexture(desc, resource);
+        }));
+    mUploader.Upload(texture.Resource.Get(), subresources);
+    texture.SrvIndex = mSrvHeap->AllocatePersistent();
+  }
+  if (planned != mPlannedSlices.end()) {
+    mPlannedSlices.erase(planned);
+  }
+
+  const D3D12_RESOURCE_DESC desc = texture.Resource->GetDesc();
+  std::vector<uint64_t> mipBytes;
+  // Slices of a packed array, files that are cube maps or arrays
+  // themselves and files without a parsed layout are not streamed.
+  const bool pinned =
+      !parsed || texture.Array != TextureArrayPlanner::kNotPacked ||
+      desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D ||
+      desc.DepthOrArraySize != 1;
+  if (texture.Array == TextureArrayPlanner::kNotPacked && pinned) {
+    // Budgeted as one "mip" covering every subresource, sized from the
+    // loader's description.
+    texture.Width = static_cast<uint32_t>(desc.Width);
+    texture.Height = desc.Height;
+    texture.MipCount = desc.MipLevels;
+    UINT64 totalBytes = 0;
+    mDevice->GetCopyableFootprints(&desc, 0,
+                                   desc.DepthOrArraySize * desc.MipLevels, 0,
+                                   nullptr, nullptr, nullptr, &totalBytes);
+    mipBytes.push_back(totalBytes);
+  } else {
+    // The header already gives the size of every mip, loaded or not.
+    for (UINT mip = 0; mip < texture.MipCount; ++mip) {
+      mipBytes.push_back(texture.Layout.GetSubresource(mip, 0).StagingBytes);
+    }
+  }
+
+  mResidency.AddTexture(texture.Width, texture.Height, std::move(mipBytes),
+                        pinned);
+  mTextures.push_back(std::move(texture));
+  const uint32_t id = static_cast<uint32_t>(mTextures.size()) - 1;
+  if (mTextures[id].Array == TextureArrayPlanner::kNotPacked) {
+    WriteSrv(id);
+  } else {
+    mArrays[mTextures[id].Array].Textures.push_back(id);
+  }
+  mCache.Insert(key, id, mResidency.GetBytes(id, mResidency.GetMinMip(id)));
+  return static_cast<int>(id);
+}
+
+void TextureStreamer::PlanTextureArrays(
+    const std::vector<std::wstring>& paths,
+    TextureArrayPlanner::Settings settings) {
+  settings.MaxDimension = std::min(
+      settings.MaxDimension, mResidency.GetSettings().MinResidentDimension);
+
+  // Only the headers are read, and the contents of files small enough to
+  // pack; files that fail here fail in LoadTexture().
+  std::vector<const std::wstring*> candidatePaths;
+  std::vector<TextureArrayPlanner::Texture> candidates;
+  // Paths whose contents match an earlier candidate, with its index.
+  std::vector<std::pair<const std::wstring*, size_t>> duplicates;
+  std::unordered_map<TextureCache::Key, size_t, TextureCache::KeyHash>
+      candidateByKey;
+  for (const std::wstring& path : paths) {
+    std::ifstream file(path, std::ios::binary);
+    DdsInfo info;
+    try {
+      info = ScanDds(file);
+    } catch (const std::runtime_error&) {
+      continue;
+    }
+    if (info.Dimension != DdsDimension::kTexture2D || info.ArraySize != 1 ||
+        std::max(info.Width, info.Height) > settings.MaxDimension) {
+      continue;
+    }
+    const std::vector<uint8_t> contents = ReadFileBytes(path);
+    if (contents.empty()) {
+      continue;
+    }
+    const auto inserted = candidateByKey.emplace(
+        MakeCacheKey(contents.data(), contents.size()), candidates.size());
+    if (!inserted.second) {
+      duplicates.emplace_back(&path, inserted.first->second);
+      continue;
+    }
+    TextureArrayPlanner::Texture candidate;
+    candidate.Format = info.Format;
+    candidate.Width = info.Width;
+    candidate.Height = info.Height;
+    candidate.MipCount = info.MipCount;
+    candidate.Bytes = info.StagingBytes;
+    candidatePaths.push_back(&path);
+    candidates.push_back(candidate);
+  }
+
+  const TextureArrayPlanner::Plan plan =
+      TextureArrayPlanner::Build(candidates, settings);
+  const uint32_t firstArray = static_cast<uint32_t>(mArrays.size());
+  for (const TextureArrayPlanner::Array& planned : plan.Arrays) {
+    TextureArray array;
+    ThrowIfFailed(CreateTexture(
+        CD3DX12_RESOURCE_DESC::Tex2D(
+            static_cast<DXGI_FORMAT>(planned.Format), planned.Width,
+            planned.Height, static_cast<UINT16>(planned.Textures.size()),
+            static_cast<UINT16>(planned.MipCount)),
+        array.Resource));
+    array.SrvIndex = mSrvHeap->AllocatePersistent();
+    WriteSrv(array.Resource.Get(), array.SrvIndex);
+    mArrays.push_back(std::move(array));
+  }
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    TextureArrayPlanner::Placement placement = plan.Placements[i];
+    if (placement.Array != TextureArrayPlanner::kNotPacked) {
+      placement.Array += firstArray;
+      mPlannedSlices[*candidatePaths[i]] = placement;
+    }
+  }
+  uint32_t sharedSlices = 0;
+  for (const auto& duplicate : duplicates) {
+    const auto planned = mPlannedSlices.find(*candidatePaths[duplicate.second]);
+    if (planned != mPlannedSlices.end()) {
+      mPlannedSlices[*duplicate.first] = planned->second;
+      ++sharedSlices;
+    }
+  }
+
+  const TextureArrayPlanner::Stats& stats = plan.PlanStats;
+  std::ostringstream message;
+  message << "Texture arrays: " << stats.PackedTextures << " of "
+          << stats.Textures << " textures in " << stats.Arrays << " arrays ("
+          << sharedSlices << " duplicate files share a slice), "
+          << stats.GrowingGroups << " groups left standalone to save memory; "
+          << stats.ResourcesBefore << " -> " << stats.ResourcesAfter
+          << " resources, " << stats.BytesBefore / (1024.0 * 1024.0)
+          << " -> " << stats.BytesAfter / (1024.0 * 1024.0) << " MB, "
+          << stats.WastedBytesBefore / 1024.0 << " -> "
+          << stats.WastedBytesAfter / 1024.0 << " KB lost to alignment\n";
+  OutputDebugStringA(message.str().c_str());
+}
+
+bool TextureStreamer::LoadIntoArray(
+    StreamedTexture& texture, const uint8_t* data,
+    const TextureArrayPlanner::Placement& placement) {
+  TextureArray& array = mArrays[placement.Array];
+  if (!array.Resource) {
+    return false;
+  }
+  const D3D12_RESOURCE_DESC desc = array.Resource->GetDesc();
+  const DdsInfo& layout = texture.Layout;
+  if (layout.Dimension != DdsDimension::kTexture2D || layout.ArraySize != 1 ||
+      layout.Format != static_cast<uint32_t>(desc.Format) ||
+      layout.Width != desc.Width || layout.Height != desc.Height ||
+      layout.MipCount != desc.MipLevels) {
+    return false;
+  }
+
+  mUploader.Upload(array.Resource.Get(), GetMipData(layout, data, 0, 0),
+                   D3D12CalcSubresource(0, placement.Slice, 0,
+                                        desc.MipLevels,
+                                        desc.DepthOrArraySize));
+  texture.Resource = array.Resource;
+  texture.SrvIndex = array.SrvIndex;
+  texture.Array = placement.Array;
+  texture.Slice = placement.Slice;
+  ++array.LiveSlices;
+  return true;
+}
+
+void TextureStreamer::ReleaseTexture(int id) {
+  DestroyTextures(mCache.Release(static_cast<uint32_t>(id)));
+}
+
+void TextureStreamer::SetCacheSettings(
+    const TextureCache::Settings& settings) {
+  DestroyTextures(mCache.SetSettings(settings));
+}
+
+void TextureStreamer::DestroyTextures(const std::vector<uint32_t>& textures) {
+  for (uint32_t id : textures) {
+    StreamedTexture& texture = mTextures[id];
+    if (texture.Array == TextureArrayPlanner::kNotPacked) {
+      // Reads and uploads still in flight are dropped when they complete.
+      Retire(texture.Resource);
+      mRetiredSrvs.push_back(texture.SrvIndex);
+    } else {
+      TextureArray& array = mArrays[texture.Array];
+      if (--array.LiveSlices == 0) {
+        Retire(array.Resource);
+        array.Resource.Reset();
+        mRetiredSrvs.push_back(array.SrvIndex);
+      }
+    }
+    texture.Resource.Reset();
+    mResidency.RemoveTexture(id);
+  }
+}
+
+void TextureStreamer::FinishLoading() {
+  mUploader.Flush();
+  for (uint32_t texture = 0; texture < mTextures.size(); ++texture) {
+    if (mTextures[texture].Resource &&
+        mTextures[texture].Array == TextureArrayPlanner::kNotPacked) {
+      SetRelocatable(texture);
+    }
+  }
+  for (uint32_t array = 0; array < mArrays.size(); ++array) {
+    if (mArrays[array].Resource) {
+      SetArrayRelocatable(array);
+    }
+  }
+  const TextureUploader::Stats& stats = mUploader.GetStats();
+  std::ostringstream message;
+  message << "Texture upload (" << (mMemoryMappedLoads ? "mapped" : "read")
+          << " files): " << stats.Textures << " textures, "
+          << stats.UploadedBytes / (1024.0 * 1024.0) << " MB in "
+          << stats.Batches << " batches, peak staging "
+          << stats.PeakStagingBytes / (1024.0 * 1024.0) << " MB, "
+          << stats.Milliseconds << " ms uploading, "
+          << std::chrono::duration<double, std::milli>(
+                 std::chrono::steady_clock::now() - mLoadStart)
+                 .count()
+          << " ms total";
+  AppendPeakMemory(message);
+  message << "\n";
+  const TextureCache::Stats cacheStats = mCache.GetStats();
+  message << "Texture cache: " << cacheStats.Hits << " hits, "
+          << cacheStats.Misses << " misses, "
+          << cacheStats.BytesSaved / (1024.0 * 1024.0) << " MB saved, "
+          << cacheStats.Textures << " textures\n";
+  OutputDebugStringA(message.str().c_str());
+}
+
+void TextureStreamer::RequestVisibleTextures(
+    const ModelGeometry& modelGeometry,
+    const std::vector<SubmeshInstance>& instances,
+    const std::vector<UINT>& visibleInstances,
+    const DirectX::SimpleMath::Vector3& cameraPosition, float proj22,
+    float viewportHeight) {
+  for (UINT instanceIndex : visibleInstances) {
+    if (instanceIndex >= instances.size()) {
+      continue;
+    }
+    const SubmeshInstance& instance = instances[instanceIndex];
+    if (instance.SubmeshIndex >= modelGeometry.Submeshes.size()) {
+      continue;
+    }
+    const UINT materialIndex =
+        modelGeometry.Submeshes[instance.SubmeshIndex].MaterialIndex;
+    if (materialIndex >= modelGeometry.Materials.size()) {
+      continue;
+    }
+    const Material& material = modelGeometry.Materials[materialIndex];
+
+    const DirectX::SimpleMath::Vector3 center(instance.WorldBounds.Center);
+    const float radius =
+        DirectX::SimpleMath::Vector3(instance.WorldBounds.Extents).Length();
+    float texels = TextureResidency::ComputeScreenTexels(
+        radius, (center - cameraPosition).Length(), proj22, viewportHeight);
+    // A tiled texture repeats across the surface and needs more texels.
+    texels *= std::max(std::abs(material.Data.TexTransform._11),
+                       std::abs(material.Data.TexTransform._22));
+
+    for (int texture :
+         {material.DiffuseTextureIndex, material.NormalTextureIndex,
+          material.DisplacementTextureIndex, material.RoughnessTextureIndex}) {
+      if (texture >= 0 && static_cast<size_t>(texture) < mTextures.size()) {
+        mResidency.RequestTexels(static_cast<uint32_t>(texture), texels);
+      }
+    }
+  }
+}
+
+void TextureStreamer::Update(ID3D12GraphicsCommandList* cmdList) {
+  for (const ComPtr<ID3D12Resource>& resource : mRetired) {
+    mAllocator->Free(resource.Get());
+  }
+  mRetired.clear();
+  for (UINT srvIndex : mRetiredSrvs) {
+    mSrvHeap->FreePersistent(srvIndex);
+  }
+  mRetiredSrvs.clear();
+
+  for (auto it = mPendingUploads.begin(); it != mPendingUploads.end();) {
+    if (!mUploader.IsComplete(it->FenceValue)) {
+      ++it;
+      continue;
+    }
+    if (!mTextures[it->Texture].Resource) {
+      mAllocator->Free(it->Resource.Get());
+      it = mPendingUploads.erase(it);
+      continue;
+    }
+    Retire(mTextures[it->Texture].Resource);
+    mTextures[it->Texture].Resource = it->Resource;
+    WriteSrv(it->Texture);
+    SetRelocatable(it->Texture);
+    mResidency.OnStreamCompleted(it->Texture, it->TopMip);
+    it = mPendingUploads.erase(it);
+  }
+
+  for (auto it = mPendingReads.begin(); it != mPendingReads.end();) {
+    if (it->Data.wait_for(std::chrono::seconds(0)) ==
+        std::future_status::ready) {
+      CompleteRead(*it);
+      it = mPendingReads.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  mUploader.Submit();
+
+  for (const TextureResidency::Request& request : mResidency.Update()) {
+    const StreamedTexture& texture = mTextures[request.Texture];
+    const uint32_t residentMip =
+        texture.MipCount - texture.Resource->GetDesc().MipLevels;
+    if (request.TopMip > residentMip) {
+      Evict(cmdList, request.Texture, request.TopMip);
+      continue;
+    }
+    // Only the requested mips and the smaller ones after them in the file.
+    const DdsSubresource& top =
+        texture.Layout.GetSubresource(request.TopMip, 0);
+    const DdsSubresource& last =
+        texture.Layout.GetSubresource(texture.MipCount - 1, 0);
+    PendingRead read;
+    read.Texture = request.Texture;
+    read.TopMip = request.TopMip;
+    read.Data = std::async(std::launch::async, ReadFileRange, texture.Path,
+                           top.FileOffset,
+                           last.FileOffset + last.FileBytes - top.FileOffset);
+    mPendingReads.push_back(std::move(read));
+  }
+
+  LogStatistics();
+}
+
+void TextureStreamer::CompleteRead(PendingRead& read) {
+  const StreamedTexture& texture = mTextures[read.Texture];
+  const std::vector<uint8_t> data = read.Data.get();
+  if (!texture.Resource) {
+    return;
+  }
+
+  D3D12_RESOURCE_DESC desc = texture.Resource->GetDesc();
+  const DdsSubresource& top = texture.Layout.GetSubresource(read.TopMip, 0);
+  desc.Width = top.Width;
+  desc.Height = top.Height;
+  desc.MipLevels = static_cast<UINT16>(texture.MipCount - read.TopMip);
+
+  PendingUpload upload;
+  upload.Texture = read.Texture;
+  upload.TopMip = read.TopMip;
+  // The new resource stays pinned while the copy queue writes it.
+  if (data.empty() || FAILED(CreateTexture(desc, upload.Resource))) {
+    OutputDebugStringA("Texture streaming: failed to load mips\n");
+    mResidency.OnStreamFailed(read.Texture);
+    return;
+  }
+  const std::vector<D3D12_SUBRESOURCE_DATA> subresources =
+      GetMipData(texture.Layout, data.data(), top.FileOffset, read.TopMip);
+
+  // The old texture stays bound until the copy queue is done with the new
+  // one.
+  upload.FenceValue = mUploader.Upload(upload.Resource.Get(), subresources);
+  mPendingUploads.push_back(std::move(upload));
+}
+
+void TextureStreamer::Evict(ID3D12GraphicsCommandList* cmdList,
+                            uint32_t textureId, uint32_t topMip) {
+  StreamedTexture& texture = mTextures[textureId];
+  const D3D12_RESOURCE_DESC oldDesc = texture.Resource->GetDesc();
+  const uint32_t oldTopMip = texture.MipCount - oldDesc.MipLevels;
+
+  D3D12_RESOURCE_DESC desc = oldDesc;
+  desc.Width = std::max(texture.Width >> topMip, 1u);
+  desc.Height = std::max(texture.Height >> topMip, 1u);
+  desc.MipLevels = static_cast<UINT16>(texture.MipCount - topMip);
+
+  ComPtr<ID3D12Resource> resource;
+  ThrowIfFailed(CreateTexture(desc, resource));
+
+  // The smaller mips are already resident; copy them instead of reading the
+  // file again. Both textures start in COMMON and are promoted implicitly.
+  for (UINT mip = 0; mip < desc.MipLevels; ++mip) {
+    const CD3DX12_TEXTURE_COPY_LOCATION dst(resource.Get(), mip);
+    const CD3DX12_TEXTURE_COPY_LOCATION src(texture.Resource.Get(),
+                                            mip + topMip - oldTopMip);
+    cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+  }
+  // Back to COMMON so the draws promote it to a read state that decays at
+  // the end of the command list.
+  const auto toCommon = CD3DX12_RESOURCE_BARRIER::Transition(
+      resource.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+      D3D12_RESOURCE_STATE_COMMON);
+  cmdList->ResourceBarrier(1, &toCommon);
+
+  Retire(texture.Resource);
+  texture.Resource = resource;
+  WriteSrv(textureId);
+  SetRelocatable(textureId);
+  mResidency.OnStreamCompleted(textureId, topMip);
+}
+
+HRESULT TextureStreamer::CreateTexture(const D3D12_RESOURCE_DESC& desc,
+                                       ComPtr<ID3D12Resource>& resource) {
+  return mAllocator->CreateResource(desc, D3D12_RESOURCE_STATE_COMMON,
+                                    nullptr, resource);
+}
+
+TextureCache::Key TextureStreamer::MakeCacheKey(const uint8_t* data,
+                                                size_t size) const {
+  // The startup mip limit decides which mips the texture is created with.
+  Fnv1aHash params;
+  params.AddUint32(mResidency.GetSettings().MinResidentDimension);
+  return TextureCache::MakeKey(data, size, params.Get());
+}
+
+void TextureStreamer::SetRelocatable(uint32_t texture) {
+  mAllocator->SetRelocatable(
+      mTextures[texture].Resource.Get(),
+      [this, texture](const ComPtr<ID3D12Resource>& replacement) {
+        mTextures[texture].Resource = replacement;
+        WriteSrv(texture);
+      });
+}
+
+void TextureStreamer::SetArrayRelocatable(uint32_t array) {
+  mAllocator->SetRelocatable(
+      mArrays[array].Resource.Get(),
+      [this, array](const ComPtr<ID3D12Resource>& replacement) {
+        TextureArray& textureArray = mArrays[array];
+        textureArray.Resource = replacement;
+        for (uint32_t texture : textureArray.Textures) {
+          if (mTextures[texture].Resource) {
+            mTextures[texture].Resource = replacement;
+          }
+        }
+        WriteSrv(replacement.Get(), textureArray.SrvIndex);
+      });
+}
+
+void TextureStreamer::Retire(const ComPtr<ID3D12Resource>& resource) {
+  // The frame being recorded may still read it, and a move would copy it
+  // for nothing.
+  mAllocator->SetRelocatable(resource.Get(), nullptr);
+  mRetired.push_back(resource);
+}
+
+void TextureStreamer::WriteSrv(uint32_t texture) {
+  WriteSrv(mTextures[texture].Resource.Get(), mTextures[texture].SrvIndex);
+}
+
+void TextureStreamer::WriteSrv(ID3D12Resource* resource, UINT srvIndex) {
+  const D3D12_RESOURCE_DESC desc = resource->GetDesc();
+
+  // An array view even for a single texture, so that the shaders sample
+  // standalone and packed textures alike.
+  D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+  srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+  srvDesc.Format = desc.Format;
+  srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+  srvDesc.Texture2DArray.MostDetailedMip = 0;
+  srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+  srvDesc.Texture2DArray.FirstArraySlice = 0;
+  srvDesc.Texture2DArray.ArraySize = desc.DepthOrArraySize;
+  srvDesc.Texture2DArray.ResourceMinLODClamp = 0.0f;
+  mDevice->CreateShaderResourceView(resource, &srvDesc,
+                                    mSrvHeap->GetCpuHandle(srvIndex));
+}
+
+void TextureStreamer::LogStatistics() {
+  if (++mStatsFrames < kStatsWindow) {
+    return;
+  }
+  mStatsFrames = 0;
+  const TextureResidency::Stats stats = mResidency.GetStats();
+  std::ostringstream message;
+  message << "Textures: " << stats.ResidentBytes / (1024.0 * 1024.0) << " of "
+          << mResidency.GetSettings().BudgetBytes / (1024.0 * 1024.0)
+          << " MB resident, " << stats.InFlight << " in flight; "
+          << stats.StreamIns << " stream-ins, " << stats.Evictions
+          << " evictions, " << stats.BudgetMisses << " over budget; "
+          << "peak staging "
+          << mUploader.GetStats().PeakStagingBytes / (1024.0 * 1024.0)
+          << " MB\n";
+  OutputDebugStringA(message.str().c_str());
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Common.h"
+#include "DdsInfo.h"
+#include "DescriptorHeap.h"
+#include "GpuMemoryAllocator.h"
+#include "Structures.h"
+#include "TextureArrayPlanner.h"
+#include "TextureCache.h"
+#include "TextureResidency.h"
+#include "TextureUploader.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Owns the material textures. At startup only mips up to
+// TextureResidency::Settings::MinResidentDimension are loaded; finer mips are
+// read from disk on worker threads as TextureResidency asks for them and
+// uploaded on TextureUploader's copy queue. Those reads cover just the
+// requested mips, located with the DdsInfo parsed at startup. Evictions copy
+// the remaining mips into a smaller resource on the GPU. Either way the
+// texture is recreated with a new mip count and its SRV is rewritten in
+// place once the copy is done, so GetSrvIndex(id) always holds texture id.
+//
+// Loads go through a TextureCache: a file whose contents are already loaded
+// returns the existing texture, and released textures stay loaded for later
+// loads until the cache's budget evicts them.
+//
+// Every SRV is a Texture2DArray view, so textures are addressed by
+// {GetSrvIndex(id), GetArraySlice(id)}. Standalone textures are slice 0 of
+// their own view; PlanTextureArrays() optionally packs small textures into
+// shared arrays.
+//
+// Textures are placed in GpuMemoryAllocator's heaps and may be moved by its
+// Defragment() while they are not being replaced. They are kept in
+// D3D12_RESOURCE_STATE_COMMON between command lists and rely on implicit
+// state promotion. Relies on the frame structure of BoxApp: Update() is
+// called while the previous frame's command list has finished executing.
+class TextureStreamer {
+ public:
+  void Initialize(ID3D12Device* device, GpuMemoryAllocator* allocator,
+                  DescriptorHeap* srvHeap);
+
+  // Whether LoadTexture() maps files instead of reading them into a buffer;
+  // on by default.
+  void SetMemoryMappedLoads(bool enabled) { mMemoryMappedLoads = enabled; }
+  // Scans the headers of the files about to be loaded, plans which to pack
+  // into Texture2DArrays with TextureArrayPlanner and creates the arrays; a
+  // later LoadTexture() of a planned file fills its slice. Slices cannot
+  // stream on their own, so only textures fully loaded at startup are
+  // packed: settings.MaxDimension is capped at MinResidentDimension. Files
+  // with the same contents, which LoadTexture() turns into one texture, are
+  // planned one slice; candidates are small, so they are read in full to
+  // find them. Call before the first LoadTexture(); logs the plan.
+  void PlanTextureArrays(const std::vector<std::wstring>& paths,
+                         TextureArrayPlanner::Settings settings);
+  // Loads the startup mips of a DDS file and returns the texture id, adding
+  // a reference to it. Files with the same contents share one texture. The
+  // upload is batched with the others until FinishLoading(). Throws
+  // std::runtime_error if the file cannot be read or srvHeap has no free
+  // slot for its SRV.
+  int LoadTexture(const std::wstring& path);
+  // Drops the reference LoadTexture() added. The texture stays valid until
+  // the cache evicts it; its resource and SRV slot are freed on the next
+  // Update().
+  void ReleaseTexture(int id);
+  // Waits for the startup uploads and logs their and the cache's statistics.
+  void FinishLoading();
+  UINT GetTextureCount() const {
+    return static_cast<UINT>(mTextures.size());
+  }
+  // Heap index of the texture's Texture2DArray SRV and its slice in it.
+  UINT GetSrvIndex(int id) const { return mTextures[id].SrvIndex; }
+  UINT GetArraySlice(int id) const { return mTextures[id].Slice; }
+
+  // Requests every texture of the visible submesh instances' materials at
+  // the resolution their projected bounds cover.
+  void RequestVisibleTextures(
+      const ModelGeometry& modelGeometry,
+      const std::vector<SubmeshInstance>& instances,
+      const std::vector<UINT>& visibleInstances,
+      const DirectX::SimpleMath::Vector3& cameraPosition, float proj22,
+      float viewportHeight);
+
+  // Swaps in finished uploads, uploads completed reads and starts new ones.
+  // Evictions are recorded on cmdList ahead of the frame's draws.
+  void Update(ID3D12GraphicsCommandList* cmdList);
+
+  TextureResidency& GetResidency() { return mResidency; }
+  // Sets the cache budget, destroying whatever it evicts.
+  void SetCacheSettings(const TextureCache::Settings& settings);
+  TextureCache::Stats GetCacheStats() const { return mCache.GetStats(); }
+
+ private:
+  struct StreamedTexture {
+    std::wstring Path;
+    // Null once the cache has evicted the texture.
+    ComPtr<ID3D12Resource> Resource;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t MipCount = 0;
+    // Where each mip is in the file; streamed textures are 2D with one
+    // slice.
+    DdsInfo Layout;
+    UINT SrvIndex = 0;
+    // Index in mArrays if packed; Resource and SrvIndex are then the
+    // array's.
+    uint32_t Array = TextureArrayPlanner::kNotPacked;
+    UINT Slice = 0;
+  };
+  struct TextureArray {
+    ComPtr<ID3D12Resource> Resource;
+    UINT SrvIndex = 0;
+    // Loaded slices; the array is destroyed with the last of them.
+    std::vector<uint32_t> Textures;
+    uint32_t LiveSlices = 0;
+  };
+  struct PendingRead {
+    uint32_t Texture = 0;
+    uint32_t TopMip = 0;
+    std::future<std::vector<uint8_t>> Data;
+  };
+  struct PendingUpload {
+    uint32_t Texture = 0;
+    uint32_t TopMip = 0;
+    ComPtr<ID3D12Resource> Resource;
+    uint64_t FenceValue = 0;
+  };
+
+  void CompleteRead(PendingRead& read);
+  void Evict(ID3D12GraphicsCommandList* cmdList, uint32_t texture,
+             uint32_t topMip);
+  void DestroyTextures(const std::vector<uint32_t>& textures);
+  // Fills a planned slice; false if the array is gone or the file no longer
+  // matches it.
+  bool LoadIntoArray(StreamedTexture& texture, const uint8_t* data,
+                     const TextureArrayPlanner::Placement& placement);
+  HRESULT CreateTexture(const D3D12_RESOURCE_DESC& desc,
+                        ComPtr<ID3D12Resource>& resource);
+  TextureCache::Key MakeCacheKey(const uint8_t* data, size_t size) const;
+  // Lets the allocator move the live resource of texture.
+  void SetRelocatable(uint32_t texture);
+  void SetArrayRelocatable(uint32_t array);
+  // Keeps resource alive and in place until the next Update().
+  void Retire(const ComPtr<ID3D12Resource>& resource);
+  void WriteSrv(uint32_t texture);
+  void WriteSrv(ID3D12Resource* resource, UINT srvIndex);
+  void LogStatistics();
+
+  ID3D12Device* mDevice = nullptr;
+  GpuMemoryAllocator* mAllocator = nullptr;
+  DescriptorHeap* mSrvHeap = nullptr;
+
+  bool mMemoryMappedLoads = true;
+  TextureResidency mResidency;
+  TextureCache mCache;
+  std::vector<StreamedTexture> mTextures;
+  std::vector<TextureArray> mArrays;
+  // Files planned into an array slice that LoadTexture() has not loaded
+  // yet.
+  std::unordered_map<std::wstring, TextureArrayPlanner::Placement>
+      mPlannedSlices;
+  std::vector<PendingRead> mPendingReads;
+  std::vector<PendingUpload> mPendingUploads;
+  // Replaced textures referenced by the frame being recorded; released on
+  // the next Update().
+  std::vector<ComPtr<ID3D12Resource>> mRetired;
+  // SRV slots of destroyed textures, freed on the next Update().
+  std::vector<UINT> mRetiredSrvs;
+  // Declared last so it is destroyed first: it waits for the copy queue
+  // before the textures above are released.
+  TextureUploader mUploader;
+
+  static constexpr UINT kStatsWindow = 120;
+  UINT mStatsFrames = 0;
+  std::chrono::steady_clock::time_point mLoadStart;
+};
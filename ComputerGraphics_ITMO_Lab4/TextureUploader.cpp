@@ -0,0 +1,220 @@
+#include "TextureUploader.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace {
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+}  // namespace
+
+TextureUploader::~TextureUploader() {
+  if (mQueue != nullptr && mBatchFenceValue > 1) {
+    mQueueSync.WaitOnCpu(mBatchFenceValue - 1);
+  }
+}
+
+void TextureUploader::Initialize(ID3D12Device* device) {
+  mDevice = device;
+  D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+  queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+  queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+  ThrowIfFailed(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mQueue)));
+  mQueueSync.Initialize(device, mQueue.Get());
+
+  Allocator allocator;
+  ThrowIfFailed(device->CreateCommandAllocator(
+      D3D12_COMMAND_LIST_TYPE_COPY,
+      IID_PPV_ARGS(&allocator.CommandAllocator)));
+  ThrowIfFailed(device->CreateCommandList(
+      0, D3D12_COMMAND_LIST_TYPE_COPY, allocator.CommandAllocator.Get(),
+      nullptr, IID_PPV_ARGS(&mCommandList)));
+  ThrowIfFailed(mCommandList->Close());
+  mAllocators.push_back(allocator);
+}
+
+uint64_t TextureUploader::Upload(
+    ID3D12Resource* texture,
+    const std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+    UINT firstSubresource) {
+  const auto start = std::chrono::steady_clock::now();
+  const D3D12_RESOURCE_DESC desc = texture->GetDesc();
+  const UINT count = static_cast<UINT>(subresources.size());
+  std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(count);
+  std::vector<UINT> rowCounts(count);
+  std::vector<UINT64> rowSizes(count);
+  UINT64 totalBytes = 0;
+  mDevice->GetCopyableFootprints(&desc, firstSubresource, count, 0,
+                                 layouts.data(), rowCounts.data(),
+                                 rowSizes.data(), &totalBytes);
+
+  uint64_t offset = 0;
+  Page& page = Allocate(totalBytes, offset);
+  if (!mRecording) {
+    BeginBatch();
+  }
+  page.FenceValue = mBatchFenceValue;
+  page.Used = offset + totalBytes;
+
+  for (UINT i = 0; i < count; ++i) {
+    const D3D12_SUBRESOURCE_DATA& source = subresources[i];
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = layouts[i];
+    footprint.Offset += offset;
+    uint8_t* destination = page.Mapped + footprint.Offset;
+    const UINT rowPitch = footprint.Footprint.RowPitch;
+    for (UINT z = 0; z < footprint.Footprint.Depth; ++z) {
+      for (UINT row = 0; row < rowCounts[i]; ++row) {
+        std::memcpy(destination +
+                        static_cast<size_t>(z * rowCounts[i] + row) * rowPitch,
+                    static_cast<const uint8_t*>(source.pData) +
+                        z * source.SlicePitch + row * source.RowPitch,
+                    static_cast<size_t>(rowSizes[i]));
+      }
+    }
+
+    const CD3DX12_TEXTURE_COPY_LOCATION dst(texture, firstSubresource + i);
+    const CD3DX12_TEXTURE_COPY_LOCATION src(page.Buffer.Get(), footprint);
+    mCommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+  }
+
+  mStats.UploadedBytes += totalBytes;
+  ++mStats.Textures;
+  mStats.Milliseconds += MillisecondsSince(start);
+  return mBatchFenceValue;
+}
+
+void TextureUploader::Submit() {
+  if (!mRecording) {
+    return;
+  }
+  ThrowIfFailed(mCommandList->Close());
+  ID3D12CommandList* lists[] = {mCommandList.Get()};
+  mQueue->ExecuteCommandLists(1, lists);
+  mQueueSync.Signal(mBatchFenceValue);
+  ++mBatchFenceValue;
+  ++mStats.Batches;
+  mRecording = false;
+}
+
+void TextureUploader::Flush() {
+  const auto start = std::chrono::steady_clock::now();
+  Submit();
+  mQueueSync.WaitOnCpu(mBatchFenceValue - 1);
+  RecyclePages();
+  mStats.Milliseconds += MillisecondsSince(start);
+}
+
+TextureUploader::Page& TextureUploader::Allocate(uint64_t size,
+                                                 uint64_t& offset) {
+  constexpr uint64_t kAlignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+  if (size > kPageBytes) {
+    RecyclePages();
+    offset = 0;
+    mDedicatedPages.push_back(CreatePage(size));
+    return mDedicatedPages.back();
+  }
+
+  if (mCurrentPage < mPages.size()) {
+    Page& page = mPages[mCurrentPage];
+    if (AlignUp(page.Used, kAlignment) + size <= page.Size) {
+      offset = AlignUp(page.Used, kAlignment);
+      return page;
+    }
+  }
+
+  // The current page is full: move on to a page no batch still copies from,
+  // growing the pool up to its limit before waiting for the oldest batch.
+  mCurrentPage = std::numeric_limits<size_t>::max();
+  RecyclePages();
+  for (size_t i = 0; i < mPages.size(); ++i) {
+    if (mPages[i].Used == 0) {
+      mCurrentPage = i;
+      break;
+    }
+  }
+  if (mCurrentPage == std::numeric_limits<size_t>::max()) {
+    if (mPages.size() < kMaxPooledPages) {
+      mPages.push_back(CreatePage(kPageBytes));
+      mCurrentPage = mPages.size() - 1;
+    } else {
+      Submit();
+      size_t oldest = 0;
+      for (size_t i = 1; i < mPages.size(); ++i) {
+        if (mPages[i].FenceValue < mPages[oldest].FenceValue) {
+          oldest = i;
+        }
+      }
+      mQueueSync.WaitOnCpu(mPages[oldest].FenceValue);
+      RecyclePages();
+      mCurrentPage = oldest;
+    }
+  }
+  offset = 0;
+  return mPages[mCurrentPage];
+}
+
+TextureUploader::Page TextureUploader::CreatePage(uint64_t size) {
+  Page page;
+  page.Size = size;
+  const CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+  const CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+  ThrowIfFailed(mDevice->CreateCommittedResource(
+      &heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+      D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+      IID_PPV_ARGS(&page.Buffer)));
+  // Upload pages stay mapped for their whole lifetime; the CPU never reads.
+  const D3D12_RANGE readRange = {0, 0};
+  ThrowIfFailed(page.Buffer->Map(0, &readRange,
+                                 reinterpret_cast<void**>(&page.Mapped)));
+
+  mStagingBytes += size;
+  mStats.PeakStagingBytes = std::max(mStats.PeakStagingBytes, mStagingBytes);
+  return page;
+}
+
+void TextureUploader::RecyclePages() {
+  const uint64_t completed = mQueueSync.GetCompletedValue();
+  for (size_t i = 0; i < mPages.size(); ++i) {
+    if (i != mCurrentPage && mPages[i].FenceValue <= completed) {
+      mPages[i].Used = 0;
+    }
+  }
+  for (auto it = mDedicatedPages.begin(); it != mDedicatedPages.end();) {
+    if (it->FenceValue <= completed) {
+      mStagingBytes -= it->Size;
+      it = mDedicatedPages.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void TextureUploader::BeginBatch() {
+  const uint64_t completed = mQueueSync.GetCompletedValue();
+  Allocator* allocator = nullptr;
+  for (Allocator& candidate : mAllocators) {
+    if (candidate.FenceValue <= completed) {
+      allocator = &candidate;
+      break;
+    }
+  }
+  if (allocator == nullptr) {
+    mAllocators.emplace_back();
+    allocator = &mAllocators.back();
+    ThrowIfFailed(mDevice->CreateCommandAllocator(
+        D3D12_COMMAND_LIST_TYPE_COPY,
+        IID_PPV_ARGS(&allocator->CommandAllocator)));
+  }
+  ThrowIfFailed(allocator->CommandAllocator->Reset());
+  ThrowIfFailed(
+      mCommandList->Reset(allocator->CommandAllocator.Get(), nullptr));
+  allocator->FenceValue = mBatchFenceValue;
+  mRecording = true;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Common.h"
+#include "D3D12QueueSync.h"
+
+using Microsoft::WRL::ComPtr;
+
+// Uploads texture data on a dedicated copy queue. Data is copied into a pool
+// of persistently mapped staging pages and the copies are recorded into the
+// current batch; a batch is submitted when Submit() or Flush() is called or
+// when the pool runs out of pages. A page is reused once the fence of the
+// last batch that used it has completed. Subresources larger than a page get
+// a dedicated page that is released after its batch.
+//
+// Textures must be in D3D12_RESOURCE_STATE_COMMON. After the batch completes
+// they decay back to COMMON and are promoted implicitly by the first read on
+// the graphics queue, so no barriers are recorded anywhere.
+class TextureUploader {
+ public:
+  struct Stats {
+    uint64_t UploadedBytes = 0;
+    uint32_t Textures = 0;
+    uint32_t Batches = 0;
+    // Largest total size of the staging pages alive at once.
+    uint64_t PeakStagingBytes = 0;
+    // CPU time spent in Upload() and Flush(), waits included.
+    double Milliseconds = 0.0;
+  };
+
+  static constexpr uint64_t kPageBytes = 32ull * 1024 * 1024;
+  static constexpr size_t kMaxPooledPages = 2;
+
+  TextureUploader() = default;
+  TextureUploader(const TextureUploader&) = delete;
+  TextureUploader& operator=(const TextureUploader&) = delete;
+  // Waits for the submitted batches; their pages and allocators must outlive
+  // them.
+  ~TextureUploader();
+
+  void Initialize(ID3D12Device* device);
+
+  // Copies subresources into texture, starting at subresource
+  // firstSubresource, e.g. one slice of an array. The source memory may be
+  // freed on return. Returns the fence value that signals the copies are
+  // done; it is reached only after Submit().
+  uint64_t Upload(ID3D12Resource* texture,
+                  const std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+                  UINT firstSubresource = 0);
+  // Submits the batch being recorded, if any.
+  void Submit();
+  bool IsComplete(uint64_t fenceValue) const {
+    return mQueueSync.GetCompletedValue() >= fenceValue;
+  }
+  // Submits the current batch and waits for every batch on the CPU.
+  void Flush();
+
+  const Stats& GetStats() const { return mStats; }
+
+ private:
+  struct Page {
+    ComPtr<ID3D12Resource> Buffer;
+    uint8_t* Mapped = nullptr;
+    uint64_t Size = 0;
+    uint64_t Used = 0;
+    // Last batch that copies from this page.
+    uint64_t FenceValue = 0;
+  };
+  struct Allocator {
+    ComPtr<ID3D12CommandAllocator> CommandAllocator;
+    uint64_t FenceValue = 0;
+  };
+
+  // Returns the page that holds size more bytes at an aligned offset, which
+  // is written to offset. May submit the current batch and wait for an
+  // earlier one.
+  Page& Allocate(uint64_t size, uint64_t& offset);
+  Page CreatePage(uint64_t size);
+  void RecyclePages();
+  void BeginBatch();
+
+  ID3D12Device* mDevice = nullptr;
+  ComPtr<ID3D12CommandQueue> mQueue;
+  ComPtr<ID3D12GraphicsCommandList> mCommandList;
+  D3D12QueueSync mQueueSync;
+  std::vector<Allocator> mAllocators;
+
+  // Pooled pages, at most kMaxPooledPages.
+  std::vector<Page> mPages;
+  size_t mCurrentPage = std::numeric_limits<size_t>::max();
+  std::vector<Page> mDedicatedPages;
+  uint64_t mStagingBytes = 0;
+
+  bool mRecording = false;
+  // Fence value of the batch being recorded.
+  uint64_t mBatchFenceValue = 1;
+
+  Stats mStats;
+};
@@ -0,0 +1,329 @@
+#include "TlsfAllocator.h"
+
+#include <stdexcept>
+
+namespace {
+uint32_t FloorLog2(uint64_t value) {
+  uint32_t result = 0;
+  while (value >>= 1) {
+    ++result;
+  }
+  return result;
+}
+
+uint32_t LowestBit(uint64_t mask) {
+  uint32_t bit = 0;
+  while ((mask & 1) == 0) {
+    mask >>= 1;
+    ++bit;
+  }
+  return bit;
+}
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+}  // namespace
+
+TlsfAllocator::TlsfAllocator(uint64_t size) { Reset(size); }
+
+void TlsfAllocator::Reset(uint64_t size) {
+  mSize = size;
+  mUsedBytes = 0;
+  mBlocks.clear();
+  mUnusedBlocks.clear();
+  mAllocated.clear();
+  mFirstLevelBitmap = 0;
+  for (uint32_t fl = 0; fl < kFirstLevelCount; ++fl) {
+    mSecondLevelBitmaps[fl] = 0;
+    for (uint32_t sl = 0; sl < kSecondLevelCount; ++sl) {
+      mFreeHeads[fl][sl] = kNone;
+    }
+  }
+  if (size > 0) {
+    // Block 0 always starts at offset 0: merges keep the lower block.
+    const uint32_t block = NewBlock();
+    mBlocks[block].Size = size;
+    InsertFree(block);
+  }
+}
+
+void TlsfAllocator::MapSize(uint64_t size, uint32_t& firstLevel,
+                            uint32_t& secondLevel) {
+  if (size < kSecondLevelCount) {
+    firstLevel = 0;
+    secondLevel = static_cast<uint32_t>(size);
+    return;
+  }
+  const uint32_t log2 = FloorLog2(size);
+  firstLevel = log2 - kSecondLevelLog2 + 1;
+  secondLevel = static_cast<uint32_t>(size >> (log2 - kSecondLevelLog2)) -
+                kSecondLevelCount;
+}
+
+uint32_t TlsfAllocator::FindFreeBlock(uint64_t size) const {
+  if (size > mSize) {
+    return kNone;
+  }
+  // Rounding up to the next size class makes every block of the class found
+  // large enough.
+  uint64_t rounded = size;
+  if (size >= kSecondLevelCount) {
+    rounded += (1ull << (FloorLog2(size) - kSecondLevelLog2)) - 1;
+  }
+  uint32_t fl = 0;
+  uint32_t sl = 0;
+  MapSize(rounded, fl, sl);
+  uint32_t secondLevelMask = mSecondLevelBitmaps[fl] & (~0u << sl);
+  if (secondLevelMask == 0) {
+    const uint64_t firstLevelMask = mFirstLevelBitmap & (~0ull << (fl + 1));
+    if (firstLevelMask != 0) {
+      fl = LowestBit(firstLevelMask);
+      secondLevelMask = mSecondLevelBitmaps[fl];
+    }
+  }
+  if (secondLevelMask != 0) {
+    return mFreeHeads[fl][LowestBit(secondLevelMask)];
+  }
+
+  // The class of size itself may still hold a block that fits exactly.
+  MapSize(size, fl, sl);
+  for (uint32_t block = mFreeHeads[fl][sl]; block != kNone;
+       block = mBlocks[block].NextFree) {
+    if (mBlocks[block].Size >= size) {
+      return block;
+    }
+  }
+  return kNone;
+}
+
+uint64_t TlsfAllocator::Allocate(uint64_t size, uint64_t alignment) {
+  if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+    throw std::invalid_argument(
+        "Allocation needs a size and a power-of-two alignment");
+  }
+  uint32_t block = FindFreeBlock(size);
+  if (block != kNone) {
+    const Block& candidate = mBlocks[block];
+    const uint64_t padding =
+        AlignUp(candidate.Offset, alignment) - candidate.Offset;
+    if (padding + size > candidate.Size) {
+      block = kNone;
+    }
+  }
+  if (block == kNone && alignment > 1) {
+    block = FindFreeBlock(size + alignment - 1);
+  }
+  if (block == kNone) {
+    return kInvalidOffset;
+  }
+
+  RemoveFree(block);
+  const uint64_t padding =
+      AlignUp(mBlocks[block].Offset, alignment) - mBlocks[block].Offset;
+  if (padding > 0) {
+    // The previous block is in use, otherwise it would have been merged, so
+    // the padding stays a separate free block.
+    const uint32_t rest = Split(block, padding);
+    InsertFree(block);
+    block = rest;
+  }
+  const uint32_t rest = Split(block, size);
+  if (rest != kNone) {
+    InsertFree(rest);
+  }
+
+  mBlocks[block].Free = false;
+  mAllocated[mBlocks[block].Offset] = block;
+  mUsedBytes += size;
+  return mBlocks[block].Offset;
+}
+
+void TlsfAllocator::Free(uint64_t offset) {
+  const auto it = mAllocated.find(offset);
+  if (it == mAllocated.end()) {
+    throw std::invalid_argument("Offset was not allocated");
+  }
+  uint32_t block = it->second;
+  mAllocated.erase(it);
+  mUsedBytes -= mBlocks[block].Size;
+  mBlocks[block].Free = true;
+
+  const uint32_t next = mBlocks[block].Next;
+  if (next != kNone && mBlocks[next].Free) {
+    RemoveFree(next);
+    MergeWithNext(block);
+  }
+  const uint32_t prev = mBlocks[block].Prev;
+  if (prev != kNone && mBlocks[prev].Free) {
+    RemoveFree(prev);
+    MergeWithNext(prev);
+    block = prev;
+  }
+  InsertFree(block);
+}
+
+uint64_t TlsfAllocator::GetLargestFreeBlock() const {
+  if (mFirstLevelBitmap == 0) {
+    return 0;
+  }
+  const uint32_t fl = FloorLog2(mFirstLevelBitmap);
+  const uint32_t sl = FloorLog2(mSecondLevelBitmaps[fl]);
+  uint64_t largest = 0;
+  for (uint32_t block = mFreeHeads[fl][sl]; block != kNone;
+       block = mBlocks[block].NextFree) {
+    if (mBlocks[block].Size > largest) {
+      largest = mBlocks[block].Size;
+    }
+  }
+  return largest;
+}
+
+uint64_t TlsfAllocator::GetAllocationSize(uint64_t offset) const {
+  const auto it = mAllocated.find(offset);
+  return it != mAllocated.end() ? mBlocks[it->second].Size : 0;
+}
+
+uint32_t TlsfAllocator::NewBlock() {
+  if (!mUnusedBlocks.empty()) {
+    const uint32_t block = mUnusedBlocks.back();
+    mUnusedBlocks.pop_back();
+    mBlocks[block] = Block();
+    return block;
+  }
+  mBlocks.emplace_back();
+  return static_cast<uint32_t>(mBlocks.size()) - 1;
+}
+
+void TlsfAllocator::InsertFree(uint32_t block) {
+  uint32_t fl = 0;
+  uint32_t sl = 0;
+  MapSize(mBlocks[block].Size, fl, sl);
+  Block& inserted = mBlocks[block];
+  inserted.Free = true;
+  inserted.PrevFree = kNone;
+  inserted.NextFree = mFreeHeads[fl][sl];
+  if (inserted.NextFree != kNone) {
+    mBlocks[inserted.NextFree].PrevFree = block;
+  }
+  mFreeHeads[fl][sl] = block;
+  mFirstLevelBitmap |= 1ull << fl;
+  mSecondLevelBitmaps[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t block) {
+  uint32_t fl = 0;
+  uint32_t sl = 0;
+  MapSize(mBlocks[block].Size, fl, sl);
+  Block& removed = mBlocks[block];
+  if (removed.PrevFree != kNone) {
+    mBlocks[removed.PrevFree].NextFree = removed.NextFree;
+  } else {
+    mFreeHeads[fl][sl] = removed.NextFree;
+  }
+  if (removed.NextFree != kNone) {
+    mBlocks[removed.NextFree].PrevFree = removed.PrevFree;
+  }
+  removed.PrevFree = kNone;
+  removed.NextFree = kNone;
+  if (mFreeHeads[fl][sl] == kNone) {
+    mSecondLevelBitmaps[fl] &= ~(1u << sl);
+    if (mSecondLevelBitmaps[fl] == 0) {
+      mFirstLevelBitmap &= ~(1ull << fl);
+    }
+  }
+}
+
+uint32_t TlsfAllocator::Split(uint32_t block, uint64_t size) {
+  if (mBlocks[block].Size == size) {
+    return kNone;
+  }
+  const uint32_t rest = NewBlock();
+  Block& front = mBlocks[block];
+  Block& back = mBlocks[rest];
+  back.Offset = front.Offset + size;
+  back.Size = front.Size - size;
+  back.Prev = block;
+  back.Next = front.Next;
+  if (back.Next != kNone) {
+    mBlocks[back.Next].Prev = rest;
+  }
+  front.Next = rest;
+  front.Size = size;
+  return rest;
+}
+
+void TlsfAllocator::MergeWithNext(uint32_t block) {
+  const uint32_t next = mBlocks[block].Next;
+  mBlocks[block].Size += mBlocks[next].Size;
+  mBlocks[block].Next = mBlocks[next].Next;
+  if (mBlocks[block].Next != kNone) {
+    mBlocks[mBlocks[block].Next].Prev = block;
+  }
+  mUnusedBlocks.push_back(next);
+}
+
+bool TlsfAllocator::Validate() const {
+  if (mSize == 0) {
+    return mBlocks.empty() && mAllocated.empty() && mFirstLevelBitmap == 0;
+  }
+  uint64_t offset = 0;
+  uint64_t usedBytes = 0;
+  uint32_t usedBlocks = 0;
+  uint32_t freeBlocks = 0;
+  uint32_t prev = kNone;
+  for (uint32_t block = 0; block != kNone; block = mBlocks[block].Next) {
+    const Block& current = mBlocks[block];
+    if (current.Offset != offset || current.Size == 0 ||
+        current.Prev != prev) {
+      return false;
+    }
+    if (current.Free) {
+      if (prev != kNone && mBlocks[prev].Free) {
+        return false;
+      }
+      ++freeBlocks;
+    } else {
+      const auto it = mAllocated.find(current.Offset);
+      if (it == mAllocated.end() || it->second != block) {
+        return false;
+      }
+      usedBytes += current.Size;
+      ++usedBlocks;
+    }
+    offset += current.Size;
+    prev = block;
+  }
+  if (offset != mSize || usedBytes != mUsedBytes ||
+      usedBlocks != mAllocated.size()) {
+    return false;
+  }
+
+  uint32_t listedBlocks = 0;
+  for (uint32_t fl = 0; fl < kFirstLevelCount; ++fl) {
+    const bool firstLevelSet = (mFirstLevelBitmap >> fl) & 1;
+    if (firstLevelSet != (mSecondLevelBitmaps[fl] != 0)) {
+      return false;
+    }
+    for (uint32_t sl = 0; sl < kSecondLevelCount; ++sl) {
+      const bool secondLevelSet = (mSecondLevelBitmaps[fl] >> sl) & 1;
+      if (secondLevelSet != (mFreeHeads[fl][sl] != kNone)) {
+        return false;
+      }
+      uint32_t prevFree = kNone;
+      for (uint32_t block = mFreeHeads[fl][sl]; block != kNone;
+           block = mBlocks[block].NextFree) {
+        uint32_t blockFl = 0;
+        uint32_t blockSl = 0;
+        MapSize(mBlocks[block].Size, blockFl, blockSl);
+        if (!mBlocks[block].Free || mBlocks[block].PrevFree != prevFree ||
+            blockFl != fl || blockSl != sl) {
+          return false;
+        }
+        ++listedBlocks;
+        prevFree = block;
+      }
+    }
+  }
+  return listedBlocks == freeBlocks;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Two-level segregated fit allocator over the byte range [0, size). Only
+// offsets are managed, so the same code places resources in an ID3D12Heap
+// and runs in tests without a GPU. Allocate and Free are O(1) apart from the
+// hash lookup of the freed offset; adjacent free blocks are merged
+// immediately.
+class TlsfAllocator {
+ public:
+  static constexpr uint64_t kInvalidOffset = ~0ull;
+
+  explicit TlsfAllocator(uint64_t size = 0);
+
+  // Drops every allocation and manages [0, size) from now on.
+  void Reset(uint64_t size);
+
+  // Returns the offset of size bytes aligned to alignment, a power of two,
+  // or kInvalidOffset if no free block fits.
+  uint64_t Allocate(uint64_t size, uint64_t alignment);
+  // offset must have been returned by Allocate and not freed since.
+  void Free(uint64_t offset);
+
+  uint64_t GetSize() const { return mSize; }
+  uint64_t GetUsedBytes() const { return mUsedBytes; }
+  uint64_t GetFreeBytes() const { return mSize - mUsedBytes; }
+  uint32_t GetAllocationCount() const {
+    return static_cast<uint32_t>(mAllocated.size());
+  }
+  uint64_t GetLargestFreeBlock() const;
+  // Size of the allocation at offset, or 0 if there is none.
+  uint64_t GetAllocationSize(uint64_t offset) const;
+
+  // Checks the block list, the free lists and the bitmaps against each
+  // other. Meant for tests; O(blocks).
+  bool Validate() const;
+
+ private:
+  static constexpr uint32_t kSecondLevelLog2 = 4;
+  static constexpr uint32_t kSecondLevelCount = 1u << kSecondLevelLog2;
+  static constexpr uint32_t kFirstLevelCount = 64 - kSecondLevelLog2 + 1;
+  static constexpr uint32_t kNone = ~0u;
+
+  struct Block {
+    uint64_t Offset = 0;
+    uint64_t Size = 0;
+    // Physical neighbours, in address order.
+    uint32_t Prev = kNone;
+    uint32_t Next = kNone;
+    // Links in the free list of the block's size class.
+    uint32_t PrevFree = kNone;
+    uint32_t NextFree = kNone;
+    bool Free = false;
+  };
+
+  static void MapSize(uint64_t size, uint32_t& firstLevel,
+                      uint32_t& secondLevel);
+  // Finds a free block no smaller than size, or kNone.
+  uint32_t FindFreeBlock(uint64_t size) const;
+  uint32_t NewBlock();
+  void InsertFree(uint32_t block);
+  void RemoveFree(uint32_t block);
+  // Splits size bytes off the front of block; the rest becomes a new free
+  // block. Returns the rest, or kNone if nothing is left.
+  uint32_t Split(uint32_t block, uint64_t size);
+  void MergeWithNext(uint32_t block);
+
+  uint64_t mSize = 0;
+  uint64_t mUsedBytes = 0;
+  std::vector<Block> mBlocks;
+  std::vector<uint32_t> mUnusedBlocks;
+  uint64_t mFirstLevelBitmap = 0;
+  uint32_t mSecondLevelBitmaps[kFirstLevelCount] = {};
+  uint32_t mFreeHeads[kFirstLevelCount][kSecondLevelCount];
+  // Allocated offset -> block.
+  std::unordered_map<uint64_t, uint32_t> mAllocated;
+};
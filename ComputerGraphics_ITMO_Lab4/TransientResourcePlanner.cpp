@@ -0,0 +1,227 @@
+#include "TransientResourcePlanner.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+void TransientResourcePlanner::Reset() {
+  mResources.clear();
+  mPlacements.clear();
+  mPasses.clear();
+  mHeapSize = 0;
+  mPeakTransientBytes = 0;
+  mUnaliasedBytes = 0;
+  mCompiled = false;
+}
+
+TransientResourcePlanner::ResourceHandle
+TransientResourcePlanner::DeclareResource(const std::string& name,
+                                          uint64_t sizeInBytes,
+                                          uint64_t alignment) {
+  if (sizeInBytes == 0) {
+    throw std::invalid_argument("Transient resource '" + name +
+                                "' has zero size");
+  }
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+    throw std::invalid_argument("Transient resource '" + name +
+                                "' alignment must be a power of two");
+  }
+
+  ResourceDesc desc;
+  desc.Name = name;
+  desc.SizeInBytes = sizeInBytes;
+  desc.Alignment = alignment;
+  mResources.push_back(desc);
+  mPlacements.emplace_back();
+  mCompiled = false;
+  return static_cast<ResourceHandle>(mResources.size() - 1);
+}
+
+uint32_t TransientResourcePlanner::AddPass(
+    const std::string& name, const std::vector<ResourceHandle>& reads,
+    const std::vector<ResourceHandle>& writes) {
+  for (ResourceHandle handle : reads) {
+    if (handle >= mResources.size()) {
+      throw std::out_of_range("Pass '" + name + "' reads unknown resource");
+    }
+  }
+  for (ResourceHandle handle : writes) {
+    if (handle >= mResources.size()) {
+      throw std::out_of_range("Pass '" + name + "' writes unknown resource");
+    }
+  }
+
+  Pass pass;
+  pass.Name = name;
+  pass.Reads = reads;
+  pass.Writes = writes;
+  mPasses.push_back(pass);
+  mCompiled = false;
+  return static_cast<uint32_t>(mPasses.size() - 1);
+}
+
+void TransientResourcePlanner::Compile() {
+  ComputeLifetimes();
+  AssignOffsets();
+  mCompiled = true;
+}
+
+const TransientResourcePlanner::ResourceDesc&
+TransientResourcePlanner::GetResource(ResourceHandle handle) const {
+  if (handle >= mResources.size()) {
+    throw std::out_of_range("Unknown transient resource");
+  }
+  return mResources[handle];
+}
+
+const TransientResourcePlanner::Placement&
+TransientResourcePlanner::GetPlacement(ResourceHandle handle) const {
+  if (!mCompiled) {
+    throw std::logic_error("TransientResourcePlanner::Compile was not called");
+  }
+  if (handle >= mPlacements.size()) {
+    throw std::out_of_range("Unknown transient resource");
+  }
+  return mPlacements[handle];
+}
+
+uint64_t TransientResourcePlanner::AlignUp(uint64_t value,
+                                           uint64_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void TransientResourcePlanner::ComputeLifetimes() {
+  for (auto& placement : mPlacements) {
+    placement = Placement();
+  }
+
+  for (uint32_t passIndex = 0; passIndex < mPasses.size(); ++passIndex) {
+    auto touch = [&](ResourceHandle handle) {
+      auto& placement = mPlacements[handle];
+      if (placement.FirstPass == kInvalidPass) {
+        placement.FirstPass = passIndex;
+      }
+      placement.LastPass = passIndex;
+    };
+    for (ResourceHandle handle : mPasses[passIndex].Writes) touch(handle);
+    for (ResourceHandle handle : mPasses[passIndex].Reads) touch(handle);
+  }
+
+  mUnaliasedBytes = 0;
+  mPeakTransientBytes = 0;
+  for (uint32_t passIndex = 0; passIndex < mPasses.size(); ++passIndex) {
+    uint64_t liveBytes = 0;
+    for (size_t i = 0; i < mResources.size(); ++i) {
+      const auto& placement = mPlacements[i];
+      if (placement.FirstPass <= passIndex && passIndex <= placement.LastPass) {
+        liveBytes += mResources[i].SizeInBytes;
+      }
+    }
+    mPeakTransientBytes = std::max(mPeakTransientBytes, liveBytes);
+  }
+  for (size_t i = 0; i < mResources.size(); ++i) {
+    if (mPlacements[i].FirstPass != kInvalidPass) {
+      mUnaliasedBytes +=
+          AlignUp(mResources[i].SizeInBytes, mResources[i].Alignment);
+    }
+  }
+}
+
+void TransientResourcePlanner::AssignOffsets() {
+  auto lifetimesOverlap = [&](size_t a, size_t b) {
+    const auto& pa = mPlacements[a];
+    const auto& pb = mPlacements[b];
+    return pa.FirstPass <= pb.LastPass && pb.FirstPass <= pa.LastPass;
+  };
+  auto memoryOverlaps = [&](size_t a, size_t b) {
+    const uint64_t aBegin = mPlacements[a].HeapOffset;
+    const uint64_t aEnd = aBegin + mResources[a].SizeInBytes;
+    const uint64_t bBegin = mPlacements[b].HeapOffset;
+    const uint64_t bEnd = bBegin + mResources[b].SizeInBytes;
+    return aBegin < bEnd && bBegin < aEnd;
+  };
+
+  std::vector<size_t> order;
+  for (size_t i = 0; i < mResources.size(); ++i) {
+    if (mPlacements[i].FirstPass != kInvalidPass) {
+      order.push_back(i);
+    }
+  }
+  // Large resources go first so smaller ones can fill the gaps.
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    if (mResources[a].SizeInBytes != mResources[b].SizeInBytes) {
+      return mResources[a].SizeInBytes > mResources[b].SizeInBytes;
+    }
+    return mPlacements[a].FirstPass < mPlacements[b].FirstPass;
+  });
+
+  mHeapSize = 0;
+  std::vector<size_t> placed;
+  for (size_t resource : order) {
+    std::vector<size_t> conflicts;
+    for (size_t other : placed) {
+      if (lifetimesOverlap(resource, other)) {
+        conflicts.push_back(other);
+      }
+    }
+    std::sort(conflicts.begin(), conflicts.end(), [&](size_t a, size_t b) {
+      return mPlacements[a].HeapOffset < mPlacements[b].HeapOffset;
+    });
+
+    const uint64_t size = mResources[resource].SizeInBytes;
+    const uint64_t alignment = mResources[resource].Alignment;
+    uint64_t offset = 0;
+    for (size_t other : conflicts) {
+      const uint64_t otherBegin = mPlacements[other].HeapOffset;
+      const uint64_t otherEnd = otherBegin + mResources[other].SizeInBytes;
+      if (offset + size <= otherBegin) {
+        break;
+      }
+      offset = std::max(offset, AlignUp(otherEnd, alignment));
+    }
+
+    mPlacements[resource].HeapOffset = offset;
+    mHeapSize = std::max(mHeapSize, offset + size);
+    placed.push_back(resource);
+  }
+
+  // Resources sharing memory never overlap in time. The predecessor is the
+  // one that ends last before this resource starts; passes are ranked so
+  // that ranges ending in the previous frame come before those of this one.
+  const uint32_t passCount = static_cast<uint32_t>(mPasses.size());
+  for (size_t resource : placed) {
+    auto& placement = mPlacements[resource];
+    uint32_t latestRank = 0;
+    for (size_t other : placed) {
+      if (other == resource || !memoryOverlaps(resource, other)) {
+        continue;
+      }
+      const uint32_t lastPass = mPlacements[other].LastPass;
+      const uint32_t rank =
+          lastPass < placement.FirstPass ? lastPass + passCount : lastPass;
+      if (placement.AliasedPredecessor == kNoResource || rank > latestRank) {
+        placement.AliasedPredecessor = static_cast<ResourceHandle>(other);
+        latestRank = rank;
+      }
+    }
+  }
+}
+
+std::string TransientResourcePlanner::BuildReport() const {
+  std::ostringstream report;
+  report << "Transient resources: " << mResources.size() << " in "
+         << mPasses.size() << " passes, heap " << mHeapSize / 1024
+         << " KB, peak live " << mPeakTransientBytes / 1024
+         << " KB, unaliased " << mUnaliasedBytes / 1024 << " KB\n";
+  for (size_t i = 0; i < mResources.size(); ++i) {
+    const auto& placement = mPlacements[i];
+    report << "  " << mResources[i].Name << ": offset " << placement.HeapOffset
+           << ", size " << mResources[i].SizeInBytes << ", passes ["
+           << placement.FirstPass << ", " << placement.LastPass << "]";
+    if (placement.AliasedPredecessor != kNoResource) {
+      report << ", aliases " << mResources[placement.AliasedPredecessor].Name;
+    }
+    report << "\n";
+  }
+  return report.str();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Plans placement of transient render targets inside shared placed heaps.
+// Passes declare which transient resources they read and write, lifetimes
+// are derived from the pass order, and resources whose lifetimes do not
+// overlap are given overlapping heap ranges. Has no D3D12 dependency.
+class TransientResourcePlanner {
+ public:
+  using ResourceHandle = uint32_t;
+  static constexpr uint32_t kInvalidPass = UINT32_MAX;
+  static constexpr ResourceHandle kNoResource = UINT32_MAX;
+
+  struct ResourceDesc {
+    std::string Name;
+    uint64_t SizeInBytes = 0;
+    uint64_t Alignment = 0;
+  };
+
+  struct Placement {
+    uint64_t HeapOffset = 0;
+    uint32_t FirstPass = kInvalidPass;
+    uint32_t LastPass = kInvalidPass;
+    // Resource that previously occupied part of this range, if any. The
+    // first pass that uses this resource needs an aliasing barrier. The
+    // plan repeats every frame, so a resource with no earlier neighbour in
+    // its range follows the one that is used last in the previous frame.
+    ResourceHandle AliasedPredecessor = kNoResource;
+  };
+
+  struct Pass {
+    std::string Name;
+    std::vector<ResourceHandle> Reads;
+    std::vector<ResourceHandle> Writes;
+  };
+
+  void Reset();
+
+  ResourceHandle DeclareResource(const std::string& name, uint64_t sizeInBytes,
+                                 uint64_t alignment);
+  uint32_t AddPass(const std::string& name,
+                   const std::vector<ResourceHandle>& reads,
+                   const std::vector<ResourceHandle>& writes);
+
+  void Compile();
+
+  const ResourceDesc& GetResource(ResourceHandle handle) const;
+  const Placement& GetPlacement(ResourceHandle handle) const;
+  size_t GetResourceCount() const { return mResources.size(); }
+  size_t GetPassCount() const { return mPasses.size(); }
+
+  // Size of the shared heap after aliasing.
+  uint64_t GetHeapSize() const { return mHeapSize; }
+  // Largest sum of live resource sizes over all passes (the lower bound for
+  // any aliasing scheme).
+  uint64_t GetPeakTransientBytes() const { return mPeakTransientBytes; }
+  // Memory that would be needed if every resource had its own allocation.
+  uint64_t GetUnaliasedBytes() const { return mUnaliasedBytes; }
+
+  std::string BuildReport() const;
+
+ private:
+  static uint64_t AlignUp(uint64_t value, uint64_t alignment);
+  void ComputeLifetimes();
+  void AssignOffsets();
+
+  std::vector<ResourceDesc> mResources;
+  std::vector<Placement> mPlacements;
+  std::vector<Pass> mPasses;
+  uint64_t mHeapSize = 0;
+  uint64_t mPeakTransientBytes = 0;
+  uint64_t mUnaliasedBytes = 0;
+  bool mCompiled = false;
+};
@@ -0,0 +1,184 @@
+#include "VertexCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+int16_t ToSnorm16(float value) {
+  const float clamped = std::min(std::max(value, -1.0f), 1.0f);
+  return static_cast<int16_t>(std::lround(clamped * 32767.0f));
+}
+
+// D3D maps both -32768 and -32767 to -1.
+float FromSnorm16(int16_t value) {
+  return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+}
+
+float SignNotZero(float value) { return value >= 0.0f ? 1.0f : -1.0f; }
+
+bool Normalize(float v[3]) {
+  const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (!(length > 0.0f)) {
+    return false;
+  }
+  for (int i = 0; i < 3; ++i) {
+    v[i] /= length;
+  }
+  return true;
+}
+
+void Cross(const float a[3], const float b[3], float out[3]) {
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Projects a unit vector onto the octahedron and unfolds the lower half
+// over the diagonals of the square.
+void EncodeOctahedral(const float direction[3], int16_t out[2]) {
+  const float l1 = std::fabs(direction[0]) + std::fabs(direction[1]) +
+                   std::fabs(direction[2]);
+  float x = direction[0] / l1;
+  float y = direction[1] / l1;
+  if (direction[2] < 0.0f) {
+    const float foldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+    y = (1.0f - std::fabs(x)) * SignNotZero(y);
+    x = foldedX;
+  }
+  out[0] = ToSnorm16(x);
+  out[1] = ToSnorm16(y);
+}
+
+void DecodeOctahedral(const int16_t encoded[2], float out[3]) {
+  out[0] = FromSnorm16(encoded[0]);
+  out[1] = FromSnorm16(encoded[1]);
+  out[2] = 1.0f - std::fabs(out[0]) - std::fabs(out[1]);
+  const float fold = std::max(-out[2], 0.0f);
+  out[0] += out[0] >= 0.0f ? -fold : fold;
+  out[1] += out[1] >= 0.0f ? -fold : fold;
+  Normalize(out);
+}
+}  // namespace
+
+PackedVertex PackVertex(const UnpackedVertex& vertex,
+                        const VertexPositionBounds& bounds) {
+  float normal[3] = {vertex.Normal[0], vertex.Normal[1], vertex.Normal[2]};
+  if (!Normalize(normal)) {
+    normal[0] = 0.0f;
+    normal[1] = 1.0f;
+    normal[2] = 0.0f;
+  }
+  float tangent[3] = {vertex.Tangent[0], vertex.Tangent[1],
+                      vertex.Tangent[2]};
+  if (!Normalize(tangent)) {
+    tangent[0] = 1.0f;
+    tangent[1] = 0.0f;
+    tangent[2] = 0.0f;
+  }
+  float derived[3];
+  Cross(normal, tangent, derived);
+  const float handedness = derived[0] * vertex.Bitangent[0] +
+                           derived[1] * vertex.Bitangent[1] +
+                           derived[2] * vertex.Bitangent[2];
+
+  PackedVertex packed = {};
+  for (int i = 0; i < 3; ++i) {
+    packed.Pos[i] =
+        bounds.Extents[i] > 0.0f
+            ? ToSnorm16((vertex.Pos[i] - bounds.Center[i]) / bounds.Extents[i])
+            : 0;
+  }
+  packed.Pos[3] = handedness < 0.0f ? -32767 : 32767;
+  EncodeOctahedral(normal, packed.Normal);
+  EncodeOctahedral(tangent, packed.Tangent);
+  packed.TexC[0] = FloatToHalf(vertex.TexC[0]);
+  packed.TexC[1] = FloatToHalf(vertex.TexC[1]);
+  return packed;
+}
+
+UnpackedVertex UnpackVertex(const PackedVertex& vertex,
+                            const VertexPositionBounds& bounds) {
+  UnpackedVertex unpacked;
+  for (int i = 0; i < 3; ++i) {
+    unpacked.Pos[i] =
+        bounds.Center[i] + bounds.Extents[i] * FromSnorm16(vertex.Pos[i]);
+  }
+  DecodeOctahedral(vertex.Normal, unpacked.Normal);
+  DecodeOctahedral(vertex.Tangent, unpacked.Tangent);
+  Cross(unpacked.Normal, unpacked.Tangent, unpacked.Bitangent);
+  Normalize(unpacked.Bitangent);
+  const float sign = SignNotZero(FromSnorm16(vertex.Pos[3]));
+  for (int i = 0; i < 3; ++i) {
+    unpacked.Bitangent[i] *= sign;
+  }
+  unpacked.TexC[0] = HalfToFloat(vertex.TexC[0]);
+  unpacked.TexC[1] = HalfToFloat(vertex.TexC[1]);
+  return unpacked;
+}
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+  const uint32_t exponent = (bits >> 23) & 0xFFu;
+  uint32_t mantissa = bits & 0x7FFFFFu;
+
+  if (exponent == 0xFFu) {
+    // Infinity stays infinity; NaN stays a quiet NaN.
+    return static_cast<uint16_t>(sign | 0x7C00u | (mantissa != 0 ? 0x200u : 0));
+  }
+  const int halfExponent = static_cast<int>(exponent) - 127 + 15;
+  if (halfExponent >= 31) {
+    return static_cast<uint16_t>(sign | 0x7C00u);
+  }
+  if (halfExponent <= 0) {
+    // Subnormal or zero: shift the implicit bit in, then round.
+    if (halfExponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000u;
+    const uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+    uint32_t half = mantissa >> shift;
+    const uint32_t remainder = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1u) != 0)) {
+      ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+  }
+  uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) |
+                  (mantissa >> 13);
+  const uint32_t remainder = mantissa & 0x1FFFu;
+  // A carry out of the mantissa correctly bumps the exponent, up to
+  // infinity.
+  if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u) != 0)) {
+    ++half;
+  }
+  return static_cast<uint16_t>(sign | half);
+}
+
+float HalfToFloat(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+  const uint32_t exponent = (value >> 10) & 0x1Fu;
+  uint32_t mantissa = value & 0x3FFu;
+  uint32_t bits;
+  if (exponent == 0x1Fu) {
+    bits = sign | 0x7F800000u | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // Subnormal: normalize the mantissa.
+    uint32_t shiftedExponent = 127 - 15 + 1;
+    while ((mantissa & 0x400u) == 0) {
+      mantissa <<= 1;
+      --shiftedExponent;
+    }
+    bits = sign | (shiftedExponent << 23) | ((mantissa & 0x3FFu) << 13);
+  }
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
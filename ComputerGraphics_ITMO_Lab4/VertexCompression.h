@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+// Packed geometry vertex: 20 bytes instead of the 76 of Vertex.
+//  - Position: 16-bit snorm relative to the bounds of the vertex's submesh,
+//    decoded as Center + Extents * snorm. The fourth component holds the
+//    bitangent sign.
+//  - Normal and tangent: octahedral, 16-bit snorm each.
+//  - Bitangent: cross(normal, tangent) * sign.
+//  - Texture coordinates: half floats.
+//  - No color.
+// DeferredGeometryVS.hlsl decodes it with PACKED_VERTICES=1. Has no D3D12
+// dependency; the formats are DXGI_FORMAT_R16G16B16A16_SNORM,
+// DXGI_FORMAT_R16G16_SNORM twice and DXGI_FORMAT_R16G16_FLOAT.
+struct PackedVertex {
+  int16_t Pos[4];
+  int16_t Normal[2];
+  int16_t Tangent[2];
+  uint16_t TexC[2];
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must stay 20 bytes");
+
+struct UnpackedVertex {
+  float Pos[3] = {};
+  float Normal[3] = {0.0f, 1.0f, 0.0f};
+  float Tangent[3] = {1.0f, 0.0f, 0.0f};
+  float Bitangent[3] = {0.0f, 0.0f, 1.0f};
+  float TexC[2] = {};
+};
+
+// Axis-aligned box the positions are quantized in. A zero extent stores
+// that coordinate exactly as Center.
+struct VertexPositionBounds {
+  float Center[3] = {};
+  float Extents[3] = {};
+};
+
+// Position quantization step in units of the bounds' extents; the error is
+// at most half of it per axis.
+constexpr float kPackedPositionStep = 1.0f / 32767.0f;
+
+// Positions outside bounds are clamped to them. Zero-length directions get
+// +Y normals and +X tangents.
+PackedVertex PackVertex(const UnpackedVertex& vertex,
+                        const VertexPositionBounds& bounds);
+// The same decode as the shader; normal, tangent and bitangent come back
+// unit length.
+UnpackedVertex UnpackVertex(const PackedVertex& vertex,
+                            const VertexPositionBounds& bounds);
+
+// IEEE 754 binary16 with round to nearest even, as DXGI_FORMAT_R16_FLOAT
+// stores it.
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
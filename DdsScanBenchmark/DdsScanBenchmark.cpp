@@ -0,0 +1,341 @@
+// Benchmarks for loading a set of DDS files.
+//
+//   DdsScanBenchmark [--iterations N] [--load read|map]
+//                    [--plan-arrays MAX_DIMENSION [--allow-growth]]
+//                    <file.dds | directory>...
+//
+// By default compares planning texture memory from DDS headers alone
+// (ScanDds) with reading whole files first, as DDSTextureLoader does. Both
+// passes parse the same header, so the difference is the file I/O.
+//
+// --load copies every subresource of every file into a staging buffer laid
+// out like TextureUploader's pages, either through a whole-file buffer
+// (read) or straight from a MappedFile (map), and reports the time and the
+// peak private memory. Run each mode in its own process.
+//
+// --plan-arrays reports how TextureArrayPlanner would pack the 2D textures
+// of at most MAX_DIMENSION texels a side into Texture2DArrays.
+//
+// The files are read once before timing; the numbers are for a warm page
+// cache.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DdsInfo.h"
+#include "MappedFile.h"
+#include "TextureArrayPlanner.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+enum class LoadMode { kNone, kRead, kMap };
+
+struct Options {
+  int Iterations = 50;
+  LoadMode Load = LoadMode::kNone;
+  // 0 unless --plan-arrays is given.
+  uint32_t PlanMaxDimension = 0;
+  bool AllowGrowth = false;
+  std::vector<fs::path> Inputs;
+};
+
+struct Totals {
+  uint64_t FileBytes = 0;
+  uint64_t StagingBytes = 0;
+  uint64_t Subresources = 0;
+  std::map<uint32_t, int> Formats;
+};
+
+Options ParseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--iterations" && i + 1 < argc) {
+      options.Iterations = std::max(1, std::stoi(argv[++i]));
+    } else if (argument == "--load" && i + 1 < argc) {
+      const std::string mode = argv[++i];
+      if (mode == "read") {
+        options.Load = LoadMode::kRead;
+      } else if (mode == "map") {
+        options.Load = LoadMode::kMap;
+      } else {
+        throw std::invalid_argument("Unknown load mode " + mode);
+      }
+    } else if (argument == "--plan-arrays" && i + 1 < argc) {
+      options.PlanMaxDimension =
+          static_cast<uint32_t>(std::max(1, std::stoi(argv[++i])));
+    } else if (argument == "--allow-growth") {
+      options.AllowGrowth = true;
+    } else if (argument.rfind("--", 0) == 0) {
+      throw std::invalid_argument("Unknown option " + argument);
+    } else if (fs::is_directory(argument)) {
+      std::vector<fs::path> files;
+      for (const fs::directory_entry& entry :
+           fs::directory_iterator(argument)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        if (entry.is_regular_file() && extension == ".dds") {
+          files.push_back(entry.path());
+        }
+      }
+      std::sort(files.begin(), files.end());
+      options.Inputs.insert(options.Inputs.end(), files.begin(), files.end());
+    } else {
+      options.Inputs.push_back(argument);
+    }
+  }
+  if (options.Inputs.empty()) {
+    throw std::invalid_argument(
+        "Usage: DdsScanBenchmark [--iterations N] [--load read|map] "
+        "[--plan-arrays MAX_DIMENSION [--allow-growth]] "
+        "<file.dds | directory>...");
+  }
+  return options;
+}
+
+DdsInfo ScanHeader(const fs::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Cannot open " + path.string());
+  }
+  return ScanDds(file);
+}
+
+DdsInfo ReadWholeFile(const fs::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Cannot open " + path.string());
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+  return ParseDdsHeader(data, data.size());
+}
+
+void PrintArrayPlan(const std::vector<fs::path>& files,
+                    const Options& options) {
+  std::vector<TextureArrayPlanner::Texture> textures;
+  for (const fs::path& file : files) {
+    const DdsInfo info = ScanHeader(file);
+    if (info.Dimension != DdsDimension::kTexture2D || info.ArraySize != 1) {
+      continue;
+    }
+    TextureArrayPlanner::Texture texture;
+    texture.Format = info.Format;
+    texture.Width = info.Width;
+    texture.Height = info.Height;
+    texture.MipCount = info.MipCount;
+    texture.Bytes = info.StagingBytes;
+    textures.push_back(texture);
+  }
+  TextureArrayPlanner::Settings settings;
+  settings.MaxDimension = options.PlanMaxDimension;
+  settings.AllowGrowth = options.AllowGrowth;
+  const TextureArrayPlanner::Plan plan =
+      TextureArrayPlanner::Build(textures, settings);
+
+  const TextureArrayPlanner::Stats& stats = plan.PlanStats;
+  std::printf("%u 2D textures, %u packed into %u arrays, %u groups left "
+              "standalone to save memory\n",
+              stats.Textures, stats.PackedTextures, stats.Arrays,
+              stats.GrowingGroups);
+  for (const TextureArrayPlanner::Array& array : plan.Arrays) {
+    std::printf("  DXGI_FORMAT %u %ux%u, %u mips: %zu slices\n",
+                array.Format, array.Width, array.Height, array.MipCount,
+                array.Textures.size());
+  }
+  std::printf("Resources: %u -> %u\n", stats.ResourcesBefore,
+              stats.ResourcesAfter);
+  std::printf("Allocated: %.2f -> %.2f MB, %.1f -> %.1f KB lost to "
+              "alignment\n",
+              stats.BytesBefore / (1024.0 * 1024.0),
+              stats.BytesAfter / (1024.0 * 1024.0),
+              stats.WastedBytesBefore / 1024.0,
+              stats.WastedBytesAfter / 1024.0);
+}
+
+// Microseconds per file for one pass over every file, best of iterations.
+template <typename Load>
+double TimePass(const std::vector<fs::path>& files, int iterations,
+                Load load) {
+  using Clock = std::chrono::steady_clock;
+  double best = 0.0;
+  uint64_t checksum = 0;
+  for (int i = 0; i < iterations; ++i) {
+    const Clock::time_point start = Clock::now();
+    for (const fs::path& file : files) {
+      checksum += load(file).StagingBytes;
+    }
+    const double micros =
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count();
+    best = i == 0 ? micros : std::min(best, micros);
+  }
+  // Keeps the loads from being optimized away.
+  if (checksum == 0) {
+    std::printf("\n");
+  }
+  return best / files.size();
+}
+
+// Anonymous resident memory in bytes, from /proc/self/status; 0 where that
+// does not exist.
+uint64_t GetPrivateResidentBytes() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("RssAnon:", 0) == 0) {
+      return std::stoull(line.substr(std::strlen("RssAnon:"))) * 1024;
+    }
+  }
+  return 0;
+}
+
+// Copies the subresources of data into staging at their planned footprints,
+// row by row like TextureUploader::Upload.
+void CopyToStaging(const DdsInfo& info, const uint8_t* data,
+                   std::vector<uint8_t>& staging) {
+  for (const DdsSubresource& subresource : info.Subresources) {
+    const uint64_t rows =
+        static_cast<uint64_t>(subresource.NumRows) * subresource.Depth;
+    for (uint64_t row = 0; row < rows; ++row) {
+      std::memcpy(staging.data() + subresource.StagingOffset +
+                      row * subresource.RowPitch,
+                  data + subresource.FileOffset + row * subresource.RowBytes,
+                  subresource.RowBytes);
+    }
+  }
+}
+
+// Loads every file once; returns milliseconds and the peak private memory
+// above what the staging buffer already holds.
+double LoadFiles(const std::vector<fs::path>& files, LoadMode mode,
+                 std::vector<uint8_t>& staging, uint64_t& peakPrivateBytes) {
+  using Clock = std::chrono::steady_clock;
+  const uint64_t baseline = GetPrivateResidentBytes();
+  const Clock::time_point start = Clock::now();
+  for (const fs::path& path : files) {
+    MappedFile mapping;
+    std::vector<uint8_t> buffer;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    if (mode == LoadMode::kMap) {
+      if (!mapping.Open(path.native())) {
+        throw std::runtime_error("Cannot map " + path.string());
+      }
+      data = mapping.GetData();
+      size = mapping.GetSize();
+    } else {
+      std::ifstream file(path, std::ios::binary);
+      buffer.resize(static_cast<size_t>(fs::file_size(path)));
+      if (!file.read(reinterpret_cast<char*>(buffer.data()),
+                     static_cast<std::streamsize>(buffer.size()))) {
+        throw std::runtime_error("Cannot read " + path.string());
+      }
+      data = buffer.data();
+      size = buffer.size();
+    }
+    const DdsInfo info = ParseDdsHeader(
+        std::vector<uint8_t>(data, data + std::min(size, kDdsMaxHeaderSize)),
+        size);
+    CopyToStaging(info, data, staging);
+    const uint64_t resident = GetPrivateResidentBytes();
+    peakPrivateBytes =
+        std::max(peakPrivateBytes, resident > baseline ? resident - baseline
+                                                       : uint64_t{0});
+  }
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  try {
+    const Options options = ParseOptions(argc, argv);
+
+    Totals totals;
+    std::vector<fs::path> files;
+    for (const fs::path& input : options.Inputs) {
+      try {
+        const DdsInfo info = ReadWholeFile(input);
+        totals.FileBytes += info.FileSize;
+        totals.StagingBytes += info.StagingBytes;
+        totals.Subresources += info.Subresources.size();
+        ++totals.Formats[info.Format];
+        files.push_back(input);
+      } catch (const std::exception& error) {
+        std::fprintf(stderr, "%s: %s\n", input.string().c_str(), error.what());
+      }
+    }
+    if (files.empty()) {
+      return 1;
+    }
+
+    if (options.PlanMaxDimension != 0) {
+      PrintArrayPlan(files, options);
+      return 0;
+    }
+
+    if (options.Load != LoadMode::kNone) {
+      uint64_t stagingBytes = 0;
+      for (const fs::path& file : files) {
+        stagingBytes = std::max(stagingBytes, ScanHeader(file).StagingBytes);
+      }
+      // Committed up front, like the uploader's pooled pages.
+      std::vector<uint8_t> staging(static_cast<size_t>(stagingBytes), 1);
+      double bestMilliseconds = 0.0;
+      uint64_t peakPrivateBytes = 0;
+      for (int i = 0; i < options.Iterations; ++i) {
+        const double milliseconds =
+            LoadFiles(files, options.Load, staging, peakPrivateBytes);
+        bestMilliseconds =
+            i == 0 ? milliseconds : std::min(bestMilliseconds, milliseconds);
+      }
+      std::printf("%s: %zu files, %.1f MB on disk, %.1f MB staging buffer\n",
+                  options.Load == LoadMode::kMap ? "map" : "read",
+                  files.size(), totals.FileBytes / (1024.0 * 1024.0),
+                  stagingBytes / (1024.0 * 1024.0));
+      std::printf("  %.2f ms per pass, %.0f MB/s, peak private memory "
+                  "above staging %.1f MB\n",
+                  bestMilliseconds,
+                  totals.FileBytes / (1024.0 * 1024.0) /
+                      (bestMilliseconds / 1000.0),
+                  peakPrivateBytes / (1024.0 * 1024.0));
+      return 0;
+    }
+
+    const double scanMicros = TimePass(files, options.Iterations, ScanHeader);
+    const double fullMicros =
+        TimePass(files, options.Iterations, ReadWholeFile);
+
+    std::printf("%zu files, %.1f MB on disk, %llu subresources, %.1f MB of "
+                "staging planned\n",
+                files.size(), totals.FileBytes / (1024.0 * 1024.0),
+                static_cast<unsigned long long>(totals.Subresources),
+                totals.StagingBytes / (1024.0 * 1024.0));
+    for (const auto& format : totals.Formats) {
+      std::printf("  DXGI_FORMAT %u: %d files\n", format.first, format.second);
+    }
+    std::printf("Header scan: %.2f us/file, %zu bytes read per file\n",
+                scanMicros, kDdsMaxHeaderSize);
+    std::printf("Whole file:  %.2f us/file, %.0f bytes read per file\n",
+                fullMicros,
+                static_cast<double>(totals.FileBytes) / files.size());
+    std::printf("Header scan is %.0fx faster\n", fullMicros / scanMicros);
+    return 0;
+  } catch (const std::exception& error) {
+    std::fprintf(stderr, "%s\n", error.what());
+    return 2;
+  }
+}
@@ -0,0 +1,257 @@
+// AsyncComputeScheduler driven by simulated queues: GPU work runs in random
+// interleavings, and the particle simulation and draw must still alternate.
+
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "AsyncComputeScheduler.h"
+#include "TestCheck.h"
+
+namespace {
+class SimulatedGpu;
+
+// A queue that executes its commands in order when the simulated GPU steps
+// it. A wait blocks the queue until the producer's fence reaches the value.
+class SimulatedQueue : public CommandQueueSync {
+ public:
+  explicit SimulatedQueue(SimulatedGpu* gpu) : mGpu(gpu) {}
+
+  void Submit(const std::string& work) {
+    mCommands.push_back({Command::Kind::Work, work, nullptr, 0});
+  }
+
+  void Signal(uint64_t value) override {
+    mCommands.push_back({Command::Kind::Signal, "", nullptr, value});
+  }
+
+  void Wait(CommandQueueSync& producer, uint64_t value) override {
+    mCommands.push_back({Command::Kind::Wait, "",
+                         static_cast<SimulatedQueue*>(&producer), value});
+  }
+
+  uint64_t GetCompletedValue() const override { return mCompleted; }
+
+  void WaitOnCpu(uint64_t value) override;
+
+  bool IsBlocked() const {
+    return mNext < mCommands.size() &&
+           mCommands[mNext].Type == Command::Kind::Wait &&
+           mCommands[mNext].Producer->mCompleted < mCommands[mNext].Value;
+  }
+  bool IsIdle() const { return mNext == mCommands.size(); }
+
+  // Executes one command; returns false when idle or blocked.
+  bool Step(std::vector<std::string>& log) {
+    if (IsIdle() || IsBlocked()) {
+      return false;
+    }
+    const Command& command = mCommands[mNext++];
+    if (command.Type == Command::Kind::Work) {
+      log.push_back(command.Work);
+    } else if (command.Type == Command::Kind::Signal) {
+      mCompleted = command.Value;
+    }
+    return true;
+  }
+
+ private:
+  struct Command {
+    enum class Kind { Work, Signal, Wait };
+    Kind Type;
+    std::string Work;
+    SimulatedQueue* Producer;
+    uint64_t Value;
+  };
+
+  SimulatedGpu* mGpu;
+  std::vector<Command> mCommands;
+  size_t mNext = 0;
+  uint64_t mCompleted = 0;
+};
+
+// Steps two queues in a seeded random order and logs the work they run.
+class SimulatedGpu {
+ public:
+  explicit SimulatedGpu(uint32_t seed)
+      : mGraphics(this), mCompute(this), mRandom(seed) {}
+
+  SimulatedQueue& Graphics() { return mGraphics; }
+  SimulatedQueue& Compute() { return mCompute; }
+  const std::vector<std::string>& Log() const { return mLog; }
+
+  // Runs up to `steps` commands picked at random from the runnable queues.
+  void RunSome(uint32_t steps) {
+    for (uint32_t i = 0; i < steps; ++i) {
+      SimulatedQueue* runnable[2];
+      uint32_t count = 0;
+      for (SimulatedQueue* queue : {&mGraphics, &mCompute}) {
+        if (!queue->IsIdle() && !queue->IsBlocked()) {
+          runnable[count++] = queue;
+        }
+      }
+      if (count == 0) {
+        return;
+      }
+      runnable[mRandom() % count]->Step(mLog);
+    }
+  }
+
+  // Runs until the queue's fence reaches the value; a state where neither
+  // queue can make progress first is a deadlock.
+  void RunUntil(const SimulatedQueue& queue, uint64_t value) {
+    while (queue.GetCompletedValue() < value) {
+      const bool graphicsRan = mGraphics.Step(mLog);
+      const bool computeRan = mCompute.Step(mLog);
+      if (!graphicsRan && !computeRan) {
+        throw std::runtime_error("simulated GPU deadlocked");
+      }
+    }
+  }
+
+  uint32_t Random(uint32_t bound) { return mRandom() % bound; }
+
+ private:
+  SimulatedQueue mGraphics;
+  SimulatedQueue mCompute;
+  std::mt19937 mRandom;
+  std::vector<std::string> mLog;
+};
+
+void SimulatedQueue::WaitOnCpu(uint64_t value) { mGpu->RunUntil(*this, value); }
+
+size_t IndexOf(const std::vector<std::string>& log, const std::string& work) {
+  for (size_t i = 0; i < log.size(); ++i) {
+    if (log[i] == work) {
+      return i;
+    }
+  }
+  return log.size();
+}
+
+// One frame as RenderingSystem records it.
+void RecordFrame(SimulatedGpu& gpu, AsyncComputeScheduler& scheduler,
+                 uint32_t frame) {
+  const std::string suffix = " " + std::to_string(frame);
+  const uint64_t previousCompute = scheduler.GetLastComputeValue();
+  scheduler.BeginComputeWork();
+  // The compute allocator is about to be reset.
+  CHECK(gpu.Compute().GetCompletedValue() >= previousCompute);
+  gpu.Compute().Submit("Simulate" + suffix);
+  CHECK_EQ(scheduler.EndComputeWork(), previousCompute + 1);
+  gpu.RunSome(gpu.Random(4));
+
+  gpu.Graphics().Submit("Geometry" + suffix);
+  gpu.Graphics().Submit("Compose" + suffix);
+  gpu.RunSome(gpu.Random(4));
+  scheduler.BeginGraphicsConsume();
+  gpu.Graphics().Submit("ParticleDraw" + suffix);
+  scheduler.EndGraphicsConsume();
+  gpu.RunSome(gpu.Random(6));
+}
+
+void TestFramesAlternateUnderRandomTiming() {
+  for (uint32_t seed = 1; seed <= 200; ++seed) {
+    SimulatedGpu gpu(seed);
+    AsyncComputeScheduler scheduler(&gpu.Graphics(), &gpu.Compute());
+    const uint32_t frameCount = 12;
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+      RecordFrame(gpu, scheduler, frame);
+    }
+    gpu.RunUntil(gpu.Graphics(), scheduler.GetLastGraphicsValue());
+    gpu.RunUntil(gpu.Compute(), scheduler.GetLastComputeValue());
+    CHECK(gpu.Graphics().IsIdle());
+    CHECK(gpu.Compute().IsIdle());
+    CHECK_EQ(gpu.Log().size(), frameCount * 4);
+
+    const auto& log = gpu.Log();
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+      const std::string suffix = " " + std::to_string(frame);
+      const size_t simulate = IndexOf(log, "Simulate" + suffix);
+      const size_t draw = IndexOf(log, "ParticleDraw" + suffix);
+      CHECK(simulate < log.size());
+      CHECK(draw < log.size());
+      // The draw reads what this frame's simulation wrote...
+      CHECK(simulate < draw);
+      // ...and the next simulation must not overwrite it before then.
+      if (frame + 1 < frameCount) {
+        const size_t nextSimulate =
+            IndexOf(log, "Simulate " + std::to_string(frame + 1));
+        CHECK(draw < nextSimulate);
+      }
+    }
+  }
+}
+
+void TestComputeOverlapsGraphicsWork() {
+  // Geometry and compose do not wait for the simulation, so some seed has to
+  // run them before it.
+  bool overlapped = false;
+  for (uint32_t seed = 1; seed <= 50 && !overlapped; ++seed) {
+    SimulatedGpu gpu(seed);
+    AsyncComputeScheduler scheduler(&gpu.Graphics(), &gpu.Compute());
+    for (uint32_t frame = 0; frame < 4; ++frame) {
+      RecordFrame(gpu, scheduler, frame);
+    }
+    gpu.RunUntil(gpu.Graphics(), scheduler.GetLastGraphicsValue());
+    for (uint32_t frame = 1; frame < 4; ++frame) {
+      const std::string suffix = " " + std::to_string(frame);
+      overlapped |= IndexOf(gpu.Log(), "Geometry" + suffix) <
+                    IndexOf(gpu.Log(), "Simulate" + suffix);
+    }
+  }
+  CHECK(overlapped);
+}
+
+void TestFenceValuesStartAtCompletedValues() {
+  SimulatedGpu gpu(7);
+  gpu.Graphics().Signal(5);
+  gpu.Compute().Signal(9);
+  gpu.RunUntil(gpu.Graphics(), 5);
+  gpu.RunUntil(gpu.Compute(), 9);
+
+  AsyncComputeScheduler scheduler(&gpu.Graphics(), &gpu.Compute());
+  CHECK_EQ(scheduler.GetLastGraphicsValue(), 5u);
+  CHECK_EQ(scheduler.GetLastComputeValue(), 9u);
+  scheduler.BeginComputeWork();
+  CHECK_EQ(scheduler.EndComputeWork(), 10u);
+  scheduler.BeginGraphicsConsume();
+  CHECK_EQ(scheduler.EndGraphicsConsume(), 6u);
+  gpu.RunUntil(gpu.Graphics(), 6);
+  CHECK_EQ(gpu.Compute().GetCompletedValue(), 10u);
+}
+
+void TestCallsOutOfOrderThrow() {
+  SimulatedGpu gpu(3);
+  AsyncComputeScheduler scheduler(&gpu.Graphics(), &gpu.Compute());
+  CHECK_THROWS(scheduler.EndComputeWork(), std::logic_error);
+  CHECK_THROWS(scheduler.BeginGraphicsConsume(), std::logic_error);
+  CHECK_THROWS(scheduler.EndGraphicsConsume(), std::logic_error);
+
+  scheduler.BeginComputeWork();
+  CHECK_THROWS(scheduler.BeginComputeWork(), std::logic_error);
+  CHECK_THROWS(scheduler.BeginGraphicsConsume(), std::logic_error);
+  scheduler.EndComputeWork();
+  CHECK_THROWS(scheduler.EndComputeWork(), std::logic_error);
+  CHECK_THROWS(scheduler.EndGraphicsConsume(), std::logic_error);
+  scheduler.BeginGraphicsConsume();
+  CHECK_THROWS(scheduler.BeginComputeWork(), std::logic_error);
+  scheduler.EndGraphicsConsume();
+
+  AsyncComputeScheduler unbound;
+  CHECK_THROWS(unbound.Initialize(nullptr, &gpu.Compute()),
+               std::invalid_argument);
+  CHECK_THROWS(unbound.Initialize(&gpu.Graphics(), nullptr),
+               std::invalid_argument);
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestFramesAlternateUnderRandomTiming);
+  RUN_TEST(TestComputeOverlapsGraphicsWork);
+  RUN_TEST(TestFenceValuesStartAtCompletedValues);
+  RUN_TEST(TestCallsOutOfOrderThrow);
+  return TestResult("AsyncComputeSchedulerTest");
+}
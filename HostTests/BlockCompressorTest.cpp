@@ -0,0 +1,239 @@
+// TextureBaker's BC5 and BC7 encoders, decoded the way the hardware does and
+// compared with the source pixels on flat, gradient and two-colour edge
+// blocks. The BC7 encoder emits mode 6 only, which these blocks all suit.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "BlockCompressor.h"
+#include "RgbaImage.h"
+#include "TestCheck.h"
+
+namespace {
+constexpr int kBlockPixels = 16;
+
+// Pixels of one 4x4 block, RGBA, row by row.
+using BlockPixels = std::vector<uint8_t>;
+
+// Reads the little-endian bit stream blocks are stored as.
+class BitReader {
+ public:
+  explicit BitReader(const uint8_t* data) : mData(data) {}
+  uint32_t Read(int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; ++i, ++mBit) {
+      value |= ((mData[mBit / 8] >> (mBit % 8)) & 1u) << i;
+    }
+    return value;
+  }
+
+ private:
+  const uint8_t* mData;
+  int mBit = 0;
+};
+
+// BC4 UNORM: two 8-bit endpoints and 3-bit indices; the six-value mode adds
+// 0 and 255.
+void DecodeChannel(const uint8_t* block, float* values) {
+  BitReader reader(block);
+  const float value0 = static_cast<float>(reader.Read(8));
+  const float value1 = static_cast<float>(reader.Read(8));
+  float palette[8] = {value0, value1};
+  if (value0 > value1) {
+    for (int i = 2; i < 8; ++i) {
+      palette[i] = ((8 - i) * value0 + (i - 1) * value1) / 7.0f;
+    }
+  } else {
+    for (int i = 2; i < 6; ++i) {
+      palette[i] = ((6 - i) * value0 + (i - 1) * value1) / 5.0f;
+    }
+    palette[6] = 0.0f;
+    palette[7] = 255.0f;
+  }
+  for (int i = 0; i < kBlockPixels; ++i) {
+    values[i] = palette[reader.Read(3)];
+  }
+}
+
+// BC5 decodes to red and green; blue is 0 and alpha 255.
+std::vector<float> DecodeBC5(const uint8_t* block) {
+  float red[kBlockPixels];
+  float green[kBlockPixels];
+  DecodeChannel(block, red);
+  DecodeChannel(block + 8, green);
+  std::vector<float> pixels;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    pixels.insert(pixels.end(), {red[i], green[i], 0.0f, 255.0f});
+  }
+  return pixels;
+}
+
+// BC7 mode 6: 7-bit RGBA endpoints with a p-bit each and 4-bit indices,
+// the first one stored in 3 bits. Any other mode fails the check.
+std::vector<float> DecodeBC7(const uint8_t* block) {
+  static const int kWeights[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                   34, 38, 43, 47, 51, 55, 60, 64};
+  BitReader reader(block);
+  CHECK_EQ(reader.Read(7), 1u << 6);
+  int endpoints[2][4] = {};
+  for (int c = 0; c < 4; ++c) {
+    endpoints[0][c] = static_cast<int>(reader.Read(7)) << 1;
+    endpoints[1][c] = static_cast<int>(reader.Read(7)) << 1;
+  }
+  const uint32_t pBit0 = reader.Read(1);
+  const uint32_t pBit1 = reader.Read(1);
+  for (int c = 0; c < 4; ++c) {
+    endpoints[0][c] |= pBit0;
+    endpoints[1][c] |= pBit1;
+  }
+  std::vector<float> pixels;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    const int weight = kWeights[reader.Read(i == 0 ? 3 : 4)];
+    for (int c = 0; c < 4; ++c) {
+      pixels.push_back(static_cast<float>(
+          ((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >>
+          6));
+    }
+  }
+  return pixels;
+}
+
+// Largest difference over the first channelCount channels.
+float MaxError(const BlockPixels& source, const std::vector<float>& decoded,
+               int channelCount) {
+  float error = 0.0f;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    for (int c = 0; c < channelCount; ++c) {
+      error = std::max(error,
+                       std::fabs(decoded[i * 4 + c] - source[i * 4 + c]));
+    }
+  }
+  return error;
+}
+
+float EncodeBC5Error(const BlockPixels& pixels) {
+  uint8_t block[16] = {};
+  EncodeBC5Block(pixels.data(), block);
+  return MaxError(pixels, DecodeBC5(block), 2);
+}
+
+float EncodeBC7Error(const BlockPixels& pixels) {
+  uint8_t block[16] = {};
+  EncodeBC7Block(pixels.data(), block);
+  return MaxError(pixels, DecodeBC7(block), 4);
+}
+
+BlockPixels Flat(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+  BlockPixels pixels;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    pixels.insert(pixels.end(), {r, g, b, a});
+  }
+  return pixels;
+}
+
+// Every channel ramps diagonally from its base by step per pixel.
+BlockPixels Gradient(const uint8_t* base, const int* step) {
+  BlockPixels pixels;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    const int distance = i % 4 + i / 4;
+    for (int c = 0; c < 4; ++c) {
+      pixels.push_back(static_cast<uint8_t>(base[c] + step[c] * distance));
+    }
+  }
+  return pixels;
+}
+
+// Left half one colour, right half the other.
+BlockPixels Edge(const uint8_t* left, const uint8_t* right) {
+  BlockPixels pixels;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    const uint8_t* color = i % 4 < 2 ? left : right;
+    pixels.insert(pixels.end(), color, color + 4);
+  }
+  return pixels;
+}
+
+void TestBC5() {
+  CHECK_EQ(GetBlockBytes(BlockFormat::kBC5), 16u);
+  // Endpoints are stored exactly, so flat and two-value blocks are lossless.
+  CHECK_EQ(EncodeBC5Error(Flat(0, 0, 0, 255)), 0.0f);
+  CHECK_EQ(EncodeBC5Error(Flat(128, 127, 0, 255)), 0.0f);
+  CHECK_EQ(EncodeBC5Error(Flat(255, 255, 0, 255)), 0.0f);
+  const uint8_t left[4] = {20, 240, 0, 255};
+  const uint8_t right[4] = {230, 10, 0, 255};
+  CHECK_EQ(EncodeBC5Error(Edge(left, right)), 0.0f);
+
+  // Six steps of 7 and 11 span 42 and 66; eight levels leave each pixel
+  // within half a level, plus one for the encoder's integer palette.
+  const uint8_t base[4] = {100, 30, 0, 255};
+  const int step[4] = {7, 11, 0, 0};
+  CHECK(EncodeBC5Error(Gradient(base, step)) <= 66.0f / 14.0f + 1.0f);
+}
+
+void TestBC7() {
+  CHECK_EQ(GetBlockBytes(BlockFormat::kBC7), 16u);
+  // Opaque blocks force p-bit 1, so even values are one off; translucent
+  // ones may pick the p-bit per endpoint and stay within one.
+  CHECK(EncodeBC7Error(Flat(201, 99, 51, 255)) == 0.0f);
+  CHECK(EncodeBC7Error(Flat(200, 100, 50, 255)) <= 1.0f);
+  CHECK(EncodeBC7Error(Flat(37, 150, 201, 128)) <= 1.0f);
+
+  // Sixteen levels over spans of 180 and 210 leave each pixel within half a
+  // level, plus one for endpoint quantization.
+  const uint8_t base[4] = {10, 200, 60, 255};
+  const int step[4] = {30, -25, 12, 0};
+  CHECK(EncodeBC7Error(Gradient(base, step)) <= 180.0f / 30.0f + 1.0f);
+  const uint8_t translucentBase[4] = {120, 40, 220, 30};
+  const int translucentStep[4] = {15, 20, -30, 35};
+  CHECK(EncodeBC7Error(Gradient(translucentBase, translucentStep)) <=
+        210.0f / 30.0f + 1.0f);
+
+  // Red and blue move against each other across this edge.
+  const uint8_t left[4] = {250, 20, 20, 255};
+  const uint8_t right[4] = {20, 20, 250, 255};
+  CHECK(EncodeBC7Error(Edge(left, right)) <= 1.0f);
+  const uint8_t clear[4] = {255, 255, 255, 0};
+  const uint8_t solid[4] = {0, 128, 0, 255};
+  CHECK(EncodeBC7Error(Edge(clear, solid)) <= 1.0f);
+}
+
+void TestCompressImageRepeatsEdges() {
+  // A 6x3 image is two blocks wide; the missing pixels repeat the last row
+  // and column, so the blocks decode to the clamped image.
+  RgbaImage image;
+  image.Width = 6;
+  image.Height = 3;
+  for (uint32_t y = 0; y < image.Height; ++y) {
+    for (uint32_t x = 0; x < image.Width; ++x) {
+      image.Pixels.insert(image.Pixels.end(),
+                          {static_cast<uint8_t>(x * 40),
+                           static_cast<uint8_t>(y * 60), 0, 255});
+    }
+  }
+  const std::vector<uint8_t> blocks =
+      CompressImage(image, BlockFormat::kBC5, 2);
+  CHECK_EQ(blocks.size(), 2u * GetBlockBytes(BlockFormat::kBC5));
+  for (uint32_t blockX = 0; blockX < 2; ++blockX) {
+    const std::vector<float> decoded = DecodeBC5(blocks.data() + blockX * 16);
+    BlockPixels expected;
+    for (uint32_t y = 0; y < 4; ++y) {
+      for (uint32_t x = 0; x < 4; ++x) {
+        const uint8_t* pixel =
+            image.GetPixel(std::min(blockX * 4 + x, image.Width - 1),
+                           std::min(y, image.Height - 1));
+        expected.insert(expected.end(), pixel, pixel + 4);
+      }
+    }
+    CHECK(MaxError(expected, decoded, 2) <= 120.0f / 14.0f + 1.0f);
+  }
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestBC5);
+  RUN_TEST(TestBC7);
+  RUN_TEST(TestCompressImageRepeatsEdges);
+  return TestResult("BlockCompressorTest");
+}
@@ -0,0 +1,454 @@
+// The DDS header parser the texture streamer sizes resources and reads
+// mips with. Headers are built in memory; the pixel data is only ever
+// accounted for through the file size.
+
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DdsInfo.h"
+#include "LittleEndianIO.h"
+#include "TestCheck.h"
+
+namespace {
+// DXGI_FORMAT values.
+constexpr uint32_t kR32G32B32A32Float = 2;
+constexpr uint32_t kR8G8B8A8Unorm = 28;
+constexpr uint32_t kR8Unorm = 61;
+constexpr uint32_t kBc1Unorm = 71;
+constexpr uint32_t kBc7Unorm = 98;
+constexpr uint32_t kYuy2 = 107;
+
+constexpr uint32_t kFlagVolume = 0x800000;
+constexpr uint32_t kCaps2Cubemap = 0x200;
+constexpr uint32_t kCaps2AllFaces = 0xfc00;
+constexpr uint32_t kMiscTextureCube = 0x4;
+
+struct HeaderDesc {
+  uint32_t Width = 1;
+  uint32_t Height = 1;
+  uint32_t Depth = 0;
+  uint32_t MipCount = 1;
+  uint32_t Flags = 0;
+  uint32_t Caps2 = 0;
+  // Written as DDS_PIXELFORMAT when Dx10 is false.
+  uint32_t PixelFormatFlags = 0x41;  // DDPF_RGB | DDPF_ALPHAPIXELS
+  uint32_t FourCc = 0;
+  uint32_t BitCount = 32;
+  uint32_t Masks[4] = {0xff, 0xff00, 0xff0000, 0xff000000};
+  bool Dx10 = true;
+  uint32_t Format = kR8G8B8A8Unorm;
+  uint32_t Dimension = static_cast<uint32_t>(DdsDimension::kTexture2D);
+  uint32_t MiscFlag = 0;
+  uint32_t ArraySize = 1;
+};
+
+std::vector<uint8_t> MakeHeader(const HeaderDesc& desc) {
+  std::vector<uint8_t> header;
+  WriteUint32LE(header, 0x20534444);  // "DDS "
+  WriteUint32LE(header, 124);
+  WriteUint32LE(header, desc.Flags);
+  WriteUint32LE(header, desc.Height);
+  WriteUint32LE(header, desc.Width);
+  WriteUint32LE(header, 0);  // pitchOrLinearSize
+  WriteUint32LE(header, desc.Depth);
+  WriteUint32LE(header, desc.MipCount);
+  for (int i = 0; i < 11; ++i) {
+    WriteUint32LE(header, 0);
+  }
+  WriteUint32LE(header, 32);
+  if (desc.Dx10) {
+    WriteUint32LE(header, 0x4);  // DDPF_FOURCC
+    WriteUint32LE(header, 0x30315844);  // "DX10"
+    for (int i = 0; i < 5; ++i) {
+      WriteUint32LE(header, 0);
+    }
+  } else {
+    WriteUint32LE(header, desc.PixelFormatFlags);
+    WriteUint32LE(header, desc.FourCc);
+    WriteUint32LE(header, desc.BitCount);
+    for (uint32_t mask : desc.Masks) {
+      WriteUint32LE(header, mask);
+    }
+  }
+  WriteUint32LE(header, 0x1000);  // DDSCAPS_TEXTURE
+  WriteUint32LE(header, desc.Caps2);
+  for (int i = 0; i < 3; ++i) {
+    WriteUint32LE(header, 0);
+  }
+  if (desc.Dx10) {
+    WriteUint32LE(header, desc.Format);
+    WriteUint32LE(header, desc.Dimension);
+    WriteUint32LE(header, desc.MiscFlag);
+    WriteUint32LE(header, desc.ArraySize);
+    WriteUint32LE(header, 0);
+  }
+  return header;
+}
+
+// File size that holds exactly the pixel data of info's subresources.
+uint64_t GetExactFileSize(const DdsInfo& info) {
+  const DdsSubresource& last = info.Subresources.back();
+  return last.FileOffset + last.FileBytes;
+}
+
+// Parses header with room for any pixel data, then again with the exact
+// file size the first parse reports.
+DdsInfo Parse(const std::vector<uint8_t>& header) {
+  const DdsInfo info = ParseDdsHeader(header, UINT64_MAX);
+  return ParseDdsHeader(header, GetExactFileSize(info));
+}
+
+// Properties every parsed layout has, whatever the header.
+void CheckLayout(const DdsInfo& info, size_t dataOffset) {
+  CHECK_EQ(info.Subresources.size(),
+           static_cast<size_t>(info.ArraySize) * info.MipCount);
+  uint64_t fileOffset = dataOffset;
+  uint64_t stagingEnd = 0;
+  for (const DdsSubresource& subresource : info.Subresources) {
+    CHECK_EQ(subresource.FileOffset, fileOffset);
+    CHECK_EQ(subresource.FileBytes,
+             static_cast<uint64_t>(subresource.RowBytes) *
+                 subresource.NumRows * subresource.Depth);
+    CHECK_EQ(subresource.RowPitch % 256, 0u);
+    CHECK(subresource.RowPitch >= subresource.RowBytes);
+    CHECK_EQ(subresource.StagingOffset % 512, 0u);
+    CHECK(subresource.StagingOffset >= stagingEnd);
+    CHECK_EQ(subresource.StagingBytes,
+             static_cast<uint64_t>(subresource.NumRows * subresource.Depth -
+                                   1) *
+                     subresource.RowPitch +
+                 subresource.RowBytes);
+    fileOffset += subresource.FileBytes;
+    stagingEnd = subresource.StagingOffset + subresource.StagingBytes;
+  }
+  CHECK(fileOffset <= info.FileSize);
+  CHECK_EQ(info.StagingBytes, stagingEnd);
+}
+
+void TestLegacyMipChain() {
+  HeaderDesc desc;
+  desc.Dx10 = false;
+  desc.Width = 256;
+  desc.Height = 64;
+  desc.MipCount = 9;
+  const DdsInfo info = Parse(MakeHeader(desc));
+  CHECK_EQ(info.Format, kR8G8B8A8Unorm);
+  CHECK_EQ(info.ArraySize, 1u);
+  CHECK_EQ(info.MipCount, 9u);
+  CheckLayout(info, 128);
+  CHECK_EQ(info.GetSubresource(0, 0).RowBytes, 1024u);
+  CHECK_EQ(info.GetSubresource(0, 0).NumRows, 64u);
+  CHECK_EQ(info.GetSubresource(6, 0).Width, 4u);
+  CHECK_EQ(info.GetSubresource(6, 0).Height, 1u);
+  CHECK_EQ(info.GetSubresource(6, 0).RowPitch, 256u);
+  CHECK_EQ(info.GetSubresource(8, 0).Width, 1u);
+
+  // B8G8R8X8 and luminance layouts map to their DXGI formats; unknown
+  // masks do not.
+  desc.MipCount = 1;
+  desc.PixelFormatFlags = 0x40;
+  desc.Masks[0] = 0xff0000;
+  desc.Masks[2] = 0xff;
+  desc.Masks[3] = 0;
+  CHECK_EQ(Parse(MakeHeader(desc)).Format, 88u);
+  desc.PixelFormatFlags = 0x20000;
+  desc.BitCount = 8;
+  desc.Masks[0] = 0xff;
+  CHECK_EQ(Parse(MakeHeader(desc)).Format, kR8Unorm);
+  desc.BitCount = 16;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(desc), UINT64_MAX),
+               std::runtime_error);
+}
+
+void TestBlockCompressed() {
+  HeaderDesc desc;
+  desc.Format = kBc1Unorm;
+  desc.Width = 10;
+  desc.Height = 6;
+  desc.MipCount = 4;
+  DdsInfo info = Parse(MakeHeader(desc));
+  CheckLayout(info, 148);
+  // 10x6, 5x3, 2x1 and 1x1 pixels round up to whole 4x4 blocks.
+  CHECK_EQ(info.GetSubresource(0, 0).RowBytes, 3u * 8);
+  CHECK_EQ(info.GetSubresource(0, 0).NumRows, 2u);
+  CHECK_EQ(info.GetSubresource(1, 0).RowBytes, 2u * 8);
+  CHECK_EQ(info.GetSubresource(1, 0).NumRows, 1u);
+  CHECK_EQ(info.GetSubresource(3, 0).RowBytes, 8u);
+  CHECK_EQ(info.GetSubresource(3, 0).NumRows, 1u);
+
+  desc.Format = kBc7Unorm;
+  info = Parse(MakeHeader(desc));
+  CHECK_EQ(info.GetSubresource(0, 0).RowBytes, 3u * 16);
+
+  HeaderDesc legacy;
+  legacy.Dx10 = false;
+  legacy.PixelFormatFlags = 0x4;
+  legacy.FourCc = 0x35545844;  // "DXT5"
+  legacy.Width = 8;
+  legacy.Height = 8;
+  info = Parse(MakeHeader(legacy));
+  CHECK_EQ(info.Format, 77u);
+  CHECK_EQ(info.GetSubresource(0, 0).FileBytes, 4u * 16);
+}
+
+void TestArraysCubesAndVolumes() {
+  HeaderDesc desc;
+  desc.Width = 32;
+  desc.Height = 32;
+  desc.MipCount = 6;
+  desc.ArraySize = 3;
+  DdsInfo info = Parse(MakeHeader(desc));
+  CHECK_EQ(info.ArraySize, 3u);
+  CHECK(!info.IsCubeMap);
+  CheckLayout(info, 148);
+  // Every mip of a slice precedes the next slice.
+  CHECK_EQ(info.GetSubresource(0, 1).FileOffset,
+           info.GetSubresource(5, 0).FileOffset +
+               info.GetSubresource(5, 0).FileBytes);
+
+  desc.MiscFlag = kMiscTextureCube;
+  desc.ArraySize = 2;
+  info = Parse(MakeHeader(desc));
+  CHECK(info.IsCubeMap);
+  CHECK_EQ(info.ArraySize, 12u);
+  CheckLayout(info, 148);
+
+  HeaderDesc legacyCube;
+  legacyCube.Dx10 = false;
+  legacyCube.Width = 16;
+  legacyCube.Height = 16;
+  legacyCube.Caps2 = kCaps2Cubemap | kCaps2AllFaces;
+  info = Parse(MakeHeader(legacyCube));
+  CHECK(info.IsCubeMap);
+  CHECK_EQ(info.ArraySize, 6u);
+  legacyCube.Caps2 = kCaps2Cubemap | 0x400;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(legacyCube), UINT64_MAX),
+               std::runtime_error);
+
+  HeaderDesc volume;
+  volume.Width = 16;
+  volume.Height = 8;
+  volume.Depth = 4;
+  volume.MipCount = 5;
+  volume.Flags = kFlagVolume;
+  volume.Dimension = static_cast<uint32_t>(DdsDimension::kTexture3D);
+  info = Parse(MakeHeader(volume));
+  CHECK(info.Dimension == DdsDimension::kTexture3D);
+  CheckLayout(info, 148);
+  CHECK_EQ(info.GetSubresource(0, 0).FileBytes, 16u * 4 * 8 * 4);
+  CHECK_EQ(info.GetSubresource(2, 0).Depth, 1u);
+  // A volume needs the volume flag and a single slice.
+  volume.ArraySize = 2;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(volume), UINT64_MAX),
+               std::runtime_error);
+
+  HeaderDesc line;
+  line.Width = 64;
+  line.Height = 7;
+  line.Dimension = static_cast<uint32_t>(DdsDimension::kTexture1D);
+  info = Parse(MakeHeader(line));
+  CHECK(info.Dimension == DdsDimension::kTexture1D);
+  CHECK_EQ(info.Height, 1u);
+}
+
+void TestLimits() {
+  HeaderDesc desc;
+  desc.Format = kR8Unorm;
+  desc.Width = 16384;
+  desc.Height = 1;
+  CHECK_EQ(Parse(MakeHeader(desc)).Width, 16384u);
+  desc.Width = 16385;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(desc), UINT64_MAX),
+               std::runtime_error);
+  desc.Width = 1;
+  desc.Height = UINT32_MAX;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(desc), UINT64_MAX),
+               std::runtime_error);
+
+  HeaderDesc volume;
+  volume.Format = kR8Unorm;
+  volume.Flags = kFlagVolume;
+  volume.Dimension = static_cast<uint32_t>(DdsDimension::kTexture3D);
+  volume.Depth = 2048;
+  CHECK_EQ(Parse(MakeHeader(volume)).Depth, 2048u);
+  volume.Depth = 2049;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(volume), UINT64_MAX),
+               std::runtime_error);
+
+  HeaderDesc array;
+  array.Format = kR8Unorm;
+  array.ArraySize = 2048;
+  CHECK_EQ(Parse(MakeHeader(array)).Subresources.size(), 2048u);
+  array.ArraySize = 2049;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(array), UINT64_MAX),
+               std::runtime_error);
+  array.ArraySize = UINT32_MAX;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(array), UINT64_MAX),
+               std::runtime_error);
+  // Six slices per cube: 341 cubes fit, 342 do not, and a count that
+  // would wrap when multiplied by six is refused rather than shrunk.
+  array.MiscFlag = kMiscTextureCube;
+  array.ArraySize = 341;
+  CHECK_EQ(Parse(MakeHeader(array)).ArraySize, 2046u);
+  array.ArraySize = 342;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(array), UINT64_MAX),
+               std::runtime_error);
+  array.ArraySize = 0x2aaaaaab;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(array), UINT64_MAX),
+               std::runtime_error);
+}
+
+void TestMalformed() {
+  HeaderDesc desc;
+  desc.Width = 64;
+  desc.Height = 64;
+  desc.MipCount = 7;
+  const std::vector<uint8_t> header = MakeHeader(desc);
+  const uint64_t fileSize = GetExactFileSize(Parse(header));
+
+  CHECK_THROWS(ParseDdsHeader(header, fileSize - 1), std::runtime_error);
+  CHECK_THROWS(ParseDdsHeader(header, 0), std::runtime_error);
+  // miscFlags2 is not read; cutting into arraySize is truncation.
+  CHECK_THROWS(
+      ParseDdsHeader(std::vector<uint8_t>(header.begin(), header.end() - 5),
+                     fileSize),
+      std::runtime_error);
+  CHECK_THROWS(
+      ParseDdsHeader(std::vector<uint8_t>(header.begin(), header.begin() + 64),
+                     fileSize),
+      std::runtime_error);
+  CHECK_THROWS(ParseDdsHeader({}, fileSize), std::runtime_error);
+
+  std::vector<uint8_t> badMagic = header;
+  badMagic[0] = 'X';
+  CHECK_THROWS(ParseDdsHeader(badMagic, fileSize), std::runtime_error);
+  std::vector<uint8_t> badSize = header;
+  badSize[4] = 123;
+  CHECK_THROWS(ParseDdsHeader(badSize, fileSize), std::runtime_error);
+
+  HeaderDesc bad = desc;
+  bad.MipCount = 8;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(bad), UINT64_MAX),
+               std::runtime_error);
+  bad = desc;
+  bad.Width = 0;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(bad), UINT64_MAX),
+               std::runtime_error);
+  bad = desc;
+  bad.ArraySize = 0;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(bad), UINT64_MAX),
+               std::runtime_error);
+  bad = desc;
+  bad.Dimension = 5;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(bad), UINT64_MAX),
+               std::runtime_error);
+  // Formats the parser does not lay out, for the loader to take instead.
+  bad = desc;
+  bad.Format = kYuy2;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(bad), UINT64_MAX),
+               std::runtime_error);
+  bad.Format = 0;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(bad), UINT64_MAX),
+               std::runtime_error);
+
+  // A header claiming the largest array of the largest mips is refused
+  // as soon as its data passes the end of a small file.
+  HeaderDesc huge;
+  huge.Format = kR32G32B32A32Float;
+  huge.Width = 16384;
+  huge.Height = 16384;
+  huge.MipCount = 15;
+  huge.ArraySize = 2048;
+  CHECK_THROWS(ParseDdsHeader(MakeHeader(huge), 1 << 20), std::runtime_error);
+}
+
+void TestScan() {
+  HeaderDesc desc;
+  desc.Width = 8;
+  desc.Height = 8;
+  desc.MipCount = 4;
+  std::vector<uint8_t> file = MakeHeader(desc);
+  const DdsInfo expected = Parse(file);
+  file.resize(GetExactFileSize(expected), 0xcd);
+
+  std::istringstream stream(std::string(file.begin(), file.end()));
+  const DdsInfo info = ScanDds(stream);
+  CHECK_EQ(info.FileSize, file.size());
+  CHECK_EQ(info.StagingBytes, expected.StagingBytes);
+
+  std::istringstream truncated(std::string(file.begin(), file.end() - 1));
+  CHECK_THROWS(ScanDds(truncated), std::runtime_error);
+  std::istringstream empty;
+  CHECK_THROWS(ScanDds(empty), std::runtime_error);
+}
+
+// Random corruption of valid headers either parses to a layout that fits
+// the file or throws std::runtime_error; nothing else escapes.
+void TestCorruptedHeaders() {
+  std::mt19937 random(47);
+  HeaderDesc desc;
+  desc.Width = 128;
+  desc.Height = 128;
+  desc.MipCount = 8;
+  desc.ArraySize = 4;
+  const std::vector<uint8_t> header = MakeHeader(desc);
+  const uint64_t fileSize = GetExactFileSize(Parse(header));
+  // The fields worth corrupting: DDS_HEADER sizes and flags, the pixel
+  // format, caps2 and the DX10 header.
+  const std::vector<size_t> fieldOffsets = {4,  8,  12, 16,  24,  28,
+                                            76, 80, 84, 112, 128, 132,
+                                            136, 140};
+  int parsed = 0;
+  int rejected = 0;
+  for (int i = 0; i < 20000; ++i) {
+    std::vector<uint8_t> corrupted = header;
+    const int fieldCount = 1 + static_cast<int>(random() % 3);
+    for (int j = 0; j < fieldCount; ++j) {
+      const size_t offset = fieldOffsets[random() % fieldOffsets.size()];
+      uint32_t value = 0;
+      switch (random() % 4) {
+        case 0:
+          value = static_cast<uint32_t>(random());
+          break;
+        case 1:
+          value = static_cast<uint32_t>(random() % 16);
+          break;
+        case 2:
+          value = 1u << (random() % 32);
+          break;
+        default:
+          value = corrupted[offset] ^ (1u << (random() % 8));
+          break;
+      }
+      for (int k = 0; k < 4; ++k) {
+        corrupted[offset + k] = static_cast<uint8_t>(value >> (8 * k));
+      }
+    }
+    const uint64_t size = random() % 2 ? fileSize : random() % (fileSize * 4);
+    try {
+      const DdsInfo info = ParseDdsHeader(corrupted, size);
+      CheckLayout(info, info.Subresources.front().FileOffset);
+      ++parsed;
+    } catch (const std::runtime_error&) {
+      ++rejected;
+    }
+  }
+  CHECK(parsed > 1000);
+  CHECK(rejected > 1000);
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestLegacyMipChain);
+  RUN_TEST(TestBlockCompressed);
+  RUN_TEST(TestArraysCubesAndVolumes);
+  RUN_TEST(TestLimits);
+  RUN_TEST(TestMalformed);
+  RUN_TEST(TestScan);
+  RUN_TEST(TestCorruptedHeaders);
+  return TestResult("DdsInfoTest");
+}
@@ -0,0 +1,195 @@
+// DescriptorAllocator: first-fit persistent ranges that merge when freed,
+// the per-frame transient region, and the errors thrown when either runs
+// out. A randomized run keeps a shadow map of every slot and checks each
+// allocation against the first free run it should have taken.
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "DescriptorAllocator.h"
+#include "TestCheck.h"
+
+namespace {
+// Free runs of the shadow map, which the allocator keeps merged.
+uint32_t CountFreeRuns(const std::vector<bool>& used) {
+  uint32_t runs = 0;
+  for (size_t i = 0; i < used.size(); ++i) {
+    if (!used[i] && (i == 0 || used[i - 1])) {
+      ++runs;
+    }
+  }
+  return runs;
+}
+
+// Start of the first free run of at least count slots, or kInvalidIndex.
+uint32_t FindFirstFit(const std::vector<bool>& used, uint32_t count) {
+  uint32_t run = 0;
+  for (uint32_t i = 0; i < used.size(); ++i) {
+    run = used[i] ? 0 : run + 1;
+    if (run == count) {
+      return i + 1 - count;
+    }
+  }
+  return DescriptorAllocator::kInvalidIndex;
+}
+
+void TestPersistentFirstFitAndMerging() {
+  DescriptorAllocator allocator(16, 4);
+  const uint32_t a = allocator.AllocatePersistent(4);
+  const uint32_t b = allocator.AllocatePersistent(2);
+  const uint32_t c = allocator.AllocatePersistent(3);
+  const uint32_t d = allocator.AllocatePersistent();
+  CHECK_EQ(a, 0u);
+  CHECK_EQ(b, 4u);
+  CHECK_EQ(c, 6u);
+  CHECK_EQ(d, 9u);
+  CHECK_EQ(allocator.GetStats().PersistentUsed, 10u);
+  CHECK_EQ(allocator.GetStats().PersistentFreeRanges, 1u);
+
+  // Freeing b leaves a hole that is too small for 3 but takes 2.
+  allocator.FreePersistent(b);
+  CHECK_EQ(allocator.GetStats().PersistentFreeRanges, 2u);
+  CHECK_EQ(allocator.AllocatePersistent(3), 10u);
+  CHECK_EQ(allocator.AllocatePersistent(2), 4u);
+  CHECK_EQ(allocator.GetStats().PersistentFreeRanges, 1u);
+
+  // Freed neighbours merge: the range at 4, a and c become one run of 9.
+  // Freeing d and then the range at 10 joins runs on both sides.
+  allocator.FreePersistent(4);
+  allocator.FreePersistent(a);
+  CHECK_EQ(allocator.GetStats().PersistentFreeRanges, 2u);
+  allocator.FreePersistent(c);
+  CHECK_EQ(allocator.GetStats().PersistentFreeRanges, 2u);
+  CHECK_EQ(allocator.AllocatePersistent(9), 0u);
+  allocator.FreePersistent(0);
+  allocator.FreePersistent(d);
+  allocator.FreePersistent(10);
+  CHECK_EQ(allocator.GetStats().PersistentFreeRanges, 1u);
+  CHECK_EQ(allocator.GetStats().PersistentUsed, 0u);
+  CHECK_EQ(allocator.GetStats().PersistentPeak, 13u);
+  CHECK_EQ(allocator.AllocatePersistent(16), 0u);
+}
+
+void TestPersistentRandomized() {
+  const uint32_t capacity = 512;
+  for (uint32_t seed = 1; seed <= 8; ++seed) {
+    std::mt19937 random(seed);
+    DescriptorAllocator allocator(capacity, 0);
+    std::vector<bool> used(capacity, false);
+    // Start and count of every live range.
+    std::vector<std::pair<uint32_t, uint32_t>> live;
+    uint32_t usedCount = 0;
+    uint32_t exhausted = 0;
+    uint32_t maxFreeRuns = 0;
+
+    for (uint32_t step = 0; step < 20000; ++step) {
+      const bool allocate =
+          live.empty() || random() % 100 < (usedCount < capacity / 2 ? 60u
+                                                                     : 45u);
+      if (allocate) {
+        const uint32_t count =
+            random() % 8 == 0 ? 1 + random() % 64 : 1 + random() % 6;
+        const uint32_t expected = FindFirstFit(used, count);
+        if (expected == DescriptorAllocator::kInvalidIndex) {
+          CHECK_THROWS(allocator.AllocatePersistent(count),
+                       std::runtime_error);
+          ++exhausted;
+        } else {
+          const uint32_t index = allocator.AllocatePersistent(count);
+          CHECK_EQ(index, expected);
+          for (uint32_t i = index; i < index + count; ++i) {
+            used[i] = true;
+          }
+          live.push_back({index, count});
+          usedCount += count;
+        }
+      } else {
+        const size_t victim = random() % live.size();
+        allocator.FreePersistent(live[victim].first);
+        for (uint32_t i = 0; i < live[victim].second; ++i) {
+          used[live[victim].first + i] = false;
+        }
+        usedCount -= live[victim].second;
+        live[victim] = live.back();
+        live.pop_back();
+      }
+
+      const DescriptorAllocator::Stats stats = allocator.GetStats();
+      CHECK_EQ(stats.PersistentUsed, usedCount);
+      CHECK(stats.PersistentPeak >= usedCount);
+      CHECK_EQ(stats.PersistentFreeRanges, CountFreeRuns(used));
+      maxFreeRuns = std::max(maxFreeRuns, stats.PersistentFreeRanges);
+    }
+    // The run filled the region and fragmented it.
+    CHECK(exhausted > 0);
+    CHECK(maxFreeRuns > 10);
+  }
+}
+
+void TestTransientFrames() {
+  DescriptorAllocator allocator(8, 6);
+  CHECK_EQ(allocator.GetCapacity(), 14u);
+  allocator.AllocatePersistent(8);
+
+  // Transient slots follow the persistent region, back to back.
+  CHECK_EQ(allocator.AllocateTransient(4), 8u);
+  CHECK_EQ(allocator.AllocateTransient(2), 12u);
+  CHECK_EQ(allocator.GetStats().TransientUsed, 6u);
+  CHECK_THROWS(allocator.AllocateTransient(1), std::runtime_error);
+
+  // Each frame starts from the beginning of the region again.
+  for (uint32_t frame = 0; frame < 3; ++frame) {
+    allocator.Reset();
+    CHECK_EQ(allocator.GetStats().TransientUsed, 0u);
+    CHECK_EQ(allocator.AllocateTransient(3), 8u);
+    CHECK_EQ(allocator.AllocateTransient(1), 11u);
+  }
+  CHECK_EQ(allocator.GetStats().TransientUsed, 4u);
+  CHECK_EQ(allocator.GetStats().TransientPeak, 6u);
+  // The persistent region is untouched by Reset().
+  CHECK_EQ(allocator.GetStats().PersistentUsed, 8u);
+}
+
+void TestExhaustionAndMisuseThrow() {
+  DescriptorAllocator allocator(8, 2);
+  const uint32_t a = allocator.AllocatePersistent(3);
+  allocator.AllocatePersistent(2);
+  allocator.AllocatePersistent(3);
+  allocator.FreePersistent(a);
+  // Three slots are free but only in one run of 3; 4 does not fit, and a
+  // failed request leaves the allocator as it was.
+  CHECK_THROWS(allocator.AllocatePersistent(4), std::runtime_error);
+  CHECK_EQ(allocator.GetStats().PersistentUsed, 5u);
+  CHECK_EQ(allocator.GetStats().PersistentFreeRanges, 1u);
+  CHECK_EQ(allocator.AllocatePersistent(3), 0u);
+  CHECK_THROWS(allocator.AllocatePersistent(), std::runtime_error);
+
+  CHECK_THROWS(allocator.AllocateTransient(3), std::runtime_error);
+  CHECK_EQ(allocator.GetStats().TransientUsed, 0u);
+  CHECK_THROWS(allocator.AllocatePersistent(0), std::invalid_argument);
+  CHECK_THROWS(allocator.AllocateTransient(0), std::invalid_argument);
+
+  // Only the start of a live range can be freed, and only once.
+  CHECK_THROWS(allocator.FreePersistent(1), std::invalid_argument);
+  CHECK_THROWS(allocator.FreePersistent(8), std::invalid_argument);
+  allocator.FreePersistent(0);
+  CHECK_THROWS(allocator.FreePersistent(0), std::invalid_argument);
+
+  DescriptorAllocator empty;
+  CHECK_EQ(empty.GetCapacity(), 0u);
+  CHECK_THROWS(empty.AllocatePersistent(), std::runtime_error);
+  CHECK_THROWS(empty.AllocateTransient(1), std::runtime_error);
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestPersistentFirstFitAndMerging);
+  RUN_TEST(TestPersistentRandomized);
+  RUN_TEST(TestTransientFrames);
+  RUN_TEST(TestExhaustionAndMisuseThrow);
+  return TestResult("DescriptorAllocatorTest");
+}
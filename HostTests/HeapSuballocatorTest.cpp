@@ -0,0 +1,346 @@
+// Randomized stress tests of TlsfAllocator and HeapSuballocator, the
+// bookkeeping under GpuMemoryAllocator. Allocations, frees and
+// defragmentation passes run in seeded random order against a shadow copy
+// of every placement; Validate() is called after every step, and the
+// placements are checked for alignment, bounds and overlap.
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "HeapSuballocator.h"
+#include "TestCheck.h"
+#include "TlsfAllocator.h"
+
+namespace {
+using Allocation = HeapSuballocator::Allocation;
+
+const uint64_t kAlignments[] = {1, 4, 256, 4096, 65536};
+
+// [offset, offset + size) ranges of one heap, sorted by offset.
+bool RangesDisjoint(std::vector<std::pair<uint64_t, uint64_t>> ranges) {
+  std::sort(ranges.begin(), ranges.end());
+  for (size_t i = 1; i < ranges.size(); ++i) {
+    if (ranges[i - 1].first + ranges[i - 1].second > ranges[i].first) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TestTlsfRandomAllocateFree() {
+  const uint64_t heapSize = 4ull * 1024 * 1024;
+  for (uint32_t seed = 1; seed <= 8; ++seed) {
+    std::mt19937 random(seed);
+    TlsfAllocator allocator(heapSize);
+    // Offset -> size.
+    std::map<uint64_t, uint64_t> shadow;
+    uint64_t shadowUsed = 0;
+    uint32_t failures = 0;
+    uint32_t invalid = 0;
+
+    for (uint32_t step = 0; step < 4000; ++step) {
+      // Lean towards allocating until the heap is fairly full.
+      const bool allocate =
+          shadow.empty() || random() % 100 < (shadowUsed < heapSize / 2 ? 65u
+                                                                        : 40u);
+      if (allocate) {
+        // Mostly small sizes, sometimes large ones, never a round number on
+        // purpose.
+        const uint64_t size = random() % 8 == 0 ? 1 + random() % (heapSize / 4)
+                                                : 1 + random() % 20000;
+        const uint64_t alignment = kAlignments[random() % 5];
+        const uint64_t largest = allocator.GetLargestFreeBlock();
+        const uint64_t offset = allocator.Allocate(size, alignment);
+        if (offset == TlsfAllocator::kInvalidOffset) {
+          ++failures;
+          // A good fit may round up to the next size class and skip the
+          // aligned start, but never misses a block twice as large.
+          CHECK(largest < 2 * (size + alignment));
+        } else {
+          CHECK_EQ(offset % alignment, 0u);
+          CHECK(offset + size <= heapSize);
+          CHECK_EQ(allocator.GetAllocationSize(offset), size);
+          shadow[offset] = size;
+          shadowUsed += size;
+        }
+      } else {
+        auto it = shadow.begin();
+        std::advance(it, random() % shadow.size());
+        allocator.Free(it->first);
+        CHECK_EQ(allocator.GetAllocationSize(it->first), 0u);
+        shadowUsed -= it->second;
+        shadow.erase(it);
+      }
+
+      invalid += !allocator.Validate();
+      CHECK_EQ(allocator.GetUsedBytes(), shadowUsed);
+      CHECK_EQ(allocator.GetAllocationCount(),
+               static_cast<uint32_t>(shadow.size()));
+      if (step % 64 == 0) {
+        CHECK(RangesDisjoint(std::vector<std::pair<uint64_t, uint64_t>>(
+            shadow.begin(), shadow.end())));
+      }
+    }
+    CHECK_EQ(invalid, 0u);
+    // The large requests have to hit a full heap sometimes.
+    CHECK(failures > 0);
+
+    // Freeing everything merges back into one block.
+    for (const auto& entry : shadow) {
+      allocator.Free(entry.first);
+    }
+    CHECK(allocator.Validate());
+    CHECK_EQ(allocator.GetUsedBytes(), 0u);
+    CHECK_EQ(allocator.GetLargestFreeBlock(), heapSize);
+    CHECK_EQ(allocator.Allocate(heapSize, 65536), 0u);
+  }
+}
+
+void TestTlsfExactFit() {
+  // Filling the heap with equal blocks leaves no room, and any freed block
+  // is found again.
+  TlsfAllocator allocator(64 * 1000);
+  std::vector<uint64_t> offsets;
+  for (uint32_t i = 0; i < 64; ++i) {
+    offsets.push_back(allocator.Allocate(1000, 1));
+    CHECK(offsets.back() != TlsfAllocator::kInvalidOffset);
+  }
+  CHECK_EQ(allocator.Allocate(1, 1), TlsfAllocator::kInvalidOffset);
+  CHECK_EQ(allocator.GetLargestFreeBlock(), 0u);
+  for (uint32_t i = 0; i < 64; i += 7) {
+    allocator.Free(offsets[i]);
+    CHECK_EQ(allocator.Allocate(1000, 1), offsets[i]);
+    CHECK(allocator.Validate());
+  }
+}
+
+void TestTlsfInvalidCalls() {
+  TlsfAllocator allocator(1024);
+  CHECK_THROWS(allocator.Allocate(0, 1), std::invalid_argument);
+  CHECK_THROWS(allocator.Allocate(16, 0), std::invalid_argument);
+  CHECK_THROWS(allocator.Allocate(16, 3), std::invalid_argument);
+  CHECK_THROWS(allocator.Free(0), std::invalid_argument);
+  const uint64_t offset = allocator.Allocate(16, 16);
+  allocator.Free(offset);
+  CHECK_THROWS(allocator.Free(offset), std::invalid_argument);
+  CHECK_EQ(allocator.Allocate(2048, 1), TlsfAllocator::kInvalidOffset);
+  CHECK(allocator.Validate());
+}
+
+struct ShadowAllocation {
+  Allocation Placement;
+  uint64_t Alignment = 1;
+  bool Movable = false;
+};
+
+// Checks every placement against the suballocator and each other.
+void CheckPlacements(const HeapSuballocator& suballocator,
+                     const std::map<uint32_t, ShadowAllocation>& shadow) {
+  std::map<uint32_t, std::vector<std::pair<uint64_t, uint64_t>>> ranges;
+  uint32_t mismatches = 0;
+  for (const auto& entry : shadow) {
+    const Allocation& expected = entry.second.Placement;
+    const Allocation& actual = suballocator.GetAllocation(entry.first);
+    mismatches += actual.Heap != expected.Heap ||
+                  actual.Offset != expected.Offset ||
+                  actual.Size != expected.Size ||
+                  !suballocator.IsHeapAlive(actual.Heap) ||
+                  actual.Offset % entry.second.Alignment != 0 ||
+                  actual.Offset + actual.Size >
+                      suballocator.GetHeapSize(actual.Heap);
+    ranges[actual.Heap].push_back({actual.Offset, actual.Size});
+  }
+  CHECK_EQ(mismatches, 0u);
+  for (const auto& heap : ranges) {
+    CHECK(RangesDisjoint(heap.second));
+  }
+}
+
+void TestSuballocatorRandomWithDefragment() {
+  HeapSuballocator::Settings settings;
+  settings.HeapBytes = 1024 * 1024;
+  for (uint32_t seed = 1; seed <= 6; ++seed) {
+    std::mt19937 random(seed);
+    HeapSuballocator suballocator(settings);
+    std::map<uint32_t, ShadowAllocation> shadow;
+    std::vector<uint32_t> ids;
+    // Heaps the caller has learned about and not yet destroyed.
+    std::vector<bool> created;
+    uint32_t invalid = 0;
+    uint64_t movedBytes = 0;
+    uint32_t releasedHeaps = 0;
+
+    for (uint32_t step = 0; step < 3000; ++step) {
+      const uint32_t action = random() % 100;
+      if (ids.empty() || action < 45) {
+        // Every 50th request is larger than a heap and gets its own.
+        const uint64_t size = random() % 50 == 0
+                                  ? settings.HeapBytes + random() % 65536
+                                  : 1 + random() % (settings.HeapBytes / 8);
+        ShadowAllocation allocation;
+        allocation.Alignment = kAlignments[random() % 5];
+        allocation.Movable = random() % 4 != 0;
+        allocation.Placement =
+            suballocator.Allocate(size, allocation.Alignment,
+                                  allocation.Movable);
+        const uint32_t heap = allocation.Placement.Heap;
+        if (heap >= created.size()) {
+          created.resize(heap + 1, false);
+        }
+        created[heap] = true;
+        CHECK_EQ(allocation.Placement.Size, size);
+        CHECK(shadow.count(allocation.Placement.Id) == 0);
+        shadow[allocation.Placement.Id] = allocation;
+        ids.push_back(allocation.Placement.Id);
+      } else if (action < 85) {
+        const size_t index = random() % ids.size();
+        suballocator.Free(ids[index]);
+        shadow.erase(ids[index]);
+        ids[index] = ids.back();
+        ids.pop_back();
+      } else if (action < 92) {
+        const uint32_t id = ids[random() % ids.size()];
+        const bool movable = random() % 2 == 0;
+        suballocator.SetMovable(id, movable);
+        shadow[id].Movable = movable;
+      } else {
+        const uint64_t maxBytes = random() % (2 * settings.HeapBytes);
+        const auto moves = suballocator.Defragment(maxBytes);
+        uint64_t planned = 0;
+        for (const HeapSuballocator::Move& move : moves) {
+          ShadowAllocation& allocation = shadow.at(move.Id);
+          CHECK(allocation.Movable);
+          CHECK_EQ(move.FromHeap, allocation.Placement.Heap);
+          CHECK_EQ(move.FromOffset, allocation.Placement.Offset);
+          CHECK_EQ(move.Size, allocation.Placement.Size);
+          CHECK(move.ToHeap != move.FromHeap);
+          // Sources are emptied, never filled in the same pass.
+          for (const HeapSuballocator::Move& other : moves) {
+            CHECK(other.ToHeap != move.FromHeap);
+          }
+          allocation.Placement.Heap = move.ToHeap;
+          allocation.Placement.Offset = move.ToOffset;
+          planned += move.Size;
+        }
+        CHECK(planned <= maxBytes);
+        movedBytes += planned;
+
+        // The copies are done; the retired heaps can go.
+        if (random() % 2 == 0) {
+          invalid += !suballocator.Validate();
+          CheckPlacements(suballocator, shadow);
+          for (uint32_t heap : suballocator.ReleaseRetiredHeaps()) {
+            CHECK(heap < created.size() && created[heap]);
+            CHECK(!suballocator.IsHeapAlive(heap));
+            created[heap] = false;
+            ++releasedHeaps;
+          }
+        }
+      }
+
+      invalid += !suballocator.Validate();
+      const HeapSuballocator::Stats stats = suballocator.GetStats();
+      CHECK_EQ(stats.Allocations, static_cast<uint32_t>(shadow.size()));
+      uint64_t used = 0;
+      for (const auto& entry : shadow) {
+        used += entry.second.Placement.Size;
+      }
+      CHECK_EQ(stats.UsedBytes, used);
+      CHECK(stats.UsedBytes <= stats.HeapBytes);
+      if (step % 16 == 0) {
+        CheckPlacements(suballocator, shadow);
+      }
+    }
+    CHECK_EQ(invalid, 0u);
+    CheckPlacements(suballocator, shadow);
+    CHECK_EQ(suballocator.GetStats().MovedBytes, movedBytes);
+    // The run has to exercise the paths it is meant to cover.
+    CHECK(movedBytes > 0);
+    CHECK(releasedHeaps > 0);
+
+    for (uint32_t id : ids) {
+      suballocator.Free(id);
+    }
+    suballocator.ReleaseRetiredHeaps();
+    CHECK(suballocator.Validate());
+    // Only the one empty shared heap kept for reuse is left.
+    CHECK(suballocator.GetStats().Heaps <= 1u);
+  }
+}
+
+void TestDefragmentEmptiesSparseHeaps() {
+  HeapSuballocator::Settings settings;
+  settings.HeapBytes = 1024 * 1024;
+  HeapSuballocator suballocator(settings);
+  // Four heaps of quarter-size blocks, then free most of three of them.
+  std::vector<Allocation> allocations;
+  for (uint32_t i = 0; i < 16; ++i) {
+    allocations.push_back(
+        suballocator.Allocate(settings.HeapBytes / 4, 65536, true));
+  }
+  CHECK_EQ(suballocator.GetStats().Heaps, 4u);
+  // Leave each heap a quarter full: one heap can take the other three.
+  for (const Allocation& allocation : allocations) {
+    if (allocation.Offset != 0) {
+      suballocator.Free(allocation.Id);
+    }
+  }
+  CHECK(suballocator.Validate());
+
+  const auto moves = suballocator.Defragment(~0ull);
+  CHECK(suballocator.Validate());
+  CHECK_EQ(moves.size(), 3u);
+  CHECK_EQ(suballocator.ReleaseRetiredHeaps().size(), 3u);
+  CHECK_EQ(suballocator.GetStats().Heaps, 1u);
+  CHECK_EQ(suballocator.GetStats().UsedBytes, settings.HeapBytes);
+  CHECK(suballocator.Validate());
+
+  // A pinned allocation keeps its sparse heap out of the plan.
+  suballocator.Allocate(settings.HeapBytes / 4, 1, false);
+  CHECK_EQ(suballocator.GetStats().Heaps, 2u);
+  CHECK(suballocator.Defragment(~0ull).empty());
+  CHECK(suballocator.Validate());
+}
+
+void TestSuballocatorInvalidCalls() {
+  HeapSuballocator::Settings settings;
+  settings.HeapBytes = 0;
+  CHECK_THROWS(HeapSuballocator{settings}, std::invalid_argument);
+  HeapSuballocator suballocator;
+  CHECK_THROWS(suballocator.Free(1), std::invalid_argument);
+  CHECK(suballocator.Validate());
+
+  // An alignment no placed heap can meet opens exactly one heap, whose
+  // offset 0 is aligned to anything, shared or dedicated alike.
+  settings.HeapBytes = 1 << 16;
+  HeapSuballocator heaps(settings);
+  CHECK_EQ(heaps.Allocate(256, 1, true).Offset, 0u);
+  const HeapSuballocator::Allocation shared =
+      heaps.Allocate(256, settings.HeapBytes * 2, true);
+  CHECK_EQ(shared.Heap, 1u);
+  CHECK_EQ(shared.Offset, 0u);
+  const HeapSuballocator::Allocation dedicated =
+      heaps.Allocate(settings.HeapBytes * 2, settings.HeapBytes * 4, true);
+  CHECK_EQ(dedicated.Heap, 2u);
+  CHECK_EQ(dedicated.Offset, 0u);
+  CHECK_EQ(heaps.GetHeapCount(), 3u);
+  CHECK_EQ(heaps.GetStats().Heaps, 3u);
+  CHECK_EQ(heaps.GetStats().HeapBytes, settings.HeapBytes * 4);
+  CHECK(heaps.Validate());
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestTlsfRandomAllocateFree);
+  RUN_TEST(TestTlsfExactFit);
+  RUN_TEST(TestTlsfInvalidCalls);
+  RUN_TEST(TestSuballocatorRandomWithDefragment);
+  RUN_TEST(TestDefragmentEmptiesSparseHeaps);
+  RUN_TEST(TestSuballocatorInvalidCalls);
+  return TestResult("HeapSuballocatorTest");
+}
@@ -0,0 +1,253 @@
+// ParticleCpuSimulator against an oracle transcribed from ParticleEmitCS and
+// ParticleSimulateCS one thread at a time. The test is built twice, with
+// and without PARTICLE_CPU_NO_SIMD, so both the SSE2 and the scalar paths
+// are checked; within a build, every worker count has to give bit-identical
+// pools.
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "ParticleCpuSimulator.h"
+#include "ParticleEmitterSet.h"
+#include "TestCheck.h"
+
+namespace {
+using Particle = ParticleCpuSimulator::Particle;
+using GpuRecord = ParticleEmitterSet::GpuRecord;
+
+// The shaders' rules over an array of Particle structs, with the dead list
+// as a stack like ParticleCpuSimulator uses.
+class ShaderOracle {
+ public:
+  explicit ShaderOracle(uint32_t capacity) : mPool(capacity) {
+    // ParticleInitCS.
+    for (uint32_t i = 0; i < capacity; ++i) {
+      mDeadList.push_back(i);
+    }
+  }
+
+  void Emit(const std::vector<GpuRecord>& emitters, uint32_t spawnCount) {
+    if (emitters.empty()) {
+      return;
+    }
+    const uint32_t deadCount = static_cast<uint32_t>(mDeadList.size());
+    for (uint32_t spawnIndex = 0; spawnIndex < spawnCount; ++spawnIndex) {
+      if (spawnIndex >= deadCount) {
+        return;
+      }
+      // Last emitter whose range starts at or before this thread.
+      uint32_t emitter = 0;
+      while (emitter + 1 < emitters.size() &&
+             emitters[emitter + 1].FirstSpawn <= spawnIndex) {
+        ++emitter;
+      }
+      const GpuRecord& e = emitters[emitter];
+      uint32_t rng =
+          e.Seed ^ ParticleEmitterSet::Hash(spawnIndex - e.FirstSpawn);
+      const uint32_t particleIndex = mDeadList.back();
+      mDeadList.pop_back();
+
+      Particle& p = mPool[particleIndex];
+      const float px = NextRandom(rng) * 2.0f - 1.0f;
+      const float py = NextRandom(rng) * 2.0f - 1.0f;
+      const float pz = NextRandom(rng) * 2.0f - 1.0f;
+      p.Position = {e.Position.X + px * e.PositionExtent.X,
+                    e.Position.Y + py * e.PositionExtent.Y,
+                    e.Position.Z + pz * e.PositionExtent.Z};
+      const float vx = NextRandom(rng) * 2.0f - 1.0f;
+      const float vy = NextRandom(rng) * 2.0f - 1.0f;
+      const float vz = NextRandom(rng) * 2.0f - 1.0f;
+      p.Velocity = {e.VelocityMean.X + vx * e.VelocityExtent.X,
+                    e.VelocityMean.Y + vy * e.VelocityExtent.Y,
+                    e.VelocityMean.Z + vz * e.VelocityExtent.Z};
+      p.Age = 0.0f;
+      p.Lifetime = e.LifetimeMin +
+                   (e.LifetimeMax - e.LifetimeMin) * NextRandom(rng);
+      std::memcpy(p.Color, e.Color, sizeof(p.Color));
+      p.Size = e.SizeMin + (e.SizeMax - e.SizeMin) * NextRandom(rng);
+    }
+  }
+
+  // Collision disabled.
+  void Simulate(float deltaTime) {
+    mAliveList.clear();
+    for (uint32_t idx = 0; idx < mPool.size(); ++idx) {
+      Particle& p = mPool[idx];
+      if (p.Age < 0.0f) {
+        continue;
+      }
+      p.Age += deltaTime;
+      p.Velocity.Y += -9.8f * deltaTime;
+      p.Position.X += p.Velocity.X * deltaTime;
+      p.Position.Y += p.Velocity.Y * deltaTime;
+      p.Position.Z += p.Velocity.Z * deltaTime;
+      if (p.Age >= p.Lifetime || p.Position.Y < -5.0f) {
+        p.Age = -1.0f;
+        mDeadList.push_back(idx);
+      } else {
+        mAliveList.push_back(idx);
+      }
+    }
+  }
+
+  const Particle& GetParticle(uint32_t index) const { return mPool[index]; }
+  uint32_t GetDeadCount() const {
+    return static_cast<uint32_t>(mDeadList.size());
+  }
+  const std::vector<uint32_t>& GetAliveList() const { return mAliveList; }
+
+ private:
+  static float NextRandom(uint32_t& rng) {
+    rng = ParticleEmitterSet::Hash(rng);
+    return static_cast<float>(rng) * (1.0f / 4294967296.0f);
+  }
+
+  std::vector<Particle> mPool;
+  std::vector<uint32_t> mDeadList;
+  std::vector<uint32_t> mAliveList;
+};
+
+bool SameParticle(const Particle& a, const Particle& b) {
+  // Dead slots keep stale motion state that nothing reads.
+  if (a.Age < 0.0f || b.Age < 0.0f) {
+    return a.Age == b.Age;
+  }
+  return a.Position.X == b.Position.X && a.Position.Y == b.Position.Y &&
+         a.Position.Z == b.Position.Z && a.Age == b.Age &&
+         a.Velocity.X == b.Velocity.X && a.Velocity.Y == b.Velocity.Y &&
+         a.Velocity.Z == b.Velocity.Z && a.Lifetime == b.Lifetime &&
+         std::memcmp(a.Color, b.Color, sizeof(a.Color)) == 0 &&
+         a.Size == b.Size;
+}
+
+ParticleEmitterSet MakeEmitters() {
+  ParticleEmitterSet emitters;
+  ParticleEmitterSet::EmitterDesc fountain;
+  fountain.PositionExtent = {0.5f, 0.0f, 0.5f};
+  fountain.SpawnRate = 2400.0f;
+  fountain.LifetimeMin = 0.5f;
+  fountain.LifetimeMax = 3.0f;
+  fountain.VelocityMean = {0.0f, 6.0f, 0.0f};
+  fountain.VelocityExtent = {2.0f, 2.0f, 2.0f};
+  emitters.AddEmitter(fountain);
+
+  // Falls below the kill height long before its lifetime ends.
+  ParticleEmitterSet::EmitterDesc drip;
+  drip.Position = {3.0f, -4.0f, 1.0f};
+  drip.PositionExtent = {1.0f, 0.5f, 1.0f};
+  drip.SpawnRate = 700.5f;
+  drip.LifetimeMin = 10.0f;
+  drip.LifetimeMax = 20.0f;
+  drip.VelocityExtent = {0.5f, 0.5f, 0.5f};
+  drip.Color[0] = 0.25f;
+  drip.SizeMin = 0.1f;
+  drip.SizeMax = 0.3f;
+  emitters.AddEmitter(drip);
+
+  ParticleEmitterSet::EmitterDesc sparks;
+  sparks.Position = {-2.0f, 1.0f, 0.0f};
+  sparks.SpawnRate = 333.3f;
+  sparks.LifetimeMin = 0.05f;
+  sparks.LifetimeMax = 0.2f;
+  sparks.VelocityExtent = {8.0f, 8.0f, 8.0f};
+  emitters.AddEmitter(sparks);
+  return emitters;
+}
+
+// Runs the oracle and simulators with the given worker counts on the same
+// batches and compares every slot after every frame. The capacity is not a
+// multiple of 4 and saturates, so the scalar tail and dropped spawns are
+// covered.
+void CompareWithOracle(uint32_t capacity,
+                       const std::vector<uint32_t>& workerCounts) {
+  ParticleEmitterSet emitters = MakeEmitters();
+  ShaderOracle oracle(capacity);
+  std::vector<std::unique_ptr<ParticleCpuSimulator>> simulators;
+  for (uint32_t workers : workerCounts) {
+    simulators.push_back(
+        std::make_unique<ParticleCpuSimulator>(capacity, workers));
+  }
+
+  std::vector<GpuRecord> records;
+  uint32_t mismatches = 0;
+  bool droppedSpawns = false;
+  bool freedSlots = false;
+  for (uint32_t frame = 0; frame < 240; ++frame) {
+    const float deltaTime = frame % 7 == 0 ? 1.0f / 30.0f : 1.0f / 60.0f;
+    const uint32_t spawnCount =
+        emitters.BuildSpawnBatch(deltaTime, capacity, records);
+    droppedSpawns |= spawnCount > oracle.GetDeadCount();
+    oracle.Emit(records, spawnCount);
+    const uint32_t deadAfterEmit = oracle.GetDeadCount();
+    oracle.Simulate(deltaTime);
+    freedSlots |= oracle.GetDeadCount() > deadAfterEmit;
+
+    for (const auto& simulator : simulators) {
+      simulator->Step(deltaTime, records, spawnCount);
+      CHECK_EQ(simulator->GetDeadCount(), oracle.GetDeadCount());
+      CHECK(simulator->GetAliveList() == oracle.GetAliveList());
+      for (uint32_t i = 0; i < capacity; ++i) {
+        if (!SameParticle(simulator->GetParticle(i), oracle.GetParticle(i))) {
+          ++mismatches;
+        }
+      }
+    }
+  }
+  CHECK_EQ(mismatches, 0u);
+  // The run has to reach the states the comparison is meant to cover.
+  CHECK(droppedSpawns);
+  CHECK(freedSlots);
+}
+
+void TestMatchesShaderOracle() { CompareWithOracle(1021, {1}); }
+
+void TestWorkerCountsMatchOracle() {
+  // More workers than chunks leaves some of them with empty ranges.
+  CompareWithOracle(1021, {2, 3, 8});
+  CompareWithOracle(6, {4});
+}
+
+void TestEmitWithoutEmittersDoesNothing() {
+  ParticleCpuSimulator simulator(16, 2);
+  simulator.Emit({}, 10);
+  simulator.Simulate(0.1f);
+  CHECK_EQ(simulator.GetDeadCount(), 16u);
+  CHECK(simulator.GetAliveList().empty());
+}
+
+void TestRepeatedSimulateReusesWorkers() {
+  // Many short frames: a pool that lost a wakeup would hang here.
+  ParticleCpuSimulator simulator(64, 4);
+  CHECK_EQ(simulator.GetWorkerCount(), 4u);
+  ParticleEmitterSet emitters = MakeEmitters();
+  std::vector<GpuRecord> records;
+  for (uint32_t frame = 0; frame < 5000; ++frame) {
+    const uint32_t spawnCount =
+        emitters.BuildSpawnBatch(1.0f / 60.0f, 64, records);
+    simulator.Step(1.0f / 60.0f, records, spawnCount);
+  }
+  CHECK_EQ(simulator.GetDeadCount() + simulator.GetAliveList().size(), 64u);
+}
+
+void TestInvalidArguments() {
+  CHECK_THROWS(ParticleCpuSimulator(0), std::invalid_argument);
+  ParticleCpuSimulator simulator(8, 1);
+  CHECK_THROWS(simulator.GetParticle(8), std::out_of_range);
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestMatchesShaderOracle);
+  RUN_TEST(TestWorkerCountsMatchOracle);
+  RUN_TEST(TestEmitWithoutEmittersDoesNothing);
+  RUN_TEST(TestRepeatedSimulateReusesWorkers);
+  RUN_TEST(TestInvalidArguments);
+#ifdef PARTICLE_CPU_NO_SIMD
+  return TestResult("ParticleCpuSimulatorTest (scalar)");
+#else
+  return TestResult("ParticleCpuSimulatorTest");
+#endif
+}
@@ -0,0 +1,261 @@
+// The bitonic network of ParticleSortCS.hlsl, emulated kernel by kernel
+// with the dispatch schedule of RenderingSystem::SortParticles, against
+// ParticleCpuSimulator::SortAliveBackToFront. Alive counts and capacities
+// are mostly not powers of two, so the padding entries are exercised.
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "ParticleCpuSimulator.h"
+#include "ParticleEmitterSet.h"
+#include "TestCheck.h"
+
+namespace {
+// Must match LOCAL_SORT_SIZE in ParticleSortCS.hlsl.
+constexpr uint32_t kLocalSortSize = 1024;
+
+struct SortEntry {
+  float Depth;
+  uint32_t Index;
+};
+
+void CompareAndSwap(SortEntry& a, SortEntry& b, bool descending) {
+  if ((a.Depth < b.Depth) == descending) {
+    std::swap(a, b);
+  }
+}
+
+uint32_t PairLow(uint32_t t, uint32_t j) {
+  return ((t & ~(j - 1)) << 1) | (t & (j - 1));
+}
+
+// One GPU sort. Threads of a group write disjoint pairs between barriers,
+// so running them one after another gives the same result.
+class BitonicSortEmulator {
+ public:
+  BitonicSortEmulator(const ParticleCpuSimulator& simulator,
+                      const float viewDepthColumn[4])
+      : mSimulator(simulator) {
+    std::copy(viewDepthColumn, viewDepthColumn + 4, mViewDepthColumn);
+    // RenderingSystem::BuildParticleResources.
+    mSortCount = kLocalSortSize;
+    while (mSortCount < simulator.GetCapacity()) {
+      mSortCount <<= 1;
+    }
+    mEntries.resize(mSortCount);
+  }
+
+  std::vector<uint32_t> Sort() {
+    const uint32_t blockCount = mSortCount / kLocalSortSize;
+    BuildKeys();
+    for (uint32_t block = 0; block < blockCount; ++block) {
+      PreSort(block);
+    }
+    for (uint32_t k = kLocalSortSize * 2; k <= mSortCount; k <<= 1) {
+      for (uint32_t j = k / 2; j >= kLocalSortSize; j >>= 1) {
+        GlobalStep(k, j);
+      }
+      for (uint32_t block = 0; block < blockCount; ++block) {
+        LocalStep(block, k);
+      }
+    }
+    return WriteBack();
+  }
+
+  uint32_t GetSortCount() const { return mSortCount; }
+
+ private:
+  void BuildKeys() {
+    const auto& alive = mSimulator.GetAliveList();
+    for (uint32_t i = 0; i < mSortCount; ++i) {
+      SortEntry e = {-3.402823466e+38f, 0xffffffffu};
+      if (i < alive.size()) {
+        e.Index = alive[i];
+        const ParticleCpuSimulator::Particle p =
+            mSimulator.GetParticle(e.Index);
+        e.Depth = p.Position.X * mViewDepthColumn[0] +
+                  p.Position.Y * mViewDepthColumn[1] +
+                  p.Position.Z * mViewDepthColumn[2] + mViewDepthColumn[3];
+      }
+      mEntries[i] = e;
+    }
+  }
+
+  void PreSort(uint32_t block) {
+    const uint32_t baseIndex = block * kLocalSortSize;
+    for (uint32_t k = 2; k <= kLocalSortSize; k <<= 1) {
+      for (uint32_t j = k >> 1; j > 0; j >>= 1) {
+        for (uint32_t gi = 0; gi < kLocalSortSize / 2; ++gi) {
+          const uint32_t lo = PairLow(gi, j);
+          CompareAndSwap(mEntries[baseIndex + lo], mEntries[baseIndex + lo + j],
+                         ((baseIndex + lo) & k) == 0);
+        }
+      }
+    }
+  }
+
+  void GlobalStep(uint32_t k, uint32_t j) {
+    for (uint32_t t = 0; t < mSortCount / 2; ++t) {
+      const uint32_t lo = PairLow(t, j);
+      CompareAndSwap(mEntries[lo], mEntries[lo + j], (lo & k) == 0);
+    }
+  }
+
+  void LocalStep(uint32_t block, uint32_t k) {
+    const uint32_t baseIndex = block * kLocalSortSize;
+    for (uint32_t j = kLocalSortSize / 2; j > 0; j >>= 1) {
+      for (uint32_t gi = 0; gi < kLocalSortSize / 2; ++gi) {
+        const uint32_t lo = PairLow(gi, j);
+        CompareAndSwap(mEntries[baseIndex + lo], mEntries[baseIndex + lo + j],
+                       ((baseIndex + lo) & k) == 0);
+      }
+    }
+  }
+
+  std::vector<uint32_t> WriteBack() const {
+    std::vector<uint32_t> sorted;
+    for (uint32_t i = 0; i < mSimulator.GetAliveList().size(); ++i) {
+      sorted.push_back(mEntries[i].Index);
+    }
+    return sorted;
+  }
+
+  const ParticleCpuSimulator& mSimulator;
+  float mViewDepthColumn[4];
+  uint32_t mSortCount = 0;
+  std::vector<SortEntry> mEntries;
+};
+
+float Depth(const ParticleCpuSimulator& simulator, uint32_t index,
+            const float viewDepthColumn[4]) {
+  const ParticleCpuSimulator::Particle p = simulator.GetParticle(index);
+  return p.Position.X * viewDepthColumn[0] +
+         p.Position.Y * viewDepthColumn[1] +
+         p.Position.Z * viewDepthColumn[2] + viewDepthColumn[3];
+}
+
+// Fills a pool to roughly `aliveTarget` live particles spread over a box.
+void Populate(ParticleCpuSimulator& simulator, uint32_t aliveTarget,
+              uint32_t seed) {
+  ParticleEmitterSet emitters;
+  ParticleEmitterSet::EmitterDesc desc;
+  desc.PositionExtent = {20.0f, 5.0f, 20.0f};
+  desc.Position = {0.0f, 10.0f, 0.0f};
+  desc.SpawnRate = static_cast<float>(aliveTarget) * 60.0f;
+  desc.LifetimeMin = 100.0f;
+  desc.LifetimeMax = 100.0f;
+  emitters.AddEmitter(desc);
+  std::vector<ParticleEmitterSet::GpuRecord> records;
+  // Different seeds give different frame indices and therefore positions.
+  for (uint32_t frame = 0; frame < seed % 5; ++frame) {
+    emitters.BuildSpawnBatch(0.0f, 0, records);
+  }
+  const uint32_t spawnCount =
+      emitters.BuildSpawnBatch(1.0f / 60.0f, aliveTarget, records);
+  simulator.Step(0.0f, records, spawnCount);
+}
+
+// The GPU result is a permutation of the alive list whose depths equal the
+// CPU reference position by position; equal depths may be ordered
+// differently.
+void CheckMatchesReference(const ParticleCpuSimulator& simulator,
+                           const float viewDepthColumn[4]) {
+  BitonicSortEmulator gpu(simulator, viewDepthColumn);
+  const std::vector<uint32_t> gpuOrder = gpu.Sort();
+  const std::vector<uint32_t> cpuOrder =
+      simulator.SortAliveBackToFront(viewDepthColumn);
+
+  CHECK_EQ(gpuOrder.size(), simulator.GetAliveList().size());
+  CHECK_EQ(cpuOrder.size(), gpuOrder.size());
+  if (cpuOrder.size() != gpuOrder.size()) {
+    return;
+  }
+  uint32_t depthMismatches = 0;
+  for (size_t i = 0; i < gpuOrder.size(); ++i) {
+    if (gpuOrder[i] >= simulator.GetCapacity() ||
+        Depth(simulator, gpuOrder[i], viewDepthColumn) !=
+            Depth(simulator, cpuOrder[i], viewDepthColumn)) {
+      ++depthMismatches;
+    }
+  }
+  CHECK_EQ(depthMismatches, 0u);
+
+  std::vector<uint32_t> gpuSet = gpuOrder;
+  std::vector<uint32_t> aliveSet = simulator.GetAliveList();
+  std::sort(gpuSet.begin(), gpuSet.end());
+  std::sort(aliveSet.begin(), aliveSet.end());
+  CHECK(gpuSet == aliveSet);
+}
+
+void TestSortMatchesReference() {
+  const float viewDepthColumn[4] = {0.3f, -0.2f, 0.93f, 25.0f};
+  // Capacities below, at and above one block, up to a multi-stage merge;
+  // alive counts from empty to full.
+  const uint32_t capacities[] = {1, 100, 1024, 1025, 3000, 5000, 9000};
+  uint32_t seed = 1;
+  for (uint32_t capacity : capacities) {
+    for (uint32_t alive :
+         {0u, 1u, capacity / 3 + 1, capacity - capacity / 7, capacity}) {
+      ParticleCpuSimulator simulator(capacity, 1);
+      Populate(simulator, std::min(alive, capacity), seed++);
+      CheckMatchesReference(simulator, viewDepthColumn);
+    }
+  }
+}
+
+void TestSortCountIsNextPowerOfTwo() {
+  const float viewDepthColumn[4] = {0.0f, 0.0f, 1.0f, 0.0f};
+  const uint32_t cases[][2] = {
+      {1, 1024}, {1024, 1024}, {1025, 2048}, {5000, 8192}, {8192, 8192}};
+  for (const auto& testCase : cases) {
+    ParticleCpuSimulator simulator(testCase[0], 1);
+    CHECK_EQ(BitonicSortEmulator(simulator, viewDepthColumn).GetSortCount(),
+             testCase[1]);
+  }
+}
+
+void TestEqualDepths() {
+  // A view axis perpendicular to the spread: every particle at one depth,
+  // so only the permutation and depths can be compared.
+  const float viewDepthColumn[4] = {0.0f, 0.0f, 0.0f, 4.0f};
+  ParticleCpuSimulator simulator(2500, 1);
+  Populate(simulator, 2100, 3);
+  CheckMatchesReference(simulator, viewDepthColumn);
+}
+
+void TestReferenceIsBackToFront() {
+  const float viewDepthColumn[4] = {-0.6f, 0.1f, 0.79f, 3.0f};
+  ParticleCpuSimulator simulator(700, 1);
+  Populate(simulator, 650, 4);
+  const std::vector<uint32_t> sorted =
+      simulator.SortAliveBackToFront(viewDepthColumn);
+  CHECK_EQ(sorted.size(), simulator.GetAliveList().size());
+  for (size_t i = 1; i < sorted.size(); ++i) {
+    CHECK(Depth(simulator, sorted[i - 1], viewDepthColumn) >=
+          Depth(simulator, sorted[i], viewDepthColumn));
+  }
+}
+
+void TestRandomViews() {
+  std::mt19937 random(11);
+  std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+  ParticleCpuSimulator simulator(3333, 1);
+  Populate(simulator, 2999, 2);
+  for (int view = 0; view < 20; ++view) {
+    const float viewDepthColumn[4] = {axis(random), axis(random), axis(random),
+                                      axis(random) * 50.0f};
+    CheckMatchesReference(simulator, viewDepthColumn);
+  }
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestSortMatchesReference);
+  RUN_TEST(TestSortCountIsNextPowerOfTwo);
+  RUN_TEST(TestEqualDepths);
+  RUN_TEST(TestReferenceIsBackToFront);
+  RUN_TEST(TestRandomViews);
+  return TestResult("ParticleSortTest");
+}
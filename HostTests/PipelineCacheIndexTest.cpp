@@ -0,0 +1,238 @@
+// The pipeline cache's on-disk index and the hash its pipeline keys are
+// built from. The keys themselves are covered by PipelineKeyTest.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Fnv1aHash.h"
+#include "LittleEndianIO.h"
+#include "PipelineCacheIndex.h"
+#include "TestCheck.h"
+
+namespace {
+using AdapterIdentity = PipelineCacheIndex::AdapterIdentity;
+
+const char* const kPath = "PipelineCacheIndexTest.bin";
+
+AdapterIdentity MakeAdapter() {
+  AdapterIdentity adapter;
+  adapter.VendorId = 0x10de;
+  adapter.DeviceId = 0x2684;
+  adapter.DriverVersion = 0x001f000e000a1234ull;
+  return adapter;
+}
+
+std::vector<uint8_t> ReadFile(const char* path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const char* path, const std::vector<uint8_t>& data) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+}
+
+PipelineCacheIndex MakeIndex(uint32_t keyCount, uint32_t librarySize) {
+  PipelineCacheIndex index;
+  index.SetAdapter(MakeAdapter());
+  std::vector<uint64_t> keys;
+  for (uint32_t i = 0; i < keyCount; ++i) {
+    keys.push_back(0x9e3779b97f4a7c15ull * (i + 1));
+  }
+  index.SetKeys(keys);
+  std::vector<uint8_t> library;
+  for (uint32_t i = 0; i < librarySize; ++i) {
+    library.push_back(static_cast<uint8_t>(i * 31 + 7));
+  }
+  index.SetLibraryData(library);
+  return index;
+}
+
+void TestRoundTrip() {
+  for (uint32_t keyCount : {0u, 1u, 37u}) {
+    for (uint32_t librarySize : {0u, 1u, 4096u}) {
+      const PipelineCacheIndex saved = MakeIndex(keyCount, librarySize);
+      saved.Save(kPath);
+
+      PipelineCacheIndex loaded;
+      CHECK(loaded.Load(kPath, MakeAdapter()));
+      CHECK(loaded.GetAdapter() == MakeAdapter());
+      CHECK(loaded.GetKeys() == saved.GetKeys());
+      CHECK(loaded.GetLibraryData() == saved.GetLibraryData());
+      for (uint64_t key : saved.GetKeys()) {
+        CHECK(loaded.Contains(key));
+      }
+      CHECK(!loaded.Contains(0));
+    }
+  }
+}
+
+void TestFileLayout() {
+  PipelineCacheIndex index = MakeIndex(2, 3);
+  index.Save(kPath);
+  const std::vector<uint8_t> data = ReadFile(kPath);
+  CHECK_EQ(data.size(), 4u + 4 + 4 + 4 + 8 + 4 + 2 * 8 + 8 + 8 + 3);
+  CHECK(std::string(data.begin(), data.begin() + 4) == "PSOC");
+
+  size_t offset = 4;
+  uint32_t value32 = 0;
+  uint64_t value64 = 0;
+  CHECK(ReadUint32LE(data, offset, value32));
+  CHECK_EQ(value32, PipelineCacheIndex::kVersion);
+  CHECK(ReadUint32LE(data, offset, value32));
+  CHECK_EQ(value32, 0x10deu);
+  // Little-endian on every host.
+  CHECK_EQ(static_cast<uint32_t>(data[8]), 0xdeu);
+  CHECK(ReadUint32LE(data, offset, value32));
+  CHECK_EQ(value32, 0x2684u);
+  CHECK(ReadUint64LE(data, offset, value64));
+  CHECK_EQ(value64, MakeAdapter().DriverVersion);
+  CHECK(ReadUint32LE(data, offset, value32));
+  CHECK_EQ(value32, 2u);
+  CHECK(ReadUint64LE(data, offset, value64));
+  CHECK_EQ(value64, index.GetKeys()[0]);
+  CHECK(ReadUint64LE(data, offset, value64));
+  CHECK_EQ(value64, index.GetKeys()[1]);
+  CHECK(ReadUint64LE(data, offset, value64));
+  CHECK_EQ(value64, 3u);
+  CHECK(ReadUint64LE(data, offset, value64));
+  Fnv1aHash libraryHash;
+  libraryHash.AddBytes(index.GetLibraryData().data(), 3);
+  CHECK_EQ(value64, libraryHash.Get());
+}
+
+void TestAdapterMismatchRejected() {
+  MakeIndex(3, 64).Save(kPath);
+  AdapterIdentity other = MakeAdapter();
+  other.DriverVersion += 1;
+  PipelineCacheIndex loaded;
+  CHECK(!loaded.Load(kPath, other));
+  CHECK(loaded.GetKeys().empty());
+  CHECK(loaded.GetLibraryData().empty());
+  other = MakeAdapter();
+  other.DeviceId ^= 1;
+  CHECK(!loaded.Load(kPath, other));
+  other = MakeAdapter();
+  other.VendorId = 0x1002;
+  CHECK(!loaded.Load(kPath, other));
+  CHECK(loaded.Load(kPath, MakeAdapter()));
+}
+
+void TestMalformedFilesRejected() {
+  MakeIndex(4, 200).Save(kPath);
+  const std::vector<uint8_t> valid = ReadFile(kPath);
+  PipelineCacheIndex loaded;
+
+  // Every truncation and one byte too many.
+  uint32_t accepted = 0;
+  for (size_t size = 0; size < valid.size(); ++size) {
+    WriteFile(kPath, std::vector<uint8_t>(valid.begin(), valid.begin() + size));
+    accepted += loaded.Load(kPath, MakeAdapter());
+  }
+  std::vector<uint8_t> longer = valid;
+  longer.push_back(0);
+  WriteFile(kPath, longer);
+  accepted += loaded.Load(kPath, MakeAdapter());
+  CHECK_EQ(accepted, 0u);
+
+  // A flipped bit anywhere outside the key list is detected; inside it the
+  // file loads with a key that simply never matches.
+  const size_t keysBegin = 4 + 4 + 4 + 4 + 8 + 4;
+  const size_t keysEnd = keysBegin + 4 * 8;
+  uint32_t undetected = 0;
+  for (size_t byte = 0; byte < valid.size(); ++byte) {
+    std::vector<uint8_t> corrupt = valid;
+    corrupt[byte] ^= 0x10;
+    WriteFile(kPath, corrupt);
+    const bool ok = loaded.Load(kPath, MakeAdapter());
+    if (byte >= keysBegin && byte < keysEnd) {
+      CHECK(ok);
+    } else {
+      undetected += ok;
+    }
+  }
+  CHECK_EQ(undetected, 0u);
+
+  // A huge key count must fail without trying to allocate for it.
+  std::vector<uint8_t> hugeCount = valid;
+  for (size_t i = keysBegin - 4; i < keysBegin; ++i) {
+    hugeCount[i] = 0xff;
+  }
+  WriteFile(kPath, hugeCount);
+  CHECK(!loaded.Load(kPath, MakeAdapter()));
+
+  CHECK(!loaded.Load("PipelineCacheIndexTest.missing", MakeAdapter()));
+}
+
+void TestSaveToUnwritablePathThrows() {
+  CHECK_THROWS(MakeIndex(1, 1).Save("no-such-directory/cache.bin"),
+               std::runtime_error);
+}
+
+void TestKeyToName() {
+  CHECK_EQ(PipelineCacheIndex::KeyToName(0), std::string("0000000000000000"));
+  CHECK_EQ(PipelineCacheIndex::KeyToName(0x0123456789abcdefull),
+           std::string("0123456789abcdef"));
+  CHECK_EQ(PipelineCacheIndex::KeyToName(~0ull),
+           std::string("ffffffffffffffff"));
+
+  std::mt19937_64 random(3);
+  for (int i = 0; i < 1000; ++i) {
+    const uint64_t key = random();
+    const std::string name = PipelineCacheIndex::KeyToName(key);
+    CHECK_EQ(name.size(), 16u);
+    CHECK_EQ(std::stoull(name, nullptr, 16), key);
+  }
+}
+
+void TestFnv1aReferenceValues() {
+  // Published FNV-1a 64 test vectors.
+  const std::pair<const char*, uint64_t> vectors[] = {
+      {"", 0xcbf29ce484222325ull},
+      {"a", 0xaf63dc4c8601ec8cull},
+      {"foobar", 0x85944171f73967e8ull}};
+  for (const auto& vector : vectors) {
+    Fnv1aHash hash;
+    hash.AddBytes(vector.first, std::string(vector.first).size());
+    CHECK_EQ(hash.Get(), vector.second);
+  }
+
+  // Integers go in little-endian regardless of the host.
+  Fnv1aHash fromInt;
+  fromInt.AddUint32(0x04030201u);
+  Fnv1aHash fromBytes;
+  const uint8_t bytes[4] = {1, 2, 3, 4};
+  fromBytes.AddBytes(bytes, 4);
+  CHECK_EQ(fromInt.Get(), fromBytes.Get());
+
+  // Strings are length-prefixed.
+  Fnv1aHash split1;
+  split1.AddString("ab");
+  split1.AddString("c");
+  Fnv1aHash split2;
+  split2.AddString("a");
+  split2.AddString("bc");
+  CHECK(split1.Get() != split2.Get());
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestRoundTrip);
+  RUN_TEST(TestFileLayout);
+  RUN_TEST(TestAdapterMismatchRejected);
+  RUN_TEST(TestMalformedFilesRejected);
+  RUN_TEST(TestSaveToUnwritablePathThrows);
+  RUN_TEST(TestKeyToName);
+  RUN_TEST(TestFnv1aReferenceValues);
+  std::remove(kPath);
+  return TestResult("PipelineCacheIndexTest");
+}
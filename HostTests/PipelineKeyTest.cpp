@@ -0,0 +1,250 @@
+// PipelineKey: every field of a pipeline description reaches the key,
+// pipelines the renderer varies by one field never collide, and the key
+// layout stays fixed so libraries saved by earlier runs keep loading.
+
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "PipelineKey.h"
+#include "TestCheck.h"
+
+namespace {
+using GraphicsDesc = PipelineKey::GraphicsDesc;
+using ComputeDesc = PipelineKey::ComputeDesc;
+
+const std::vector<uint8_t> kVertexShader = {0x44, 0x58, 0x42, 0x43, 1, 2, 3};
+const std::vector<uint8_t> kPixelShader = {0x44, 0x58, 0x42, 0x43, 9, 8};
+
+PipelineKey::Shader MakeShader(const std::vector<uint8_t>& bytecode) {
+  PipelineKey::Shader shader;
+  shader.Bytecode = bytecode.data();
+  shader.Size = bytecode.size();
+  return shader;
+}
+
+// A geometry-pass-like pipeline: two targets, depth test, four inputs.
+GraphicsDesc MakeGraphicsDesc() {
+  GraphicsDesc desc;
+  desc.RootSignatureHash = 0x0123456789abcdefull;
+  desc.VS = MakeShader(kVertexShader);
+  desc.PS = MakeShader(kPixelShader);
+  for (auto& target : desc.BlendState.RenderTarget) {
+    target.SrcBlend = 2;
+    target.DestBlend = 1;
+    target.BlendOp = 1;
+    target.SrcBlendAlpha = 2;
+    target.DestBlendAlpha = 1;
+    target.BlendOpAlpha = 1;
+    target.LogicOp = 4;
+    target.RenderTargetWriteMask = 0xf;
+  }
+  desc.SampleMask = 0xffffffffu;
+  desc.RasterizerState.FillMode = 3;
+  desc.RasterizerState.CullMode = 3;
+  desc.RasterizerState.DepthClipEnable = 1;
+  desc.DepthStencilState.DepthEnable = 1;
+  desc.DepthStencilState.DepthWriteMask = 1;
+  desc.DepthStencilState.DepthFunc = 2;
+  desc.DepthStencilState.StencilReadMask = 0xff;
+  desc.DepthStencilState.StencilWriteMask = 0xff;
+  const char* const semantics[] = {"POSITION", "NORMAL", "TEXCOORD",
+                                   "TANGENT"};
+  uint32_t offset = 0;
+  for (const char* semantic : semantics) {
+    PipelineKey::InputElement element;
+    element.SemanticName = semantic;
+    element.Format = 6;
+    element.AlignedByteOffset = offset;
+    offset += 12;
+    desc.InputLayout.push_back(element);
+  }
+  desc.PrimitiveTopologyType = 3;
+  desc.NumRenderTargets = 2;
+  desc.RTVFormats[0] = 28;
+  desc.RTVFormats[1] = 10;
+  desc.DSVFormat = 40;
+  desc.SampleCount = 1;
+  return desc;
+}
+
+ComputeDesc MakeComputeDesc(uint64_t rootSignatureHash,
+                            const std::vector<uint8_t>& bytecode,
+                            uint32_t nodeMask = 0, uint32_t flags = 0) {
+  ComputeDesc desc;
+  desc.RootSignatureHash = rootSignatureHash;
+  desc.CS = MakeShader(bytecode);
+  desc.NodeMask = nodeMask;
+  desc.Flags = flags;
+  return desc;
+}
+
+void TestLayoutIsStable() {
+  // Libraries on disk are named by these keys. If a value changes, bump
+  // PipelineKey::kVersion so stale pipelines are rebuilt.
+  CHECK_EQ(PipelineKey::ComputeGraphics(MakeGraphicsDesc()),
+           0xe6aebecfe1908967ull);
+  CHECK_EQ(PipelineKey::ComputeCompute(
+               MakeComputeDesc(0x0123456789abcdefull, kVertexShader)),
+           0x43fd2c19ee5129fbull);
+  CHECK_EQ(PipelineKey::HashRootSignature(kPixelShader.data(),
+                                          kPixelShader.size()),
+           0x16c7e81bb4a0c387ull);
+}
+
+void TestEveryGraphicsFieldCounts() {
+  using Mutation = std::function<void(GraphicsDesc&)>;
+  const std::vector<uint8_t> other = {0x44, 0x58, 0x42, 0x43, 1, 2, 4};
+  const std::vector<Mutation> mutations = {
+      [](GraphicsDesc& d) { d.RootSignatureHash ^= 1; },
+      [&](GraphicsDesc& d) { d.VS = MakeShader(other); },
+      [&](GraphicsDesc& d) { d.PS = MakeShader(other); },
+      // The same bytecode in another stage is another pipeline.
+      [](GraphicsDesc& d) { d.DS = d.VS; },
+      [](GraphicsDesc& d) { d.HS = d.VS; },
+      [](GraphicsDesc& d) { d.GS = d.VS; },
+      [](GraphicsDesc& d) { d.StreamOutput.Entries.emplace_back(); },
+      [](GraphicsDesc& d) { d.StreamOutput.BufferStrides.push_back(16); },
+      [](GraphicsDesc& d) { d.StreamOutput.RasterizedStream = 1; },
+      [](GraphicsDesc& d) { d.BlendState.AlphaToCoverageEnable = 1; },
+      [](GraphicsDesc& d) { d.BlendState.IndependentBlendEnable = 1; },
+      [](GraphicsDesc& d) { d.BlendState.RenderTarget[0].BlendEnable = 1; },
+      [](GraphicsDesc& d) { d.BlendState.RenderTarget[7].LogicOp = 5; },
+      [](GraphicsDesc& d) {
+        d.BlendState.RenderTarget[1].RenderTargetWriteMask = 0x7;
+      },
+      [](GraphicsDesc& d) { d.SampleMask = 1; },
+      [](GraphicsDesc& d) { d.RasterizerState.FillMode = 2; },
+      [](GraphicsDesc& d) { d.RasterizerState.CullMode = 1; },
+      [](GraphicsDesc& d) { d.RasterizerState.FrontCounterClockwise = 1; },
+      [](GraphicsDesc& d) { d.RasterizerState.DepthBias = -1; },
+      [](GraphicsDesc& d) { d.RasterizerState.DepthBiasClamp = 0.5f; },
+      // -0.0f and 0.0f compare equal but are different bit patterns.
+      [](GraphicsDesc& d) { d.RasterizerState.SlopeScaledDepthBias = -0.0f; },
+      [](GraphicsDesc& d) { d.RasterizerState.DepthClipEnable = 0; },
+      [](GraphicsDesc& d) { d.RasterizerState.MultisampleEnable = 1; },
+      [](GraphicsDesc& d) { d.RasterizerState.AntialiasedLineEnable = 1; },
+      [](GraphicsDesc& d) { d.RasterizerState.ForcedSampleCount = 4; },
+      [](GraphicsDesc& d) { d.RasterizerState.ConservativeRaster = 1; },
+      [](GraphicsDesc& d) { d.DepthStencilState.DepthEnable = 0; },
+      [](GraphicsDesc& d) { d.DepthStencilState.DepthWriteMask = 0; },
+      [](GraphicsDesc& d) { d.DepthStencilState.DepthFunc = 4; },
+      [](GraphicsDesc& d) { d.DepthStencilState.StencilEnable = 1; },
+      [](GraphicsDesc& d) { d.DepthStencilState.StencilReadMask = 0xf; },
+      [](GraphicsDesc& d) { d.DepthStencilState.StencilWriteMask = 0xf; },
+      [](GraphicsDesc& d) { d.DepthStencilState.FrontFace.StencilFunc = 8; },
+      [](GraphicsDesc& d) { d.DepthStencilState.BackFace.StencilPassOp = 3; },
+      [](GraphicsDesc& d) { d.InputLayout.pop_back(); },
+      [](GraphicsDesc& d) { d.InputLayout[1].SemanticName = "BINORMAL"; },
+      [](GraphicsDesc& d) { d.InputLayout[1].SemanticIndex = 1; },
+      [](GraphicsDesc& d) { d.InputLayout[2].Format = 16; },
+      [](GraphicsDesc& d) { d.InputLayout[2].InputSlot = 1; },
+      [](GraphicsDesc& d) { d.InputLayout[3].AlignedByteOffset = 40; },
+      [](GraphicsDesc& d) { d.InputLayout[3].InputSlotClass = 1; },
+      [](GraphicsDesc& d) { d.InputLayout[3].InstanceDataStepRate = 1; },
+      [](GraphicsDesc& d) { std::swap(d.InputLayout[0], d.InputLayout[1]); },
+      [](GraphicsDesc& d) { d.IBStripCutValue = 1; },
+      [](GraphicsDesc& d) { d.PrimitiveTopologyType = 4; },
+      [](GraphicsDesc& d) { d.NumRenderTargets = 1; },
+      [](GraphicsDesc& d) { d.RTVFormats[1] = 24; },
+      [](GraphicsDesc& d) { d.RTVFormats[7] = 28; },
+      [](GraphicsDesc& d) { d.DSVFormat = 55; },
+      [](GraphicsDesc& d) { d.SampleCount = 4; },
+      [](GraphicsDesc& d) { d.SampleQuality = 1; },
+      [](GraphicsDesc& d) { d.NodeMask = 1; },
+      [](GraphicsDesc& d) { d.Flags = 1; },
+  };
+
+  std::set<uint64_t> keys = {PipelineKey::ComputeGraphics(MakeGraphicsDesc())};
+  for (const Mutation& mutate : mutations) {
+    GraphicsDesc desc = MakeGraphicsDesc();
+    mutate(desc);
+    keys.insert(PipelineKey::ComputeGraphics(desc));
+  }
+  CHECK_EQ(keys.size(), mutations.size() + 1);
+}
+
+void TestKeysFollowContentsNotPointers() {
+  // Bytecode and semantic names are read through their pointers, so copies
+  // in other buffers give the same key.
+  const std::vector<uint8_t> vertexCopy = kVertexShader;
+  const std::string semantic = "NORMAL";
+  GraphicsDesc copy = MakeGraphicsDesc();
+  copy.VS = MakeShader(vertexCopy);
+  copy.InputLayout[1].SemanticName = semantic.c_str();
+  CHECK_EQ(PipelineKey::ComputeGraphics(copy),
+           PipelineKey::ComputeGraphics(MakeGraphicsDesc()));
+
+  // A missing name hashes as an empty one.
+  GraphicsDesc empty = MakeGraphicsDesc();
+  empty.InputLayout[0].SemanticName = "";
+  GraphicsDesc missing = MakeGraphicsDesc();
+  missing.InputLayout[0].SemanticName = nullptr;
+  CHECK_EQ(PipelineKey::ComputeGraphics(empty),
+           PipelineKey::ComputeGraphics(missing));
+
+  // A graphics and a compute pipeline never share a key.
+  GraphicsDesc vertexOnly;
+  vertexOnly.VS = MakeShader(kVertexShader);
+  CHECK(PipelineKey::ComputeGraphics(vertexOnly) !=
+        PipelineKey::ComputeCompute(MakeComputeDesc(0, kVertexShader)));
+
+  CHECK_EQ(PipelineKey::HashRootSignature(kVertexShader.data(),
+                                          kVertexShader.size()),
+           PipelineKey::HashRootSignature(vertexCopy.data(),
+                                          vertexCopy.size()));
+  CHECK(PipelineKey::HashRootSignature(kVertexShader.data(),
+                                       kVertexShader.size()) !=
+        PipelineKey::HashRootSignature(kPixelShader.data(),
+                                       kPixelShader.size()));
+}
+
+void TestComputeKeysDoNotCollide() {
+  // Every variation the renderer produces changes a handful of fields:
+  // shader bytes, root signature, flags. Sweep single-field changes around
+  // a set of base pipelines, plus random bytecode, and require unique keys.
+  std::mt19937 random(17);
+  std::set<uint64_t> keys;
+  uint32_t count = 0;
+  auto add = [&](const ComputeDesc& desc) {
+    keys.insert(PipelineKey::ComputeCompute(desc));
+    ++count;
+  };
+
+  for (uint32_t base = 0; base < 64; ++base) {
+    std::vector<uint8_t> bytecode(64 + base * 13);
+    for (auto& byte : bytecode) {
+      byte = static_cast<uint8_t>(random());
+    }
+    const uint64_t rootSignature = 0xabcdef0000000000ull + base;
+    add(MakeComputeDesc(rootSignature, bytecode));
+    add(MakeComputeDesc(rootSignature + 0x100, bytecode));
+    add(MakeComputeDesc(rootSignature, bytecode, 1, 0));
+    add(MakeComputeDesc(rootSignature, bytecode, 0, 1));
+    for (size_t byte = 0; byte < bytecode.size(); ++byte) {
+      for (uint8_t bit = 1; bit != 0; bit <<= 1) {
+        std::vector<uint8_t> changed = bytecode;
+        changed[byte] ^= bit;
+        add(MakeComputeDesc(rootSignature, changed));
+      }
+    }
+    // Appending a zero byte must not alias the unpadded shader.
+    std::vector<uint8_t> padded = bytecode;
+    padded.push_back(0);
+    add(MakeComputeDesc(rootSignature, padded));
+  }
+  CHECK_EQ(keys.size(), static_cast<size_t>(count));
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestLayoutIsStable);
+  RUN_TEST(TestEveryGraphicsFieldCounts);
+  RUN_TEST(TestKeysFollowContentsNotPointers);
+  RUN_TEST(TestComputeKeysDoNotCollide);
+  return TestResult("PipelineKeyTest");
+}
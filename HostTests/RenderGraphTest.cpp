@@ -0,0 +1,458 @@
+// Barriers RenderGraph derives from pass usages, and the order it keeps
+// passes and batches in.
+
+#include <string>
+#include <vector>
+
+#include "RenderGraph.h"
+#include "TestCheck.h"
+
+namespace {
+using Barrier = RenderGraph::Barrier;
+using BarrierSplit = RenderGraph::BarrierSplit;
+using BarrierType = RenderGraph::BarrierType;
+
+constexpr auto kRt = RenderGraph::kStateRenderTarget;
+constexpr auto kUav = RenderGraph::kStateUnorderedAccess;
+constexpr auto kPsr = RenderGraph::kStatePixelShaderResource;
+constexpr auto kNpsr = RenderGraph::kStateNonPixelShaderResource;
+constexpr auto kDepthWrite = RenderGraph::kStateDepthWrite;
+constexpr auto kDepthRead = RenderGraph::kStateDepthRead;
+constexpr auto kIndirect = RenderGraph::kStateIndirectArgument;
+constexpr auto kPresent = RenderGraph::kStatePresent;
+
+bool IsTransition(const Barrier& barrier, RenderGraph::ResourceHandle resource,
+                  RenderGraph::ResourceState before,
+                  RenderGraph::ResourceState after,
+                  BarrierSplit split = BarrierSplit::None) {
+  return barrier.Type == BarrierType::Transition &&
+         barrier.Resource == resource && barrier.Before == before &&
+         barrier.After == after && barrier.Split == split;
+}
+
+void TestPassesKeepDeclarationOrder() {
+  RenderGraph graph;
+  const auto target = graph.ImportResource("Target", kPsr, kPsr);
+  const char* names[] = {"Shadow", "Geometry", "Compose", "Post"};
+  for (uint32_t i = 0; i < 4; ++i) {
+    CHECK_EQ(graph.AddPass(names[i], {{target, i % 2 == 0 ? kRt : kPsr}}), i);
+  }
+  graph.Compile(false);
+  CHECK_EQ(graph.GetPassCount(), 4u);
+  for (uint32_t i = 0; i < 4; ++i) {
+    CHECK_EQ(graph.GetPassName(i), std::string(names[i]));
+  }
+  // Alternating write/read: one transition before every pass.
+  for (uint32_t i = 0; i < 4; ++i) {
+    const auto& batch = graph.GetBarriersBeforePass(i);
+    CHECK_EQ(batch.size(), 1u);
+    if (batch.size() == 1) {
+      const auto before = i == 0 ? kPsr : (i % 2 == 0 ? kPsr : kRt);
+      const auto after = i % 2 == 0 ? kRt : kPsr;
+      CHECK(IsTransition(batch[0], target, before, after));
+    }
+  }
+  CHECK(graph.GetFinalBarriers().empty());
+  CHECK_EQ(graph.GetBarrierCount(), 4u);
+  CHECK_EQ(graph.GetBatchCount(), 4u);
+}
+
+void TestNoBarrierWhenStateMatches() {
+  RenderGraph graph;
+  const auto depth = graph.ImportResource("Depth", kDepthWrite, kDepthWrite);
+  graph.AddPass("Geometry", {{depth, kDepthWrite}});
+  graph.AddPass("Decals", {{depth, kDepthWrite}});
+  graph.Compile(true);
+  CHECK_EQ(graph.GetBarrierCount(), 0u);
+  CHECK_EQ(graph.GetBatchCount(), 0u);
+}
+
+void TestConsecutiveReadsAreMerged() {
+  RenderGraph graph;
+  const auto depth = graph.ImportResource("Depth", kDepthWrite, kDepthWrite);
+  graph.AddPass("Geometry", {{depth, kDepthWrite}});
+  graph.AddPass("Compose", {{depth, kPsr}});
+  graph.AddPass("Particles", {{depth, kDepthRead}});
+  graph.AddPass("DepthCopy", {{depth, kNpsr}});
+  graph.Compile(false);
+
+  const auto& compose = graph.GetBarriersBeforePass(1);
+  CHECK_EQ(compose.size(), 1u);
+  if (compose.size() == 1) {
+    CHECK(IsTransition(compose[0], depth, kDepthWrite,
+                       kPsr | kDepthRead | kNpsr));
+  }
+  CHECK(graph.GetBarriersBeforePass(2).empty());
+  CHECK(graph.GetBarriersBeforePass(3).empty());
+  const auto& final = graph.GetFinalBarriers();
+  CHECK_EQ(final.size(), 1u);
+  if (final.size() == 1) {
+    CHECK(IsTransition(final[0], depth, kPsr | kDepthRead | kNpsr,
+                       kDepthWrite));
+  }
+}
+
+void TestReadAlreadyCoveredNeedsNoBarrier() {
+  RenderGraph graph;
+  const auto buffer = graph.ImportResource("Args", kIndirect | kNpsr, kNpsr);
+  graph.AddPass("Draw", {{buffer, kIndirect}});
+  graph.Compile(false);
+  CHECK(graph.GetBarriersBeforePass(0).empty());
+  const auto& final = graph.GetFinalBarriers();
+  CHECK_EQ(final.size(), 1u);
+  if (final.size() == 1) {
+    CHECK(IsTransition(final[0], buffer, kIndirect | kNpsr, kNpsr));
+  }
+}
+
+void TestUavBarrierBetweenUavPasses() {
+  RenderGraph graph;
+  const auto pool = graph.ImportResource("Pool", kUav, kNpsr);
+  graph.AddPass("Emit", {{pool, kUav}});
+  graph.AddPass("Simulate", {{pool, kUav}});
+  graph.AddPass("Draw", {{pool, kNpsr}});
+  graph.Compile(false);
+
+  // Already in UAV state, so the first pass needs nothing.
+  CHECK(graph.GetBarriersBeforePass(0).empty());
+  const auto& simulate = graph.GetBarriersBeforePass(1);
+  CHECK_EQ(simulate.size(), 1u);
+  if (simulate.size() == 1) {
+    CHECK(simulate[0].Type == BarrierType::Uav);
+    CHECK_EQ(simulate[0].Resource, pool);
+  }
+  const auto& draw = graph.GetBarriersBeforePass(2);
+  CHECK_EQ(draw.size(), 1u);
+  if (draw.size() == 1) {
+    CHECK(IsTransition(draw[0], pool, kUav, kNpsr));
+  }
+  CHECK(graph.GetFinalBarriers().empty());
+}
+
+void TestSplitBarriersSpanIdlePasses() {
+  for (bool split : {false, true}) {
+    RenderGraph graph;
+    const auto albedo = graph.ImportResource("Albedo", kPsr, kPsr);
+    const auto other = graph.ImportResource("Other", kPsr, kPsr);
+    graph.AddPass("Geometry", {{albedo, kRt}});
+    graph.AddPass("Lighting", {{other, kRt}});
+    graph.AddPass("Fog", {{other, kPsr}});
+    graph.AddPass("Compose", {{albedo, kPsr}});
+    graph.Compile(split);
+
+    // Albedo is idle in Lighting and Fog: the RT -> PSR transition begins
+    // right after Geometry and ends right before Compose.
+    const auto& lighting = graph.GetBarriersBeforePass(1);
+    const auto& compose = graph.GetBarriersBeforePass(3);
+    if (split) {
+      CHECK_EQ(lighting.size(), 2u);
+      bool hasBegin = false;
+      for (const auto& barrier : lighting) {
+        hasBegin |= IsTransition(barrier, albedo, kRt, kPsr,
+                                 BarrierSplit::BeginOnly);
+      }
+      CHECK(hasBegin);
+      CHECK_EQ(compose.size(), 1u);
+      if (compose.size() == 1) {
+        CHECK(IsTransition(compose[0], albedo, kRt, kPsr,
+                           BarrierSplit::EndOnly));
+      }
+    } else {
+      CHECK_EQ(lighting.size(), 1u);
+      CHECK_EQ(compose.size(), 1u);
+      if (compose.size() == 1) {
+        CHECK(IsTransition(compose[0], albedo, kRt, kPsr));
+      }
+    }
+
+    // The first transition of a resource is split from the start of the
+    // frame if the resource is idle before its first use.
+    const auto& geometry = graph.GetBarriersBeforePass(0);
+    if (split) {
+      CHECK_EQ(geometry.size(), 2u);
+    }
+    const auto& fog = graph.GetBarriersBeforePass(2);
+    CHECK_EQ(fog.size(), 1u);
+    if (fog.size() == 1) {
+      CHECK(IsTransition(fog[0], other, kRt, kPsr));
+    }
+  }
+}
+
+void TestFirstTransitionSplitsFromFrameStart() {
+  RenderGraph graph;
+  const auto target = graph.ImportResource("Target", kPsr, kPsr);
+  const auto busy = graph.ImportResource("Busy", kUav, kUav);
+  graph.AddPass("Simulate", {{busy, kUav}});
+  graph.AddPass("Render", {{target, kRt}});
+  graph.Compile(true);
+  const auto& simulate = graph.GetBarriersBeforePass(0);
+  CHECK_EQ(simulate.size(), 1u);
+  if (simulate.size() == 1) {
+    CHECK(IsTransition(simulate[0], target, kPsr, kRt,
+                       BarrierSplit::BeginOnly));
+  }
+  const auto& render = graph.GetBarriersBeforePass(1);
+  CHECK_EQ(render.size(), 1u);
+  if (render.size() == 1) {
+    CHECK(IsTransition(render[0], target, kPsr, kRt, BarrierSplit::EndOnly));
+  }
+  // Transitions after the last use are never split.
+  CHECK_EQ(graph.GetFinalBarriers().size(), 1u);
+  CHECK_EQ(graph.GetBatchCount(), 3u);
+}
+
+void TestSplitsStayInsideSubmission() {
+  RenderGraph graph;
+  const auto target = graph.ImportResource("Target", kPsr, kPsr);
+  const auto other = graph.ImportResource("Other", kUav, kUav);
+  graph.AddPass("First", {{target, kRt}});
+  graph.AddSubmitBoundary();
+  graph.AddPass("Second", {{other, kUav}});
+  graph.AddPass("Third", {{other, kUav}});
+  graph.AddPass("Fourth", {{target, kPsr}});
+  graph.Compile(true);
+  // Target is idle from Second on; the RT -> PSR transition begins at the
+  // start of the second submission rather than after First.
+  const auto& first = graph.GetBarriersBeforePass(0);
+  CHECK_EQ(first.size(), 1u);
+  if (first.size() == 1) {
+    CHECK(IsTransition(first[0], target, kPsr, kRt));
+  }
+  const auto& second = graph.GetBarriersBeforePass(1);
+  CHECK_EQ(second.size(), 1u);
+  if (second.size() == 1) {
+    CHECK(IsTransition(second[0], target, kRt, kPsr, BarrierSplit::BeginOnly));
+  }
+  const auto& fourth = graph.GetBarriersBeforePass(3);
+  CHECK_EQ(fourth.size(), 1u);
+  if (fourth.size() == 1) {
+    CHECK(IsTransition(fourth[0], target, kRt, kPsr, BarrierSplit::EndOnly));
+  }
+
+  // A boundary right before the next use leaves nothing to split.
+  RenderGraph tight;
+  const auto a = tight.ImportResource("A", kPsr, kPsr);
+  tight.AddPass("Idle", {});
+  tight.AddSubmitBoundary();
+  tight.AddPass("Use", {{a, kRt}});
+  tight.Compile(true);
+  CHECK(tight.GetBarriersBeforePass(0).empty());
+  const auto& use = tight.GetBarriersBeforePass(1);
+  CHECK_EQ(use.size(), 1u);
+  if (use.size() == 1) {
+    CHECK(IsTransition(use[0], a, kPsr, kRt));
+  }
+}
+
+void TestNoSplitResource() {
+  RenderGraph graph;
+  const auto shared = graph.ImportResource("Shared", kNpsr, kNpsr);
+  const auto local = graph.ImportResource("Local", kNpsr, kNpsr);
+  graph.SetNoSplitBarriers(shared);
+  graph.AddPass("Idle", {});
+  graph.AddPass("Write", {{shared, kUav}, {local, kUav}});
+  graph.Compile(true);
+  const auto& idle = graph.GetBarriersBeforePass(0);
+  CHECK_EQ(idle.size(), 1u);
+  if (idle.size() == 1) {
+    CHECK(IsTransition(idle[0], local, kNpsr, kUav, BarrierSplit::BeginOnly));
+  }
+  bool sharedWhole = false;
+  for (const auto& barrier : graph.GetBarriersBeforePass(1)) {
+    sharedWhole |= IsTransition(barrier, shared, kNpsr, kUav);
+  }
+  CHECK(sharedWhole);
+  CHECK_THROWS(graph.SetNoSplitBarriers(local + 1), std::out_of_range);
+}
+
+void TestUnusedResourceGoesToFinalState() {
+  RenderGraph graph;
+  const auto unused = graph.ImportResource("Unused", kPresent, kRt);
+  graph.AddPass("Nothing", {});
+  graph.Compile(true);
+  CHECK(graph.GetBarriersBeforePass(0).empty());
+  const auto& final = graph.GetFinalBarriers();
+  CHECK_EQ(final.size(), 1u);
+  if (final.size() == 1) {
+    CHECK(IsTransition(final[0], unused, kPresent, kRt));
+  }
+  CHECK_EQ(graph.GetFinalState(unused), kRt);
+}
+
+// The frame RenderingSystem::Render records with synchronous simulation.
+void TestRendererFrame() {
+  RenderGraph graph;
+  const auto pool = graph.ImportResource("ParticlePool", kNpsr, kNpsr);
+  const auto aliveList = graph.ImportResource("AliveList", kNpsr, kNpsr);
+  const auto drawArgs = graph.ImportResource("DrawArgs", kIndirect, kIndirect);
+  const auto collision = graph.ImportResource("CollisionDepth", kNpsr, kNpsr);
+  const auto albedo = graph.ImportResource("GBufferAlbedo", kPsr, kPsr);
+  const auto normal = graph.ImportResource("GBufferNormal", kPsr, kPsr);
+  const auto depth = graph.ImportResource("Depth", kDepthWrite, kDepthWrite);
+  const auto particles = graph.ImportResource("ParticleColor", kPsr, kPsr);
+  const auto backBuffer = graph.ImportResource("BackBuffer", kPresent,
+                                               kPresent);
+  const uint32_t simulate = graph.AddPass(
+      "ParticleSimulate", {{pool, kUav},
+                           {aliveList, kUav},
+                           {drawArgs, kUav},
+                           {collision, kNpsr}});
+  const uint32_t geometry = graph.AddPass(
+      "Geometry", {{albedo, kRt}, {normal, kRt}, {depth, kDepthWrite}});
+  const uint32_t compose = graph.AddPass(
+      "Compose",
+      {{albedo, kPsr}, {normal, kPsr}, {depth, kPsr}, {backBuffer, kRt}});
+  const uint32_t render = graph.AddPass("ParticleRender",
+                                        {{pool, kNpsr},
+                                         {aliveList, kNpsr},
+                                         {drawArgs, kIndirect},
+                                         {depth, kDepthRead},
+                                         {particles, kRt}});
+  const uint32_t composite = graph.AddPass(
+      "ParticleComposite", {{particles, kPsr}, {backBuffer, kRt}});
+  const uint32_t depthCopy =
+      graph.AddPass("ParticleDepthCopy", {{depth, kNpsr}, {collision, kUav}});
+  graph.Compile(false);
+
+  CHECK_EQ(graph.GetBarriersBeforePass(simulate).size(), 3u);
+  CHECK_EQ(graph.GetBarriersBeforePass(geometry).size(), 2u);
+  // Depth goes to one combined read state for compose, the particle draw
+  // and the copy.
+  const auto& composeBatch = graph.GetBarriersBeforePass(compose);
+  CHECK_EQ(composeBatch.size(), 4u);
+  bool depthMerged = false;
+  for (const auto& barrier : composeBatch) {
+    depthMerged |= IsTransition(barrier, depth, kDepthWrite,
+                                kPsr | kDepthRead | kNpsr);
+  }
+  CHECK(depthMerged);
+  // Pool and alive list back to NPSR, draw args to INDIRECT_ARGUMENT, the
+  // particle target to RT; depth is already readable.
+  CHECK_EQ(graph.GetBarriersBeforePass(render).size(), 4u);
+  // The back buffer stays a render target from compose to composite.
+  const auto& compositeBatch = graph.GetBarriersBeforePass(composite);
+  CHECK_EQ(compositeBatch.size(), 1u);
+  if (compositeBatch.size() == 1) {
+    CHECK(IsTransition(compositeBatch[0], particles, kRt, kPsr));
+  }
+  const auto& copyBatch = graph.GetBarriersBeforePass(depthCopy);
+  CHECK_EQ(copyBatch.size(), 1u);
+  if (copyBatch.size() == 1) {
+    CHECK(IsTransition(copyBatch[0], collision, kNpsr, kUav));
+  }
+  // Depth, collision depth and the back buffer return to their end states.
+  CHECK_EQ(graph.GetFinalBarriers().size(), 3u);
+}
+
+// The frame RenderingSystem::Render records with the simulation on the
+// compute queue: geometry and compose are submitted first, then the graphics
+// queue waits for the simulation, which reads the collision depth.
+void TestAsyncRendererFrame() {
+  RenderGraph graph;
+  const auto pool = graph.ImportResource("ParticlePool", kNpsr, kNpsr);
+  const auto aliveList = graph.ImportResource("AliveList", kNpsr, kNpsr);
+  const auto drawArgs = graph.ImportResource("DrawArgs", kIndirect, kIndirect);
+  const auto collision = graph.ImportResource("CollisionDepth", kNpsr, kNpsr);
+  for (auto handle : {pool, aliveList, drawArgs, collision}) {
+    graph.SetNoSplitBarriers(handle);
+  }
+  const auto albedo = graph.ImportResource("GBufferAlbedo", kPsr, kPsr);
+  const auto normal = graph.ImportResource("GBufferNormal", kPsr, kPsr);
+  const auto depth = graph.ImportResource("Depth", kDepthWrite, kDepthWrite);
+  const auto particles = graph.ImportResource("ParticleColor", kPsr, kPsr);
+  const auto backBuffer = graph.ImportResource("BackBuffer", kPresent,
+                                               kPresent);
+  const uint32_t geometry = graph.AddPass(
+      "Geometry", {{albedo, kRt}, {normal, kRt}, {depth, kDepthWrite}});
+  const uint32_t compose = graph.AddPass(
+      "Compose",
+      {{albedo, kPsr}, {normal, kPsr}, {depth, kPsr}, {backBuffer, kRt}});
+  graph.AddSubmitBoundary();
+  const uint32_t render = graph.AddPass("ParticleRender",
+                                        {{pool, kNpsr},
+                                         {aliveList, kNpsr},
+                                         {drawArgs, kIndirect},
+                                         {depth, kDepthRead},
+                                         {particles, kRt}});
+  graph.AddPass("ParticleComposite", {{particles, kPsr}, {backBuffer, kRt}});
+  const uint32_t depthCopy =
+      graph.AddPass("ParticleDepthCopy", {{depth, kNpsr}, {collision, kUav}});
+  graph.Compile(true);
+
+  // Every split begun in the first submission ends there too.
+  int openSplits = 0;
+  for (uint32_t pass : {geometry, compose}) {
+    for (const auto& barrier : graph.GetBarriersBeforePass(pass)) {
+      if (barrier.Split == BarrierSplit::BeginOnly) {
+        ++openSplits;
+      } else if (barrier.Split == BarrierSplit::EndOnly) {
+        --openSplits;
+      }
+    }
+  }
+  CHECK_EQ(openSplits, 0);
+  // The particle target's PSR -> RT would otherwise begin at geometry.
+  const auto& renderBatch = graph.GetBarriersBeforePass(render);
+  CHECK_EQ(renderBatch.size(), 1u);
+  if (renderBatch.size() == 1) {
+    CHECK(IsTransition(renderBatch[0], particles, kPsr, kRt));
+  }
+  // The collision depth goes to UAV whole, right before the copy, and has no
+  // other barrier in the frame.
+  const auto& copyBatch = graph.GetBarriersBeforePass(depthCopy);
+  CHECK_EQ(copyBatch.size(), 1u);
+  if (copyBatch.size() == 1) {
+    CHECK(IsTransition(copyBatch[0], collision, kNpsr, kUav));
+  }
+  for (uint32_t pass = 0; pass < graph.GetPassCount(); ++pass) {
+    if (pass != depthCopy) {
+      for (const auto& barrier : graph.GetBarriersBeforePass(pass)) {
+        CHECK(barrier.Resource != collision);
+      }
+    }
+  }
+}
+
+void TestInvalidUsage() {
+  RenderGraph graph;
+  const auto a = graph.ImportResource("A", kPsr, kPsr);
+  CHECK_THROWS(graph.AddPass("Twice", {{a, kRt}, {a, kPsr}}),
+               std::invalid_argument);
+  CHECK_THROWS(graph.AddPass("Unknown", {{a + 1, kRt}}), std::out_of_range);
+  graph.AddPass("Valid", {{a, kRt}});
+  graph.Compile(false);
+  CHECK_THROWS(graph.GetBarriersBeforePass(1), std::out_of_range);
+  CHECK_THROWS(graph.GetPassName(1), std::out_of_range);
+  CHECK_THROWS(graph.GetFinalState(a + 1), std::out_of_range);
+}
+
+void TestResetClearsEverything() {
+  RenderGraph graph;
+  const auto a = graph.ImportResource("A", kPsr, kPsr);
+  graph.AddPass("Write", {{a, kRt}});
+  graph.Compile(false);
+  graph.Reset();
+  CHECK_EQ(graph.GetPassCount(), 0u);
+  CHECK_EQ(graph.GetBarrierCount(), 0u);
+  CHECK_EQ(graph.ImportResource("B", kPsr, kPsr), 0u);
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestPassesKeepDeclarationOrder);
+  RUN_TEST(TestNoBarrierWhenStateMatches);
+  RUN_TEST(TestConsecutiveReadsAreMerged);
+  RUN_TEST(TestReadAlreadyCoveredNeedsNoBarrier);
+  RUN_TEST(TestUavBarrierBetweenUavPasses);
+  RUN_TEST(TestSplitBarriersSpanIdlePasses);
+  RUN_TEST(TestFirstTransitionSplitsFromFrameStart);
+  RUN_TEST(TestSplitsStayInsideSubmission);
+  RUN_TEST(TestNoSplitResource);
+  RUN_TEST(TestUnusedResourceGoesToFinalState);
+  RUN_TEST(TestRendererFrame);
+  RUN_TEST(TestAsyncRendererFrame);
+  RUN_TEST(TestInvalidUsage);
+  RUN_TEST(TestResetClearsEverything);
+  return TestResult("RenderGraphTest");
+}
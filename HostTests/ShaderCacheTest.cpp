@@ -0,0 +1,220 @@
+// ShaderCache: what the content and request keys depend on, the package
+// round trip, loading bytecode by request key alone as a package without
+// shader sources does, and how an edited source replaces the stale entry.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ShaderCache.h"
+#include "TestCheck.h"
+
+namespace {
+using Define = ShaderCache::Define;
+
+const char* const kPath = "ShaderCacheTest.bin";
+
+std::vector<uint8_t> ReadFile(const char* path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const char* path, const std::vector<uint8_t>& data) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+}
+
+std::vector<uint8_t> MakeBytecode(uint32_t seed, uint32_t size) {
+  std::vector<uint8_t> bytecode;
+  for (uint32_t i = 0; i < size; ++i) {
+    bytecode.push_back(static_cast<uint8_t>(seed * 131 + i * 7));
+  }
+  return bytecode;
+}
+
+uint64_t Key(const std::string& source, const std::string& entryPoint = "VS",
+             const std::string& target = "vs_5_1",
+             const std::vector<Define>& defines = {}, uint32_t flags = 0) {
+  return ShaderCache::ComputeKey(source, entryPoint, target, defines, flags);
+}
+
+uint64_t RequestKey(const std::string& file,
+                    const std::string& entryPoint = "VS",
+                    const std::string& target = "vs_5_1",
+                    const std::vector<Define>& defines = {},
+                    uint32_t flags = 0) {
+  return ShaderCache::ComputeRequestKey(file, entryPoint, target, defines,
+                                        flags);
+}
+
+void TestKeys() {
+  const std::string source = "float4 VS() : SV_Position { return 0; }";
+  const uint64_t key = Key(source);
+  CHECK_EQ(Key(source), key);
+  CHECK(Key(source + " ") != key);
+  CHECK(Key(source, "PlainVS") != key);
+  CHECK(Key(source, "VS", "vs_5_0") != key);
+  CHECK(Key(source, "VS", "vs_5_1", {{"PACKED_VERTICES", "0"}}) != key);
+  CHECK(Key(source, "VS", "vs_5_1", {{"PACKED_VERTICES", "0"}}) !=
+        Key(source, "VS", "vs_5_1", {{"PACKED_VERTICES", "1"}}));
+  CHECK(Key(source, "VS", "vs_5_1", {}, 1) != key);
+
+  // A request key names the file instead of hashing it, and never equals
+  // the content key of a source whose text is that name.
+  const uint64_t request = RequestKey("DeferredGeometryVS.hlsl");
+  CHECK_EQ(RequestKey("DeferredGeometryVS.hlsl"), request);
+  CHECK(RequestKey("DeferredGeometryPS.hlsl") != request);
+  CHECK(RequestKey("DeferredGeometryVS.hlsl", "PlainVS") != request);
+  CHECK(RequestKey("DeferredGeometryVS.hlsl", "VS", "vs_5_1",
+                   {{"PACKED_VERTICES", "1"}}) != request);
+  CHECK(RequestKey("DeferredGeometryVS.hlsl", "VS", "vs_5_1", {}, 1) !=
+        request);
+  CHECK(Key("DeferredGeometryVS.hlsl") != request);
+}
+
+void TestRoundTrip() {
+  ShaderCache cache;
+  for (uint32_t i = 0; i < 5; ++i) {
+    const uint64_t key = Key("source " + std::to_string(i));
+    cache.Insert(key, MakeBytecode(i, 100 + i * 50));
+    cache.SetRequest(RequestKey("Shader" + std::to_string(i) + ".hlsl"), key);
+  }
+  // Two entry points of one file share the file but not the request.
+  cache.SetRequest(RequestKey("Shader0.hlsl", "PlainVS"), Key("source 0"));
+  CHECK(cache.IsDirty());
+  cache.Save(kPath);
+
+  ShaderCache loaded;
+  CHECK(loaded.Load(kPath));
+  CHECK(!loaded.IsDirty());
+  CHECK_EQ(loaded.GetEntryCount(), 5u);
+  CHECK_EQ(loaded.GetRequestCount(), 6u);
+  for (uint32_t i = 0; i < 5; ++i) {
+    const std::vector<uint8_t>* bytecode =
+        loaded.Find(Key("source " + std::to_string(i)));
+    CHECK(bytecode != nullptr && *bytecode == MakeBytecode(i, 100 + i * 50));
+  }
+  CHECK(loaded.Find(Key("source 5")) == nullptr);
+
+  // Saving what was loaded gives the same package.
+  const std::vector<uint8_t> first = ReadFile(kPath);
+  ShaderCache copy;
+  CHECK(copy.Load(kPath));
+  copy.Save(kPath);
+  CHECK_EQ(ReadFile(kPath).size(), first.size());
+}
+
+void TestLoadByRequestWithoutSources() {
+  ShaderCache build;
+  const uint64_t key = Key("particle source");
+  build.Insert(key, MakeBytecode(7, 300));
+  build.SetRequest(RequestKey("ParticleVS.hlsl", "VS", "vs_5_0"), key);
+  build.Save(kPath);
+
+  // The packaged run knows only the file name, entry point, target, defines
+  // and flags.
+  ShaderCache package;
+  CHECK(package.Load(kPath));
+  const std::vector<uint8_t>* bytecode =
+      package.FindRequest(RequestKey("ParticleVS.hlsl", "VS", "vs_5_0"));
+  CHECK(bytecode != nullptr && *bytecode == MakeBytecode(7, 300));
+  CHECK(package.FindRequest(RequestKey("ParticleVS.hlsl", "VS", "vs_5_1")) ==
+        nullptr);
+  CHECK(package.FindRequest(RequestKey("ParticlePS.hlsl", "VS", "vs_5_0")) ==
+        nullptr);
+  CHECK(!package.IsDirty());
+}
+
+void TestEditedSourceReplacesStaleEntry() {
+  ShaderCache cache;
+  const uint64_t request = RequestKey("ComposePS.hlsl", "PS", "ps_5_0");
+  const uint64_t other = RequestKey("Compose.hlsl", "PS", "ps_5_0");
+  const uint64_t oldKey = Key("old compose", "PS", "ps_5_0");
+  cache.Insert(oldKey, MakeBytecode(1, 64));
+  cache.SetRequest(request, oldKey);
+  cache.SetRequest(other, oldKey);
+  cache.Save(kPath);
+
+  // With the source present the content key is checked first: the edited
+  // text misses, is compiled and replaces the request's entry. The old
+  // bytecode stays while the other request still uses it.
+  CHECK(cache.Load(kPath));
+  const uint64_t newKey = Key("new compose", "PS", "ps_5_0");
+  CHECK(cache.Find(newKey) == nullptr);
+  cache.Insert(newKey, MakeBytecode(2, 80));
+  cache.SetRequest(request, newKey);
+  CHECK(cache.IsDirty());
+  CHECK_EQ(cache.GetEntryCount(), 2u);
+  CHECK(*cache.FindRequest(request) == MakeBytecode(2, 80));
+  CHECK(*cache.FindRequest(other) == MakeBytecode(1, 64));
+
+  // Once nothing points at it the stale entry goes.
+  cache.SetRequest(other, newKey);
+  CHECK_EQ(cache.GetEntryCount(), 1u);
+  CHECK(cache.Find(oldKey) == nullptr);
+  cache.Save(kPath);
+  ShaderCache loaded;
+  CHECK(loaded.Load(kPath));
+  CHECK_EQ(loaded.GetEntryCount(), 1u);
+  CHECK(*loaded.FindRequest(other) == MakeBytecode(2, 80));
+
+  // Pointing a request at the entry it already has changes nothing.
+  loaded.SetRequest(request, newKey);
+  CHECK(!loaded.IsDirty());
+  CHECK_THROWS(loaded.SetRequest(request, oldKey), std::invalid_argument);
+}
+
+void TestMalformedPackagesAreRejected() {
+  ShaderCache cache;
+  CHECK(!cache.Load("no-such-file.bin"));
+
+  ShaderCache source;
+  const uint64_t key = Key("source");
+  source.Insert(key, MakeBytecode(3, 40));
+  source.SetRequest(RequestKey("A.hlsl"), key);
+  source.Save(kPath);
+  const std::vector<uint8_t> package = ReadFile(kPath);
+
+  // Every truncation fails and leaves the cache empty.
+  for (size_t size = 0; size < package.size(); ++size) {
+    WriteFile(kPath, std::vector<uint8_t>(package.begin(),
+                                          package.begin() + size));
+    CHECK(!cache.Load(kPath));
+    CHECK_EQ(cache.GetEntryCount(), 0u);
+    CHECK_EQ(cache.GetRequestCount(), 0u);
+  }
+
+  // A version 1 package, which has no request index, is rebuilt.
+  std::vector<uint8_t> oldVersion = package;
+  oldVersion[4] = 1;
+  WriteFile(kPath, oldVersion);
+  CHECK(!cache.Load(kPath));
+
+  // A request that points at an entry the package does not hold.
+  std::vector<uint8_t> dangling = package;
+  dangling[dangling.size() - 1] ^= 0xff;
+  WriteFile(kPath, dangling);
+  CHECK(!cache.Load(kPath));
+
+  WriteFile(kPath, package);
+  CHECK(cache.Load(kPath));
+  CHECK_EQ(cache.GetRequestCount(), 1u);
+  CHECK_THROWS(cache.Save("no-such-directory/cache.bin"), std::runtime_error);
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestKeys);
+  RUN_TEST(TestRoundTrip);
+  RUN_TEST(TestLoadByRequestWithoutSources);
+  RUN_TEST(TestEditedSourceReplacesStaleEntry);
+  RUN_TEST(TestMalformedPackagesAreRejected);
+  std::remove(kPath);
+  return TestResult("ShaderCacheTest");
+}
@@ -0,0 +1,242 @@
+// TessellationFactors against a line-by-line transcription of
+// ComputeEdgeTessFactor in DeferredGeometryHS.hlsl, fed the constants the
+// way RenderingSystem packs them, plus the properties the hull shader
+// relies on: shared edges agree, factors scale with screen size and stay
+// clamped.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "TessellationFactors.h"
+#include "TestCheck.h"
+
+namespace {
+using Float3 = TessellationFactors::Float3;
+using Params = TessellationFactors::Params;
+
+struct Float4 {
+  float X, Y, Z, W;
+};
+
+float Distance(const Float3& a, const Float3& b) {
+  const float dx = a.X - b.X;
+  const float dy = a.Y - b.Y;
+  const float dz = a.Z - b.Z;
+  return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+// DeferredGeometryHS.hlsl: tessellationParams is ObjectData's
+// TessellationParams (z = max, w = min), screenParams is
+// cbGeometryPass.gTessScreenParams (x = pixels per unit, y = target pixels,
+// z = budget).
+float ShaderEdgeTessFactor(const Float3& a, const Float3& b, const Float3& eye,
+                           const Float4& tessellationParams,
+                           const Float4& screenParams) {
+  const float minTess = std::max(tessellationParams.W, 1.0f);
+  const float maxTess = std::max(tessellationParams.Z, minTess);
+
+  const Float3 mid = {0.5f * (a.X + b.X), 0.5f * (a.Y + b.Y),
+                      0.5f * (a.Z + b.Z)};
+  const float distToCamera = std::max(Distance(mid, eye), 1e-3f);
+  const float edgePixels = Distance(a, b) * screenParams.X / distToCamera;
+  const float factor =
+      edgePixels / std::max(screenParams.Y, 1e-3f) * screenParams.Z;
+  return std::min(std::max(factor, minTess), maxTess);
+}
+
+bool Near(float actual, float expected, float relative = 1e-5f) {
+  return std::fabs(actual - expected) <=
+         relative * std::max(1.0f, std::fabs(expected));
+}
+
+Params MakeParams(float pixelsPerUnit) {
+  Params params;
+  params.PixelsPerUnit = pixelsPerUnit;
+  params.TargetPixelsPerEdge = 12.0f;
+  params.Budget = 1.0f;
+  params.MinTess = 1.0f;
+  params.MaxTess = 64.0f;
+  return params;
+}
+
+void TestMatchesShader() {
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> coordinate(-200.0f, 200.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  uint32_t mismatches = 0;
+  for (int i = 0; i < 20000; ++i) {
+    const Float3 a = {coordinate(random), coordinate(random),
+                      coordinate(random)};
+    const Float3 b = {a.X + coordinate(random) * 0.05f,
+                      a.Y + coordinate(random) * 0.05f,
+                      a.Z + coordinate(random) * 0.05f};
+    const Float3 eye = {coordinate(random), coordinate(random),
+                        coordinate(random)};
+    Params params;
+    params.PixelsPerUnit = 100.0f + unit(random) * 1000.0f;
+    params.TargetPixelsPerEdge = unit(random) * 40.0f;
+    params.Budget = unit(random) * 2.0f;
+    // Includes MinTess < 1 and MaxTess < MinTess.
+    params.MinTess = unit(random) * 8.0f;
+    params.MaxTess = unit(random) * 64.0f;
+
+    const Float4 tessellationParams = {0.0f, 0.0f, params.MaxTess,
+                                       params.MinTess};
+    const Float4 screenParams = {params.PixelsPerUnit,
+                                 params.TargetPixelsPerEdge, params.Budget,
+                                 0.0f};
+    if (TessellationFactors::ComputeEdgeFactor(a, b, eye, params) !=
+        ShaderEdgeTessFactor(a, b, eye, tessellationParams, screenParams)) {
+      ++mismatches;
+    }
+  }
+  CHECK_EQ(mismatches, 0u);
+}
+
+void TestClosedForm() {
+  // A 2-unit edge seen side-on from 10 units: 2 * 600 / 10 = 120 pixels,
+  // 10 segments of 12 pixels.
+  const Params params = MakeParams(600.0f);
+  const Float3 a = {-1.0f, 0.0f, 10.0f};
+  const Float3 b = {1.0f, 0.0f, 10.0f};
+  const Float3 eye = {};
+  CHECK(Near(TessellationFactors::ComputeEdgeFactor(a, b, eye, params),
+             10.0f));
+
+  // Twice as close: twice the pixels and the factor.
+  const Float3 nearA = {-1.0f, 0.0f, 5.0f};
+  const Float3 nearB = {1.0f, 0.0f, 5.0f};
+  CHECK(Near(TessellationFactors::ComputeEdgeFactor(nearA, nearB, eye, params),
+             20.0f));
+
+  // The budget multiplies the factor.
+  Params halfBudget = params;
+  halfBudget.Budget = 0.5f;
+  CHECK(Near(TessellationFactors::ComputeEdgeFactor(a, b, eye, halfBudget),
+             5.0f));
+}
+
+void TestClamping() {
+  Params params = MakeParams(600.0f);
+  const Float3 eye = {};
+  const Float3 farA = {0.0f, 0.0f, 1000.0f};
+  const Float3 farB = {0.1f, 0.0f, 1000.0f};
+  const Float3 closeA = {-50.0f, 0.0f, 1.0f};
+  const Float3 closeB = {50.0f, 0.0f, 1.0f};
+
+  CHECK_EQ(TessellationFactors::ComputeEdgeFactor(farA, farB, eye, params),
+           1.0f);
+  CHECK_EQ(TessellationFactors::ComputeEdgeFactor(closeA, closeB, eye, params),
+           64.0f);
+
+  // An eye on the edge's midpoint must not divide by zero.
+  const Float3 onEdge = {0.0f, 0.0f, 1.0f};
+  CHECK_EQ(
+      TessellationFactors::ComputeEdgeFactor(closeA, closeB, onEdge, params),
+      64.0f);
+
+  // A degenerate edge gets the minimum.
+  CHECK_EQ(TessellationFactors::ComputeEdgeFactor(farA, farA, eye, params),
+           1.0f);
+
+  params.MinTess = 0.25f;
+  CHECK_EQ(TessellationFactors::ComputeEdgeFactor(farA, farB, eye, params),
+           1.0f);
+  params.MinTess = 8.0f;
+  params.MaxTess = 4.0f;
+  CHECK_EQ(TessellationFactors::ComputeEdgeFactor(closeA, closeB, eye, params),
+           8.0f);
+  CHECK_EQ(TessellationFactors::ComputeEdgeFactor(farA, farB, eye, params),
+           8.0f);
+
+  // A zero target is clamped to 1e-3 pixels rather than dividing by zero:
+  // 0.06 pixels give 60 segments.
+  params = MakeParams(600.0f);
+  params.TargetPixelsPerEdge = 0.0f;
+  CHECK(Near(TessellationFactors::ComputeEdgeFactor(farA, farB, eye, params),
+             60.0f, 1e-4f));
+}
+
+void TestSharedEdgesAgree() {
+  // A grid of triangles viewed from random eyes: every edge is computed by
+  // both patches that share it, in opposite directions.
+  std::mt19937 random(9);
+  std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+  std::uniform_real_distribution<float> eyeCoordinate(-30.0f, 30.0f);
+  const int size = 16;
+  Float3 grid[size + 1][size + 1];
+  for (int z = 0; z <= size; ++z) {
+    for (int x = 0; x <= size; ++x) {
+      grid[z][x] = {x + jitter(random), jitter(random), z + jitter(random)};
+    }
+  }
+  const Params params = MakeParams(900.0f);
+  uint32_t cracks = 0;
+  for (int view = 0; view < 10; ++view) {
+    const Float3 eye = {eyeCoordinate(random), 5.0f + eyeCoordinate(random),
+                        eyeCoordinate(random)};
+    for (int z = 0; z < size; ++z) {
+      for (int x = 0; x < size; ++x) {
+        // Quad split into (p00, p10, p11) and (p00, p11, p01); the diagonal
+        // is edge 1 of the first and edge 2 of the second.
+        const Float3& p00 = grid[z][x];
+        const Float3& p10 = grid[z][x + 1];
+        const Float3& p11 = grid[z + 1][x + 1];
+        const Float3& p01 = grid[z + 1][x];
+        const auto first =
+            TessellationFactors::ComputePatchFactors(p00, p10, p11, eye, params);
+        const auto second =
+            TessellationFactors::ComputePatchFactors(p00, p11, p01, eye, params);
+        cracks += first.Edge[1] != second.Edge[2];
+
+        // The right edge p10-p11 against the neighbouring quad's left edge.
+        if (x + 1 < size) {
+          const auto neighbour = TessellationFactors::ComputePatchFactors(
+              p10, grid[z + 1][x + 2], p11, eye, params);
+          cracks += first.Edge[0] != neighbour.Edge[1];
+        }
+      }
+    }
+  }
+  CHECK_EQ(cracks, 0u);
+}
+
+void TestPatchFactors() {
+  const Params params = MakeParams(600.0f);
+  const Float3 p0 = {0.0f, 0.0f, 10.0f};
+  const Float3 p1 = {4.0f, 0.0f, 10.0f};
+  const Float3 p2 = {0.0f, 1.0f, 10.0f};
+  const Float3 eye = {};
+  const auto factors =
+      TessellationFactors::ComputePatchFactors(p0, p1, p2, eye, params);
+  CHECK_EQ(factors.Edge[0],
+           TessellationFactors::ComputeEdgeFactor(p1, p2, eye, params));
+  CHECK_EQ(factors.Edge[1],
+           TessellationFactors::ComputeEdgeFactor(p2, p0, eye, params));
+  CHECK_EQ(factors.Edge[2],
+           TessellationFactors::ComputeEdgeFactor(p0, p1, eye, params));
+  CHECK(Near(factors.Inside,
+             (factors.Edge[0] + factors.Edge[1] + factors.Edge[2]) / 3.0f));
+  // The longest edge gets the most segments.
+  CHECK(factors.Edge[2] > factors.Edge[1]);
+}
+
+void TestPixelsPerUnit() {
+  // 90 degree vertical field of view: proj._22 = 1.
+  CHECK(Near(TessellationFactors::ComputePixelsPerUnit(1.0f, 720.0f), 360.0f));
+  const float proj22 = 1.0f / std::tan(0.25f * 3.14159265f / 2.0f);
+  CHECK(Near(TessellationFactors::ComputePixelsPerUnit(proj22, 1080.0f),
+             540.0f * proj22));
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestMatchesShader);
+  RUN_TEST(TestClosedForm);
+  RUN_TEST(TestClamping);
+  RUN_TEST(TestSharedEdgesAgree);
+  RUN_TEST(TestPatchFactors);
+  RUN_TEST(TestPixelsPerUnit);
+  return TestResult("TessellationFactorsTest");
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <string>
+
+// Minimal assertions for the host tests. A failed check reports and counts
+// the failure and lets the test continue; main returns TestResult().
+
+inline int& TestFailureCount() {
+  static int count = 0;
+  return count;
+}
+
+inline void ReportTestFailure(const char* file, int line,
+                              const std::string& message) {
+  std::fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+  ++TestFailureCount();
+}
+
+#define CHECK(condition)                                        \
+  do {                                                          \
+    if (!(condition)) {                                         \
+      ReportTestFailure(__FILE__, __LINE__, "CHECK(" #condition \
+                                            ") failed");        \
+    }                                                           \
+  } while (false)
+
+#define CHECK_EQ(actual, expected)                                      \
+  do {                                                                  \
+    const auto& checkActual = (actual);                                 \
+    const auto& checkExpected = (expected);                             \
+    if (!(checkActual == checkExpected)) {                              \
+      std::ostringstream checkMessage;                                  \
+      checkMessage << "CHECK_EQ(" #actual ", " #expected "): got "      \
+                   << checkActual << ", expected " << checkExpected;    \
+      ReportTestFailure(__FILE__, __LINE__, checkMessage.str());        \
+    }                                                                   \
+  } while (false)
+
+#define CHECK_THROWS(statement, exceptionType)                           \
+  do {                                                                   \
+    bool checkThrew = false;                                             \
+    try {                                                                \
+      statement;                                                         \
+    } catch (const exceptionType&) {                                     \
+      checkThrew = true;                                                 \
+    }                                                                    \
+    if (!checkThrew) {                                                   \
+      ReportTestFailure(__FILE__, __LINE__,                              \
+                        "CHECK_THROWS(" #statement ", " #exceptionType   \
+                        ") did not throw");                              \
+    }                                                                    \
+  } while (false)
+
+// Runs one test function, turning an escaped exception into a failure.
+#define RUN_TEST(test)                                                    \
+  do {                                                                    \
+    try {                                                                 \
+      test();                                                             \
+    } catch (const std::exception& error) {                               \
+      ReportTestFailure(__FILE__, __LINE__,                               \
+                        std::string(#test " threw: ") + error.what());    \
+    }                                                                     \
+  } while (false)
+
+inline int TestResult(const char* name) {
+  if (TestFailureCount() != 0) {
+    std::fprintf(stderr, "%s: %d check(s) failed\n", name,
+                 TestFailureCount());
+    return 1;
+  }
+  std::printf("%s: passed\n", name);
+  return 0;
+}
@@ -0,0 +1,343 @@
+// Grouping of small textures into Texture2DArray resources and the memory
+// the plan reports.
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "TestCheck.h"
+#include "TextureArrayPlanner.h"
+
+namespace {
+using Planner = TextureArrayPlanner;
+
+// DXGI_FORMAT values.
+constexpr uint32_t kR8G8B8A8Unorm = 28;
+constexpr uint32_t kBc1Unorm = 71;
+constexpr uint32_t kBc3Unorm = 77;
+
+uint32_t GetFullMipCount(uint32_t width, uint32_t height) {
+  uint32_t mips = 1;
+  while ((std::max(width, height) >> mips) > 0) {
+    ++mips;
+  }
+  return mips;
+}
+
+// RGBA8 sizes are exact; block-compressed ones count whole 4x4 blocks.
+Planner::Texture MakeTexture(uint32_t format, uint32_t width, uint32_t height,
+                             uint32_t mipCount) {
+  Planner::Texture texture;
+  texture.Format = format;
+  texture.Width = width;
+  texture.Height = height;
+  texture.MipCount = mipCount;
+  for (uint32_t mip = 0; mip < mipCount; ++mip) {
+    const uint64_t mipWidth = std::max(width >> mip, 1u);
+    const uint64_t mipHeight = std::max(height >> mip, 1u);
+    if (format == kR8G8B8A8Unorm) {
+      texture.Bytes += mipWidth * mipHeight * 4;
+    } else {
+      const uint64_t blockBytes = format == kBc1Unorm ? 8 : 16;
+      texture.Bytes += (mipWidth + 3) / 4 * ((mipHeight + 3) / 4) * blockBytes;
+    }
+  }
+  return texture;
+}
+
+Planner::Texture MakeTexture(uint32_t format, uint32_t size) {
+  return MakeTexture(format, size, size, GetFullMipCount(size, size));
+}
+
+// Placements and arrays describe each other, every array holds textures
+// of one kind within the limits, and the stats add up.
+void CheckPlan(const std::vector<Planner::Texture>& textures,
+               const Planner::Settings& settings, const Planner::Plan& plan) {
+  CHECK_EQ(plan.Placements.size(), textures.size());
+  uint32_t packed = 0;
+  for (uint32_t i = 0; i < textures.size(); ++i) {
+    const Planner::Placement& placement = plan.Placements[i];
+    if (placement.Array == Planner::kNotPacked) {
+      continue;
+    }
+    ++packed;
+    CHECK(placement.Array < plan.Arrays.size());
+    if (placement.Array < plan.Arrays.size()) {
+      const Planner::Array& array = plan.Arrays[placement.Array];
+      CHECK(placement.Slice < array.Textures.size());
+      if (placement.Slice < array.Textures.size()) {
+        CHECK_EQ(array.Textures[placement.Slice], i);
+      }
+    }
+  }
+
+  uint32_t slices = 0;
+  uint64_t bytesAfter = 0;
+  for (const Planner::Array& array : plan.Arrays) {
+    CHECK(array.Textures.size() >= settings.MinSlices);
+    CHECK(array.Textures.size() <= settings.MaxSlices);
+    CHECK(std::max(array.Width, array.Height) <= settings.MaxDimension);
+    CHECK(std::is_sorted(array.Textures.begin(), array.Textures.end()));
+    uint64_t bytes = 0;
+    for (uint32_t texture : array.Textures) {
+      const Planner::Texture& member = textures[texture];
+      CHECK_EQ(member.Format, array.Format);
+      CHECK_EQ(member.Width, array.Width);
+      CHECK_EQ(member.Height, array.Height);
+      CHECK_EQ(member.MipCount, array.MipCount);
+      bytes += member.Bytes;
+    }
+    CHECK_EQ(array.Bytes, bytes);
+    slices += static_cast<uint32_t>(array.Textures.size());
+    bytesAfter += Planner::GetAllocatedBytes(array.Bytes, settings);
+  }
+  CHECK_EQ(slices, packed);
+
+  uint64_t dataBytes = 0;
+  uint64_t bytesBefore = 0;
+  for (uint32_t i = 0; i < textures.size(); ++i) {
+    const uint64_t allocated =
+        Planner::GetAllocatedBytes(textures[i].Bytes, settings);
+    dataBytes += textures[i].Bytes;
+    bytesBefore += allocated;
+    if (plan.Placements[i].Array == Planner::kNotPacked) {
+      bytesAfter += allocated;
+    }
+  }
+  const Planner::Stats& stats = plan.PlanStats;
+  CHECK_EQ(stats.Textures, static_cast<uint32_t>(textures.size()));
+  CHECK_EQ(stats.PackedTextures, packed);
+  CHECK_EQ(stats.Arrays, static_cast<uint32_t>(plan.Arrays.size()));
+  CHECK_EQ(stats.ResourcesBefore, stats.Textures);
+  CHECK_EQ(stats.ResourcesAfter,
+           stats.Textures - stats.PackedTextures + stats.Arrays);
+  CHECK_EQ(stats.BytesBefore, bytesBefore);
+  CHECK_EQ(stats.BytesAfter, bytesAfter);
+  CHECK_EQ(stats.BytesBefore - stats.WastedBytesBefore, dataBytes);
+  CHECK_EQ(stats.BytesAfter - stats.WastedBytesAfter, dataBytes);
+  if (!settings.AllowGrowth) {
+    CHECK(stats.BytesAfter <= stats.BytesBefore);
+  }
+}
+
+void TestGrouping() {
+  // 128x128 RGBA8 with every mip is 87380 bytes, 131072 once aligned to
+  // 64 KB on its own.
+  std::vector<Planner::Texture> textures;
+  for (int i = 0; i < 5; ++i) {
+    textures.push_back(MakeTexture(kR8G8B8A8Unorm, 128));
+    textures.push_back(MakeTexture(kR8G8B8A8Unorm, 512));
+  }
+  // Same size, one mip: a group of its own.
+  textures.push_back(MakeTexture(kR8G8B8A8Unorm, 128, 128, 1));
+  textures.push_back(MakeTexture(kR8G8B8A8Unorm, 128, 128, 1));
+  // Not square, and a lone texture below MinSlices.
+  textures.push_back(MakeTexture(kR8G8B8A8Unorm, 256, 128, 9));
+  textures.push_back(MakeTexture(kR8G8B8A8Unorm, 256, 128, 9));
+  textures.push_back(MakeTexture(kR8G8B8A8Unorm, 64));
+
+  const Planner::Settings settings;
+  const Planner::Plan plan = Planner::Build(textures, settings);
+  CheckPlan(textures, settings, plan);
+  CHECK_EQ(plan.Arrays.size(), 3u);
+  CHECK_EQ(plan.PlanStats.PackedTextures, 9u);
+  CHECK_EQ(plan.PlanStats.ResourcesAfter, 9u);
+  for (uint32_t i = 0; i < 10; i += 2) {
+    CHECK(plan.Placements[i].Array != Planner::kNotPacked);
+    CHECK_EQ(plan.Placements[i].Slice, i / 2);
+    // Larger than MaxDimension.
+    CHECK_EQ(plan.Placements[i + 1].Array, Planner::kNotPacked);
+  }
+  CHECK(plan.Placements[10].Array != plan.Placements[0].Array);
+  CHECK_EQ(plan.Placements[10].Array, plan.Placements[11].Array);
+  CHECK_EQ(plan.Placements[12].Array, plan.Placements[13].Array);
+  CHECK_EQ(plan.Placements[14].Array, Planner::kNotPacked);
+
+  // Five 128x128 slices share one 64 KB-aligned resource.
+  CHECK_EQ(Planner::GetAllocatedBytes(87380, settings), 2u * 65536);
+  if (plan.Placements[0].Array < plan.Arrays.size()) {
+    const Planner::Array& array = plan.Arrays[plan.Placements[0].Array];
+    CHECK_EQ(array.Bytes, 5u * 87380);
+    CHECK_EQ(Planner::GetAllocatedBytes(array.Bytes, settings), 7u * 65536);
+  }
+
+  // Nothing to pack.
+  const Planner::Plan empty = Planner::Build({}, settings);
+  CHECK(empty.Arrays.empty());
+  CHECK(empty.Placements.empty());
+  CHECK_EQ(empty.PlanStats.BytesAfter, 0u);
+}
+
+void TestMixedFormats() {
+  // Same size and mips in three formats: one array per format, with
+  // slices numbered per array.
+  std::vector<Planner::Texture> textures;
+  const uint32_t formats[] = {kR8G8B8A8Unorm, kBc1Unorm, kBc3Unorm};
+  for (int i = 0; i < 12; ++i) {
+    textures.push_back(MakeTexture(formats[i % 3], 256));
+  }
+  // The BC1 textures are small enough that their array needs the larger
+  // alignment.
+  Planner::Settings settings;
+  settings.AllowGrowth = true;
+  const Planner::Plan plan = Planner::Build(textures, settings);
+  CheckPlan(textures, settings, plan);
+  CHECK_EQ(plan.Arrays.size(), 3u);
+  for (uint32_t i = 0; i < textures.size(); ++i) {
+    const Planner::Placement& placement = plan.Placements[i];
+    CHECK_EQ(placement.Slice, i / 3);
+    CHECK(placement.Array < plan.Arrays.size());
+    if (placement.Array < plan.Arrays.size()) {
+      CHECK_EQ(plan.Arrays[placement.Array].Format, formats[i % 3]);
+    }
+  }
+
+  // Without growth the BC1 group stays standalone.
+  settings.AllowGrowth = false;
+  const Planner::Plan shrinking = Planner::Build(textures, settings);
+  CheckPlan(textures, settings, shrinking);
+  CHECK_EQ(shrinking.Arrays.size(), 2u);
+  CHECK_EQ(shrinking.PlanStats.GrowingGroups, 1u);
+  CHECK_EQ(shrinking.Placements[1].Array, Planner::kNotPacked);
+}
+
+void TestSliceCap() {
+  // 600 textures of one kind under a 256-slice cap: two full arrays and a
+  // third with the rest.
+  std::vector<Planner::Texture> textures(600, MakeTexture(kBc1Unorm, 64));
+  Planner::Settings settings;
+  settings.MaxSlices = 256;
+  settings.AllowGrowth = true;
+  Planner::Plan plan = Planner::Build(textures, settings);
+  CheckPlan(textures, settings, plan);
+  CHECK_EQ(plan.Arrays.size(), 3u);
+  CHECK_EQ(plan.Arrays[0].Textures.size(), 256u);
+  CHECK_EQ(plan.Arrays[1].Textures.size(), 256u);
+  CHECK_EQ(plan.Arrays[2].Textures.size(), 88u);
+  CHECK_EQ(plan.Placements[256].Array, 1u);
+  CHECK_EQ(plan.Placements[256].Slice, 0u);
+  CHECK_EQ(plan.Placements[599].Slice, 87u);
+
+  // A remainder below MinSlices stays standalone.
+  settings.MinSlices = 100;
+  plan = Planner::Build(textures, settings);
+  CheckPlan(textures, settings, plan);
+  CHECK_EQ(plan.Arrays.size(), 2u);
+  CHECK_EQ(plan.PlanStats.PackedTextures, 512u);
+  CHECK_EQ(plan.Placements[512].Array, Planner::kNotPacked);
+
+  // The default cap is the D3D12 array size limit.
+  textures.resize(2050, textures.front());
+  const Planner::Settings defaults;
+  CHECK_EQ(defaults.MaxSlices, 2048u);
+  plan = Planner::Build(textures, defaults);
+  CheckPlan(textures, defaults, plan);
+  CHECK_EQ(plan.Arrays.size(), 2u);
+  CHECK_EQ(plan.Arrays[0].Textures.size(), 2048u);
+  CHECK_EQ(plan.Arrays[1].Textures.size(), 2u);
+
+  Planner::Settings bad;
+  bad.MinSlices = 0;
+  CHECK_THROWS(Planner::Build(textures, bad), std::invalid_argument);
+  bad.MinSlices = 4;
+  bad.MaxSlices = 3;
+  CHECK_THROWS(Planner::Build(textures, bad), std::invalid_argument);
+}
+
+void TestGrowth() {
+  // Three 30000-byte textures take 32 KB each on their own but 128 KB
+  // together, past the 64 KB small-resource limit.
+  Planner::Texture texture;
+  texture.Format = kR8G8B8A8Unorm;
+  texture.Width = 64;
+  texture.Height = 64;
+  texture.MipCount = 1;
+  texture.Bytes = 30000;
+  const std::vector<Planner::Texture> textures(3, texture);
+
+  Planner::Settings settings;
+  Planner::Plan plan = Planner::Build(textures, settings);
+  CheckPlan(textures, settings, plan);
+  CHECK(plan.Arrays.empty());
+  CHECK_EQ(plan.PlanStats.GrowingGroups, 1u);
+  CHECK_EQ(plan.PlanStats.BytesAfter, 3u * 32768);
+
+  settings.AllowGrowth = true;
+  plan = Planner::Build(textures, settings);
+  CheckPlan(textures, settings, plan);
+  CHECK_EQ(plan.Arrays.size(), 1u);
+  CHECK_EQ(plan.PlanStats.GrowingGroups, 0u);
+  CHECK_EQ(plan.PlanStats.BytesAfter, 2u * 65536);
+  CHECK_EQ(plan.PlanStats.WastedBytesAfter, 2u * 65536 - 90000);
+}
+
+void TestRandomScenes() {
+  std::mt19937 random(49);
+  const uint32_t formats[] = {kR8G8B8A8Unorm, kBc1Unorm, kBc3Unorm};
+  const uint32_t sizes[] = {32, 64, 128, 256, 512, 1024};
+  uint32_t arrays = 0;
+  uint32_t growing = 0;
+  uint32_t fullArrays = 0;
+  for (int scene = 0; scene < 200; ++scene) {
+    std::vector<Planner::Texture> textures(random() % 400);
+    for (Planner::Texture& texture : textures) {
+      const uint32_t width = sizes[random() % 6];
+      const uint32_t height = random() % 4 ? width : sizes[random() % 6];
+      const uint32_t fullMips = GetFullMipCount(width, height);
+      texture = MakeTexture(formats[random() % 3], width, height,
+                            random() % 4 ? fullMips : 1 + random() % fullMips);
+    }
+    Planner::Settings settings;
+    settings.MinSlices = 1 + random() % 4;
+    settings.MaxSlices = settings.MinSlices + random() % 32;
+    settings.AllowGrowth = random() % 2 != 0;
+    const Planner::Plan plan = Planner::Build(textures, settings);
+    CheckPlan(textures, settings, plan);
+
+    // Every group of at least MinSlices textures is packed unless it
+    // would grow; only a remainder below MinSlices is left over.
+    using GroupKey = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>;
+    std::map<GroupKey, uint32_t> unpacked;
+    for (uint32_t i = 0; i < textures.size(); ++i) {
+      const Planner::Texture& texture = textures[i];
+      if (plan.Placements[i].Array == Planner::kNotPacked &&
+          std::max(texture.Width, texture.Height) <= settings.MaxDimension) {
+        ++unpacked[GroupKey(texture.Format, texture.Width, texture.Height,
+                            texture.MipCount)];
+      }
+    }
+    uint32_t leftOver = 0;
+    for (const auto& group : unpacked) {
+      if (group.second >= settings.MinSlices) {
+        ++leftOver;
+      }
+    }
+    CHECK(leftOver <= plan.PlanStats.GrowingGroups);
+    if (settings.AllowGrowth) {
+      CHECK_EQ(plan.PlanStats.GrowingGroups, 0u);
+    }
+    for (const Planner::Array& array : plan.Arrays) {
+      fullArrays += array.Textures.size() == settings.MaxSlices ? 1 : 0;
+    }
+    arrays += plan.PlanStats.Arrays;
+    growing += plan.PlanStats.GrowingGroups;
+  }
+  // The scenes reached packing, the cap and the growth check.
+  CHECK(arrays > 1000);
+  CHECK(fullArrays > 100);
+  CHECK(growing > 10);
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestGrouping);
+  RUN_TEST(TestMixedFormats);
+  RUN_TEST(TestSliceCap);
+  RUN_TEST(TestGrowth);
+  RUN_TEST(TestRandomScenes);
+  return TestResult("TextureArrayPlannerTest");
+}
@@ -0,0 +1,211 @@
+// TextureCache: content keys, reference counting, and eviction of the
+// least recently released textures once the unreferenced ones exceed the
+// budget. A seeded random run is checked against a plain model of the
+// cache.
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "TestCheck.h"
+#include "TextureCache.h"
+
+namespace {
+using Key = TextureCache::Key;
+
+Key MakeKey(const std::string& contents, uint64_t paramsHash = 0) {
+  return TextureCache::MakeKey(contents.data(), contents.size(), paramsHash);
+}
+
+TextureCache MakeCache(uint64_t budgetBytes) {
+  TextureCache cache;
+  TextureCache::Settings settings;
+  settings.BudgetBytes = budgetBytes;
+  CHECK(cache.SetSettings(settings).empty());
+  return cache;
+}
+
+void TestKeys() {
+  // Equal contents give equal keys whatever the buffer; any byte, the size
+  // or the load parameters tell keys apart.
+  const std::string a = "DDS texture bytes";
+  std::string copy = a;
+  CHECK(MakeKey(a) == MakeKey(copy));
+  copy[5] ^= 1;
+  CHECK(!(MakeKey(a) == MakeKey(copy)));
+  CHECK(!(MakeKey(a) == MakeKey(a + '\0')));
+  CHECK(!(MakeKey(a, 1) == MakeKey(a, 2)));
+  CHECK_EQ(MakeKey(a).ContentSize, static_cast<uint64_t>(a.size()));
+}
+
+void TestHitsAndReferences() {
+  TextureCache cache = MakeCache(0);
+  const Key key = MakeKey("albedo");
+  CHECK_EQ(cache.Acquire(key), TextureCache::kNotFound);
+  cache.Insert(key, 7, 1000);
+  CHECK_EQ(cache.Acquire(key), 7u);
+  CHECK_EQ(cache.Acquire(key), 7u);
+
+  TextureCache::Stats stats = cache.GetStats();
+  CHECK_EQ(stats.Misses, 1u);
+  CHECK_EQ(stats.Hits, 2u);
+  CHECK_EQ(stats.BytesSaved, 2000u);
+  CHECK_EQ(stats.Textures, 1u);
+  CHECK_EQ(stats.ReferencedBytes, 1000u);
+
+  // Three references; with no budget the last release evicts at once.
+  CHECK(cache.Release(7).empty());
+  CHECK(cache.Release(7).empty());
+  CHECK(cache.Release(7) == std::vector<uint32_t>{7});
+  stats = cache.GetStats();
+  CHECK_EQ(stats.Textures, 0u);
+  CHECK_EQ(stats.ReferencedBytes, 0u);
+  CHECK_EQ(stats.UnreferencedBytes, 0u);
+  CHECK_EQ(stats.Evictions, 1u);
+  CHECK_EQ(cache.Acquire(key), TextureCache::kNotFound);
+}
+
+void TestBudgetEvictsLeastRecentlyReleased() {
+  TextureCache cache = MakeCache(300);
+  for (uint32_t texture = 0; texture < 4; ++texture) {
+    cache.Insert(MakeKey(std::to_string(texture)), texture, 100);
+  }
+  // Referenced textures never count against the budget.
+  CHECK_EQ(cache.GetStats().ReferencedBytes, 400u);
+
+  CHECK(cache.Release(2).empty());
+  CHECK(cache.Release(0).empty());
+  CHECK(cache.Release(3).empty());
+  CHECK_EQ(cache.GetStats().UnreferencedBytes, 300u);
+  // Acquiring 0 again takes it off the list; releasing it makes it the
+  // most recent.
+  CHECK_EQ(cache.Acquire(MakeKey("0")), 0u);
+  CHECK(cache.Release(0).empty());
+  // The fourth unreferenced texture goes over the budget: 2 was released
+  // first.
+  CHECK(cache.Release(1) == std::vector<uint32_t>{2});
+  CHECK_EQ(cache.GetStats().UnreferencedBytes, 300u);
+  CHECK_EQ(cache.Acquire(MakeKey("2")), TextureCache::kNotFound);
+
+  // A smaller budget evicts in the same order; a larger one keeps the rest.
+  TextureCache::Settings settings;
+  settings.BudgetBytes = 150;
+  CHECK(cache.SetSettings(settings) == (std::vector<uint32_t>{3, 0}));
+  settings.BudgetBytes = 1000;
+  CHECK(cache.SetSettings(settings).empty());
+  CHECK_EQ(cache.GetStats().Textures, 1u);
+  CHECK_EQ(cache.GetStats().Evictions, 3u);
+  CHECK_EQ(cache.Acquire(MakeKey("1")), 1u);
+
+  // A texture larger than the whole budget is evicted as soon as it is
+  // released.
+  cache.Insert(MakeKey("large"), 9, 5000);
+  CHECK(cache.Release(9) == std::vector<uint32_t>{9});
+}
+
+void TestMisuseThrows() {
+  TextureCache cache = MakeCache(1000);
+  cache.Insert(MakeKey("a"), 1, 10);
+  CHECK_THROWS(cache.Insert(MakeKey("a"), 2, 10), std::invalid_argument);
+  CHECK_THROWS(cache.Insert(MakeKey("b"), 1, 10), std::invalid_argument);
+  CHECK_THROWS(cache.Release(2), std::invalid_argument);
+  cache.Release(1);
+  CHECK_THROWS(cache.Release(1), std::invalid_argument);
+  CHECK_EQ(cache.GetStats().Textures, 1u);
+}
+
+void TestRandomAgainstModel() {
+  for (uint32_t seed = 1; seed <= 8; ++seed) {
+    std::mt19937 random(seed);
+    const uint64_t budget = 1000 + random() % 2000;
+    TextureCache cache = MakeCache(budget);
+
+    // The model: references and size per cached file, and the
+    // unreferenced files, least recently released first.
+    struct Cached {
+      uint32_t Texture = 0;
+      uint32_t References = 0;
+      uint64_t Bytes = 0;
+    };
+    std::map<uint32_t, Cached> cached;
+    std::list<uint32_t> unreferenced;
+    uint32_t nextTexture = 0;
+    uint64_t evictions = 0;
+    uint64_t peakUnreferenced = 0;
+
+    for (uint32_t step = 0; step < 20000; ++step) {
+      const uint32_t file = random() % 64;
+      const auto it = cached.find(file);
+      if (random() % 100 < 45) {
+        // Load: a hit adds a reference, a miss loads and inserts.
+        const uint32_t texture = cache.Acquire(MakeKey(std::to_string(file)));
+        if (it == cached.end()) {
+          CHECK_EQ(texture, TextureCache::kNotFound);
+          Cached entry;
+          entry.Texture = nextTexture++;
+          entry.References = 1;
+          entry.Bytes = 50 + random() % 500;
+          cache.Insert(MakeKey(std::to_string(file)), entry.Texture,
+                       entry.Bytes);
+          cached[file] = entry;
+        } else {
+          CHECK_EQ(texture, it->second.Texture);
+          if (it->second.References++ == 0) {
+            unreferenced.remove(file);
+          }
+        }
+      } else if (it != cached.end() && it->second.References > 0) {
+        const uint32_t texture = it->second.Texture;
+        std::vector<uint32_t> expected;
+        if (--it->second.References == 0) {
+          unreferenced.push_back(file);
+          uint64_t bytes = 0;
+          for (uint32_t f : unreferenced) {
+            bytes += cached[f].Bytes;
+          }
+          peakUnreferenced = std::max(peakUnreferenced, bytes);
+          while (bytes > budget) {
+            const uint32_t victim = unreferenced.front();
+            unreferenced.pop_front();
+            bytes -= cached[victim].Bytes;
+            expected.push_back(cached[victim].Texture);
+            cached.erase(victim);
+            ++evictions;
+          }
+        }
+        CHECK(cache.Release(texture) == expected);
+      }
+    }
+
+    const TextureCache::Stats stats = cache.GetStats();
+    uint64_t referencedBytes = 0;
+    uint64_t unreferencedBytes = 0;
+    for (const auto& entry : cached) {
+      (entry.second.References > 0 ? referencedBytes : unreferencedBytes) +=
+          entry.second.Bytes;
+    }
+    CHECK_EQ(stats.Textures, static_cast<uint32_t>(cached.size()));
+    CHECK_EQ(stats.ReferencedBytes, referencedBytes);
+    CHECK_EQ(stats.UnreferencedBytes, unreferencedBytes);
+    CHECK(stats.UnreferencedBytes <= budget);
+    CHECK_EQ(stats.Evictions, evictions);
+    // The run went over the budget and reused cached textures.
+    CHECK(peakUnreferenced > budget);
+    CHECK(stats.Hits > 1000);
+  }
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestKeys);
+  RUN_TEST(TestHitsAndReferences);
+  RUN_TEST(TestBudgetEvictsLeastRecentlyReleased);
+  RUN_TEST(TestMisuseThrows);
+  RUN_TEST(TestRandomAgainstModel);
+  return TestResult("TextureCacheTest");
+}
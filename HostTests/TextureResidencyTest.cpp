@@ -0,0 +1,345 @@
+// TextureResidency driven by scripted camera paths. A camera flies along a
+// row of large textured objects, reporting screen texels the way
+// RenderingSystem does; stream-ins complete a few frames after they are
+// issued and evictions at once, like TextureStreamer. Every frame the
+// budget, the in-flight limit and the byte accounting are checked.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+#include "TestCheck.h"
+#include "TextureResidency.h"
+
+namespace {
+using Request = TextureResidency::Request;
+
+constexpr uint32_t kTextureSize = 2048;
+constexpr uint32_t kPackedSize = 512;
+constexpr float kObjectRadius = 10.0f;
+constexpr float kObjectSpacing = 10.0f;
+constexpr uint32_t kObjectCount = 20;
+// 60 degree vertical field of view at 1080p.
+constexpr float kProj22 = 1.7320508f;
+constexpr float kViewportHeight = 1080.0f;
+constexpr uint32_t kStreamLatency = 3;
+
+// RGBA8 mip chain of a square texture.
+std::vector<uint64_t> MipBytes(uint32_t size) {
+  std::vector<uint64_t> bytes;
+  for (uint32_t s = size; s > 0; s >>= 1) {
+    bytes.push_back(4ull * s * s);
+  }
+  return bytes;
+}
+
+// The smallest mip with at least one texel per pixel, within the startup
+// mips.
+uint32_t ExpectedMip(const TextureResidency& residency, uint32_t texture,
+                     float screenTexels) {
+  uint32_t mip = 0;
+  while (mip < residency.GetMinMip(texture) &&
+         static_cast<float>(kTextureSize >> (mip + 1)) >=
+             std::max(screenTexels, 1.0f)) {
+    ++mip;
+  }
+  return mip;
+}
+
+class Scene {
+ public:
+  explicit Scene(uint64_t budgetBytes, uint32_t packedCount = 0) {
+    TextureResidency::Settings settings;
+    settings.BudgetBytes = budgetBytes;
+    mResidency.SetSettings(settings);
+    for (uint32_t i = 0; i < kObjectCount; ++i) {
+      mObjects.push_back(mResidency.AddTexture(kTextureSize, kTextureSize,
+                                               MipBytes(kTextureSize)));
+    }
+    // Slices of a packed array: resident in full for their whole life.
+    for (uint32_t i = 0; i < packedCount; ++i) {
+      mPacked.push_back(mResidency.AddTexture(kPackedSize, kPackedSize,
+                                              MipBytes(kPackedSize), true));
+    }
+  }
+
+  TextureResidency& Residency() { return mResidency; }
+  uint32_t Object(uint32_t index) const { return mObjects[index]; }
+  float ObjectZ(uint32_t index) const { return index * kObjectSpacing; }
+
+  float ScreenTexels(uint32_t index, float cameraZ) const {
+    const float distance = std::abs(ObjectZ(index) - cameraZ);
+    return TextureResidency::ComputeScreenTexels(kObjectRadius, distance,
+                                                 kProj22, kViewportHeight);
+  }
+
+  // Requests everything in front of the camera looking along +z (direction
+  // 1) or -z (direction -1), closes the frame and checks the invariants.
+  void Frame(float cameraZ, float direction) {
+    for (uint32_t i = 0; i < kObjectCount; ++i) {
+      if ((ObjectZ(i) - cameraZ) * direction > 0.0f) {
+        mResidency.RequestTexels(mObjects[i], ScreenTexels(i, cameraZ));
+      }
+    }
+    // The packed slices are drawn every frame as well.
+    for (uint32_t texture : mPacked) {
+      mResidency.RequestTexels(texture, kViewportHeight);
+    }
+
+    const std::vector<Request> requests = mResidency.Update();
+    for (const Request& request : requests) {
+      CHECK(!mResidency.IsPinned(request.Texture));
+      const uint32_t resident = mResidency.GetResidentMip(request.Texture);
+      CHECK(request.TopMip != resident);
+      CHECK(request.TopMip <= mResidency.GetMinMip(request.Texture));
+      if (request.TopMip > resident) {
+        mResidency.OnStreamCompleted(request.Texture, request.TopMip);
+      } else {
+        mInFlight.push_back({mFrame + kStreamLatency, request});
+      }
+    }
+
+    CheckInvariants();
+    while (!mInFlight.empty() && mInFlight.front().DoneFrame <= mFrame) {
+      const Request& request = mInFlight.front().Stream;
+      mResidency.OnStreamCompleted(request.Texture, request.TopMip);
+      mInFlight.pop_front();
+    }
+    ++mFrame;
+  }
+
+  void Fly(float fromZ, float toZ, float direction, float speed) {
+    const uint32_t frames =
+        static_cast<uint32_t>(std::abs(toZ - fromZ) / speed);
+    for (uint32_t f = 0; f <= frames; ++f) {
+      Frame(fromZ + (toZ - fromZ) * f / std::max(frames, 1u), direction);
+    }
+  }
+
+ private:
+  void CheckInvariants() {
+    const TextureResidency::Stats stats = mResidency.GetStats();
+    CHECK(stats.ResidentBytes <= mResidency.GetSettings().BudgetBytes);
+    CHECK(stats.InFlight <= mResidency.GetSettings().MaxInFlight);
+    CHECK_EQ(static_cast<size_t>(stats.InFlight), mInFlight.size());
+
+    uint64_t committed = 0;
+    for (uint32_t texture : mObjects) {
+      committed +=
+          mResidency.GetBytes(texture, mResidency.GetCommittedMip(texture));
+    }
+    for (uint32_t texture : mPacked) {
+      CHECK_EQ(mResidency.GetResidentMip(texture), 0u);
+      CHECK_EQ(mResidency.GetCommittedMip(texture), 0u);
+      committed += mResidency.GetBytes(texture, 0);
+    }
+    CHECK_EQ(stats.ResidentBytes, committed);
+  }
+
+  struct InFlightStream {
+    uint32_t DoneFrame;
+    Request Stream;
+  };
+
+  TextureResidency mResidency;
+  std::vector<uint32_t> mObjects;
+  std::vector<uint32_t> mPacked;
+  std::deque<InFlightStream> mInFlight;
+  uint32_t mFrame = 0;
+};
+
+void TestFlyThroughStaysWithinBudget() {
+  // Room for about two full chains next to the startup mips.
+  Scene scene(48ull * 1024 * 1024, 4);
+  scene.Fly(-30.0f, 230.0f, 1.0f, 0.5f);
+  scene.Fly(230.0f, -30.0f, -1.0f, 0.5f);
+
+  const TextureResidency::Stats stats = scene.Residency().GetStats();
+  CHECK(stats.StreamIns > 0);
+  // The budget only covers a few objects, so passing the rest forces
+  // evictions.
+  CHECK(stats.Evictions > 0);
+  // On the way back the objects were passed from the last to the first, so
+  // the ones still holding extra mips are a run of the first few: the
+  // others were evicted least recently used first.
+  uint32_t holding = 0;
+  while (holding < kObjectCount &&
+         scene.Residency().GetCommittedMip(scene.Object(holding)) <
+             scene.Residency().GetMinMip(scene.Object(holding))) {
+    ++holding;
+  }
+  CHECK(holding > 0);
+  CHECK(holding < kObjectCount);
+  for (uint32_t i = holding; i < kObjectCount; ++i) {
+    CHECK_EQ(scene.Residency().GetCommittedMip(scene.Object(i)),
+             scene.Residency().GetMinMip(scene.Object(i)));
+  }
+}
+
+void TestHoveringCameraConverges() {
+  Scene scene(48ull * 1024 * 1024, 4);
+  const float cameraZ = 95.0f;
+  scene.Fly(-30.0f, cameraZ, 1.0f, 0.5f);
+  for (uint32_t frame = 0; frame < 60; ++frame) {
+    scene.Frame(cameraZ, 1.0f);
+  }
+
+  TextureResidency& residency = scene.Residency();
+  const TextureResidency::Stats stats = residency.GetStats();
+  CHECK_EQ(stats.InFlight, 0u);
+  // The nearest object ahead gets all the detail it can use.
+  const uint32_t nearest = 10;
+  CHECK_EQ(residency.GetResidentMip(scene.Object(nearest)),
+           ExpectedMip(residency, scene.Object(nearest),
+                       scene.ScreenTexels(nearest, cameraZ)));
+  // Behind the camera only the startup mips remain...
+  for (uint32_t i = 0; i < nearest; ++i) {
+    CHECK_EQ(residency.GetResidentMip(scene.Object(i)),
+             residency.GetMinMip(scene.Object(i)));
+  }
+  // ...and ahead of it, any object short of its mip could not take even
+  // one more level within the budget.
+  for (uint32_t i = nearest; i < kObjectCount; ++i) {
+    const uint32_t texture = scene.Object(i);
+    const uint32_t resident = residency.GetResidentMip(texture);
+    CHECK(resident >=
+          ExpectedMip(residency, texture, scene.ScreenTexels(i, cameraZ)));
+    if (resident > ExpectedMip(residency, texture,
+                               scene.ScreenTexels(i, cameraZ))) {
+      const uint64_t oneMore = residency.GetBytes(texture, resident - 1) -
+                               residency.GetBytes(texture, resident);
+      CHECK(stats.ResidentBytes + oneMore >
+            residency.GetSettings().BudgetBytes);
+    }
+  }
+}
+
+void TestUnlimitedBudgetNeverEvicts() {
+  Scene scene(~0ull, 2);
+  scene.Fly(-30.0f, 230.0f, 1.0f, 1.0f);
+  CHECK_EQ(scene.Residency().GetStats().Evictions, 0u);
+  CHECK_EQ(scene.Residency().GetStats().BudgetMisses, 0u);
+  // Every object was seen from close by and keeps its mip 0 resident.
+  for (uint32_t i = 0; i < kObjectCount; ++i) {
+    CHECK_EQ(scene.Residency().GetResidentMip(scene.Object(i)), 0u);
+  }
+}
+
+void TestLeastRecentlyUsedEvictedFirst() {
+  // Room for two full chains: looking at A, B, then C evicts A, not B.
+  TextureResidency residency;
+  TextureResidency::Settings settings;
+  settings.MaxInFlight = 1;
+  const std::vector<uint64_t> bytes = MipBytes(kTextureSize);
+  uint64_t full = 0;
+  for (uint64_t mip : bytes) {
+    full += mip;
+  }
+  settings.BudgetBytes = 2 * full + full / 2;
+  residency.SetSettings(settings);
+  uint32_t textures[3];
+  for (uint32_t& texture : textures) {
+    texture = residency.AddTexture(kTextureSize, kTextureSize, bytes);
+  }
+
+  for (uint32_t texture : textures) {
+    residency.RequestTexels(texture, 1e6f);
+    const std::vector<Request> requests = residency.Update();
+    for (const Request& request : requests) {
+      residency.OnStreamCompleted(request.Texture, request.TopMip);
+    }
+    CHECK_EQ(residency.GetResidentMip(texture), 0u);
+  }
+  CHECK_EQ(residency.GetResidentMip(textures[0]),
+           residency.GetMinMip(textures[0]));
+  CHECK_EQ(residency.GetResidentMip(textures[1]), 0u);
+  CHECK_EQ(residency.GetStats().Evictions, 1u);
+}
+
+void TestPinnedTexturesAreNeverStreamed() {
+  TextureResidency residency;
+  TextureResidency::Settings settings;
+  const std::vector<uint64_t> bytes = MipBytes(kTextureSize);
+  settings.BudgetBytes = bytes[0];
+  residency.SetSettings(settings);
+  // Larger than MinResidentDimension, but starts and stays at mip 0.
+  const uint32_t pinned =
+      residency.AddTexture(kTextureSize, kTextureSize, bytes, true);
+  CHECK(residency.IsPinned(pinned));
+  CHECK_EQ(residency.GetMinMip(pinned), 0u);
+  CHECK_EQ(residency.GetResidentMip(pinned), 0u);
+  const uint32_t streamed =
+      residency.AddTexture(kTextureSize, kTextureSize, bytes);
+  CHECK(!residency.IsPinned(streamed));
+
+  // The streamed texture cannot fit, and the pinned one is not evicted to
+  // make room for it.
+  for (uint32_t frame = 0; frame < 10; ++frame) {
+    residency.RequestTexels(pinned, 1.0f);
+    residency.RequestTexels(streamed, 1e6f);
+    for (const Request& request : residency.Update()) {
+      CHECK(request.Texture != pinned);
+      residency.OnStreamCompleted(request.Texture, request.TopMip);
+    }
+  }
+  CHECK_EQ(residency.GetResidentMip(pinned), 0u);
+  CHECK_EQ(residency.GetStats().Evictions, 0u);
+  CHECK(residency.GetStats().BudgetMisses > 0);
+
+  residency.RemoveTexture(pinned);
+  CHECK_EQ(residency.GetStats().ResidentBytes,
+           residency.GetBytes(streamed, residency.GetMinMip(streamed)));
+}
+
+void TestFailedAndRemovedStreams() {
+  TextureResidency residency;
+  const uint32_t a = residency.AddTexture(kTextureSize, kTextureSize,
+                                          MipBytes(kTextureSize));
+  const uint32_t b = residency.AddTexture(kTextureSize, kTextureSize,
+                                          MipBytes(kTextureSize));
+
+  residency.RequestTexels(a, 1e6f);
+  residency.RequestTexels(b, 1e6f);
+  CHECK_EQ(residency.Update().size(), 2u);
+  CHECK_EQ(residency.GetStats().InFlight, 2u);
+
+  // A failed read gives the bytes back and the texture is asked for again.
+  residency.OnStreamFailed(a);
+  CHECK_EQ(residency.GetResidentMip(a), residency.GetMinMip(a));
+  residency.RequestTexels(a, 1e6f);
+  residency.RequestTexels(b, 1e6f);
+  const std::vector<Request> retry = residency.Update();
+  CHECK_EQ(retry.size(), 1u);
+  CHECK_EQ(retry[0].Texture, a);
+
+  // Removing a texture mid-stream drops its bytes; the late completion is
+  // ignored.
+  residency.RemoveTexture(b);
+  residency.OnStreamCompleted(b, 0);
+  residency.OnStreamCompleted(a, 0);
+  CHECK_EQ(residency.GetResidentMip(a), 0u);
+  CHECK_EQ(residency.GetStats().ResidentBytes, residency.GetBytes(a, 0));
+  residency.RequestTexels(b, 1e6f);
+  CHECK(residency.Update().empty());
+}
+
+void TestInvalidTexturesThrow() {
+  TextureResidency residency;
+  CHECK_THROWS(residency.AddTexture(0, 16, {64}), std::invalid_argument);
+  CHECK_THROWS(residency.AddTexture(16, 16, {}), std::invalid_argument);
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestFlyThroughStaysWithinBudget);
+  RUN_TEST(TestHoveringCameraConverges);
+  RUN_TEST(TestUnlimitedBudgetNeverEvicts);
+  RUN_TEST(TestLeastRecentlyUsedEvictedFirst);
+  RUN_TEST(TestPinnedTexturesAreNeverStreamed);
+  RUN_TEST(TestFailedAndRemovedStreams);
+  RUN_TEST(TestInvalidTexturesThrow);
+  return TestResult("TextureResidencyTest");
+}
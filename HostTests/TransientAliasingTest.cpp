@@ -0,0 +1,335 @@
+// TransientResourcePlanner placement and the aliasing barriers RenderGraph
+// derives from it.
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "RenderGraph.h"
+#include "TestCheck.h"
+#include "TransientResourcePlanner.h"
+
+namespace {
+using Planner = TransientResourcePlanner;
+constexpr uint64_t kMiB = 1024 * 1024;
+constexpr uint64_t kAlignment = 64 * 1024;
+
+bool LifetimesOverlap(const Planner::Placement& a,
+                      const Planner::Placement& b) {
+  return a.FirstPass <= b.LastPass && b.FirstPass <= a.LastPass;
+}
+
+bool MemoryOverlaps(const Planner& planner, Planner::ResourceHandle a,
+                    Planner::ResourceHandle b) {
+  const uint64_t aBegin = planner.GetPlacement(a).HeapOffset;
+  const uint64_t bBegin = planner.GetPlacement(b).HeapOffset;
+  return aBegin < bBegin + planner.GetResource(b).SizeInBytes &&
+         bBegin < aBegin + planner.GetResource(a).SizeInBytes;
+}
+
+// The targets and passes GBuffer declares, with a 1080p-like size ratio.
+enum Target : uint32_t { kAlbedo, kNormal, kDepth, kParticleColor };
+
+void BuildFramePlan(Planner& planner) {
+  planner.Reset();
+  planner.DeclareResource("GBufferAlbedo", 8 * kMiB, kAlignment);
+  planner.DeclareResource("GBufferNormal", 16 * kMiB, kAlignment);
+  planner.DeclareResource("Depth", 8 * kMiB, kAlignment);
+  planner.DeclareResource("ParticleColor", 8 * kMiB, kAlignment);
+  planner.AddPass("Geometry", {}, {kAlbedo, kNormal, kDepth});
+  planner.AddPass("Compose", {kAlbedo, kNormal, kDepth}, {});
+  planner.AddPass("ParticleRender", {kDepth}, {kParticleColor});
+  planner.AddPass("ParticleComposite", {kParticleColor}, {});
+  planner.AddPass("ParticleDepthCopy", {kDepth}, {});
+  planner.Compile();
+}
+
+void TestFramePlanReusesGBufferMemory() {
+  Planner planner;
+  BuildFramePlan(planner);
+
+  CHECK_EQ(planner.GetUnaliasedBytes(), 40 * kMiB);
+  CHECK_EQ(planner.GetPeakTransientBytes(), 32 * kMiB);
+  CHECK_EQ(planner.GetHeapSize(), 32 * kMiB);
+
+  const auto& particle = planner.GetPlacement(kParticleColor);
+  CHECK_EQ(particle.FirstPass, 2u);
+  CHECK_EQ(particle.LastPass, 3u);
+  CHECK(MemoryOverlaps(planner, kParticleColor, kNormal));
+  CHECK_EQ(particle.AliasedPredecessor, static_cast<uint32_t>(kNormal));
+  // The normal target takes its memory back from the previous frame's
+  // particle target.
+  CHECK_EQ(planner.GetPlacement(kNormal).AliasedPredecessor,
+           static_cast<uint32_t>(kParticleColor));
+  CHECK_EQ(planner.GetPlacement(kAlbedo).AliasedPredecessor,
+           Planner::kNoResource);
+  CHECK_EQ(planner.GetPlacement(kDepth).AliasedPredecessor,
+           Planner::kNoResource);
+}
+
+void TestUnusedResourceIsNotPlaced() {
+  Planner planner;
+  const auto used = planner.DeclareResource("Used", 4 * kMiB, kAlignment);
+  const auto unused = planner.DeclareResource("Unused", 4 * kMiB, kAlignment);
+  planner.AddPass("Only", {}, {used});
+  planner.Compile();
+  CHECK_EQ(planner.GetPlacement(unused).FirstPass, Planner::kInvalidPass);
+  CHECK_EQ(planner.GetUnaliasedBytes(), 4 * kMiB);
+  CHECK_EQ(planner.GetHeapSize(), 4 * kMiB);
+}
+
+void TestInvalidArguments() {
+  Planner planner;
+  CHECK_THROWS(planner.DeclareResource("Empty", 0, kAlignment),
+               std::invalid_argument);
+  CHECK_THROWS(planner.DeclareResource("Odd", kMiB, 3000),
+               std::invalid_argument);
+  const auto handle = planner.DeclareResource("Target", kMiB, kAlignment);
+  CHECK_THROWS(planner.AddPass("Bad", {handle + 1}, {}), std::out_of_range);
+  CHECK_THROWS(planner.GetPlacement(handle), std::logic_error);
+  planner.AddPass("Good", {}, {handle});
+  planner.Compile();
+  CHECK_THROWS(planner.GetPlacement(handle + 1), std::out_of_range);
+}
+
+// Random plans: resources that are live together never share memory, every
+// offset is aligned, and each predecessor is the last earlier user of the
+// memory, counting the previous frame. Ties between predecessors that end
+// in the same pass may go either way.
+void TestRandomPlansKeepLiveResourcesApart() {
+  std::mt19937 random(26);
+  for (int iteration = 0; iteration < 500; ++iteration) {
+    Planner planner;
+    const uint32_t resourceCount = 1 + random() % 12;
+    const uint32_t passCount = 1 + random() % 10;
+    for (uint32_t i = 0; i < resourceCount; ++i) {
+      const uint64_t alignment = (random() % 2) != 0 ? kAlignment : 4096;
+      planner.DeclareResource("R" + std::to_string(i),
+                              (1 + random() % 64) * 4096 + random() % 4096,
+                              alignment);
+    }
+    for (uint32_t pass = 0; pass < passCount; ++pass) {
+      std::vector<Planner::ResourceHandle> reads;
+      std::vector<Planner::ResourceHandle> writes;
+      for (uint32_t i = 0; i < resourceCount; ++i) {
+        const uint32_t roll = random() % 6;
+        if (roll == 0) {
+          reads.push_back(i);
+        } else if (roll == 1) {
+          writes.push_back(i);
+        }
+      }
+      planner.AddPass("P" + std::to_string(pass), reads, writes);
+    }
+    planner.Compile();
+
+    CHECK(planner.GetHeapSize() >= planner.GetPeakTransientBytes());
+    for (uint32_t a = 0; a < resourceCount; ++a) {
+      const auto& placement = planner.GetPlacement(a);
+      if (placement.FirstPass == Planner::kInvalidPass) {
+        continue;
+      }
+      CHECK_EQ(placement.HeapOffset % planner.GetResource(a).Alignment, 0u);
+      CHECK(placement.HeapOffset + planner.GetResource(a).SizeInBytes <=
+            planner.GetHeapSize());
+
+      bool hasPredecessor = false;
+      uint32_t bestRank = 0;
+      for (uint32_t b = 0; b < resourceCount; ++b) {
+        const auto& other = planner.GetPlacement(b);
+        if (b == a || other.FirstPass == Planner::kInvalidPass ||
+            !MemoryOverlaps(planner, a, b)) {
+          continue;
+        }
+        CHECK(!LifetimesOverlap(placement, other));
+        const uint32_t rank = other.LastPass < placement.FirstPass
+                                  ? other.LastPass + passCount
+                                  : other.LastPass;
+        if (!hasPredecessor || rank > bestRank) {
+          hasPredecessor = true;
+          bestRank = rank;
+        }
+      }
+      CHECK_EQ(placement.AliasedPredecessor != Planner::kNoResource,
+               hasPredecessor);
+      if (hasPredecessor && placement.AliasedPredecessor < resourceCount) {
+        const uint32_t lastPass =
+            planner.GetPlacement(placement.AliasedPredecessor).LastPass;
+        CHECK(MemoryOverlaps(planner, a, placement.AliasedPredecessor));
+        CHECK_EQ(lastPass < placement.FirstPass ? lastPass + passCount
+                                                : lastPass,
+                 bestRank);
+      }
+    }
+  }
+}
+
+// The frame as RenderingSystem::Render builds it, reduced to the
+// transient targets and the back buffer.
+struct FrameGraph {
+  RenderGraph Graph;
+  RenderGraph::ResourceHandle Targets[4] = {};
+  uint32_t Geometry = 0;
+  uint32_t Compose = 0;
+  uint32_t ParticleRender = 0;
+  uint32_t ParticleComposite = 0;
+  uint32_t DepthCopy = 0;
+};
+
+void BuildFrameGraph(FrameGraph& frame, const Planner& planner,
+                     bool useSplitBarriers) {
+  RenderGraph& graph = frame.Graph;
+  const auto srv = RenderGraph::kStatePixelShaderResource;
+  frame.Targets[kAlbedo] = graph.ImportResource("GBufferAlbedo", srv, srv);
+  frame.Targets[kNormal] = graph.ImportResource("GBufferNormal", srv, srv);
+  frame.Targets[kDepth] =
+      graph.ImportResource("Depth", RenderGraph::kStateDepthWrite,
+                           RenderGraph::kStateDepthWrite);
+  frame.Targets[kParticleColor] =
+      graph.ImportResource("ParticleColor", srv, srv);
+  const auto backBuffer = graph.ImportResource(
+      "BackBuffer", RenderGraph::kStatePresent, RenderGraph::kStatePresent);
+  for (uint32_t target = 0; target < 4; ++target) {
+    const auto predecessor = planner.GetPlacement(target).AliasedPredecessor;
+    if (predecessor != Planner::kNoResource) {
+      graph.SetAliasedPredecessor(frame.Targets[target],
+                                  frame.Targets[predecessor]);
+    }
+  }
+
+  const auto rt = RenderGraph::kStateRenderTarget;
+  frame.Geometry = graph.AddPass(
+      "Geometry", {{frame.Targets[kAlbedo], rt},
+                   {frame.Targets[kNormal], rt},
+                   {frame.Targets[kDepth], RenderGraph::kStateDepthWrite}});
+  frame.Compose = graph.AddPass(
+      "Compose", {{frame.Targets[kAlbedo], srv},
+                  {frame.Targets[kNormal], srv},
+                  {frame.Targets[kDepth], srv},
+                  {backBuffer, rt}});
+  frame.ParticleRender = graph.AddPass(
+      "ParticleRender",
+      {{frame.Targets[kDepth], RenderGraph::kStateDepthRead},
+       {frame.Targets[kParticleColor], rt}});
+  frame.ParticleComposite = graph.AddPass(
+      "ParticleComposite",
+      {{frame.Targets[kParticleColor], srv}, {backBuffer, rt}});
+  frame.DepthCopy = graph.AddPass(
+      "ParticleDepthCopy",
+      {{frame.Targets[kDepth], RenderGraph::kStateNonPixelShaderResource}});
+  graph.Compile(useSplitBarriers);
+}
+
+// Index of the first barrier in the batch of the given type and resource,
+// or -1.
+int FindBarrier(const std::vector<RenderGraph::Barrier>& barriers,
+                RenderGraph::BarrierType type,
+                RenderGraph::ResourceHandle resource) {
+  for (size_t i = 0; i < barriers.size(); ++i) {
+    if (barriers[i].Type == type && barriers[i].Resource == resource) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+void TestGraphIssuesAliasingBarriers() {
+  Planner planner;
+  BuildFramePlan(planner);
+  for (bool split : {false, true}) {
+    FrameGraph frame;
+    BuildFrameGraph(frame, planner, split);
+    const RenderGraph& graph = frame.Graph;
+
+    const auto& particleBatch =
+        graph.GetBarriersBeforePass(frame.ParticleRender);
+    const int aliasing =
+        FindBarrier(particleBatch, RenderGraph::BarrierType::Aliasing,
+                    frame.Targets[kParticleColor]);
+    const int transition =
+        FindBarrier(particleBatch, RenderGraph::BarrierType::Transition,
+                    frame.Targets[kParticleColor]);
+    CHECK(aliasing >= 0);
+    CHECK(transition > aliasing);
+    if (aliasing >= 0) {
+      CHECK_EQ(particleBatch[aliasing].AliasedResource,
+               frame.Targets[kNormal]);
+    }
+    if (transition >= 0) {
+      // The memory is the normal target's until the aliasing barrier, so
+      // the transition cannot start earlier.
+      CHECK(particleBatch[transition].Split ==
+            RenderGraph::BarrierSplit::None);
+      CHECK_EQ(particleBatch[transition].After,
+               RenderGraph::kStateRenderTarget);
+    }
+
+    const auto& geometryBatch = graph.GetBarriersBeforePass(frame.Geometry);
+    const int normalAliasing =
+        FindBarrier(geometryBatch, RenderGraph::BarrierType::Aliasing,
+                    frame.Targets[kNormal]);
+    CHECK(normalAliasing >= 0);
+    if (normalAliasing >= 0) {
+      CHECK_EQ(geometryBatch[normalAliasing].AliasedResource,
+               frame.Targets[kParticleColor]);
+    }
+    CHECK_EQ(FindBarrier(geometryBatch, RenderGraph::BarrierType::Aliasing,
+                         frame.Targets[kAlbedo]),
+             -1);
+
+    // Every aliasing barrier in the frame is one of the two above.
+    size_t aliasingCount = 0;
+    for (uint32_t pass = 0; pass < graph.GetPassCount(); ++pass) {
+      for (const auto& barrier : graph.GetBarriersBeforePass(pass)) {
+        if (barrier.Type == RenderGraph::BarrierType::Aliasing) {
+          ++aliasingCount;
+        }
+      }
+    }
+    CHECK_EQ(aliasingCount, 2u);
+
+    // Aliased targets end the frame where they were last used, so no
+    // barrier touches them after their memory changes hands. Only depth,
+    // which aliases nothing, and the back buffer are transitioned back.
+    const auto& finalBarriers = graph.GetFinalBarriers();
+    CHECK_EQ(finalBarriers.size(), 2u);
+    for (Target target : {kAlbedo, kNormal, kParticleColor}) {
+      CHECK_EQ(FindBarrier(finalBarriers,
+                           RenderGraph::BarrierType::Transition,
+                           frame.Targets[target]),
+               -1);
+    }
+  }
+}
+
+void TestAliasingOfUnusedResourceIsIgnored() {
+  RenderGraph graph;
+  const auto used = graph.ImportResource("Used", 0, 0);
+  const auto unused = graph.ImportResource("Unused", 0, 0);
+  graph.SetAliasedPredecessor(unused, used);
+  graph.AddPass("Only", {{used, RenderGraph::kStateRenderTarget}});
+  graph.Compile(true);
+  for (const auto& barrier : graph.GetBarriersBeforePass(0)) {
+    CHECK(barrier.Type != RenderGraph::BarrierType::Aliasing);
+  }
+}
+
+void TestInvalidAliasing() {
+  RenderGraph graph;
+  const auto a = graph.ImportResource("A", 0, 0);
+  CHECK_THROWS(graph.SetAliasedPredecessor(a, a), std::invalid_argument);
+  CHECK_THROWS(graph.SetAliasedPredecessor(a, a + 1), std::out_of_range);
+  CHECK_THROWS(graph.SetAliasedPredecessor(a + 1, a), std::out_of_range);
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestFramePlanReusesGBufferMemory);
+  RUN_TEST(TestUnusedResourceIsNotPlaced);
+  RUN_TEST(TestInvalidArguments);
+  RUN_TEST(TestRandomPlansKeepLiveResourcesApart);
+  RUN_TEST(TestGraphIssuesAliasingBarriers);
+  RUN_TEST(TestAliasingOfUnusedResourceIsIgnored);
+  RUN_TEST(TestInvalidAliasing);
+  return TestResult("TransientAliasingTest");
+}
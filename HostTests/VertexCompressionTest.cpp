@@ -0,0 +1,256 @@
+// The packed vertex format: half floats, octahedral normals and tangents,
+// and positions quantized in submesh bounds. UnpackVertex decodes like
+// DeferredGeometryVS.hlsl, so its errors are the ones the renderer sees.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+
+#include "TestCheck.h"
+#include "VertexCompression.h"
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+
+// binary16 decoded field by field, independently of HalfToFloat.
+double DecodeHalf(uint16_t value) {
+  const int exponent = (value >> 10) & 0x1f;
+  const int mantissa = value & 0x3ff;
+  const double sign = (value & 0x8000) ? -1.0 : 1.0;
+  if (exponent == 0) {
+    return sign * std::ldexp(mantissa, -24);
+  }
+  if (exponent == 31) {
+    return mantissa ? std::numeric_limits<double>::quiet_NaN()
+                    : sign * std::numeric_limits<double>::infinity();
+  }
+  return sign * std::ldexp(1024 + mantissa, exponent - 25);
+}
+
+bool IsHalfNaN(uint16_t value) {
+  return (value & 0x7c00) == 0x7c00 && (value & 0x3ff) != 0;
+}
+
+double Dot(const float a[3], const float b[3]) {
+  return static_cast<double>(a[0]) * b[0] + static_cast<double>(a[1]) * b[1] +
+         static_cast<double>(a[2]) * b[2];
+}
+
+double GetAngleDegrees(const float a[3], const float b[3]) {
+  const double cosine = Dot(a, b) / std::sqrt(Dot(a, a) * Dot(b, b));
+  return std::acos(std::fmin(std::fmax(cosine, -1.0), 1.0)) * 180.0 / kPi;
+}
+
+void Normalize(float v[3]) {
+  const double length = std::sqrt(Dot(v, v));
+  for (int i = 0; i < 3; ++i) {
+    v[i] = static_cast<float>(v[i] / length);
+  }
+}
+
+void TestHalfRoundTrip() {
+  // Every half decodes exactly and encodes back to itself; NaNs stay NaN.
+  for (uint32_t bits = 0; bits < 0x10000; ++bits) {
+    const uint16_t half = static_cast<uint16_t>(bits);
+    const float value = HalfToFloat(half);
+    if (IsHalfNaN(half)) {
+      CHECK(std::isnan(value));
+      CHECK(IsHalfNaN(FloatToHalf(value)));
+      continue;
+    }
+    CHECK_EQ(static_cast<double>(value), DecodeHalf(half));
+    CHECK_EQ(FloatToHalf(value), half);
+  }
+
+  // Round to nearest, ties to even, overflow to infinity.
+  CHECK_EQ(FloatToHalf(1.0f + std::ldexp(1.0f, -11)), 0x3c00);
+  CHECK_EQ(FloatToHalf(1.0f + 3 * std::ldexp(1.0f, -11)), 0x3c02);
+  CHECK_EQ(FloatToHalf(65504.0f), 0x7bff);
+  CHECK_EQ(FloatToHalf(65519.0f), 0x7bff);
+  CHECK_EQ(FloatToHalf(65520.0f), 0x7c00);
+  CHECK_EQ(FloatToHalf(-1e10f), 0xfc00);
+  CHECK_EQ(FloatToHalf(std::ldexp(1.0f, -24)), 0x0001);
+  CHECK_EQ(FloatToHalf(std::ldexp(1.0f, -25)), 0x0000);
+  CHECK_EQ(FloatToHalf(std::ldexp(1.5f, -25)), 0x0001);
+  CHECK_EQ(FloatToHalf(-0.0f), 0x8000);
+
+  // Any other float encodes to a nearest half.
+  std::mt19937 random(50);
+  for (int i = 0; i < 1000000; ++i) {
+    const uint32_t bits = static_cast<uint32_t>(random());
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    if (std::isnan(value) || std::fabs(value) >= 65520.0f) {
+      continue;
+    }
+    const uint16_t half = FloatToHalf(value);
+    const double error = std::fabs(DecodeHalf(half) - value);
+    const uint16_t magnitude = half & 0x7fff;
+    if (magnitude < 0x7bff) {
+      const uint16_t up = static_cast<uint16_t>(half + 1);
+      CHECK(error <= std::fabs(DecodeHalf(up) - value));
+    }
+    if (magnitude > 0) {
+      const uint16_t down = static_cast<uint16_t>(half - 1);
+      CHECK(error <= std::fabs(DecodeHalf(down) - value));
+    }
+  }
+}
+
+void TestNormalsAndTangents() {
+  const VertexPositionBounds bounds;
+  // The axes survive exactly.
+  const float axes[6][3] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                            {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+  for (const auto& axis : axes) {
+    UnpackedVertex vertex;
+    for (int i = 0; i < 3; ++i) {
+      vertex.Normal[i] = axis[i];
+    }
+    const UnpackedVertex decoded =
+        UnpackVertex(PackVertex(vertex, bounds), bounds);
+    for (int i = 0; i < 3; ++i) {
+      CHECK_EQ(decoded.Normal[i], axis[i]);
+    }
+  }
+
+  // 16-bit octahedral directions are within 0.004 degrees; 0.005 leaves
+  // room for float rounding. The bitangent keeps its handedness.
+  std::mt19937 random(50);
+  std::normal_distribution<float> gaussian;
+  double maxNormalError = 0.0;
+  double maxTangentError = 0.0;
+  int mirrored = 0;
+  for (int i = 0; i < 200000; ++i) {
+    UnpackedVertex vertex;
+    for (int k = 0; k < 3; ++k) {
+      vertex.Normal[k] = gaussian(random);
+      vertex.Tangent[k] = gaussian(random);
+    }
+    Normalize(vertex.Normal);
+    // Orthogonalize the tangent against the normal.
+    const double along = Dot(vertex.Tangent, vertex.Normal);
+    for (int k = 0; k < 3; ++k) {
+      vertex.Tangent[k] -= static_cast<float>(along * vertex.Normal[k]);
+    }
+    Normalize(vertex.Tangent);
+    const float sign = random() % 2 ? 1.0f : -1.0f;
+    const float* n = vertex.Normal;
+    const float* t = vertex.Tangent;
+    vertex.Bitangent[0] = (n[1] * t[2] - n[2] * t[1]) * sign;
+    vertex.Bitangent[1] = (n[2] * t[0] - n[0] * t[2]) * sign;
+    vertex.Bitangent[2] = (n[0] * t[1] - n[1] * t[0]) * sign;
+    mirrored += sign < 0.0f ? 1 : 0;
+
+    const UnpackedVertex decoded =
+        UnpackVertex(PackVertex(vertex, bounds), bounds);
+    CHECK(std::fabs(Dot(decoded.Normal, decoded.Normal) - 1.0) < 1e-5);
+    CHECK(std::fabs(Dot(decoded.Tangent, decoded.Tangent) - 1.0) < 1e-5);
+    maxNormalError = std::fmax(maxNormalError,
+                               GetAngleDegrees(vertex.Normal, decoded.Normal));
+    maxTangentError = std::fmax(
+        maxTangentError, GetAngleDegrees(vertex.Tangent, decoded.Tangent));
+    CHECK(GetAngleDegrees(vertex.Bitangent, decoded.Bitangent) < 0.2);
+  }
+  CHECK(maxNormalError < 0.005);
+  CHECK(maxTangentError < 0.005);
+  // The sampled errors come close to the bound, so it is not loose.
+  CHECK(maxNormalError > 0.003);
+  CHECK(mirrored > 1000);
+
+  // Zero-length directions fall back to +Y normals and +X tangents.
+  UnpackedVertex degenerate;
+  for (int i = 0; i < 3; ++i) {
+    degenerate.Normal[i] = 0.0f;
+    degenerate.Tangent[i] = 0.0f;
+  }
+  const UnpackedVertex decoded =
+      UnpackVertex(PackVertex(degenerate, bounds), bounds);
+  CHECK_EQ(decoded.Normal[1], 1.0f);
+  CHECK_EQ(decoded.Tangent[0], 1.0f);
+}
+
+void TestPositionQuantization() {
+  VertexPositionBounds bounds;
+  const float centers[3] = {10.0f, -3.0f, 0.5f};
+  const float extents[3] = {1500.0f, 2.0f, 0.0f};
+  for (int i = 0; i < 3; ++i) {
+    bounds.Center[i] = centers[i];
+    bounds.Extents[i] = extents[i];
+  }
+
+  // The error is at most half a step of each extent, plus float rounding
+  // of the decode; a zero extent stores its center exactly.
+  std::mt19937 random(50);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  double maxStepError = 0.0;
+  for (int i = 0; i < 200000; ++i) {
+    UnpackedVertex vertex;
+    for (int k = 0; k < 3; ++k) {
+      vertex.Pos[k] = centers[k] + extents[k] * unit(random);
+    }
+    const PackedVertex packed = PackVertex(vertex, bounds);
+    const UnpackedVertex decoded = UnpackVertex(packed, bounds);
+    for (int k = 0; k < 2; ++k) {
+      const double error =
+          std::fabs(static_cast<double>(decoded.Pos[k]) - vertex.Pos[k]) /
+          extents[k];
+      CHECK(error <= 0.5 * kPackedPositionStep + 1e-6);
+      maxStepError = std::fmax(maxStepError, error / kPackedPositionStep);
+    }
+    CHECK_EQ(packed.Pos[2], 0);
+    CHECK_EQ(decoded.Pos[2], centers[2]);
+  }
+  CHECK(maxStepError > 0.45);
+
+  // The corners are exact and positions outside the bounds clamp to them.
+  UnpackedVertex corner;
+  corner.Pos[0] = centers[0] + extents[0];
+  corner.Pos[1] = centers[1] - extents[1];
+  UnpackedVertex outside;
+  outside.Pos[0] = centers[0] + 2.0f * extents[0];
+  outside.Pos[1] = centers[1] - 2.0f * extents[1];
+  for (const UnpackedVertex& vertex : {corner, outside}) {
+    const PackedVertex packed = PackVertex(vertex, bounds);
+    CHECK_EQ(packed.Pos[0], 32767);
+    CHECK_EQ(packed.Pos[1], -32767);
+    const UnpackedVertex decoded = UnpackVertex(packed, bounds);
+    CHECK_EQ(decoded.Pos[0], corner.Pos[0]);
+    CHECK_EQ(decoded.Pos[1], corner.Pos[1]);
+  }
+  // D3D decodes -32768 as -1 like -32767.
+  PackedVertex lowest = PackVertex(corner, bounds);
+  lowest.Pos[1] = -32768;
+  CHECK_EQ(UnpackVertex(lowest, bounds).Pos[1], corner.Pos[1]);
+}
+
+void TestTextureCoordinates() {
+  // Half precision: a relative error of at most 2^-11 above the subnormal
+  // range, where the spacing is 2^-24 absolute.
+  std::mt19937 random(50);
+  std::uniform_real_distribution<float> range(-8.0f, 8.0f);
+  const VertexPositionBounds bounds;
+  for (int i = 0; i < 100000; ++i) {
+    UnpackedVertex vertex;
+    vertex.TexC[0] = range(random);
+    vertex.TexC[1] = range(random) * 1e-3f;
+    const UnpackedVertex decoded =
+        UnpackVertex(PackVertex(vertex, bounds), bounds);
+    for (int k = 0; k < 2; ++k) {
+      const double error = std::fabs(decoded.TexC[k] - vertex.TexC[k]);
+      CHECK(error <= std::fmax(std::fabs(vertex.TexC[k]) * std::ldexp(1.0, -11),
+                               std::ldexp(1.0, -25)));
+    }
+  }
+}
+}  // namespace
+
+int main() {
+  RUN_TEST(TestHalfRoundTrip);
+  RUN_TEST(TestNormalsAndTangents);
+  RUN_TEST(TestPositionQuantization);
+  RUN_TEST(TestTextureCoordinates);
+  return TestResult("VertexCompressionTest");
+}
@@ -0,0 +1,133 @@
+// Throughput of ParticleCpuSimulator, the CPU reference for the particle
+// compute passes.
+//
+//   ParticleBenchmark [--frames N] [--workers N] [CAPACITY...]
+//
+// For each pool capacity (16384, 262144 and 1048576 by default) four
+// emitters are set to keep most of the pool alive, the simulator runs until
+// the alive count settles, and then N frames of Step are timed at 60 Hz.
+// Reports the best and median Simulate time and the alive particles
+// simulated per millisecond at the median.
+// ParticleBenchmarkScalar is built with PARTICLE_CPU_NO_SIMD.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ParticleCpuSimulator.h"
+#include "ParticleEmitterSet.h"
+
+namespace {
+constexpr float kDeltaTime = 1.0f / 60.0f;
+constexpr uint32_t kEmitters = 4;
+// Frames run before timing; four seconds covers the longest lifetime.
+constexpr uint32_t kWarmupFrames = 240;
+
+struct Options {
+  uint32_t Frames = 120;
+  // 0 uses one worker per hardware thread.
+  uint32_t Workers = 0;
+  std::vector<uint32_t> Capacities;
+};
+
+Options ParseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--frames" && i + 1 < argc) {
+      options.Frames =
+          static_cast<uint32_t>(std::max(1, std::stoi(argv[++i])));
+    } else if (argument == "--workers" && i + 1 < argc) {
+      options.Workers =
+          static_cast<uint32_t>(std::max(0, std::stoi(argv[++i])));
+    } else if (argument.rfind("--", 0) == 0) {
+      throw std::invalid_argument(
+          "Usage: ParticleBenchmark [--frames N] [--workers N] "
+          "[CAPACITY...]");
+    } else {
+      options.Capacities.push_back(
+          static_cast<uint32_t>(std::max(1, std::stoi(argument))));
+    }
+  }
+  if (options.Capacities.empty()) {
+    options.Capacities = {16384, 262144, 1048576};
+  }
+  return options;
+}
+
+// Emitters spread over a 40 m square whose combined rate, at a mean
+// lifetime of two seconds, is the capacity: most of the pool stays alive and
+// every frame both spawns and retires particles.
+void AddEmitters(uint32_t capacity, ParticleEmitterSet& emitters) {
+  for (uint32_t i = 0; i < kEmitters; ++i) {
+    ParticleEmitterSet::EmitterDesc desc;
+    desc.Position = {-20.0f + 40.0f * (i % 2), 2.0f,
+                     -20.0f + 40.0f * (i / 2)};
+    desc.PositionExtent = {1.0f, 1.0f, 1.0f};
+    desc.SpawnRate = capacity / (2.0f * kEmitters);
+    desc.LifetimeMin = 1.0f;
+    desc.LifetimeMax = 3.0f;
+    desc.VelocityMean = {0.0f, 4.0f, 0.0f};
+    desc.VelocityExtent = {2.0f, 1.0f, 2.0f};
+    desc.SizeMin = 0.1f;
+    desc.SizeMax = 0.3f;
+    emitters.AddEmitter(desc);
+  }
+}
+
+void RunCapacity(uint32_t capacity, const Options& options) {
+  ParticleEmitterSet emitters;
+  AddEmitters(capacity, emitters);
+  ParticleCpuSimulator simulator(capacity, options.Workers);
+  std::vector<ParticleEmitterSet::GpuRecord> records;
+  const auto step = [&]() {
+    const uint32_t spawnCount = emitters.BuildSpawnBatch(
+        kDeltaTime, simulator.GetDeadCount(), records);
+    simulator.Step(kDeltaTime, records, spawnCount);
+  };
+
+  for (uint32_t frame = 0; frame < kWarmupFrames; ++frame) {
+    step();
+  }
+
+  std::vector<double> simulateMs;
+  uint64_t aliveTotal = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t frame = 0; frame < options.Frames; ++frame) {
+    step();
+    simulateMs.push_back(simulator.GetLastSimulateMs());
+    aliveTotal += simulator.GetAliveList().size();
+  }
+  const double stepMs = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count() /
+                        options.Frames;
+
+  std::sort(simulateMs.begin(), simulateMs.end());
+  const double bestMs = simulateMs.front();
+  const double medianMs = simulateMs[simulateMs.size() / 2];
+  const double alive = static_cast<double>(aliveTotal) / options.Frames;
+  std::printf(
+      "%8u slots %3u workers: %8.0f alive, simulate best %7.3f ms median "
+      "%7.3f ms, step %7.3f ms, %9.0f particles/ms\n",
+      capacity, simulator.GetWorkerCount(), alive, bestMs, medianMs, stepMs,
+      medianMs > 0.0 ? alive / medianMs : 0.0);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  try {
+    const Options options = ParseOptions(argc, argv);
+    for (uint32_t capacity : options.Capacities) {
+      RunCapacity(capacity, options);
+    }
+  } catch (const std::exception& error) {
+    std::fprintf(stderr, "%s\n", error.what());
+    return 1;
+  }
+  return 0;
+}
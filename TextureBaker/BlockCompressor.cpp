@@ -0,0 +1,509 @@
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+constexpr int kBlockPixels = 16;
+
+// One 4x4 block, one array per channel, values 0-255.
+struct Block {
+  float Channels[4][kBlockPixels];
+};
+
+Block LoadBlock(const uint8_t* rgba) {
+  Block block;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      block.Channels[c][i] = rgba[i * 4 + c];
+    }
+  }
+  return block;
+}
+
+// Mean and principal axis of the first channelCount channels, found by power
+// iteration on the covariance matrix. A block without variance leaves axis
+// untouched.
+void FindPrincipalAxis(const Block& block, int channelCount, float* mean,
+                       float* axis) {
+  for (int c = 0; c < channelCount; ++c) {
+    float sum = 0.0f;
+    for (int i = 0; i < kBlockPixels; ++i) {
+      sum += block.Channels[c][i];
+    }
+    mean[c] = sum / kBlockPixels;
+  }
+  float covariance[4][4] = {};
+  for (int a = 0; a < channelCount; ++a) {
+    for (int b = a; b < channelCount; ++b) {
+      float sum = 0.0f;
+      for (int i = 0; i < kBlockPixels; ++i) {
+        sum += (block.Channels[a][i] - mean[a]) *
+               (block.Channels[b][i] - mean[b]);
+      }
+      covariance[a][b] = covariance[b][a] = sum;
+    }
+  }
+  // Starting from the column of the most varying channel keeps the start
+  // from being orthogonal to the axis, as an all-ones start is when two
+  // channels move against each other.
+  int seed = 0;
+  for (int c = 1; c < channelCount; ++c) {
+    if (covariance[c][c] > covariance[seed][seed]) {
+      seed = c;
+    }
+  }
+  if (covariance[seed][seed] < 1e-6f) {
+    return;
+  }
+  for (int c = 0; c < channelCount; ++c) {
+    axis[c] = covariance[c][seed] / covariance[seed][seed];
+  }
+  for (int iteration = 0; iteration < 8; ++iteration) {
+    float next[4] = {};
+    float length = 0.0f;
+    for (int a = 0; a < channelCount; ++a) {
+      for (int b = 0; b < channelCount; ++b) {
+        next[a] += covariance[a][b] * axis[b];
+      }
+      length = std::max(length, std::fabs(next[a]));
+    }
+    if (length < 1e-6f) {
+      return;
+    }
+    for (int c = 0; c < channelCount; ++c) {
+      axis[c] = next[c] / length;
+    }
+  }
+}
+
+// Endpoints at the extreme projections of the block onto its principal axis.
+void FitEndpointsToAxis(const Block& block, int channelCount, float* low,
+                        float* high) {
+  float mean[4] = {};
+  float axis[4] = {};
+  FindPrincipalAxis(block, channelCount, mean, axis);
+  float axisLength = 0.0f;
+  for (int c = 0; c < channelCount; ++c) {
+    axisLength += axis[c] * axis[c];
+  }
+  float minT = 0.0f;
+  float maxT = 0.0f;
+  if (axisLength > 0.0f) {
+    minT = std::numeric_limits<float>::max();
+    maxT = -minT;
+    for (int i = 0; i < kBlockPixels; ++i) {
+      float t = 0.0f;
+      for (int c = 0; c < channelCount; ++c) {
+        t += (block.Channels[c][i] - mean[c]) * axis[c];
+      }
+      minT = std::min(minT, t);
+      maxT = std::max(maxT, t);
+    }
+    minT /= axisLength;
+    maxT /= axisLength;
+  }
+  for (int c = 0; c < channelCount; ++c) {
+    low[c] = std::min(std::max(mean[c] + minT * axis[c], 0.0f), 255.0f);
+    high[c] = std::min(std::max(mean[c] + maxT * axis[c], 0.0f), 255.0f);
+  }
+}
+
+// Least-squares endpoints for fixed indices, where pixel i is reconstructed
+// as weights[indices[i]] * first + (1 - weights[indices[i]]) * second.
+// Returns false if the indices do not determine both endpoints.
+bool FitEndpointsToIndices(const Block& block, int channelCount,
+                           const uint8_t* indices, const float* weights,
+                           float* first, float* second) {
+  float aa = 0.0f;
+  float ab = 0.0f;
+  float bb = 0.0f;
+  float ax[4] = {};
+  float bx[4] = {};
+  for (int i = 0; i < kBlockPixels; ++i) {
+    const float a = weights[indices[i]];
+    const float b = 1.0f - a;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (int c = 0; c < channelCount; ++c) {
+      ax[c] += a * block.Channels[c][i];
+      bx[c] += b * block.Channels[c][i];
+    }
+  }
+  const float determinant = aa * bb - ab * ab;
+  if (std::fabs(determinant) < 1e-6f) {
+    return false;
+  }
+  for (int c = 0; c < channelCount; ++c) {
+    first[c] = std::min(
+        std::max((bb * ax[c] - ab * bx[c]) / determinant, 0.0f), 255.0f);
+    second[c] = std::min(
+        std::max((aa * bx[c] - ab * ax[c]) / determinant, 0.0f), 255.0f);
+  }
+  return true;
+}
+
+// Picks the nearest of paletteSize colors for every pixel and returns the
+// total squared error.
+float AssignIndices(const Block& block, int channelCount,
+                    const float (*palette)[4], int paletteSize,
+                    uint8_t* indices) {
+  float bestErrors[kBlockPixels];
+  std::fill(bestErrors, bestErrors + kBlockPixels,
+            std::numeric_limits<float>::max());
+  std::fill(indices, indices + kBlockPixels, 0);
+  for (int p = 0; p < paletteSize; ++p) {
+    for (int i = 0; i < kBlockPixels; ++i) {
+      float error = 0.0f;
+      for (int c = 0; c < channelCount; ++c) {
+        const float d = block.Channels[c][i] - palette[p][c];
+        error += d * d;
+      }
+      if (error < bestErrors[i]) {
+        bestErrors[i] = error;
+        indices[i] = static_cast<uint8_t>(p);
+      }
+    }
+  }
+  float total = 0.0f;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    total += bestErrors[i];
+  }
+  return total;
+}
+
+// Writes little-endian bit fields, least significant bit first.
+class BitWriter {
+ public:
+  BitWriter(uint8_t* out, size_t bytes) : mOut(out) {
+    std::memset(out, 0, bytes);
+  }
+  void Write(uint32_t value, int bits) {
+    for (int i = 0; i < bits; ++i, ++mPosition) {
+      if (value & (1u << i)) {
+        mOut[mPosition / 8] |= static_cast<uint8_t>(1u << (mPosition % 8));
+      }
+    }
+  }
+
+ private:
+  uint8_t* mOut;
+  size_t mPosition = 0;
+};
+
+// --- BC1 color ---------------------------------------------------------------
+
+uint16_t PackRgb565(const float* color) {
+  const auto quantize = [](float value, int max) {
+    return static_cast<uint32_t>(
+        std::lround(std::min(std::max(value, 0.0f), 255.0f) * max / 255.0f));
+  };
+  return static_cast<uint16_t>((quantize(color[0], 31) << 11) |
+                               (quantize(color[1], 63) << 5) |
+                               quantize(color[2], 31));
+}
+
+void UnpackRgb565(uint16_t packed, float* color) {
+  const uint32_t r = (packed >> 11) & 31;
+  const uint32_t g = (packed >> 5) & 63;
+  const uint32_t b = packed & 31;
+  color[0] = static_cast<float>((r << 3) | (r >> 2));
+  color[1] = static_cast<float>((g << 2) | (g >> 4));
+  color[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+// Weight of the first endpoint for each 4-color BC1 index.
+constexpr float kBC1Weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+
+struct ColorCandidate {
+  uint16_t Color0 = 0;
+  uint16_t Color1 = 0;
+  uint8_t Indices[kBlockPixels] = {};
+  float Error = std::numeric_limits<float>::max();
+};
+
+// Always uses the 4-color mode (color0 > color1), which is also how BC3
+// interprets its color block.
+ColorCandidate EvaluateColorEndpoints(const Block& block, const float* first,
+                                      const float* second) {
+  ColorCandidate candidate;
+  candidate.Color0 = PackRgb565(first);
+  candidate.Color1 = PackRgb565(second);
+  if (candidate.Color0 < candidate.Color1) {
+    std::swap(candidate.Color0, candidate.Color1);
+  }
+  float palette[4][4] = {};
+  UnpackRgb565(candidate.Color0, palette[0]);
+  UnpackRgb565(candidate.Color1, palette[1]);
+  for (int c = 0; c < 3; ++c) {
+    palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+    palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+  }
+  // Equal endpoints select the 3-color mode, where index 3 is black.
+  const int paletteSize = candidate.Color0 == candidate.Color1 ? 1 : 4;
+  candidate.Error =
+      AssignIndices(block, 3, palette, paletteSize, candidate.Indices);
+  return candidate;
+}
+
+void EncodeColor(const Block& block, uint8_t* out) {
+  float low[4] = {};
+  float high[4] = {};
+  FitEndpointsToAxis(block, 3, low, high);
+  ColorCandidate best = EvaluateColorEndpoints(block, high, low);
+  for (int iteration = 0; iteration < 2 && best.Color0 != best.Color1;
+       ++iteration) {
+    float first[4] = {};
+    float second[4] = {};
+    if (!FitEndpointsToIndices(block, 3, best.Indices, kBC1Weights, first,
+                               second)) {
+      break;
+    }
+    const ColorCandidate refined =
+        EvaluateColorEndpoints(block, first, second);
+    if (refined.Error >= best.Error) {
+      break;
+    }
+    best = refined;
+  }
+
+  BitWriter writer(out, 8);
+  writer.Write(best.Color0, 16);
+  writer.Write(best.Color1, 16);
+  for (int i = 0; i < kBlockPixels; ++i) {
+    writer.Write(best.Indices[i], 2);
+  }
+}
+
+// --- BC4 channel (BC3 alpha, BC5) --------------------------------------------
+
+void EncodeChannel(const float* values, uint8_t* out) {
+  float low = 255.0f;
+  float high = 0.0f;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    low = std::min(low, values[i]);
+    high = std::max(high, values[i]);
+  }
+  const int value0 = static_cast<int>(std::lround(high));
+  const int value1 = static_cast<int>(std::lround(low));
+
+  uint8_t indices[kBlockPixels] = {};
+  if (value0 > value1) {
+    // 8-value mode: index 0 and 1 are the endpoints, 2-7 interpolate.
+    Block block;
+    std::copy(values, values + kBlockPixels, block.Channels[0]);
+    float palette[8][4] = {};
+    palette[0][0] = static_cast<float>(value0);
+    palette[1][0] = static_cast<float>(value1);
+    for (int i = 1; i < 7; ++i) {
+      palette[i + 1][0] =
+          static_cast<float>(((7 - i) * value0 + i * value1) / 7);
+    }
+    AssignIndices(block, 1, palette, 8, indices);
+  }
+
+  BitWriter writer(out, 8);
+  writer.Write(static_cast<uint32_t>(value0), 8);
+  writer.Write(static_cast<uint32_t>(value1), 8);
+  for (int i = 0; i < kBlockPixels; ++i) {
+    writer.Write(indices[i], 3);
+  }
+}
+
+// --- BC7 mode 6 --------------------------------------------------------------
+
+constexpr int kBC7Weights[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Bc7Endpoint {
+  uint8_t Values[4] = {};  // 7 bits each.
+  uint8_t PBit = 0;
+  int Expanded(int channel) const { return (Values[channel] << 1) | PBit; }
+};
+
+// Chooses the p-bit that reproduces color best; opaque blocks force p-bit 1
+// so alpha decodes as exactly 255.
+Bc7Endpoint QuantizeBc7Endpoint(const float* color, bool opaque) {
+  Bc7Endpoint best;
+  float bestError = std::numeric_limits<float>::max();
+  for (uint8_t pBit = opaque ? 1 : 0; pBit < 2; ++pBit) {
+    Bc7Endpoint endpoint;
+    endpoint.PBit = pBit;
+    float error = 0.0f;
+    for (int c = 0; c < 4; ++c) {
+      const long value = std::lround((color[c] - pBit) / 2.0f);
+      endpoint.Values[c] =
+          static_cast<uint8_t>(std::min(std::max(value, 0l), 127l));
+      const float d = endpoint.Expanded(c) - color[c];
+      error += d * d;
+    }
+    if (error < bestError) {
+      bestError = error;
+      best = endpoint;
+    }
+  }
+  return best;
+}
+
+struct Bc7Candidate {
+  Bc7Endpoint Endpoints[2];
+  uint8_t Indices[kBlockPixels] = {};
+  float Error = std::numeric_limits<float>::max();
+};
+
+Bc7Candidate EvaluateBc7Endpoints(const Block& block, const float* first,
+                                  const float* second, bool opaque) {
+  Bc7Candidate candidate;
+  candidate.Endpoints[0] = QuantizeBc7Endpoint(first, opaque);
+  candidate.Endpoints[1] = QuantizeBc7Endpoint(second, opaque);
+  float palette[16][4] = {};
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      palette[i][c] = static_cast<float>(
+          ((64 - kBC7Weights[i]) * candidate.Endpoints[0].Expanded(c) +
+           kBC7Weights[i] * candidate.Endpoints[1].Expanded(c) + 32) >>
+          6);
+    }
+  }
+  candidate.Error = AssignIndices(block, 4, palette, 16, candidate.Indices);
+  return candidate;
+}
+
+// --- Parallel surface encoding -----------------------------------------------
+
+using BlockEncoder = void (*)(const uint8_t*, uint8_t*);
+
+BlockEncoder GetEncoder(BlockFormat format) {
+  switch (format) {
+    case BlockFormat::kBC1:
+      return EncodeBC1Block;
+    case BlockFormat::kBC3:
+      return EncodeBC3Block;
+    case BlockFormat::kBC5:
+      return EncodeBC5Block;
+    case BlockFormat::kBC7:
+      return EncodeBC7Block;
+  }
+  throw std::invalid_argument("Unknown block format");
+}
+}  // namespace
+
+uint32_t GetBlockBytes(BlockFormat format) {
+  return format == BlockFormat::kBC1 ? 8 : 16;
+}
+
+void EncodeBC1Block(const uint8_t* rgba, uint8_t* out) {
+  EncodeColor(LoadBlock(rgba), out);
+}
+
+void EncodeBC3Block(const uint8_t* rgba, uint8_t* out) {
+  const Block block = LoadBlock(rgba);
+  EncodeChannel(block.Channels[3], out);
+  EncodeColor(block, out + 8);
+}
+
+void EncodeBC5Block(const uint8_t* rgba, uint8_t* out) {
+  const Block block = LoadBlock(rgba);
+  EncodeChannel(block.Channels[0], out);
+  EncodeChannel(block.Channels[1], out + 8);
+}
+
+void EncodeBC7Block(const uint8_t* rgba, uint8_t* out) {
+  const Block block = LoadBlock(rgba);
+  bool opaque = true;
+  for (int i = 0; i < kBlockPixels; ++i) {
+    opaque = opaque && block.Channels[3][i] == 255.0f;
+  }
+
+  float low[4] = {};
+  float high[4] = {};
+  FitEndpointsToAxis(block, 4, low, high);
+  Bc7Candidate best = EvaluateBc7Endpoints(block, low, high, opaque);
+  float weights[16];
+  for (int i = 0; i < 16; ++i) {
+    weights[i] = (64 - kBC7Weights[i]) / 64.0f;
+  }
+  for (int iteration = 0; iteration < 2; ++iteration) {
+    float first[4] = {};
+    float second[4] = {};
+    if (!FitEndpointsToIndices(block, 4, best.Indices, weights, first,
+                               second)) {
+      break;
+    }
+    const Bc7Candidate refined =
+        EvaluateBc7Endpoints(block, first, second, opaque);
+    if (refined.Error >= best.Error) {
+      break;
+    }
+    best = refined;
+  }
+
+  // The anchor index is stored without its top bit.
+  if (best.Indices[0] & 8) {
+    std::swap(best.Endpoints[0], best.Endpoints[1]);
+    for (uint8_t& index : best.Indices) {
+      index = static_cast<uint8_t>(15 - index);
+    }
+  }
+
+  BitWriter writer(out, 16);
+  writer.Write(1u << 6, 7);
+  for (int c = 0; c < 4; ++c) {
+    writer.Write(best.Endpoints[0].Values[c], 7);
+    writer.Write(best.Endpoints[1].Values[c], 7);
+  }
+  writer.Write(best.Endpoints[0].PBit, 1);
+  writer.Write(best.Endpoints[1].PBit, 1);
+  writer.Write(best.Indices[0], 3);
+  for (int i = 1; i < kBlockPixels; ++i) {
+    writer.Write(best.Indices[i], 4);
+  }
+}
+
+std::vector<uint8_t> CompressImage(const RgbaImage& image, BlockFormat format,
+                                   unsigned workerCount) {
+  const BlockEncoder encode = GetEncoder(format);
+  const uint32_t blockBytes = GetBlockBytes(format);
+  const uint32_t blocksX = (image.Width + 3) / 4;
+  const uint32_t blocksY = (image.Height + 3) / 4;
+  std::vector<uint8_t> result(static_cast<size_t>(blocksX) * blocksY *
+                              blockBytes);
+
+  std::atomic<uint32_t> nextRow{0};
+  const auto work = [&]() {
+    uint8_t pixels[kBlockPixels * 4];
+    for (uint32_t row = nextRow++; row < blocksY; row = nextRow++) {
+      for (uint32_t column = 0; column < blocksX; ++column) {
+        for (uint32_t y = 0; y < 4; ++y) {
+          const uint32_t sourceY = std::min(row * 4 + y, image.Height - 1);
+          for (uint32_t x = 0; x < 4; ++x) {
+            const uint32_t sourceX =
+                std::min(column * 4 + x, image.Width - 1);
+            std::memcpy(&pixels[(y * 4 + x) * 4],
+                        image.GetPixel(sourceX, sourceY), 4);
+          }
+        }
+        encode(pixels, &result[(static_cast<size_t>(row) * blocksX + column) *
+                               blockBytes]);
+      }
+    }
+  };
+
+  const unsigned threadCount =
+      std::max(1u, std::min<unsigned>(workerCount, blocksY));
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < threadCount; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return result;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "RgbaImage.h"
+
+enum class BlockFormat {
+  // Opaque RGB, 4 bpp.
+  kBC1,
+  // RGB as BC1 plus interpolated alpha, 8 bpp.
+  kBC3,
+  // Two interpolated channels (R and G), 8 bpp. Used for normal maps.
+  kBC5,
+  // RGBA in BC7 mode 6: one subset, 7-bit endpoints with a p-bit and 4-bit
+  // indices, 8 bpp.
+  kBC7,
+};
+
+uint32_t GetBlockBytes(BlockFormat format);
+
+// Each takes the 16 pixels of a 4x4 block as RGBA bytes, row by row, and
+// writes GetBlockBytes() bytes. Pixels are kept in per-channel arrays of
+// 16 floats and every search loops over all 16 lanes, so the compiler can
+// vectorize them.
+void EncodeBC1Block(const uint8_t* rgba, uint8_t* out);
+void EncodeBC3Block(const uint8_t* rgba, uint8_t* out);
+void EncodeBC5Block(const uint8_t* rgba, uint8_t* out);
+void EncodeBC7Block(const uint8_t* rgba, uint8_t* out);
+
+// Compresses image into rows of blocks; partial edge blocks repeat the last
+// row and column. Block rows are spread over workerCount threads.
+std::vector<uint8_t> CompressImage(const RgbaImage& image, BlockFormat format,
+                                   unsigned workerCount);
@@ -0,0 +1,99 @@
+#include "DdsWriter.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+constexpr uint32_t kDdsMagic = 0x20534444;  // "DDS "
+constexpr uint32_t kDx10FourCc = 0x30315844;  // "DX10"
+constexpr uint32_t kHeaderSize = 124;
+constexpr uint32_t kPixelFormatSize = 32;
+
+// DDS_HEADER flags.
+constexpr uint32_t kFlagCaps = 0x1;
+constexpr uint32_t kFlagHeight = 0x2;
+constexpr uint32_t kFlagWidth = 0x4;
+constexpr uint32_t kFlagPixelFormat = 0x1000;
+constexpr uint32_t kFlagMipMapCount = 0x20000;
+constexpr uint32_t kFlagLinearSize = 0x80000;
+constexpr uint32_t kPixelFormatFourCc = 0x4;
+constexpr uint32_t kCapsComplex = 0x8;
+constexpr uint32_t kCapsTexture = 0x1000;
+constexpr uint32_t kCapsMipMap = 0x400000;
+constexpr uint32_t kDimensionTexture2D = 3;
+
+// DXGI_FORMAT values.
+uint32_t GetDxgiFormat(BlockFormat format, bool srgb) {
+  switch (format) {
+    case BlockFormat::kBC1:
+      return srgb ? 72 : 71;
+    case BlockFormat::kBC3:
+      return srgb ? 78 : 77;
+    case BlockFormat::kBC5:
+      return 83;  // No sRGB variant.
+    case BlockFormat::kBC7:
+      return srgb ? 99 : 98;
+  }
+  throw std::invalid_argument("Unknown block format");
+}
+
+void WriteUint32(std::vector<uint8_t>& out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+}  // namespace
+
+std::vector<uint8_t> BuildDds(uint32_t width, uint32_t height,
+                              BlockFormat format, bool srgb,
+                              const std::vector<std::vector<uint8_t>>& mips) {
+  if (mips.empty()) {
+    throw std::invalid_argument("DDS needs at least one mip");
+  }
+  const uint32_t mipCount = static_cast<uint32_t>(mips.size());
+  std::vector<uint8_t> out;
+  WriteUint32(out, kDdsMagic);
+
+  WriteUint32(out, kHeaderSize);
+  WriteUint32(out, kFlagCaps | kFlagHeight | kFlagWidth | kFlagPixelFormat |
+                       kFlagLinearSize | (mipCount > 1 ? kFlagMipMapCount : 0));
+  WriteUint32(out, height);
+  WriteUint32(out, width);
+  WriteUint32(out, static_cast<uint32_t>(mips[0].size()));
+  WriteUint32(out, 0);  // Depth.
+  WriteUint32(out, mipCount);
+  for (int i = 0; i < 11; ++i) {
+    WriteUint32(out, 0);
+  }
+  WriteUint32(out, kPixelFormatSize);
+  WriteUint32(out, kPixelFormatFourCc);
+  WriteUint32(out, kDx10FourCc);
+  for (int i = 0; i < 5; ++i) {
+    WriteUint32(out, 0);  // Bit count and masks.
+  }
+  WriteUint32(out, kCapsTexture |
+                       (mipCount > 1 ? kCapsComplex | kCapsMipMap : 0));
+  for (int i = 0; i < 4; ++i) {
+    WriteUint32(out, 0);  // Caps2-4, reserved.
+  }
+
+  WriteUint32(out, GetDxgiFormat(format, srgb));
+  WriteUint32(out, kDimensionTexture2D);
+  WriteUint32(out, 0);  // Misc flags.
+  WriteUint32(out, 1);  // Array size.
+  WriteUint32(out, 0);  // Alpha mode unknown.
+
+  for (const std::vector<uint8_t>& mip : mips) {
+    out.insert(out.end(), mip.begin(), mip.end());
+  }
+  return out;
+}
+
+void WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+  if (!file) {
+    throw std::runtime_error("Cannot write " + path);
+  }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BlockCompressor.h"
+
+// Builds a 2D DDS file with the "DX10" header extension, which is the only
+// way to store BC7 and the sRGB formats. mips holds the compressed levels,
+// largest first.
+std::vector<uint8_t> BuildDds(uint32_t width, uint32_t height,
+                              BlockFormat format, bool srgb,
+                              const std::vector<std::vector<uint8_t>>& mips);
+void WriteFile(const std::string& path, const std::vector<uint8_t>& data);
@@ -0,0 +1,176 @@
+#include "MipChain.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+// Four floats per texel, rows top to bottom.
+struct FloatImage {
+  uint32_t Width = 0;
+  uint32_t Height = 0;
+  std::vector<float> Texels;
+};
+
+struct Tap {
+  uint32_t Source = 0;
+  float Weight = 0.0f;
+};
+
+float SrgbToLinear(float value) {
+  return value <= 0.04045f ? value / 12.92f
+                           : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float LinearToSrgb(float value) {
+  return value <= 0.0031308f ? value * 12.92f
+                             : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+uint8_t ToUnorm8(float value) {
+  return static_cast<uint8_t>(
+      std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+// Source texels covering each of dstSize texels when srcSize texels are
+// shrunk to dstSize, weighted by overlap; weights of a texel sum to 1.
+std::vector<std::vector<Tap>> BuildTaps(uint32_t srcSize, uint32_t dstSize) {
+  std::vector<std::vector<Tap>> taps(dstSize);
+  const double scale = static_cast<double>(srcSize) / dstSize;
+  for (uint32_t i = 0; i < dstSize; ++i) {
+    const double begin = i * scale;
+    const double end = (i + 1) * scale;
+    for (uint32_t s = static_cast<uint32_t>(begin);
+         s < srcSize && s < end; ++s) {
+      const double overlap =
+          std::min<double>(end, s + 1) - std::max<double>(begin, s);
+      if (overlap > 0.0) {
+        taps[i].push_back({s, static_cast<float>(overlap / scale)});
+      }
+    }
+  }
+  return taps;
+}
+
+FloatImage Downsample(const FloatImage& src) {
+  FloatImage dst;
+  dst.Width = std::max(src.Width / 2, 1u);
+  dst.Height = std::max(src.Height / 2, 1u);
+  const auto xTaps = BuildTaps(src.Width, dst.Width);
+  const auto yTaps = BuildTaps(src.Height, dst.Height);
+
+  // Horizontal pass into rows of the source height, then vertical.
+  std::vector<float> rows(static_cast<size_t>(dst.Width) * src.Height * 4);
+  for (uint32_t y = 0; y < src.Height; ++y) {
+    for (uint32_t x = 0; x < dst.Width; ++x) {
+      std::array<float, 4> sum = {};
+      for (const Tap& tap : xTaps[x]) {
+        const float* texel =
+            &src.Texels[(static_cast<size_t>(y) * src.Width + tap.Source) * 4];
+        for (int c = 0; c < 4; ++c) {
+          sum[c] += texel[c] * tap.Weight;
+        }
+      }
+      std::copy(sum.begin(), sum.end(),
+                &rows[(static_cast<size_t>(y) * dst.Width + x) * 4]);
+    }
+  }
+
+  dst.Texels.resize(static_cast<size_t>(dst.Width) * dst.Height * 4);
+  for (uint32_t y = 0; y < dst.Height; ++y) {
+    for (uint32_t x = 0; x < dst.Width; ++x) {
+      std::array<float, 4> sum = {};
+      for (const Tap& tap : yTaps[y]) {
+        const float* texel =
+            &rows[(static_cast<size_t>(tap.Source) * dst.Width + x) * 4];
+        for (int c = 0; c < 4; ++c) {
+          sum[c] += texel[c] * tap.Weight;
+        }
+      }
+      std::copy(sum.begin(), sum.end(),
+                &dst.Texels[(static_cast<size_t>(y) * dst.Width + x) * 4]);
+    }
+  }
+  return dst;
+}
+
+FloatImage Decode(const RgbaImage& image, TextureUsage usage) {
+  std::array<float, 256> srgbToLinear;
+  for (int i = 0; i < 256; ++i) {
+    srgbToLinear[i] = SrgbToLinear(i / 255.0f);
+  }
+
+  FloatImage result;
+  result.Width = image.Width;
+  result.Height = image.Height;
+  result.Texels.resize(image.Pixels.size());
+  for (size_t i = 0; i < image.Pixels.size(); i += 4) {
+    for (int c = 0; c < 3; ++c) {
+      const uint8_t value = image.Pixels[i + c];
+      switch (usage) {
+        case TextureUsage::kColor:
+          result.Texels[i + c] = srgbToLinear[value];
+          break;
+        case TextureUsage::kNormalMap:
+          result.Texels[i + c] = value / 127.5f - 1.0f;
+          break;
+        case TextureUsage::kLinear:
+          result.Texels[i + c] = value / 255.0f;
+          break;
+      }
+    }
+    result.Texels[i + 3] = image.Pixels[i + 3] / 255.0f;
+  }
+  return result;
+}
+
+RgbaImage Encode(const FloatImage& image, TextureUsage usage) {
+  RgbaImage result;
+  result.Width = image.Width;
+  result.Height = image.Height;
+  result.Pixels.resize(image.Texels.size());
+  for (size_t i = 0; i < image.Texels.size(); i += 4) {
+    std::array<float, 3> rgb = {image.Texels[i], image.Texels[i + 1],
+                                image.Texels[i + 2]};
+    if (usage == TextureUsage::kNormalMap) {
+      // Averaging shortens the vectors.
+      const float length =
+          std::sqrt(rgb[0] * rgb[0] + rgb[1] * rgb[1] + rgb[2] * rgb[2]);
+      for (float& value : rgb) {
+        value = length > 1e-6f ? value / length : 0.0f;
+      }
+      if (length <= 1e-6f) {
+        rgb[2] = 1.0f;
+      }
+    }
+    for (int c = 0; c < 3; ++c) {
+      switch (usage) {
+        case TextureUsage::kColor:
+          result.Pixels[i + c] = ToUnorm8(LinearToSrgb(rgb[c]));
+          break;
+        case TextureUsage::kNormalMap:
+          result.Pixels[i + c] = ToUnorm8(rgb[c] * 0.5f + 0.5f);
+          break;
+        case TextureUsage::kLinear:
+          result.Pixels[i + c] = ToUnorm8(rgb[c]);
+          break;
+      }
+    }
+    result.Pixels[i + 3] = ToUnorm8(image.Texels[i + 3]);
+  }
+  return result;
+}
+}  // namespace
+
+std::vector<RgbaImage> BuildMipChain(const RgbaImage& image,
+                                     TextureUsage usage) {
+  std::vector<RgbaImage> chain;
+  chain.push_back(image);
+  FloatImage level = Decode(image, usage);
+  while (level.Width > 1 || level.Height > 1) {
+    level = Downsample(level);
+    chain.push_back(Encode(level, usage));
+  }
+  return chain;
+}
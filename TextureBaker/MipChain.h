@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+#include "RgbaImage.h"
+
+enum class TextureUsage {
+  // sRGB-encoded color; filtered in linear light. Alpha is linear.
+  kColor,
+  // Tangent-space normals in RGB; filtered as vectors and renormalized.
+  kNormalMap,
+  // Any other data, such as masks; filtered as stored.
+  kLinear,
+};
+
+// Returns the full mip chain down to 1x1, with image as mip 0. Each level
+// halves the previous one (rounding down, at least 1) with an area-weighted
+// box filter, so odd sizes are resampled rather than truncated. Levels are
+// computed from the previous level's unquantized values.
+std::vector<RgbaImage> BuildMipChain(const RgbaImage& image,
+                                     TextureUsage usage);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 8-bit RGBA pixels, rows top to bottom with no padding.
+struct RgbaImage {
+  uint32_t Width = 0;
+  uint32_t Height = 0;
+  std::vector<uint8_t> Pixels;
+
+  const uint8_t* GetPixel(uint32_t x, uint32_t y) const {
+    return Pixels.data() + (static_cast<size_t>(y) * Width + x) * 4;
+  }
+  bool HasTranslucency() const {
+    for (size_t i = 3; i < Pixels.size(); i += 4) {
+      if (Pixels[i] != 255) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
@@ -0,0 +1,199 @@
+// Bakes the TGA textures under textures/ into the DDS files LoadAllTextures
+// expects: full mip chains compressed to BC1/BC3/BC5/BC7 by usage.
+//
+//   TextureBaker [--high-quality] [--srgb] [--threads N] <output-dir>
+//                <file.tga | directory>...
+//
+// Normal maps (*_ddn) become BC5; masks (*_mask) are filtered linearly; other
+// textures are color, BC3 if they have translucent pixels and BC1 otherwise.
+// --high-quality uses BC7 for everything but normal maps. The BC7 encoder
+// tries mode 6 only (one subset, 4-bit indices): smooth blocks and two-colour
+// edges come out well, but blocks with three or more distinct colours are
+// fitted by a single line and lose more than a multi-subset encoder would.
+// Color stays in *_UNORM formats unless --srgb is given, matching the
+// existing DDS files, which the renderer samples without sRGB decoding.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlockCompressor.h"
+#include "DdsWriter.h"
+#include "MipChain.h"
+#include "TgaDecoder.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+struct Options {
+  bool HighQuality = false;
+  bool Srgb = false;
+  unsigned Threads = 0;
+  fs::path OutputDirectory;
+  std::vector<fs::path> Inputs;
+};
+
+struct BakeStats {
+  double Megapixels = 0.0;
+  double PrepareSeconds = 0.0;
+  double EncodeSeconds = 0.0;
+};
+
+const char* GetFormatName(BlockFormat format) {
+  switch (format) {
+    case BlockFormat::kBC1:
+      return "BC1";
+    case BlockFormat::kBC3:
+      return "BC3";
+    case BlockFormat::kBC5:
+      return "BC5";
+    case BlockFormat::kBC7:
+      return "BC7";
+  }
+  return "?";
+}
+
+bool EndsWith(const std::string& text, const std::string& suffix) {
+  return text.size() >= suffix.size() &&
+         text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+Options ParseOptions(int argc, char** argv) {
+  Options options;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--high-quality") {
+      options.HighQuality = true;
+    } else if (argument == "--srgb") {
+      options.Srgb = true;
+    } else if (argument == "--threads" && i + 1 < argc) {
+      options.Threads = static_cast<unsigned>(std::stoul(argv[++i]));
+    } else if (argument.rfind("--", 0) == 0) {
+      throw std::invalid_argument("Unknown option " + argument);
+    } else {
+      positional.push_back(argument);
+    }
+  }
+  if (positional.size() < 2) {
+    throw std::invalid_argument(
+        "Usage: TextureBaker [--high-quality] [--srgb] [--threads N] "
+        "<output-dir> <file.tga | directory>...\n"
+        "  --high-quality  BC7 instead of BC1/BC3; mode 6 only, so blocks "
+        "of three or more colours lose detail");
+  }
+  options.OutputDirectory = positional[0];
+  for (size_t i = 1; i < positional.size(); ++i) {
+    const fs::path input = positional[i];
+    if (fs::is_directory(input)) {
+      std::vector<fs::path> files;
+      for (const fs::directory_entry& entry : fs::directory_iterator(input)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        if (entry.is_regular_file() && extension == ".tga") {
+          files.push_back(entry.path());
+        }
+      }
+      std::sort(files.begin(), files.end());
+      options.Inputs.insert(options.Inputs.end(), files.begin(), files.end());
+    } else {
+      options.Inputs.push_back(input);
+    }
+  }
+  if (options.Threads == 0) {
+    options.Threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return options;
+}
+
+BakeStats BakeTexture(const fs::path& input, const Options& options) {
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point start = Clock::now();
+
+  const std::string stem = input.stem().string();
+  const RgbaImage image = LoadTga(input.string());
+  TextureUsage usage = TextureUsage::kColor;
+  BlockFormat format = BlockFormat::kBC1;
+  if (EndsWith(stem, "_ddn")) {
+    usage = TextureUsage::kNormalMap;
+    format = BlockFormat::kBC5;
+  } else {
+    if (EndsWith(stem, "_mask")) {
+      usage = TextureUsage::kLinear;
+    }
+    if (options.HighQuality) {
+      format = BlockFormat::kBC7;
+    } else if (image.HasTranslucency()) {
+      format = BlockFormat::kBC3;
+    }
+  }
+  const std::vector<RgbaImage> mips = BuildMipChain(image, usage);
+  const Clock::time_point prepared = Clock::now();
+
+  BakeStats stats;
+  std::vector<std::vector<uint8_t>> compressed;
+  for (const RgbaImage& mip : mips) {
+    compressed.push_back(CompressImage(mip, format, options.Threads));
+    stats.Megapixels += mip.Width * static_cast<double>(mip.Height) / 1e6;
+  }
+  const Clock::time_point encoded = Clock::now();
+
+  const bool srgb = options.Srgb && usage == TextureUsage::kColor;
+  const fs::path output = options.OutputDirectory / (stem + ".dds");
+  WriteFile(output.string(), BuildDds(image.Width, image.Height, format, srgb,
+                                      compressed));
+
+  stats.PrepareSeconds =
+      std::chrono::duration<double>(prepared - start).count();
+  stats.EncodeSeconds =
+      std::chrono::duration<double>(encoded - prepared).count();
+  std::printf("%s: %ux%u, %zu mips, %s%s, %.1f MP/s\n",
+              output.filename().string().c_str(), image.Width, image.Height,
+              mips.size(), GetFormatName(format), srgb ? " sRGB" : "",
+              stats.Megapixels / stats.EncodeSeconds);
+  return stats;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  try {
+    const Options options = ParseOptions(argc, argv);
+    fs::create_directories(options.OutputDirectory);
+
+    BakeStats total;
+    int failures = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const fs::path& input : options.Inputs) {
+      try {
+        const BakeStats stats = BakeTexture(input, options);
+        total.Megapixels += stats.Megapixels;
+        total.PrepareSeconds += stats.PrepareSeconds;
+        total.EncodeSeconds += stats.EncodeSeconds;
+      } catch (const std::exception& error) {
+        std::fprintf(stderr, "%s: %s\n", input.string().c_str(), error.what());
+        ++failures;
+      }
+    }
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    std::printf(
+        "Baked %zu textures on %u threads: %.1f MP in %.2f s. Encode %.1f "
+        "MP/s, decode and mips %.1f MP/s, overall %.1f MP/s\n",
+        options.Inputs.size() - failures, options.Threads, total.Megapixels,
+        seconds, total.Megapixels / total.EncodeSeconds,
+        total.Megapixels / total.PrepareSeconds, total.Megapixels / seconds);
+    return failures == 0 ? 0 : 1;
+  } catch (const std::exception& error) {
+    std::fprintf(stderr, "%s\n", error.what());
+    return 2;
+  }
+}
@@ -0,0 +1,142 @@
+#include "TgaDecoder.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace {
+constexpr size_t kHeaderSize = 18;
+constexpr uint8_t kTrueColor = 2;
+constexpr uint8_t kGrayscale = 3;
+constexpr uint8_t kRleFlag = 8;
+// Image descriptor bits.
+constexpr uint8_t kRightToLeft = 0x10;
+constexpr uint8_t kTopToBottom = 0x20;
+
+// Converts one stored pixel to RGBA.
+void ReadPixel(const uint8_t* src, uint32_t bytesPerPixel, bool grayscale,
+               uint8_t* dst) {
+  if (grayscale) {
+    dst[0] = dst[1] = dst[2] = src[0];
+    dst[3] = 255;
+  } else if (bytesPerPixel == 2) {
+    // A1R5G5B5, little endian.
+    const uint32_t value = src[0] | (src[1] << 8);
+    const uint32_t r = (value >> 10) & 31;
+    const uint32_t g = (value >> 5) & 31;
+    const uint32_t b = value & 31;
+    dst[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+    dst[1] = static_cast<uint8_t>((g << 3) | (g >> 2));
+    dst[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+    dst[3] = (value & 0x8000) ? 255 : 0;
+  } else {
+    // BGR(A).
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = src[0];
+    dst[3] = bytesPerPixel == 4 ? src[3] : 255;
+  }
+}
+}  // namespace
+
+RgbaImage DecodeTga(const std::vector<uint8_t>& data) {
+  if (data.size() < kHeaderSize) {
+    throw std::runtime_error("TGA header is truncated");
+  }
+  const uint8_t idLength = data[0];
+  const uint8_t colorMapType = data[1];
+  const uint8_t imageType = data[2];
+  const uint32_t width = data[12] | (data[13] << 8);
+  const uint32_t height = data[14] | (data[15] << 8);
+  const uint8_t bitsPerPixel = data[16];
+  const uint8_t descriptor = data[17];
+
+  if (colorMapType != 0) {
+    throw std::runtime_error("Color-mapped TGA is not supported");
+  }
+  const uint8_t baseType = imageType & ~kRleFlag;
+  const bool rle = (imageType & kRleFlag) != 0;
+  if (baseType != kTrueColor && baseType != kGrayscale) {
+    throw std::runtime_error("Unsupported TGA image type " +
+                             std::to_string(imageType));
+  }
+  const bool grayscale = baseType == kGrayscale;
+  if (grayscale ? bitsPerPixel != 8
+                : bitsPerPixel != 16 && bitsPerPixel != 24 &&
+                      bitsPerPixel != 32) {
+    throw std::runtime_error("Unsupported TGA pixel depth " +
+                             std::to_string(bitsPerPixel));
+  }
+  if (width == 0 || height == 0) {
+    throw std::runtime_error("TGA image is empty");
+  }
+
+  const uint32_t bytesPerPixel = bitsPerPixel / 8;
+  const size_t pixelCount = static_cast<size_t>(width) * height;
+  size_t offset = kHeaderSize + idLength;
+
+  // Decoded in file order, then flipped into RgbaImage's row order.
+  std::vector<uint8_t> stored(pixelCount * 4);
+  if (!rle) {
+    if (data.size() < offset ||
+        data.size() - offset < pixelCount * bytesPerPixel) {
+      throw std::runtime_error("TGA pixel data is truncated");
+    }
+    for (size_t i = 0; i < pixelCount; ++i) {
+      ReadPixel(&data[offset + i * bytesPerPixel], bytesPerPixel, grayscale,
+                &stored[i * 4]);
+    }
+  } else {
+    size_t pixel = 0;
+    while (pixel < pixelCount) {
+      if (offset >= data.size()) {
+        throw std::runtime_error("TGA RLE data is truncated");
+      }
+      const uint8_t packet = data[offset++];
+      const size_t count =
+          std::min<size_t>((packet & 0x7f) + 1, pixelCount - pixel);
+      const bool repeated = (packet & 0x80) != 0;
+      const size_t needed = repeated ? bytesPerPixel : count * bytesPerPixel;
+      if (data.size() - offset < needed) {
+        throw std::runtime_error("TGA RLE data is truncated");
+      }
+      for (size_t i = 0; i < count; ++i) {
+        ReadPixel(&data[offset + (repeated ? 0 : i * bytesPerPixel)],
+                  bytesPerPixel, grayscale, &stored[(pixel + i) * 4]);
+      }
+      offset += needed;
+      pixel += count;
+    }
+  }
+
+  RgbaImage image;
+  image.Width = width;
+  image.Height = height;
+  image.Pixels.resize(pixelCount * 4);
+  const bool topToBottom = (descriptor & kTopToBottom) != 0;
+  const bool rightToLeft = (descriptor & kRightToLeft) != 0;
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint32_t srcY = topToBottom ? y : height - 1 - y;
+    for (uint32_t x = 0; x < width; ++x) {
+      const uint32_t srcX = rightToLeft ? width - 1 - x : x;
+      const size_t src = (static_cast<size_t>(srcY) * width + srcX) * 4;
+      const size_t dst = (static_cast<size_t>(y) * width + x) * 4;
+      for (int c = 0; c < 4; ++c) {
+        image.Pixels[dst + c] = stored[src + c];
+      }
+    }
+  }
+  return image;
+}
+
+RgbaImage LoadTga(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+  return DecodeTga(data);
+}
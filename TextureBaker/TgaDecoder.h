@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "RgbaImage.h"
+
+// Decodes uncompressed and RLE TGA files with 8-bit grayscale or 16, 24 and
+// 32-bit true color pixels. Color-mapped images are not supported. Throws
+// std::runtime_error on malformed or unsupported data.
+RgbaImage DecodeTga(const std::vector<uint8_t>& data);
+RgbaImage LoadTga(const std::string& path);